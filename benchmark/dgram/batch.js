@@ -0,0 +1,66 @@
+// Test UDP send/recv throughput of socket.sendBatch() and of sockets that
+// receive in batches, against one send() per datagram.
+'use strict';
+
+const common = require('../common.js');
+const dgram = require('dgram');
+const PORT = common.PORT;
+
+// `num` is the number of datagrams to send each time, either as `num` send()
+// calls or as one sendBatch() call.
+const bench = common.createBenchmark(main, {
+  len: [64, 256, 1024],
+  num: [100],
+  method: ['send', 'sendBatch'],
+  recvBatch: ['false', 'true'],
+  type: ['send', 'recv'],
+  dur: [5]
+});
+
+function main({ dur, len, num, method, recvBatch, type }) {
+  const chunk = Buffer.allocUnsafe(len);
+  const messages = new Array(num).fill(chunk);
+  var sent = 0;
+  var received = 0;
+  const socket = dgram.createSocket({
+    type: 'udp4',
+    recvBatch: recvBatch === 'true'
+  });
+
+  function onsend() {
+    if (sent++ % num === 0) {
+      // The setImmediate() is necessary to have event loop progress on OSes
+      // that only perform synchronous I/O on nonblocking UDP sockets.
+      setImmediate(() => {
+        if (method === 'sendBatch') {
+          socket.sendBatch(messages, PORT, '127.0.0.1', () => {
+            sent += num - 1;
+            onsend();
+          });
+          return;
+        }
+        for (var i = 0; i < num; i++) {
+          socket.send(chunk, PORT, '127.0.0.1', onsend);
+        }
+      });
+    }
+  }
+
+  socket.on('listening', () => {
+    bench.start();
+    onsend();
+
+    setTimeout(() => {
+      const bytes = (type === 'send' ? sent : received) * len;
+      const gbits = (bytes * 8) / (1024 * 1024 * 1024);
+      bench.end(gbits);
+      process.exit(0);
+    }, dur * 1000);
+  });
+
+  socket.on('message', () => {
+    received++;
+  });
+
+  socket.bind(PORT);
+}
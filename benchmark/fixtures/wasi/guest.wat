@@ -0,0 +1,143 @@
+;; Guest for the WASI benchmarks. Each exported loop makes the same syscall
+;; `n` times from WebAssembly, so that the whole path from guest code through
+;; the bindings into uvwasi is measured, and returns the first nonzero errno.
+;;
+;; Memory layout:
+;;   0     result of the last syscall
+;;   16    iovec that fd_read and fd_write use, pointing at the buffer
+;;   24    iovec that copy() writes from, pointing at the buffer
+;;   64    path for path_open(), written by the host
+;;   1024  buffer, up to 64 KiB
+;;
+;; Assembled into guest.wasm without a name section.
+(module
+  (import "wasi_unstable" "clock_time_get"
+    (func $wasi_clock_time_get (param i32 i64 i32) (result i32)))
+  (import "wasi_unstable" "fd_close"
+    (func $wasi_fd_close (param i32) (result i32)))
+  (import "wasi_unstable" "fd_read"
+    (func $wasi_fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_unstable" "fd_readdir"
+    (func $wasi_fd_readdir (param i32 i32 i32 i64 i32) (result i32)))
+  (import "wasi_unstable" "fd_write"
+    (func $wasi_fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_unstable" "path_open"
+    (func $wasi_path_open
+      (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+
+  (memory 2)
+  (export "memory" (memory 0))
+
+  (func $start)
+  (export "_start" (func $start))
+
+  ;; Points the iovec at 16 at the first `len` bytes of the buffer.
+  (func $set_iovec (param $len i32)
+    (i32.store (i32.const 16) (i32.const 1024))
+    (i32.store (i32.const 20) (local.get $len)))
+
+  ;; clock_time_get(CLOCK_MONOTONIC).
+  (func $clock_time_get (param $n i32) (result i32)
+    (local $err i32)
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (local.set $err
+          (call $wasi_clock_time_get (i32.const 1) (i64.const 0) (i32.const 0)))
+        (br_if $done (local.get $err))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)))
+    (local.get $err))
+  (export "clock_time_get" (func $clock_time_get))
+
+  ;; fd_write() of `len` bytes to `fd`.
+  (func $fd_write (param $n i32) (param $fd i32) (param $len i32) (result i32)
+    (local $err i32)
+    (call $set_iovec (local.get $len))
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (local.set $err
+          (call $wasi_fd_write
+            (local.get $fd) (i32.const 16) (i32.const 1) (i32.const 0)))
+        (br_if $done (local.get $err))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)))
+    (local.get $err))
+  (export "fd_write" (func $fd_write))
+
+  ;; fd_read() of up to `len` bytes from `fd`.
+  (func $fd_read (param $n i32) (param $fd i32) (param $len i32) (result i32)
+    (local $err i32)
+    (call $set_iovec (local.get $len))
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (local.set $err
+          (call $wasi_fd_read
+            (local.get $fd) (i32.const 16) (i32.const 1) (i32.const 0)))
+        (br_if $done (local.get $err))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)))
+    (local.get $err))
+  (export "fd_read" (func $fd_read))
+
+  ;; path_open() of the path at 64 relative to `dirfd` for reading, followed
+  ;; by fd_close() of the new fd.
+  (func $path_open (param $n i32) (param $dirfd i32) (param $len i32)
+    (result i32)
+    (local $err i32)
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (local.set $err
+          (call $wasi_path_open
+            (local.get $dirfd) (i32.const 0) (i32.const 64) (local.get $len)
+            (i32.const 0) (i64.const 2) (i64.const 0) (i32.const 0)
+            (i32.const 0)))
+        (br_if $done (local.get $err))
+        (local.set $err (call $wasi_fd_close (i32.load (i32.const 0))))
+        (br_if $done (local.get $err))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)))
+    (local.get $err))
+  (export "path_open" (func $path_open))
+
+  ;; fd_readdir() of the first `len` bytes of the entries of `fd`.
+  (func $fd_readdir (param $n i32) (param $fd i32) (param $len i32)
+    (result i32)
+    (local $err i32)
+    (block $done
+      (loop $next
+        (br_if $done (i32.eqz (local.get $n)))
+        (local.set $err
+          (call $wasi_fd_readdir
+            (local.get $fd) (i32.const 1024) (local.get $len) (i64.const 0)
+            (i32.const 0)))
+        (br_if $done (local.get $err))
+        (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+        (br $next)))
+    (local.get $err))
+  (export "fd_readdir" (func $fd_readdir))
+
+  ;; Copies `src` to `dst` in chunks of `len` bytes until fd_read() reaches
+  ;; the end of `src`. Regular files are written completely by each fd_write().
+  (func $copy (param $src i32) (param $dst i32) (param $len i32) (result i32)
+    (local $err i32)
+    (call $set_iovec (local.get $len))
+    (i32.store (i32.const 24) (i32.const 1024))
+    (block $done
+      (loop $next
+        (local.set $err
+          (call $wasi_fd_read
+            (local.get $src) (i32.const 16) (i32.const 1) (i32.const 0)))
+        (br_if $done (local.get $err))
+        (br_if $done (i32.eqz (i32.load (i32.const 0))))
+        (i32.store (i32.const 28) (i32.load (i32.const 0)))
+        (local.set $err
+          (call $wasi_fd_write
+            (local.get $dst) (i32.const 24) (i32.const 1) (i32.const 0)))
+        (br_if $done (local.get $err))
+        (br $next)))
+    (local.get $err))
+  (export "copy" (func $copy)))
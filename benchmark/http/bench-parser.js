@@ -3,13 +3,14 @@
 const common = require('../common');
 
 const bench = common.createBenchmark(main, {
-  len: [4, 8, 16, 32],
+  len: [4, 8, 16, 32, 64, 128],
+  flat: [0, 1],
   n: [1e5]
 }, {
   flags: ['--expose-internals', '--no-warnings']
 });
 
-function main({ len, n }) {
+function main({ len, flat, n }) {
   const { HTTPParser } = common.binding('http_parser');
   const REQUEST = HTTPParser.REQUEST;
   const kOnHeaders = HTTPParser.kOnHeaders | 0;
@@ -17,6 +18,9 @@ function main({ len, n }) {
   const kOnBody = HTTPParser.kOnBody | 0;
   const kOnMessageComplete = HTTPParser.kOnMessageComplete | 0;
   const CRLF = '\r\n';
+  // With `flat`, headers are passed as a Buffer and offsets, like the http
+  // module does, instead of as arrays of strings flushed every 32 headers.
+  const headerOffsets = flat ? new Uint32Array(4002) : undefined;
 
   function processHeader(header, n) {
     const parser = newParser(REQUEST);
@@ -24,14 +28,14 @@ function main({ len, n }) {
     bench.start();
     for (let i = 0; i < n; i++) {
       parser.execute(header, 0, header.length);
-      parser.initialize(REQUEST, {});
+      parser.initialize(REQUEST, {}, headerOffsets);
     }
     bench.end(n);
   }
 
   function newParser(type) {
     const parser = new HTTPParser();
-    parser.initialize(type, {});
+    parser.initialize(type, {}, headerOffsets);
 
     parser.headers = [];
 
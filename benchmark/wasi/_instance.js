@@ -0,0 +1,73 @@
+'use strict';
+/* global WebAssembly */
+
+// Shared setup for the WASI benchmarks. The module used by createInstance()
+// only exports one page of memory and an empty _start function, so the
+// benchmarks can drive wasiImport directly and measure the cost of the
+// bindings themselves. The guest from benchmark/fixtures/wasi/guest.wat makes
+// syscalls in loops from WebAssembly instead, which includes the cost of
+// calling out of the guest.
+
+const fs = require('fs');
+const path = require('path');
+
+const kModule = fs.readFileSync(
+  path.resolve(__dirname, '../../test/fixtures/wasi/memory.wasm'));
+const kGuest = fs.readFileSync(
+  path.resolve(__dirname, '../fixtures/wasi/guest.wasm'));
+
+const kPreopenFd = 3;
+const kRightsReadSeek = BigInt((1 << 1) | (1 << 2));
+const kRightsReadWriteSeek = BigInt((1 << 1) | (1 << 2) | (1 << 6));
+const kOpenCreat = 1 << 0;
+const kOpenTrunc = 1 << 3;
+
+function createInstance(options) {
+  const { WASI } = require('wasi');
+  const wasi = new WASI(options);
+  const mod = new WebAssembly.Module(kModule);
+  const instance = new WebAssembly.Instance(mod, {
+    wasi_unstable: wasi.wasiImport
+  });
+  wasi.start(instance);
+  return { wasi, memory: instance.exports.memory };
+}
+
+// Instantiates and starts the guest. Its exports are the syscall loops and
+// `memory`.
+function createGuest(wasi) {
+  const mod = new WebAssembly.Module(kGuest);
+  const instance = new WebAssembly.Instance(mod, {
+    wasi_unstable: wasi.wasiImport
+  });
+  wasi.start(instance);
+  return instance.exports;
+}
+
+// Opens `name` relative to the first preopened directory, using the start of
+// guest memory as scratch space. Returns the guest file descriptor.
+function openFile(wasi, memory, name, oflags = kOpenCreat | kOpenTrunc,
+                  rights = kRightsReadWriteSeek) {
+  const view = new DataView(memory.buffer);
+  const nameLength = Buffer.from(memory.buffer).write(name, 4);
+  const err = wasi.wasiImport.path_open(kPreopenFd,
+                                        0,
+                                        4,
+                                        nameLength,
+                                        oflags,
+                                        rights,
+                                        0n,
+                                        0,
+                                        0);
+  if (err !== 0)
+    throw new Error(`path_open(${name}) failed with ${err}`);
+  return view.getUint32(0, true);
+}
+
+module.exports = {
+  createInstance,
+  createGuest,
+  openFile,
+  kGuest,
+  kRightsReadSeek
+};
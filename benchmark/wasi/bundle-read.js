@@ -0,0 +1,60 @@
+'use strict';
+
+// Compares fd_pread on a file in a host directory with the same file served
+// from a bundle, either packed in memory or mapped from a bundle file.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+const {
+  createInstance, openFile, kRightsReadSeek
+} = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  backend: ['directory', 'memory', 'file'],
+  bufferSize: [64, 4096],
+  n: [1e5]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+// Guest memory layout.
+const kResultPtr = 512;
+const kIovsPtr = 1024;
+const kBufferPtr = 4096;
+
+function main({ backend, bufferSize, n }) {
+  const { createBundle } = require('wasi');
+  const contents = Buffer.alloc(bufferSize, 'x');
+
+  tmpdir.refresh();
+  let preopen;
+  const options = {};
+  if (backend === 'directory') {
+    fs.writeFileSync(path.join(tmpdir.path, 'asset'), contents);
+    preopen = tmpdir.path;
+  } else if (backend === 'memory') {
+    preopen = { asset: contents };
+  } else {
+    const file = path.join(tmpdir.path, 'assets.bundle');
+    fs.writeFileSync(file, createBundle({ asset: contents }));
+    options.bundles = { '/assets': file };
+  }
+  if (preopen !== undefined)
+    options.preopens = { '/assets': preopen };
+
+  const { wasi, memory } = createInstance(options);
+  const fd = openFile(wasi, memory, 'asset', 0, kRightsReadSeek);
+  const view = new DataView(memory.buffer);
+  view.setUint32(kIovsPtr, kBufferPtr, true);
+  view.setUint32(kIovsPtr + 4, bufferSize, true);
+
+  const { fd_pread } = wasi.wasiImport;
+  bench.start();
+  for (let i = 0; i < n; i++)
+    fd_pread(fd, kIovsPtr, 1, 0n, kResultPtr);
+  bench.end(n);
+
+  wasi.wasiImport.fd_close(fd);
+}
@@ -0,0 +1,41 @@
+'use strict';
+
+// Copies a file from the guest with fd_read() and fd_write() in chunks of
+// `bufferSize` bytes, and reports the throughput in MiB per second.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+const { createGuest, openFile, kRightsReadSeek } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  size: [1 << 20, 16 << 20],
+  bufferSize: [4096, 65536],
+  n: [10]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+function main({ size, bufferSize, n }) {
+  const { WASI } = require('wasi');
+
+  tmpdir.refresh();
+  fs.writeFileSync(path.join(tmpdir.path, 'source'), Buffer.alloc(size, 'x'));
+
+  const wasi = new WASI({ preopens: { '/sandbox': tmpdir.path } });
+  const guest = createGuest(wasi);
+  const { fd_close } = wasi.wasiImport;
+
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    const src = openFile(wasi, guest.memory, 'source', 0, kRightsReadSeek);
+    const dst = openFile(wasi, guest.memory, 'copy');
+    const err = guest.copy(src, dst, bufferSize);
+    fd_close(src);
+    fd_close(dst);
+    if (err !== 0)
+      throw new Error(`copy failed with ${err}`);
+  }
+  bench.end(n * size / (1024 * 1024));
+}
@@ -0,0 +1,64 @@
+'use strict';
+/* global WebAssembly */
+
+// Measures the steps of running a WASI application: creating the WASI
+// instance, which opens the preopened directories, instantiating the guest
+// against its imports, and calling start() on the result. The preopened
+// directories stay open until the WASI instances are garbage collected, so
+// `n` is kept low enough not to run out of file descriptors.
+
+const common = require('../common.js');
+const tmpdir = require('../../test/common/tmpdir');
+const { kGuest } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  phase: ['construct', 'instantiate', 'start'],
+  preopens: [0, 1, 4],
+  n: [200]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+function main({ phase, preopens, n }) {
+  const { WASI } = require('wasi');
+
+  tmpdir.refresh();
+  const options = {
+    args: ['guest', '--flag', 'value'],
+    env: { HOME: '/home', PATH: '/bin' },
+    preopens: {}
+  };
+  for (let i = 0; i < preopens; i++)
+    options.preopens[`/sandbox${i}`] = tmpdir.path;
+
+  const mod = new WebAssembly.Module(kGuest);
+  let i;
+
+  if (phase === 'construct') {
+    bench.start();
+    for (i = 0; i < n; i++)
+      new WASI(options);
+    bench.end(n);
+    return;
+  }
+
+  const wasi = new WASI(options);
+  const imports = { wasi_unstable: wasi.wasiImport };
+
+  if (phase === 'instantiate') {
+    bench.start();
+    for (i = 0; i < n; i++)
+      new WebAssembly.Instance(mod, imports);
+    bench.end(n);
+    return;
+  }
+
+  const instances = [];
+  for (i = 0; i < n; i++)
+    instances.push(new WebAssembly.Instance(mod, imports));
+
+  bench.start();
+  for (i = 0; i < n; i++)
+    wasi.start(instances[i]);
+  bench.end(n);
+}
@@ -0,0 +1,79 @@
+'use strict';
+
+// Measures syscalls made by a WebAssembly guest in a loop, which unlike
+// syscall-overhead.js includes the transition out of the guest and back.
+// The files are chosen so that the host side does as little as possible:
+// one byte reads and writes of the null and zero devices, opening a file in
+// the preopened directory, and reading the first entries of a directory.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+const { createGuest, openFile, kRightsReadSeek } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  syscall: ['clock_time_get', 'fd_write', 'fd_read', 'path_open', 'fd_readdir'],
+  n: [1e5]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+const kPreopenFd = 3;
+const kPathPtr = 64;
+const kEntries = 100;
+
+function main({ syscall, n }) {
+  const { WASI } = require('wasi');
+
+  tmpdir.refresh();
+  for (let i = 0; i < kEntries; i++)
+    fs.writeFileSync(path.join(tmpdir.path, `file${i}`), 'x');
+
+  // Windows has no null or zero devices, so a file is used for both.
+  const preopens = { '/sandbox': tmpdir.path };
+  let device = 'file0';
+  let deviceFd = kPreopenFd;
+  if (process.platform !== 'win32') {
+    preopens['/dev'] = '/dev';
+    deviceFd = kPreopenFd + 1;
+  }
+
+  const wasi = new WASI({ preopens });
+  const guest = createGuest(wasi);
+  let fd;
+  let len;
+
+  switch (syscall) {
+    case 'clock_time_get':
+      break;
+    case 'fd_write':
+      if (deviceFd !== kPreopenFd)
+        device = 'null';
+      fd = openFile(wasi, guest.memory, device, 0);
+      len = 1;
+      break;
+    case 'fd_read':
+      if (deviceFd !== kPreopenFd)
+        device = 'zero';
+      fd = openFile(wasi, guest.memory, device, 0, kRightsReadSeek);
+      len = 1;
+      break;
+    case 'path_open':
+      fd = kPreopenFd;
+      len = Buffer.from(guest.memory.buffer).write('file0', kPathPtr);
+      break;
+    case 'fd_readdir':
+      fd = kPreopenFd;
+      len = 4096;
+      break;
+  }
+
+  const loop = guest[syscall];
+  bench.start();
+  const err = loop(n, fd, len);
+  bench.end(n);
+
+  if (err !== 0)
+    throw new Error(`${syscall} failed with ${err}`);
+}
@@ -0,0 +1,52 @@
+'use strict';
+
+// Measures the cost of marshalling guest iovecs for the vectored WASI
+// syscalls. Each call hands `iovs` small buffers to fd_pread/fd_pwrite at
+// offset 0, so the file size stays bounded and the syscall itself is cheap.
+
+const common = require('../common.js');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+const { createInstance, openFile } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  method: ['fd_pwrite', 'fd_pread'],
+  iovs: [1, 4, 16, 64],
+  n: [1e5]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+const kBufferSize = 16;
+
+// Guest memory layout.
+const kResultPtr = 512;
+const kIovsPtr = 1024;
+const kBuffersPtr = 4096;
+
+function main({ method, iovs, n }) {
+  tmpdir.refresh();
+  const { wasi, memory } = createInstance({
+    preopens: { '/sandbox': tmpdir.path }
+  });
+  const fd = openFile(wasi, memory, path.basename(__filename));
+  const view = new DataView(memory.buffer);
+
+  for (let i = 0; i < iovs; i++) {
+    view.setUint32(kIovsPtr + i * 8, kBuffersPtr + i * kBufferSize, true);
+    view.setUint32(kIovsPtr + i * 8 + 4, kBufferSize, true);
+  }
+
+  // Make sure fd_pread has data to read back.
+  const err = wasi.wasiImport.fd_pwrite(fd, kIovsPtr, iovs, 0n, kResultPtr);
+  if (err !== 0)
+    throw new Error(`fd_pwrite() failed with ${err}`);
+
+  const fn = wasi.wasiImport[method];
+  bench.start();
+  for (let i = 0; i < n; i++)
+    fn(fd, kIovsPtr, iovs, 0n, kResultPtr);
+  bench.end(n);
+
+  wasi.wasiImport.fd_close(fd);
+}
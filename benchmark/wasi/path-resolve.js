@@ -0,0 +1,48 @@
+'use strict';
+
+// Measures path resolution by stat()ing a file `depth` directories below the
+// preopened directory. Every component is walked and checked for symlinks
+// unless the resolver can skip it.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+const { createInstance } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  depth: [1, 4, 16],
+  n: [1e5]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+const kPreopenFd = 3;
+const kFilestatPtr = 0;
+const kPathPtr = 64;
+
+function main({ depth, n }) {
+  tmpdir.refresh();
+  const segments = [];
+  for (let i = 0; i < depth; i++)
+    segments.push(`dir${i}`);
+  fs.mkdirSync(path.join(tmpdir.path, ...segments), { recursive: true });
+  fs.writeFileSync(path.join(tmpdir.path, ...segments, 'file'), '');
+
+  const { wasi, memory } = createInstance({
+    preopens: { '/sandbox': tmpdir.path }
+  });
+  const name = [...segments, 'file'].join('/');
+  const nameLength = Buffer.from(memory.buffer).write(name, kPathPtr);
+  const { path_filestat_get } = wasi.wasiImport;
+
+  const err = path_filestat_get(kPreopenFd, 0, kPathPtr, nameLength,
+                                kFilestatPtr);
+  if (err !== 0)
+    throw new Error(`path_filestat_get() failed with ${err}`);
+
+  bench.start();
+  for (let i = 0; i < n; i++)
+    path_filestat_get(kPreopenFd, 0, kPathPtr, nameLength, kFilestatPtr);
+  bench.end(n);
+}
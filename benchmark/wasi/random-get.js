@@ -0,0 +1,29 @@
+'use strict';
+
+// Measures random_get() for the request sizes guests typically use, from
+// hash map seeds to UUIDs. Requests are served from a buffered ChaCha20
+// stream that is reseeded from the host every MiB, so running this under
+// `strace -c -f -e trace=getrandom` shows a handful of getrandom() calls
+// instead of one per request.
+
+const common = require('../common.js');
+const { createInstance } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  size: [8, 16, 256, 4096],
+  n: [1e5]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+const kBufferPtr = 4096;
+
+function main({ size, n }) {
+  const { wasi } = createInstance({});
+  const { random_get } = wasi.wasiImport;
+
+  bench.start();
+  for (let i = 0; i < n; i++)
+    random_get(kBufferPtr, size);
+  bench.end(n);
+}
@@ -0,0 +1,67 @@
+'use strict';
+
+// Lists a directory of `entries` files through fd_readdir, `bufferSize` bytes
+// at a time, resuming from the cookie of the last complete entry like a
+// libc readdir() implementation does.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+const { createInstance } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  entries: [1e3, 1e4],
+  bufferSize: [4096],
+  n: [10]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+const kPreopenFd = 3;
+const kDirentSize = 24;
+const kUsedPtr = 0;
+const kBufPtr = 8;
+
+function listDirectory(fd_readdir, view, bufferSize) {
+  let cookie = 0n;
+  let count = 0;
+
+  for (;;) {
+    fd_readdir(kPreopenFd, kBufPtr, bufferSize, cookie, kUsedPtr);
+    const used = view.getUint32(kUsedPtr, true);
+    let offset = 0;
+
+    while (offset + kDirentSize <= used) {
+      const nameLength = view.getUint32(kBufPtr + offset + 16, true);
+      if (offset + kDirentSize + nameLength > used)
+        break;
+      cookie = view.getBigUint64(kBufPtr + offset, true);
+      offset += kDirentSize + nameLength;
+      count++;
+    }
+
+    if (used < bufferSize)
+      return count;
+  }
+}
+
+function main({ entries, bufferSize, n }) {
+  tmpdir.refresh();
+  for (let i = 0; i < entries; i++)
+    fs.writeFileSync(path.join(tmpdir.path, `entry-${i}`), '');
+
+  const { wasi, memory } = createInstance({
+    preopens: { '/sandbox': tmpdir.path }
+  });
+  const view = new DataView(memory.buffer);
+  const { fd_readdir } = wasi.wasiImport;
+
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    const count = listDirectory(fd_readdir, view, bufferSize);
+    if (count < entries)
+      throw new Error(`expected ${entries} entries, got ${count}`);
+  }
+  bench.end(n * entries);
+}
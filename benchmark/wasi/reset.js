@@ -0,0 +1,49 @@
+'use strict';
+/* global WebAssembly */
+
+// Measures how long it takes to get a WASI instance ready for the next guest,
+// either by constructing a new one or by resetting a pooled one, and starting
+// the guest with it.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+
+const bench = common.createBenchmark(main, {
+  mode: ['construct', 'reset'],
+  preopens: [1, 8],
+  n: [1e4]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+function main({ mode, preopens, n }) {
+  const { WASI } = require('wasi');
+  const bytes = fs.readFileSync(
+    path.resolve(__dirname, '../../test/fixtures/wasi/memory.wasm'));
+  const mod = new WebAssembly.Module(bytes);
+
+  tmpdir.refresh();
+  const options = { preopens: {}, returnOnExit: true };
+  for (let i = 0; i < preopens; i++) {
+    const dir = path.join(tmpdir.path, `dir${i}`);
+    fs.mkdirSync(dir);
+    options.preopens[`/dir${i}`] = dir;
+  }
+
+  let wasi = new WASI(options);
+
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    if (mode === 'reset')
+      wasi.reset();
+    else
+      wasi = new WASI(options);
+    const instance = new WebAssembly.Instance(mod, {
+      wasi_unstable: wasi.wasiImport
+    });
+    wasi.start(instance);
+  }
+  bench.end(n);
+}
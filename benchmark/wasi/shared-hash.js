@@ -0,0 +1,137 @@
+'use strict';
+/* global WebAssembly */
+
+// Hashes a directory of files on a number of worker threads that share one
+// WASI context and one shared memory, like the threads of a WebAssembly
+// application do. Each worker reads its files through the shared fd table in
+// its own region of the memory, and hashes what it read.
+
+const common = require('../common.js');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../../test/common/tmpdir');
+
+const bench = common.createBenchmark(main, {
+  threads: [1, 2, 4],
+  files: [32],
+  fileSize: [1 << 20]
+}, {
+  flags: ['--experimental-wasi', '--experimental-wasm-threads',
+          '--no-warnings']
+});
+
+const kChunkSize = 64 * 1024;
+// Each worker gets a region for its chunk buffer and syscall arguments.
+const kRegionPages = 2;
+const kPageSize = 64 * 1024;
+
+const kWorkerSource = `
+'use strict';
+const { createHash } = require('crypto');
+const { parentPort, workerData } = require('worker_threads');
+const { WASI } = require('wasi');
+
+const { context, memory, base, chunkSize } = workerData;
+const kPreopenFd = 3;
+const kRightsRead = 1n << 1n;
+const kResultPtr = base;
+const kIovPtr = base + 8;
+const kPathPtr = base + 16;
+const kDataPtr = base + 256;
+
+const wasi = new WASI({ context });
+wasi.setMemory(memory);
+const { fd_close, fd_read, path_open } = wasi.wasiImport;
+const view = new DataView(memory.buffer);
+const bytes = Buffer.from(memory.buffer);
+view.setUint32(kIovPtr, kDataPtr, true);
+view.setUint32(kIovPtr + 4, chunkSize, true);
+
+function check(err, name) {
+  if (err !== 0)
+    throw new Error(name + ' failed with ' + err);
+}
+
+parentPort.on('message', (names) => {
+  for (const name of names) {
+    const length = bytes.write(name, kPathPtr);
+    check(path_open(kPreopenFd, 0, kPathPtr, length, 0, kRightsRead, 0n, 0,
+                    kResultPtr), 'path_open');
+    const fd = view.getUint32(kResultPtr, true);
+    const hash = createHash('sha256');
+    for (;;) {
+      check(fd_read(fd, kIovPtr, 1, kResultPtr), 'fd_read');
+      const nread = view.getUint32(kResultPtr, true);
+      if (nread === 0)
+        break;
+      hash.update(bytes.subarray(kDataPtr, kDataPtr + nread));
+    }
+    hash.digest();
+    check(fd_close(fd), 'fd_close');
+  }
+  parentPort.postMessage('done');
+});
+parentPort.postMessage('ready');
+`;
+
+function main({ threads, files, fileSize }) {
+  const { Worker } = require('worker_threads');
+  const { WASI } = require('wasi');
+
+  tmpdir.refresh();
+  const contents = Buffer.alloc(fileSize, 'x');
+  const names = [];
+  for (let i = 0; i < files; i++) {
+    names.push(`file${i}`);
+    fs.writeFileSync(path.join(tmpdir.path, names[i]), contents);
+  }
+
+  const wasi = new WASI({ preopens: { '/data': tmpdir.path }, shared: true });
+  const pages = threads * kRegionPages;
+  const memory = new WebAssembly.Memory({
+    initial: pages,
+    maximum: pages,
+    shared: true
+  });
+  wasi.setMemory(memory);
+
+  const workers = [];
+  let ready = 0;
+  let done = 0;
+
+  for (let i = 0; i < threads; i++) {
+    const worker = new Worker(kWorkerSource, {
+      eval: true,
+      workerData: {
+        context: wasi.context,
+        memory,
+        base: i * kRegionPages * kPageSize,
+        chunkSize: kChunkSize
+      }
+    });
+    worker.on('message', onMessage);
+    workers.push(worker);
+  }
+
+  function onMessage(message) {
+    if (message === 'ready') {
+      if (++ready === threads)
+        run();
+      return;
+    }
+
+    if (++done === threads) {
+      bench.end(files);
+      for (const worker of workers)
+        worker.terminate();
+    }
+  }
+
+  // Files are split evenly between the workers.
+  function run() {
+    bench.start();
+    workers.forEach((worker, i) => {
+      worker.postMessage(names.filter((name, j) => j % threads === i));
+    });
+  }
+}
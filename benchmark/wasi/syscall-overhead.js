@@ -0,0 +1,59 @@
+'use strict';
+
+// Measures the fixed per-call cost of the WASI bindings with syscalls that do
+// almost no work: a one byte fd_write to the null device and clock_time_get.
+// With `stats`, every call is also timed and recorded in a histogram.
+
+const common = require('../common.js');
+const tmpdir = require('../../test/common/tmpdir');
+const { createInstance, openFile } = require('./_instance.js');
+
+const bench = common.createBenchmark(main, {
+  syscall: ['fd_write', 'clock_time_get'],
+  stats: [0, 1],
+  n: [1e6]
+}, {
+  flags: ['--experimental-wasi', '--no-warnings']
+});
+
+// Guest memory layout.
+const kResultPtr = 512;
+const kIovsPtr = 1024;
+const kBufferPtr = 4096;
+
+const kClockMonotonic = 1;
+
+function main({ syscall, stats, n }) {
+  let preopens;
+  let name;
+
+  if (process.platform === 'win32') {
+    tmpdir.refresh();
+    preopens = { '/sandbox': tmpdir.path };
+    name = 'syscall-overhead.txt';
+  } else {
+    preopens = { '/dev': '/dev' };
+    name = 'null';
+  }
+
+  const { wasi, memory } = createInstance({ preopens, stats: stats === 1 });
+  const { fd_write, clock_time_get } = wasi.wasiImport;
+  const view = new DataView(memory.buffer);
+  let i;
+
+  if (syscall === 'fd_write') {
+    const fd = openFile(wasi, memory, name, 0);
+    view.setUint32(kIovsPtr, kBufferPtr, true);
+    view.setUint32(kIovsPtr + 4, 1, true);
+
+    bench.start();
+    for (i = 0; i < n; i++)
+      fd_write(fd, kIovsPtr, 1, kResultPtr);
+    bench.end(n);
+  } else {
+    bench.start();
+    for (i = 0; i < n; i++)
+      clock_time_get(kClockMonotonic, 0n, kResultPtr);
+    bench.end(n);
+  }
+}
@@ -23,23 +23,65 @@
 
 #if !defined(_WIN32)
 # include "unix/internal.h"
+# include "unix/atomic-ops.h"
 #endif
 
 #include <stdlib.h>
 
 #define MAX_THREADPOOL_SIZE 1024
 
+/* Number of fast I/O requests a worker runs in a row while CPU work is
+ * waiting in the same shard, so that a steady stream of file system requests
+ * can't starve uv_queue_work().
+ */
+#define MAX_FAST_IO_STREAK 8
+
+/* Workers look at the slow I/O queue every this many requests even when
+ * their shards aren't empty.
+ */
+#define SLOW_IO_POLL_INTERVAL 16
+
+/* Each worker owns a shard with a queue per kind of work. Requests are posted
+ * to the shard that their address hashes to, and workers that run out of work
+ * in their own shard steal from the others. Slow I/O lives in a global queue
+ * because only some of the threads may run it at a time.
+ *
+ * Idle workers sleep on the condition variable of their own shard. When there
+ * is one, a new request is handed to it directly instead of being queued, so
+ * the request runs right away just like it would with a single FIFO queue.
+ * Posting a request therefore only ever locks one shard: the idle worker is
+ * found through its `idle` flag, which is claimed with a compare-and-swap.
+ */
+struct uv__wq_shard {
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  QUEUE wq[2];  /* Indexed by UV__WORK_CPU and UV__WORK_FAST_IO. */
+  unsigned int fast_io_streak;
+  unsigned int ticks;
+  /* Set by the owner before it looks for work one last time and goes to
+   * sleep, cleared by whoever wins the compare-and-swap to wake it up.
+   */
+  int idle;
+  /* Protected by `mutex`, set by whoever cleared `idle`. */
+  int woken;
+  QUEUE* handoff;
+  /* Only used by the owner, for a request that was handed over while it had
+   * already found other work.
+   */
+  QUEUE* pending;
+};
+
 static uv_once_t once = UV_ONCE_INIT;
-static uv_cond_t cond;
 static uv_mutex_t mutex;
-static unsigned int idle_threads;
 static unsigned int slow_io_work_running;
 static unsigned int nthreads;
+static int exiting;
+static int idle_workers;
 static uv_thread_t* threads;
 static uv_thread_t default_threads[4];
-static QUEUE exit_message;
-static QUEUE wq;
-static QUEUE run_slow_work_message;
+static struct uv__wq_shard* shards;
+static struct uv__wq_shard default_shards[ARRAY_SIZE(default_threads)];
+static uv_sem_t* start_sem;
 static QUEUE slow_io_pending_wq;
 
 static unsigned int slow_work_thread_threshold(void) {
@@ -51,72 +93,270 @@ static void uv__cancelled(struct uv__work* w) {
 }
 
 
+/* Both are full memory barriers. */
+static int cas(int* ptr, int oldval, int newval) {
+#ifdef _WIN32
+  return InterlockedCompareExchange((LONG volatile*) ptr, newval, oldval);
+#else
+  return cmpxchgi(ptr, oldval, newval);
+#endif
+}
+
+
+/* Adds `n` to `idle_workers` and returns the old value. */
+static int idle_workers_add(int n) {
+  int val;
+
+  do
+    val = idle_workers;
+  while (cas(&idle_workers, val, val + n) != val);
+
+  return val;
+}
+
+
+static struct uv__wq_shard* shard_of(struct uv__work* w) {
+  uintptr_t h;
+
+  /* Requests are usually allocated on 16 byte boundaries, mix the rest. */
+  h = (uintptr_t) w >> 4;
+  h ^= h >> 7;
+  h ^= h >> 15;
+  return shards + h % nthreads;
+}
+
+
+/* `s->mutex` should be locked. */
+static QUEUE* shard_pop(struct uv__wq_shard* s) {
+  QUEUE* q;
+  int kind;
+
+  kind = UV__WORK_FAST_IO;
+  if (QUEUE_EMPTY(&s->wq[UV__WORK_FAST_IO]) ||
+      (s->fast_io_streak >= MAX_FAST_IO_STREAK &&
+       !QUEUE_EMPTY(&s->wq[UV__WORK_CPU]))) {
+    kind = UV__WORK_CPU;
+  }
+
+  if (QUEUE_EMPTY(&s->wq[kind]))
+    return NULL;
+
+  if (kind == UV__WORK_FAST_IO)
+    s->fast_io_streak++;
+  else
+    s->fast_io_streak = 0;
+
+  q = QUEUE_HEAD(&s->wq[kind]);
+  QUEUE_REMOVE(q);
+  QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
+  return q;
+}
+
+
+/* `mutex` should be locked. */
+static QUEUE* slow_io_pop(void) {
+  QUEUE* q;
+
+  if (QUEUE_EMPTY(&slow_io_pending_wq))
+    return NULL;
+
+  if (slow_io_work_running >= slow_work_thread_threshold())
+    return NULL;
+
+  slow_io_work_running++;
+  q = QUEUE_HEAD(&slow_io_pending_wq);
+  QUEUE_REMOVE(q);
+  QUEUE_INIT(q);
+  return q;
+}
+
+
+/* Takes the idle flag of a worker, starting with the one that owns `start`.
+ * Returns NULL if all workers are busy. The caller has to wake it up.
+ */
+static struct uv__wq_shard* claim_idle(struct uv__wq_shard* start) {
+  struct uv__wq_shard* s;
+  unsigned int i;
+
+  if (idle_workers_add(0) <= 0)
+    return NULL;
+
+  s = start;
+  for (i = 0; i < nthreads; i++) {
+    if (cas(&s->idle, 1, 0) == 1) {
+      idle_workers_add(-1);
+      return s;
+    }
+
+    if (++s == shards + nthreads)
+      s = shards;
+  }
+
+  return NULL;
+}
+
+
+/* Wakes up a claimed worker and hands it `q`, or lets it look for work
+ * itself when `q` is NULL.
+ */
+static void wake(struct uv__wq_shard* s, QUEUE* q) {
+  uv_mutex_lock(&s->mutex);
+  s->woken = 1;
+  s->handoff = q;
+  uv_cond_signal(&s->cond);
+  uv_mutex_unlock(&s->mutex);
+}
+
+
+/* Takes work from the other shards, starting after `self`. Shards that are
+ * locked by someone else are skipped, wait_for_work() looks at them again.
+ */
+static QUEUE* steal(struct uv__wq_shard* self) {
+  struct uv__wq_shard* s;
+  unsigned int i;
+  QUEUE* q;
+
+  s = self;
+  for (i = 1; i < nthreads; i++) {
+    if (++s == shards + nthreads)
+      s = shards;
+
+    if (uv_mutex_trylock(&s->mutex))
+      continue;
+    q = shard_pop(s);
+    uv_mutex_unlock(&s->mutex);
+
+    if (q != NULL)
+      return q;
+  }
+
+  return NULL;
+}
+
+
+/* Looks at the slow I/O queue and every shard, waiting for their locks. */
+static QUEUE* find_work(struct uv__wq_shard* self, int* is_slow_work) {
+  struct uv__wq_shard* s;
+  unsigned int i;
+  QUEUE* q;
+
+  uv_mutex_lock(&mutex);
+  q = slow_io_pop();
+  uv_mutex_unlock(&mutex);
+
+  if (q != NULL) {
+    *is_slow_work = 1;
+    return q;
+  }
+
+  s = self;
+  for (i = 0; i < nthreads; i++) {
+    uv_mutex_lock(&s->mutex);
+    q = shard_pop(s);
+    uv_mutex_unlock(&s->mutex);
+
+    if (q != NULL)
+      return q;
+
+    if (++s == shards + nthreads)
+      s = shards;
+  }
+
+  return NULL;
+}
+
+
+/* Sleeps until there is work in any shard, slow I/O work that may run, or a
+ * request handed over by post(). Returns NULL when the threadpool is shutting
+ * down.
+ */
+static QUEUE* wait_for_work(struct uv__wq_shard* self, int* is_slow_work) {
+  QUEUE* q;
+
+  for (;;) {
+    /* The worker is marked idle before it looks, and requests are queued
+     * before post() looks for an idle worker, so either this finds the
+     * request or post() wakes a worker up for it.
+     */
+    cas(&self->idle, 0, 1);
+    idle_workers_add(1);
+
+    q = find_work(self, is_slow_work);
+
+    uv_mutex_lock(&self->mutex);
+    if (q == NULL)
+      while (!self->woken && !exiting)
+        uv_cond_wait(&self->cond, &self->mutex);
+
+    if (!self->woken && cas(&self->idle, 1, 0) == 1) {
+      /* Found work or exiting, and nobody is about to wake us up. */
+      idle_workers_add(-1);
+      uv_mutex_unlock(&self->mutex);
+      return q;
+    }
+
+    /* Claimed by post() or by a finished slow I/O request. The flag is
+     * cleared before `woken` is set, so wait for the latter.
+     */
+    while (!self->woken)
+      uv_cond_wait(&self->cond, &self->mutex);
+
+    self->woken = 0;
+    if (q == NULL)
+      q = self->handoff;
+    else
+      self->pending = self->handoff;
+    self->handoff = NULL;
+    uv_mutex_unlock(&self->mutex);
+
+    if (q != NULL)
+      return q;
+  }
+}
+
+
 /* To avoid deadlock with uv_cancel() it's crucial that the worker
- * never holds the global mutex and the loop-local mutex at the same time.
+ * never holds the global mutex or a shard mutex and the loop-local mutex at
+ * the same time.
  */
 static void worker(void* arg) {
+  struct uv__wq_shard* self;
+  struct uv__wq_shard* s;
   struct uv__work* w;
   QUEUE* q;
   int is_slow_work;
+  int slow_io_pending;
 
-  uv_sem_post((uv_sem_t*) arg);
+  self = arg;
+  uv_sem_post(start_sem);
   arg = NULL;
 
-  uv_mutex_lock(&mutex);
   for (;;) {
-    /* `mutex` should always be locked at this point. */
-
-    /* Keep waiting while either no work is present or only slow I/O
-       and we're at the threshold for that. */
-    while (QUEUE_EMPTY(&wq) ||
-           (QUEUE_HEAD(&wq) == &run_slow_work_message &&
-            QUEUE_NEXT(&run_slow_work_message) == &wq &&
-            slow_io_work_running >= slow_work_thread_threshold())) {
-      idle_threads += 1;
-      uv_cond_wait(&cond, &mutex);
-      idle_threads -= 1;
-    }
+    q = self->pending;
+    self->pending = NULL;
+    is_slow_work = 0;
 
-    q = QUEUE_HEAD(&wq);
-    if (q == &exit_message) {
-      uv_cond_signal(&cond);
+    if (q == NULL && ++self->ticks % SLOW_IO_POLL_INTERVAL == 0) {
+      uv_mutex_lock(&mutex);
+      q = slow_io_pop();
       uv_mutex_unlock(&mutex);
-      break;
+      is_slow_work = (q != NULL);
     }
 
-    QUEUE_REMOVE(q);
-    QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
-
-    is_slow_work = 0;
-    if (q == &run_slow_work_message) {
-      /* If we're at the slow I/O threshold, re-schedule until after all
-         other work in the queue is done. */
-      if (slow_io_work_running >= slow_work_thread_threshold()) {
-        QUEUE_INSERT_TAIL(&wq, q);
-        continue;
-      }
-
-      /* If we encountered a request to run slow I/O work but there is none
-         to run, that means it's cancelled => Start over. */
-      if (QUEUE_EMPTY(&slow_io_pending_wq))
-        continue;
-
-      is_slow_work = 1;
-      slow_io_work_running++;
-
-      q = QUEUE_HEAD(&slow_io_pending_wq);
-      QUEUE_REMOVE(q);
-      QUEUE_INIT(q);
-
-      /* If there is more slow I/O work, schedule it to be run as well. */
-      if (!QUEUE_EMPTY(&slow_io_pending_wq)) {
-        QUEUE_INSERT_TAIL(&wq, &run_slow_work_message);
-        if (idle_threads > 0)
-          uv_cond_signal(&cond);
-      }
+    if (q == NULL) {
+      uv_mutex_lock(&self->mutex);
+      q = shard_pop(self);
+      uv_mutex_unlock(&self->mutex);
     }
 
-    uv_mutex_unlock(&mutex);
+    if (q == NULL)
+      q = steal(self);
+
+    if (q == NULL)
+      q = wait_for_work(self, &is_slow_work);
+
+    if (q == NULL)
+      break;
 
     w = QUEUE_DATA(q, struct uv__work, wq);
     w->work(w);
@@ -128,35 +368,50 @@ static void worker(void* arg) {
     uv_async_send(&w->loop->wq_async);
     uv_mutex_unlock(&w->loop->wq_mutex);
 
-    /* Lock `mutex` since that is expected at the start of the next
-     * iteration. */
-    uv_mutex_lock(&mutex);
     if (is_slow_work) {
-      /* `slow_io_work_running` is protected by `mutex`. */
+      /* `slow_io_work_running` is protected by `mutex`. Idle workers may
+       * have left slow I/O work alone because we were at the threshold.
+       */
+      uv_mutex_lock(&mutex);
       slow_io_work_running--;
+      slow_io_pending = !QUEUE_EMPTY(&slow_io_pending_wq);
+      uv_mutex_unlock(&mutex);
+
+      if (slow_io_pending && (s = claim_idle(self)) != NULL)
+        wake(s, NULL);
     }
   }
 }
 
 
-static void post(QUEUE* q, enum uv__work_kind kind) {
-  uv_mutex_lock(&mutex);
+static void post(struct uv__work* w, enum uv__work_kind kind) {
+  struct uv__wq_shard* s;
+
   if (kind == UV__WORK_SLOW_IO) {
-    /* Insert into a separate queue. */
-    QUEUE_INSERT_TAIL(&slow_io_pending_wq, q);
-    if (!QUEUE_EMPTY(&run_slow_work_message)) {
-      /* Running slow I/O tasks is already scheduled => Nothing to do here.
-         The worker that runs said other task will schedule this one as well. */
-      uv_mutex_unlock(&mutex);
+    uv_mutex_lock(&mutex);
+    QUEUE_INSERT_TAIL(&slow_io_pending_wq, &w->wq);
+    uv_mutex_unlock(&mutex);
+  } else {
+    s = claim_idle(shard_of(w));
+    if (s != NULL) {
+      /* A request that is handed over counts as executing for uv_cancel(). */
+      QUEUE_INIT(&w->wq);
+      wake(s, &w->wq);
       return;
     }
-    q = &run_slow_work_message;
+
+    s = shard_of(w);
+    uv_mutex_lock(&s->mutex);
+    QUEUE_INSERT_TAIL(&s->wq[kind], &w->wq);
+    uv_mutex_unlock(&s->mutex);
   }
 
-  QUEUE_INSERT_TAIL(&wq, q);
-  if (idle_threads > 0)
-    uv_cond_signal(&cond);
-  uv_mutex_unlock(&mutex);
+  /* A worker that went idle after the check above may have looked at the
+   * queue before the request was added.
+   */
+  s = claim_idle(shard_of(w));
+  if (s != NULL)
+    wake(s, NULL);
 }
 
 
@@ -167,20 +422,36 @@ UV_DESTRUCTOR(static void cleanup(void)) {
   if (nthreads == 0)
     return;
 
-  post(&exit_message, UV__WORK_CPU);
+  /* Workers read `exiting` with their own shard locked. */
+  for (i = 0; i < nthreads; i++)
+    uv_mutex_lock(&shards[i].mutex);
+  exiting = 1;
+  for (i = 0; i < nthreads; i++) {
+    uv_cond_signal(&shards[i].cond);
+    uv_mutex_unlock(&shards[i].mutex);
+  }
 
   for (i = 0; i < nthreads; i++)
     if (uv_thread_join(threads + i))
       abort();
 
+  for (i = 0; i < nthreads; i++) {
+    uv_mutex_destroy(&shards[i].mutex);
+    uv_cond_destroy(&shards[i].cond);
+  }
+
   if (threads != default_threads)
     uv__free(threads);
 
+  if (shards != default_shards)
+    uv__free(shards);
+
   uv_mutex_destroy(&mutex);
-  uv_cond_destroy(&cond);
 
   threads = NULL;
+  shards = NULL;
   nthreads = 0;
+  exiting = 0;
 }
 #endif
 
@@ -200,34 +471,52 @@ static void init_threads(void) {
     nthreads = MAX_THREADPOOL_SIZE;
 
   threads = default_threads;
+  shards = default_shards;
   if (nthreads > ARRAY_SIZE(default_threads)) {
     threads = uv__malloc(nthreads * sizeof(threads[0]));
-    if (threads == NULL) {
+    shards = uv__malloc(nthreads * sizeof(shards[0]));
+    if (threads == NULL || shards == NULL) {
+      uv__free(threads);
+      uv__free(shards);
       nthreads = ARRAY_SIZE(default_threads);
       threads = default_threads;
+      shards = default_shards;
     }
   }
 
-  if (uv_cond_init(&cond))
-    abort();
-
   if (uv_mutex_init(&mutex))
     abort();
 
-  QUEUE_INIT(&wq);
   QUEUE_INIT(&slow_io_pending_wq);
-  QUEUE_INIT(&run_slow_work_message);
+  idle_workers = 0;
+
+  for (i = 0; i < nthreads; i++) {
+    if (uv_mutex_init(&shards[i].mutex))
+      abort();
+    if (uv_cond_init(&shards[i].cond))
+      abort();
+    QUEUE_INIT(&shards[i].wq[UV__WORK_CPU]);
+    QUEUE_INIT(&shards[i].wq[UV__WORK_FAST_IO]);
+    shards[i].fast_io_streak = 0;
+    shards[i].ticks = 0;
+    shards[i].idle = 0;
+    shards[i].woken = 0;
+    shards[i].handoff = NULL;
+    shards[i].pending = NULL;
+  }
 
   if (uv_sem_init(&sem, 0))
     abort();
 
+  start_sem = &sem;
   for (i = 0; i < nthreads; i++)
-    if (uv_thread_create(threads + i, worker, &sem))
+    if (uv_thread_create(threads + i, worker, shards + i))
       abort();
 
   for (i = 0; i < nthreads; i++)
     uv_sem_wait(&sem);
 
+  start_sem = NULL;
   uv_sem_destroy(&sem);
 }
 
@@ -243,8 +532,8 @@ static void reset_once(void) {
 static void init_once(void) {
 #ifndef _WIN32
   /* Re-initialize the threadpool after fork.
-   * Note that this discards the global mutex and condition as well
-   * as the work queue.
+   * Note that this discards the global mutex and the shards as well
+   * as the work queues.
    */
   if (pthread_atfork(NULL, NULL, &reset_once))
     abort();
@@ -262,14 +551,22 @@ void uv__work_submit(uv_loop_t* loop,
   w->loop = loop;
   w->work = work;
   w->done = done;
-  post(&w->wq, kind);
+  post(w, kind);
 }
 
 
 static int uv__work_cancel(uv_loop_t* loop, uv_req_t* req, struct uv__work* w) {
+  struct uv__wq_shard* s;
   int cancelled;
 
+  uv_once(&once, init_once);
+
+  /* The request is either in the slow I/O queue or in the shard that its
+   * address hashes to, work is never moved between shards.
+   */
+  s = shard_of(w);
   uv_mutex_lock(&mutex);
+  uv_mutex_lock(&s->mutex);
   uv_mutex_lock(&w->loop->wq_mutex);
 
   cancelled = !QUEUE_EMPTY(&w->wq) && w->work != NULL;
@@ -277,6 +574,7 @@ static int uv__work_cancel(uv_loop_t* loop, uv_req_t* req, struct uv__work* w) {
     QUEUE_REMOVE(&w->wq);
 
   uv_mutex_unlock(&w->loop->wq_mutex);
+  uv_mutex_unlock(&s->mutex);
   uv_mutex_unlock(&mutex);
 
   if (!cancelled)
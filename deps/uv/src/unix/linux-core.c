@@ -36,6 +36,7 @@
 
 #include <net/if.h>
 #include <sys/epoll.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/prctl.h>
 #include <sys/sysinfo.h>
@@ -75,6 +76,52 @@
 # define CLOCK_BOOTTIME 7
 #endif
 
+/* Number of submission queue entries. The kernel makes the completion queue
+ * twice as large, which is also how many requests can be in flight at once.
+ */
+#define UV__IOU_SQ_ENTRIES 64
+
+/* A loop's io_uring instance, created when the loop first does file system
+ * I/O and kept in `loop->internal_fields`. `ringfd` is -1 when io_uring is
+ * disabled or unavailable, and requests then go to the threadpool.
+ *
+ * Submissions are batched: requests are added to the submission queue as
+ * they are made and handed to the kernel with one io_uring_enter() call
+ * right before the loop polls for I/O. The ring fd is watched like any other
+ * fd and becomes readable when there are completions.
+ */
+struct uv__iou {
+  uint32_t* sqhead;
+  uint32_t* sqtail;
+  uint32_t* sqarray;
+  uint32_t sqmask;
+  uint32_t* cqhead;
+  uint32_t* cqtail;
+  uint32_t cqmask;
+  uint32_t cq_entries;
+  uint32_t in_flight;
+  uint32_t unsubmitted;
+  struct uv__io_uring_sqe* sqe;
+  struct uv__io_uring_cqe* cqe;
+  void* sq;
+  void* cq;
+  size_t sqlen;
+  size_t cqlen;
+  size_t sqelen;
+  int ringfd;
+  uv__io_t watcher;
+};
+
+STATIC_ASSERT(16 == sizeof(struct uv__io_uring_cqe));
+STATIC_ASSERT(64 == sizeof(struct uv__io_uring_sqe));
+STATIC_ASSERT(120 == sizeof(struct uv__io_uring_params));
+
+static uv_once_t uv__iou_once = UV_ONCE_INIT;
+static int uv__iou_disabled;
+
+static void uv__iou_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
+static void uv__iou_delete(uv_loop_t* loop);
+static void uv__iou_submit(struct uv__iou* iou);
 static int read_models(unsigned int numcpus, uv_cpu_info_t* ci);
 static int read_times(FILE* statfile_fp,
                       unsigned int numcpus,
@@ -137,6 +184,8 @@ int uv__io_fork(uv_loop_t* loop) {
 
 
 void uv__platform_loop_delete(uv_loop_t* loop) {
+  uv__iou_delete(loop);
+
   if (loop->inotify_fd == -1) return;
   uv__io_stop(loop, &loop->inotify_read_watcher, POLLIN);
   uv__close(loop->inotify_fd);
@@ -198,6 +247,437 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 }
 
 
+static void uv__iou_init_once(void) {
+  const char* val;
+
+  val = getenv("UV_USE_IO_URING");
+  uv__iou_disabled = (val != NULL && atoi(val) == 0);
+}
+
+
+static int uv__iou_supported(int ringfd) {
+  static const uint8_t ops[] = {
+    UV__IORING_OP_READV,
+    UV__IORING_OP_WRITEV,
+    UV__IORING_OP_FSYNC,
+    UV__IORING_OP_OPENAT,
+    UV__IORING_OP_CLOSE,
+    UV__IORING_OP_STATX
+  };
+  struct uv__io_uring_probe probe;
+  size_t i;
+
+  /* Probing was added in the same kernel release, 5.6, as the last of the
+   * operations that libuv needs.
+   */
+  memset(&probe, 0, sizeof(probe));
+  if (uv__io_uring_register(ringfd,
+                            UV__IORING_REGISTER_PROBE,
+                            &probe,
+                            ARRAY_SIZE(probe.ops))) {
+    return 0;
+  }
+
+  for (i = 0; i < ARRAY_SIZE(ops); i++) {
+    if (ops[i] > probe.last_op || ops[i] >= ARRAY_SIZE(probe.ops))
+      return 0;
+    if (!(probe.ops[ops[i]].flags & UV__IO_URING_OP_SUPPORTED))
+      return 0;
+  }
+
+  return 1;
+}
+
+
+static void uv__iou_init(uv_loop_t* loop, struct uv__iou* iou) {
+  struct uv__io_uring_params params;
+  uint32_t features;
+  char* sq;
+  char* cq;
+  void* sqe;
+  size_t sqlen;
+  size_t cqlen;
+  size_t sqelen;
+  int ringfd;
+
+  iou->ringfd = -1;
+
+  uv_once(&uv__iou_once, uv__iou_init_once);
+  if (uv__iou_disabled)
+    return;
+
+  memset(&params, 0, sizeof(params));
+  ringfd = uv__io_uring_setup(UV__IOU_SQ_ENTRIES, &params);
+  if (ringfd == -1)
+    return;
+
+  /* Reads and writes at the current file position need RW_CUR_POS, and
+   * NODROP means completions are never lost.
+   */
+  features = UV__IORING_FEAT_NODROP | UV__IORING_FEAT_RW_CUR_POS;
+  if ((params.features & features) != features || !uv__iou_supported(ringfd)) {
+    uv__close(ringfd);
+    return;
+  }
+
+  sqlen = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cqlen = params.cq_off.cqes +
+          params.cq_entries * sizeof(struct uv__io_uring_cqe);
+  sqelen = params.sq_entries * sizeof(struct uv__io_uring_sqe);
+
+  if (params.features & UV__IORING_FEAT_SINGLE_MMAP) {
+    if (cqlen > sqlen)
+      sqlen = cqlen;
+    cqlen = sqlen;
+  }
+
+  sq = mmap(NULL,
+            sqlen,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            ringfd,
+            UV__IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED)
+    goto fail_sq;
+
+  cq = sq;
+  if (!(params.features & UV__IORING_FEAT_SINGLE_MMAP)) {
+    cq = mmap(NULL,
+              cqlen,
+              PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE,
+              ringfd,
+              UV__IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED)
+      goto fail_cq;
+  }
+
+  sqe = mmap(NULL,
+             sqelen,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE,
+             ringfd,
+             UV__IORING_OFF_SQES);
+  if (sqe == MAP_FAILED)
+    goto fail_sqe;
+
+  iou->sqhead = (uint32_t*) (sq + params.sq_off.head);
+  iou->sqtail = (uint32_t*) (sq + params.sq_off.tail);
+  iou->sqarray = (uint32_t*) (sq + params.sq_off.array);
+  iou->sqmask = *(uint32_t*) (sq + params.sq_off.ring_mask);
+  iou->cqhead = (uint32_t*) (cq + params.cq_off.head);
+  iou->cqtail = (uint32_t*) (cq + params.cq_off.tail);
+  iou->cqmask = *(uint32_t*) (cq + params.cq_off.ring_mask);
+  iou->cq_entries = params.cq_entries;
+  iou->in_flight = 0;
+  iou->unsubmitted = 0;
+  iou->sqe = sqe;
+  iou->cqe = (struct uv__io_uring_cqe*) (cq + params.cq_off.cqes);
+  iou->sq = sq;
+  iou->cq = cq;
+  iou->sqlen = sqlen;
+  iou->cqlen = cqlen;
+  iou->sqelen = sqelen;
+  iou->ringfd = ringfd;
+
+  uv__io_init(&iou->watcher, uv__iou_io, ringfd);
+  uv__io_start(loop, &iou->watcher, POLLIN);
+  return;
+
+fail_sqe:
+  if (cq != sq)
+    munmap(cq, cqlen);
+fail_cq:
+  munmap(sq, sqlen);
+fail_sq:
+  uv__close(ringfd);
+}
+
+
+static void uv__iou_delete(uv_loop_t* loop) {
+  struct uv__iou* iou;
+
+  iou = loop->internal_fields;
+  if (iou == NULL)
+    return;
+
+  if (iou->ringfd != -1) {
+    uv__io_stop(loop, &iou->watcher, POLLIN);
+    munmap(iou->sqe, iou->sqelen);
+    if (iou->cq != iou->sq)
+      munmap(iou->cq, iou->cqlen);
+    munmap(iou->sq, iou->sqlen);
+    uv__close(iou->ringfd);
+  }
+
+  uv__free(iou);
+  loop->internal_fields = NULL;
+}
+
+
+static void uv__iou_submit(struct uv__iou* iou) {
+  int rc;
+
+  while (iou->unsubmitted > 0) {
+    rc = uv__io_uring_enter(iou->ringfd, iou->unsubmitted, 0, 0);
+
+    if (rc > 0) {
+      iou->unsubmitted -= rc;
+      continue;
+    }
+
+    if (rc == -1 && errno == EINTR)
+      continue;
+
+    /* Out of memory for the moment, try again on the next tick. */
+    if (rc == 0 || errno == EAGAIN || errno == EBUSY)
+      break;
+
+    abort();
+  }
+}
+
+
+/* Returns a zeroed submission queue entry for `req`, or NULL if the request
+ * should run on the threadpool instead. The request counts as active from
+ * here on, callers must submit the entry with uv__iou_commit().
+ */
+static struct uv__io_uring_sqe* uv__iou_get_sqe(uv_loop_t* loop,
+                                                uv_fs_t* req) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t slot;
+
+  iou = loop->internal_fields;
+  if (iou == NULL) {
+    iou = uv__calloc(1, sizeof(*iou));
+    if (iou == NULL)
+      return NULL;
+    uv__iou_init(loop, iou);
+    loop->internal_fields = iou;
+  }
+
+  if (iou->ringfd == -1)
+    return NULL;
+
+  /* Don't let completions outnumber the completion queue. */
+  if (iou->in_flight >= iou->cq_entries)
+    return NULL;
+
+  tail = *iou->sqtail;
+  head = __atomic_load_n(iou->sqhead, __ATOMIC_ACQUIRE);
+  if (tail - head > iou->sqmask) {
+    uv__iou_submit(iou);
+    head = __atomic_load_n(iou->sqhead, __ATOMIC_ACQUIRE);
+    if (tail - head > iou->sqmask)
+      return NULL;
+  }
+
+  slot = tail & iou->sqmask;
+  iou->sqarray[slot] = slot;
+  sqe = &iou->sqe[slot];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = (uintptr_t) req;
+
+  /* Make uv_cancel() report the request as executing. */
+  req->work_req.loop = loop;
+  req->work_req.work = NULL;
+  req->work_req.done = NULL;
+  QUEUE_INIT(&req->work_req.wq);
+
+  uv__req_register(loop, req);
+  iou->in_flight++;
+
+  return sqe;
+}
+
+
+static void uv__iou_commit(uv_loop_t* loop) {
+  struct uv__iou* iou;
+
+  iou = loop->internal_fields;
+  __atomic_store_n(iou->sqtail, *iou->sqtail + 1, __ATOMIC_RELEASE);
+  iou->unsubmitted++;
+}
+
+
+int uv__iou_fs_close(uv_loop_t* loop, uv_fs_t* req) {
+  struct uv__io_uring_sqe* sqe;
+
+  sqe = uv__iou_get_sqe(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = UV__IORING_OP_CLOSE;
+  sqe->fd = req->file;
+  uv__iou_commit(loop);
+
+  return 1;
+}
+
+
+int uv__iou_fs_fsync(uv_loop_t* loop, uv_fs_t* req, int datasync) {
+  struct uv__io_uring_sqe* sqe;
+
+  sqe = uv__iou_get_sqe(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = UV__IORING_OP_FSYNC;
+  sqe->fd = req->file;
+  sqe->rw_flags = datasync ? UV__IORING_FSYNC_DATASYNC : 0;
+  uv__iou_commit(loop);
+
+  return 1;
+}
+
+
+int uv__iou_fs_open(uv_loop_t* loop, uv_fs_t* req) {
+  struct uv__io_uring_sqe* sqe;
+
+  sqe = uv__iou_get_sqe(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = UV__IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (uintptr_t) req->path;
+  sqe->len = req->mode;
+  sqe->rw_flags = req->flags | O_CLOEXEC;
+  uv__iou_commit(loop);
+
+  return 1;
+}
+
+
+int uv__iou_fs_read_or_write(uv_loop_t* loop, uv_fs_t* req, int is_read) {
+  struct uv__io_uring_sqe* sqe;
+
+  /* Larger writes are split up by the threadpool. */
+  if (req->nbufs > (unsigned int) uv__getiovmax())
+    return 0;
+
+  sqe = uv__iou_get_sqe(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = is_read ? UV__IORING_OP_READV : UV__IORING_OP_WRITEV;
+  sqe->fd = req->file;
+  sqe->addr = (uintptr_t) req->bufs;
+  sqe->len = req->nbufs;
+  sqe->off = req->off < 0 ? (uint64_t) -1 : (uint64_t) req->off;
+  uv__iou_commit(loop);
+
+  return 1;
+}
+
+
+int uv__iou_fs_statx(uv_loop_t* loop,
+                     uv_fs_t* req,
+                     int is_fstat,
+                     int is_lstat) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__statx* statxbuf;
+
+  statxbuf = uv__malloc(sizeof(*statxbuf));
+  if (statxbuf == NULL)
+    return 0;
+
+  sqe = uv__iou_get_sqe(loop, req);
+  if (sqe == NULL) {
+    uv__free(statxbuf);
+    return 0;
+  }
+
+  req->ptr = statxbuf;
+
+  sqe->opcode = UV__IORING_OP_STATX;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (uintptr_t) req->path;
+  sqe->len = 0xFFF;  /* STATX_BASIC_STATS + STATX_BTIME */
+  sqe->off = (uintptr_t) statxbuf;
+
+  if (is_fstat) {
+    sqe->fd = req->file;
+    sqe->addr = (uintptr_t) "";
+    sqe->rw_flags = 0x1000;  /* AT_EMPTY_PATH */
+  }
+
+  if (is_lstat)
+    sqe->rw_flags = AT_SYMLINK_NOFOLLOW;
+
+  uv__iou_commit(loop);
+
+  return 1;
+}
+
+
+static void uv__iou_fs_done(uv_loop_t* loop, uv_fs_t* req, int res) {
+  switch (req->fs_type) {
+  case UV_FS_CLOSE:
+    /* Same as uv__fs_close(), the descriptor is gone either way. */
+    if (res == -EINTR || res == -EINPROGRESS)
+      res = 0;
+    break;
+
+  case UV_FS_READ:
+  case UV_FS_WRITE:
+    if (req->bufs != req->bufsml)
+      uv__free(req->bufs);
+    req->bufs = NULL;
+    req->nbufs = 0;
+    break;
+
+  case UV_FS_STAT:
+  case UV_FS_LSTAT:
+  case UV_FS_FSTAT:
+    if (res == 0)
+      uv__statx_to_stat(req->ptr, &req->statbuf);
+    uv__free(req->ptr);
+    req->ptr = NULL;
+    if (res == 0)
+      req->ptr = &req->statbuf;
+    break;
+
+  default:
+    break;
+  }
+
+  req->result = res;
+  uv__req_unregister(loop, req);
+  req->cb(req);
+}
+
+
+static void uv__iou_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  struct uv__io_uring_cqe* cqe;
+  struct uv__iou* iou;
+  uint32_t head;
+  uint32_t tail;
+  uv_fs_t* req;
+  int res;
+
+  iou = container_of(w, struct uv__iou, watcher);
+  head = *iou->cqhead;
+  tail = __atomic_load_n(iou->cqtail, __ATOMIC_ACQUIRE);
+
+  while (head != tail) {
+    cqe = &iou->cqe[head & iou->cqmask];
+    req = (uv_fs_t*) (uintptr_t) cqe->user_data;
+    res = cqe->res;
+
+    /* Give the entry back before the callback can make new requests. */
+    head++;
+    __atomic_store_n(iou->cqhead, head, __ATOMIC_RELEASE);
+    iou->in_flight--;
+
+    uv__iou_fs_done(loop, req, res);
+  }
+}
+
+
 void uv__io_poll(uv_loop_t* loop, int timeout) {
   /* A bug in kernels < 2.6.37 makes timeouts larger than ~30 minutes
    * effectively infinite on 32 bits architectures.  To avoid blocking
@@ -227,6 +707,9 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int op;
   int i;
 
+  if (loop->internal_fields != NULL)
+    uv__iou_submit(loop->internal_fields);
+
   if (loop->nfds == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
@@ -219,6 +219,34 @@
 # endif
 #endif /* __NR_getrandom */
 
+/* The io_uring system calls have the same numbers on all architectures. */
+#ifndef __NR_io_uring_setup
+# if defined(__arm__)
+#  define __NR_io_uring_setup (UV_SYSCALL_BASE + 425)
+# elif defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) ||   \
+       defined(__ppc__) || defined(__s390__)
+#  define __NR_io_uring_setup 425
+# endif
+#endif /* __NR_io_uring_setup */
+
+#ifndef __NR_io_uring_enter
+# if defined(__arm__)
+#  define __NR_io_uring_enter (UV_SYSCALL_BASE + 426)
+# elif defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) ||   \
+       defined(__ppc__) || defined(__s390__)
+#  define __NR_io_uring_enter 426
+# endif
+#endif /* __NR_io_uring_enter */
+
+#ifndef __NR_io_uring_register
+# if defined(__arm__)
+#  define __NR_io_uring_register (UV_SYSCALL_BASE + 427)
+# elif defined(__x86_64__) || defined(__i386__) || defined(__aarch64__) ||   \
+       defined(__ppc__) || defined(__s390__)
+#  define __NR_io_uring_register 427
+# endif
+#endif /* __NR_io_uring_register */
+
 int uv__accept4(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags) {
 #if defined(__i386__)
   unsigned long args[4];
@@ -392,3 +420,44 @@ ssize_t uv__getrandom(void* buf, size_t buflen, unsigned flags) {
   return errno = ENOSYS, -1;
 #endif
 }
+
+
+int uv__io_uring_setup(unsigned int entries,
+                       struct uv__io_uring_params* params) {
+#if defined(__NR_io_uring_setup)
+  return syscall(__NR_io_uring_setup, entries, params);
+#else
+  return errno = ENOSYS, -1;
+#endif
+}
+
+
+int uv__io_uring_enter(int fd,
+                       unsigned int to_submit,
+                       unsigned int min_complete,
+                       unsigned int flags) {
+#if defined(__NR_io_uring_enter)
+  /* The last two arguments are the signal mask and its size. */
+  return syscall(__NR_io_uring_enter,
+                 fd,
+                 to_submit,
+                 min_complete,
+                 flags,
+                 NULL,
+                 0L);
+#else
+  return errno = ENOSYS, -1;
+#endif
+}
+
+
+int uv__io_uring_register(int fd,
+                          unsigned int opcode,
+                          void* arg,
+                          unsigned int nargs) {
+#if defined(__NR_io_uring_register)
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+#else
+  return errno = ENOSYS, -1;
+#endif
+}
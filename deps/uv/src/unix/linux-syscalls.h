@@ -110,6 +110,99 @@ struct uv__statx {
   uint64_t unused1[14];
 };
 
+/* The io_uring ABI, see <linux/io_uring.h>. Only what libuv uses is here. */
+#define UV__IORING_OP_READV 1
+#define UV__IORING_OP_WRITEV 2
+#define UV__IORING_OP_FSYNC 3
+#define UV__IORING_OP_OPENAT 18
+#define UV__IORING_OP_CLOSE 19
+#define UV__IORING_OP_STATX 21
+
+#define UV__IORING_FSYNC_DATASYNC 1u
+
+#define UV__IORING_FEAT_SINGLE_MMAP 1u
+#define UV__IORING_FEAT_NODROP 2u
+#define UV__IORING_FEAT_RW_CUR_POS 8u
+
+#define UV__IORING_OFF_SQ_RING 0x00000000ull
+#define UV__IORING_OFF_CQ_RING 0x08000000ull
+#define UV__IORING_OFF_SQES 0x10000000ull
+
+#define UV__IORING_REGISTER_PROBE 8
+#define UV__IO_URING_OP_SUPPORTED 1u
+
+struct uv__io_sqring_offsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t reserved0;
+  uint64_t reserved1;
+};
+
+struct uv__io_cqring_offsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint64_t reserved0;
+  uint64_t reserved1;
+};
+
+struct uv__io_uring_params {
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t reserved[4];
+  struct uv__io_sqring_offsets sq_off;
+  struct uv__io_cqring_offsets cq_off;
+};
+
+/* `off` doubles as the statx buffer and `rw_flags` as the fsync, open and
+ * statx flags, they are unions in the kernel headers.
+ */
+struct uv__io_uring_sqe {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  uint64_t off;
+  uint64_t addr;
+  uint32_t len;
+  uint32_t rw_flags;
+  uint64_t user_data;
+  uint64_t pad[3];
+};
+
+struct uv__io_uring_cqe {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+struct uv__io_uring_probe_op {
+  uint8_t op;
+  uint8_t reserved0;
+  uint16_t flags;
+  uint32_t reserved1;
+};
+
+struct uv__io_uring_probe {
+  uint8_t last_op;
+  uint8_t ops_len;
+  uint16_t reserved0;
+  uint32_t reserved1[3];
+  struct uv__io_uring_probe_op ops[32];
+};
+
 struct uv__inotify_event {
   int32_t wd;
   uint32_t mask;
@@ -149,5 +242,15 @@ int uv__statx(int dirfd,
               unsigned int mask,
               struct uv__statx* statxbuf);
 ssize_t uv__getrandom(void* buf, size_t buflen, unsigned flags);
+int uv__io_uring_setup(unsigned int entries,
+                       struct uv__io_uring_params* params);
+int uv__io_uring_enter(int fd,
+                       unsigned int to_submit,
+                       unsigned int min_complete,
+                       unsigned int flags);
+int uv__io_uring_register(int fd,
+                          unsigned int opcode,
+                          void* arg,
+                          unsigned int nargs);
 
 #endif /* UV_LINUX_SYSCALL_H_ */
@@ -424,6 +424,30 @@ int uv_udp_try_send(uv_udp_t* handle,
 }
 
 
+int uv_udp_try_send2(uv_udp_t* handle,
+                     unsigned int count,
+                     uv_buf_t* bufs[],
+                     unsigned int nbufs[],
+                     struct sockaddr* addrs[],
+                     unsigned int flags) {
+  unsigned int i;
+  int addrlen;
+
+  if (count < 1 || flags != 0)
+    return UV_EINVAL;
+
+  for (i = 0; i < count; i++) {
+    if (nbufs[i] < 1)
+      return UV_EINVAL;
+    addrlen = uv__udp_check_before_send(handle, addrs[i]);
+    if (addrlen < 0)
+      return addrlen;
+  }
+
+  return uv__udp_try_send2(handle, count, bufs, nbufs, addrs);
+}
+
+
 int uv_udp_recv_start(uv_udp_t* handle,
                       uv_alloc_cb alloc_cb,
                       uv_udp_recv_cb recv_cb) {
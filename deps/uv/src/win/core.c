@@ -243,6 +243,7 @@ int uv_loop_init(uv_loop_t* loop) {
   QUEUE_INIT(&loop->handle_queue);
   loop->active_reqs.count = 0;
   loop->active_handles = 0;
+  loop->internal_fields = NULL;
 
   loop->pending_reqs_tail = NULL;
 
@@ -4130,3 +4130,115 @@ TEST_IMPL(fs_statfs) {
 
   return 0;
 }
+
+/* More requests than io_uring runs at once on Linux, so that some of them go
+ * to the threadpool.
+ */
+static uv_fs_t many_reqs[300];
+static char many_bufs[ARRAY_SIZE(many_reqs)][4];
+static unsigned int many_cb_count;
+static uv_file many_file;
+
+
+static void many_fill(char* buf, unsigned int i) {
+  buf[0] = '0' + i / 100 % 10;
+  buf[1] = '0' + i / 10 % 10;
+  buf[2] = '0' + i % 10;
+  buf[3] = '\n';
+}
+
+
+static void many_close_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  uv_fs_req_cleanup(req);
+  many_cb_count++;
+}
+
+
+static void many_read_cb(uv_fs_t* req) {
+  char expected[4];
+  unsigned int i;
+
+  i = req - many_reqs;
+  ASSERT(req->fs_type == UV_FS_READ);
+  ASSERT(req->result == 4);
+  many_fill(expected, i);
+  ASSERT(0 == memcmp(many_bufs[i], expected, sizeof(expected)));
+  uv_fs_req_cleanup(req);
+
+  if (++many_cb_count == ARRAY_SIZE(many_reqs))
+    ASSERT(0 == uv_fs_close(loop, &close_req, many_file, many_close_cb));
+}
+
+
+static void many_fstat_cb(uv_fs_t* req) {
+  uv_buf_t buf;
+  unsigned int i;
+
+  ASSERT(req->result == 0);
+  ASSERT(req->ptr == &req->statbuf);
+  ASSERT(req->statbuf.st_size == sizeof(many_bufs));
+  uv_fs_req_cleanup(req);
+
+  many_cb_count = 0;
+  memset(many_bufs, 0, sizeof(many_bufs));
+  for (i = 0; i < ARRAY_SIZE(many_reqs); i++) {
+    buf = uv_buf_init(many_bufs[i], sizeof(many_bufs[i]));
+    ASSERT(0 == uv_fs_read(loop,
+                           many_reqs + i,
+                           many_file,
+                           &buf,
+                           1,
+                           i * sizeof(many_bufs[i]),
+                           many_read_cb));
+  }
+}
+
+
+static void many_write_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_WRITE);
+  ASSERT(req->result == 4);
+  uv_fs_req_cleanup(req);
+
+  if (++many_cb_count == ARRAY_SIZE(many_reqs))
+    ASSERT(0 == uv_fs_fstat(loop, &stat_req, many_file, many_fstat_cb));
+}
+
+
+TEST_IMPL(fs_read_write_many) {
+  uv_fs_t open_req;
+  uv_buf_t buf;
+  unsigned int i;
+
+  unlink("test_file");
+  loop = uv_default_loop();
+
+  many_file = uv_fs_open(NULL,
+                         &open_req,
+                         "test_file",
+                         O_RDWR | O_CREAT | O_TRUNC,
+                         S_IWUSR | S_IRUSR,
+                         NULL);
+  ASSERT(many_file >= 0);
+  uv_fs_req_cleanup(&open_req);
+
+  for (i = 0; i < ARRAY_SIZE(many_reqs); i++) {
+    many_fill(many_bufs[i], i);
+    buf = uv_buf_init(many_bufs[i], sizeof(many_bufs[i]));
+    ASSERT(0 == uv_fs_write(loop,
+                            many_reqs + i,
+                            many_file,
+                            &buf,
+                            1,
+                            i * sizeof(many_bufs[i]),
+                            many_write_cb));
+  }
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(many_cb_count == ARRAY_SIZE(many_reqs) + 1);
+
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -74,3 +74,94 @@ TEST_IMPL(threadpool_queue_work_einval) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_sem_t pause_sem;
+static unsigned int cpu_work_done;
+static unsigned int cpu_work_done_before_stat;
+static uv_work_t cpu_reqs[4];
+static uv_work_t pause_req;
+
+
+static void pause_work_cb(uv_work_t* req) {
+  uv_sem_wait(&pause_sem);
+}
+
+
+static void noop_work_cb(uv_work_t* req) {
+}
+
+
+static void cpu_done_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  cpu_work_done++;
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  ASSERT(req->result == 0);
+  cpu_work_done_before_stat = cpu_work_done;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(threadpool_fast_io_first) {
+  uv_fs_t stat_req;
+  uv_loop_t* loop;
+  size_t i;
+
+  /* With a single thread, the file system request queued after the CPU work
+   * still runs first. It has to go to the threadpool rather than io_uring.
+   */
+  putenv((char*) "UV_THREADPOOL_SIZE=1");
+  putenv((char*) "UV_USE_IO_URING=0");
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_sem_init(&pause_sem, 0));
+  ASSERT(0 == uv_queue_work(loop, &pause_req, pause_work_cb, cpu_done_cb));
+
+  for (i = 0; i < ARRAY_SIZE(cpu_reqs); i++)
+    ASSERT(0 == uv_queue_work(loop, cpu_reqs + i, noop_work_cb, cpu_done_cb));
+
+  ASSERT(0 == uv_fs_stat(loop, &stat_req, ".", stat_cb));
+  uv_sem_post(&pause_sem);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(cpu_work_done == 1 + ARRAY_SIZE(cpu_reqs));
+  ASSERT(cpu_work_done_before_stat <= 1);
+
+  uv_sem_destroy(&pause_sem);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_work_t many_reqs[1024];
+static unsigned int many_done;
+
+
+static void many_done_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  many_done++;
+}
+
+
+TEST_IMPL(threadpool_queue_work_many) {
+  uv_loop_t* loop;
+  size_t i;
+
+  /* More requests than threads, so that most of them are stolen from the
+   * shard that they were posted to.
+   */
+  putenv((char*) "UV_THREADPOOL_SIZE=8");
+  loop = uv_default_loop();
+
+  for (i = 0; i < ARRAY_SIZE(many_reqs); i++)
+    ASSERT(0 == uv_queue_work(loop, many_reqs + i, noop_work_cb, many_done_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(many_done == ARRAY_SIZE(many_reqs));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
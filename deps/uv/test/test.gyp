@@ -150,6 +150,7 @@
         'test-udp-create-socket-early.c',
         'test-udp-dgram-too-big.c',
         'test-udp-ipv6.c',
+        'test-udp-mmsg.c',
         'test-udp-open.c',
         'test-udp-options.c',
         'test-udp-send-and-recv.c',
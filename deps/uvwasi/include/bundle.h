@@ -0,0 +1,87 @@
+#ifndef __UVWASI_BUNDLE_H__
+#define __UVWASI_BUNDLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wasi_types.h"
+
+/* A bundle is a read-only directory tree packed into a single buffer, which is
+   either copied from the embedder or memory-mapped from a file. Files in it
+   are read with memcpy() instead of system calls.
+
+   All integers are little endian. The buffer starts with a 16 byte header:
+
+     char     magic[8]     "UVWASIB" followed by a NUL byte
+     uint32_t version      UVWASI__BUNDLE_VERSION
+     uint32_t count        Number of entries
+
+   which is followed by count entries of UVWASI__BUNDLE_ENTRY_SIZE bytes:
+
+     uint64_t offset       Files: offset of the contents in the buffer.
+                           Directories: index of the first child.
+     uint64_t size         Files: size of the contents in bytes.
+                           Directories: number of children.
+     uint32_t name_offset  Offset of the name in the buffer.
+     uint32_t name_len     Length of the name in bytes, without a NUL byte.
+     uint32_t parent       Index of the parent directory.
+     uint32_t type         UVWASI_FILETYPE_DIRECTORY or
+                           UVWASI_FILETYPE_REGULAR_FILE.
+
+   Entry 0 is the root directory, which is its own parent and has an empty
+   name. The children of a directory are consecutive entries after it, sorted
+   by name in byte order, so that lookups can use a binary search. */
+
+#define UVWASI__BUNDLE_MAGIC "UVWASIB"
+#define UVWASI__BUNDLE_VERSION 1
+#define UVWASI__BUNDLE_HEADER_SIZE 16
+#define UVWASI__BUNDLE_ENTRY_SIZE 32
+#define UVWASI__BUNDLE_ROOT 0
+
+struct uvwasi__bundle_node_t {
+  const char* name;
+  uint32_t name_len;
+  uint32_t parent;
+  uvwasi_filetype_t type;
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct uvwasi__bundle_s {
+  struct uvwasi__bundle_s* next;
+  char* data;
+  size_t size;
+  int mapped;
+  struct uvwasi__bundle_node_t* nodes;
+  uint32_t node_count;
+};
+
+uvwasi_errno_t uvwasi__bundle_from_memory(const void* data,
+                                          size_t size,
+                                          struct uvwasi__bundle_s** bundle);
+/* Maps the file read-only. It must not change while the bundle exists: on Unix,
+   reading pages that truncating it removed raises SIGBUS. */
+uvwasi_errno_t uvwasi__bundle_from_file(const char* path,
+                                        struct uvwasi__bundle_s** bundle);
+void uvwasi__bundle_free(struct uvwasi__bundle_s* bundle);
+
+uvwasi_errno_t uvwasi__bundle_lookup(const struct uvwasi__bundle_s* bundle,
+                                     uint32_t dir,
+                                     const char* path,
+                                     size_t path_len,
+                                     uint32_t* node);
+void uvwasi__bundle_filestat(const struct uvwasi__bundle_s* bundle,
+                             uint32_t node,
+                             uvwasi_filestat_t* buf);
+size_t uvwasi__bundle_read(const struct uvwasi__bundle_s* bundle,
+                           uint32_t node,
+                           const uvwasi_iovec_t* iovs,
+                           size_t iovs_len,
+                           uvwasi_filesize_t offset);
+void uvwasi__bundle_readdir(const struct uvwasi__bundle_s* bundle,
+                            uint32_t node,
+                            void* buf,
+                            size_t buf_len,
+                            uvwasi_dircookie_t cookie,
+                            size_t* bufused);
+
+#endif /* __UVWASI_BUNDLE_H__ */
@@ -17,22 +17,87 @@
 #endif
 
 
+/* Paths are interned per fd table and reference counted, so slots only hold
+   pointers to them. Entries that refer to the same host path, such as a
+   preopen whose mapped and real paths match, or a file opened many times,
+   share one allocation. */
+struct uvwasi__path_s {
+  struct uvwasi__path_s* next;
+  uint32_t hash;
+  uint32_t refcount;
+  size_t len;
+  char str[1];
+};
+
+struct uvwasi__bundle_s;
+
 struct uvwasi_fd_wrap_t {
-  uvwasi_fd_t id;
+  uvwasi_fd_t id;  /* For free slots, the index of the next free slot. */
   uv_file fd;
-  char path[PATH_MAX_BYTES];
-  char real_path[PATH_MAX_BYTES];
-  uvwasi_filetype_t type;
+  const char* path;
+  const char* real_path;
   uvwasi_rights_t rights_base;
   uvwasi_rights_t rights_inheriting;
+  /* Directory stream cached by fd_readdir(), or NULL. dir_cookie is the cookie
+     of the next entry that reading from the stream will return. */
+  uv_dir_t* dir;
+  uvwasi_dircookie_t dir_cookie;
+  /* Bundle that a read-only entry is served from, or NULL. Such entries have
+     no host fd, and keep their own file position. */
+  struct uvwasi__bundle_s* bundle;
+  uint32_t bundle_node;
+  uvwasi_filesize_t bundle_offset;
+  uvwasi_filetype_t type;
   int preopen;
+  /* Set for entries in the saved table. Their host fds are needed to restore
+     it, so closing the WASI fd leaves them open. */
+  int saved;
   int valid;
+  /* The members below are not copied by uvwasi__fd_wrap_assign(). The first
+     three are protected by the table's pin_mutex. generation changes whenever
+     the entry stops referring to the file that it referred to, pins counts the
+     threads that still need the entry to stay allocated, and detached is set
+     once the entry has left the table, see uvwasi_fd_table_detach(). */
+  uint32_t generation;
+  uint32_t pins;
+  int detached;
+  /* Held while a system call uses the entry. */
+  uv_mutex_t mutex;
 };
 
+/* The table is protected by a reader-writer lock, and each entry by its own
+   mutex, so that several threads can make system calls on one uvwasi_t.
+   uvwasi_fd_table_get() returns the entry locked, and the caller unlocks
+   wrap->mutex once it is done with it. It pins the entry under the read lock
+   and only waits for the entry mutex after releasing it, so that a thread
+   waiting for a busy fd does not hold up the rest of the table. If the entry
+   changed meanwhile, the fd counts as closed.
+
+   A thread that holds an entry must not take the table lock or get another
+   entry, because a thread that holds the table lock exclusively may be
+   waiting for that entry. Calls that use two entries, or remove one, take the
+   table lock with uvwasi_fd_table_lock() and then use the _nolock functions.
+   fd_close() instead detaches the entry with uvwasi_fd_table_detach(), so
+   that it waits for the entry without blocking the rest of the table. */
+
 struct uvwasi_fd_table_t {
-  struct uvwasi_fd_wrap_t* fds;
+  /* Entries are allocated one by one and are only freed with the table, so
+     they do not move while a thread holds one and another grows the table. */
+  struct uvwasi_fd_wrap_t** fds;
   uint32_t size;
   uint32_t used;
+  uvwasi_fd_t free_head;
+  /* Protects the generation and pins of the entries. */
+  uv_mutex_t pin_mutex;
+  struct uvwasi__path_s** paths;
+  uint32_t paths_size;
+  uint32_t paths_used;
+  size_t paths_bytes;
+  /* Copy of the valid entries at the time uvwasi_fd_table_save() was called,
+     or NULL. uvwasi_fd_table_restore() resets the table to it. */
+  struct uvwasi_fd_wrap_t* saved;
+  uint32_t saved_count;
+  uv_rwlock_t rwlock;
 };
 
 uvwasi_errno_t uvwasi_fd_table_init(struct uvwasi_fd_table_t* table,
@@ -49,12 +114,43 @@ uvwasi_errno_t uvwasi_fd_table_insert_fd(struct uvwasi_fd_table_t* table,
                                          uvwasi_rights_t rights_base,
                                          uvwasi_rights_t rights_inheriting,
                                          struct uvwasi_fd_wrap_t* wrap);
-uvwasi_errno_t uvwasi_fd_table_get(const struct uvwasi_fd_table_t* table,
+uvwasi_errno_t uvwasi_fd_table_insert_stream(struct uvwasi_fd_table_t* table,
+                                             uv_stream_t* stream,
+                                             uvwasi_fd_t* id);
+uvwasi_errno_t uvwasi_fd_table_insert_bundle(struct uvwasi_fd_table_t* table,
+                                             struct uvwasi__bundle_s* bundle,
+                                             uint32_t node,
+                                             const char* path,
+                                             int preopen,
+                                             uvwasi_rights_t rights_base,
+                                             uvwasi_rights_t rights_inheriting,
+                                             uvwasi_fd_t* id);
+uvwasi_errno_t uvwasi_fd_table_get(struct uvwasi_fd_table_t* table,
                                    const uvwasi_fd_t id,
                                    struct uvwasi_fd_wrap_t** wrap,
                                    uvwasi_rights_t rights_base,
                                    uvwasi_rights_t rights_inheriting);
-uvwasi_errno_t uvwasi_fd_table_remove(struct uvwasi_fd_table_t* table,
-                                      const uvwasi_fd_t id);
+uvwasi_errno_t uvwasi_fd_table_get_nolock(struct uvwasi_fd_table_t* table,
+                                          const uvwasi_fd_t id,
+                                          struct uvwasi_fd_wrap_t** wrap,
+                                          uvwasi_rights_t rights_base,
+                                          uvwasi_rights_t rights_inheriting);
+uvwasi_errno_t uvwasi_fd_table_remove_nolock(struct uvwasi_fd_table_t* table,
+                                             const uvwasi_fd_t id);
+uvwasi_errno_t uvwasi_fd_table_detach(struct uvwasi_fd_table_t* table,
+                                      const uvwasi_fd_t id,
+                                      struct uvwasi_fd_wrap_t** wrap);
+void uvwasi_fd_table_free_detached(struct uvwasi_fd_table_t* table,
+                                   struct uvwasi_fd_wrap_t* wrap);
+uvwasi_errno_t uvwasi_fd_table_renumber_nolock(struct uvwasi_fd_table_t* table,
+                                               const uvwasi_fd_t dst,
+                                               const uvwasi_fd_t src);
+void uvwasi_fd_table_lock(struct uvwasi_fd_table_t* table);
+void uvwasi_fd_table_unlock(struct uvwasi_fd_table_t* table);
+uvwasi_errno_t uvwasi_fd_table_save(struct uvwasi_fd_table_t* table);
+uvwasi_errno_t uvwasi_fd_table_restore(struct uvwasi_fd_table_t* table);
+size_t uvwasi_fd_table_memory_size(struct uvwasi_fd_table_t* table);
+uint32_t uvwasi__path_hash(const char* path, size_t len);
+void uvwasi__fd_wrap_close_dir(struct uvwasi_fd_wrap_t* wrap);
 
 #endif /* __UVWASI_FD_TABLE_H__ */
@@ -0,0 +1,64 @@
+#ifndef __UVWASI_PATH_RESOLVER_H__
+#define __UVWASI_PATH_RESOLVER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "uv.h"
+#include "wasi_types.h"
+#include "fd_table.h"
+
+#define UVWASI__PATH_CACHE_SIZE 64
+
+struct uvwasi_s;
+struct uvwasi_fd_wrap_t;
+
+/* The path cache remembers host directories that the resolver reached without
+   traversing a symlink, so that resolving another path below them does not
+   have to walk their components again. Each entry keeps the directory open,
+   and the resolver continues from a duplicate of that fd, so a symlink that
+   replaces one of the components later is never followed. The cache only
+   observes changes made through uvwasi, which invalidates affected entries
+   from the path_* calls that can rename or remove directories. Entries are
+   evicted in LRU order. The cache is shared by every thread that makes system
+   calls, and has its own lock. */
+struct uvwasi__path_cache_entry_t {
+  char* path;
+  size_t len;
+  uint32_t hash;
+  uint64_t last_used;
+  int fd;
+};
+
+struct uvwasi__path_cache_t {
+  struct uvwasi__path_cache_entry_t entries[UVWASI__PATH_CACHE_SIZE];
+  uint64_t clock;
+  uv_mutex_t mutex;
+};
+
+uvwasi_errno_t uvwasi__path_cache_init(struct uvwasi__path_cache_t* cache);
+void uvwasi__path_cache_free(struct uvwasi__path_cache_t* cache);
+void uvwasi__path_cache_invalidate(struct uvwasi__path_cache_t* cache,
+                                   const char* path);
+
+/* The result of uvwasi__resolve_path(). On POSIX, the system call that the
+   path is for must be made relative to dir_fd, with name, so that it does not
+   depend on the path to dir_fd staying the same. host_path names the same
+   file, and is only meant for bookkeeping, like the paths of the fd table and
+   the path cache. On Windows, dir_fd is -1 and name is host_path. */
+struct uvwasi__resolved_path_t {
+  /* Directory that contains the file, owned by the caller. */
+  int dir_fd;
+  /* Final component of the path, or "." if the path names dir_fd itself. */
+  const char* name;
+  char host_path[PATH_MAX_BYTES];
+};
+
+uvwasi_errno_t uvwasi__resolve_path(struct uvwasi_s* uvwasi,
+                                    const struct uvwasi_fd_wrap_t* fd,
+                                    const char* path,
+                                    size_t path_len,
+                                    struct uvwasi__resolved_path_t* resolved,
+                                    uvwasi_lookupflags_t flags);
+void uvwasi__resolved_path_free(struct uvwasi__resolved_path_t* resolved);
+
+#endif /* __UVWASI_PATH_RESOLVER_H__ */
@@ -0,0 +1,27 @@
+#ifndef __UVWASI_POLL_ONEOFF_H__
+#define __UVWASI_POLL_ONEOFF_H__
+
+#include <stddef.h>
+#include "uv.h"
+#include "wasi_types.h"
+
+struct uvwasi_s;
+
+/* poll_oneoff() runs on a private loop, so that guest fds are never watched
+   by the embedder's loop. The loop is created by the first call and reused by
+   later ones. When several threads poll at once, the ones that find it in use
+   run on a temporary loop instead of waiting for it. */
+struct uvwasi__poll_t {
+  uv_loop_t* loop;
+  uv_mutex_t mutex;
+};
+
+uvwasi_errno_t uvwasi__poll_init(struct uvwasi__poll_t* poll);
+void uvwasi__poll_free(struct uvwasi__poll_t* poll);
+uvwasi_errno_t uvwasi__poll_oneoff(struct uvwasi_s* uvwasi,
+                                   const uvwasi_subscription_t* in,
+                                   uvwasi_event_t* out,
+                                   size_t nsubscriptions,
+                                   size_t* nevents);
+
+#endif /* __UVWASI_POLL_ONEOFF_H__ */
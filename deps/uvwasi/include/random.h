@@ -0,0 +1,41 @@
+#ifndef __UVWASI_RANDOM_H__
+#define __UVWASI_RANDOM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "uv.h"
+#include "wasi_types.h"
+
+/* Bytes of ChaCha20 output generated at a time. The first
+   UVWASI__RANDOM_KEY_SIZE bytes of each batch replace the key, and the rest
+   are handed out to random_get() calls. */
+#define UVWASI__RANDOM_BUF_SIZE 1024
+#define UVWASI__RANDOM_KEY_SIZE 32
+/* The key is replaced with one from the host after this many bytes. */
+#define UVWASI__RANDOM_RESEED_BYTES (1024 * 1024)
+
+/* Serves random_get() from a buffered ChaCha20 stream, so that the small
+   requests guests typically make do not each cost a system call. The key is
+   taken from uv_random() when the first bytes are requested, then every
+   UVWASI__RANDOM_RESEED_BYTES, and after the process forks. Bytes are erased
+   from the buffer when they are handed out, and each batch replaces the key
+   it was generated with, so earlier output cannot be recovered from the
+   state. The state is shared by every thread that makes system calls, and has
+   its own lock. */
+struct uvwasi__random_t {
+  uint32_t key[UVWASI__RANDOM_KEY_SIZE / 4];
+  unsigned char buf[UVWASI__RANDOM_BUF_SIZE];
+  size_t available;
+  size_t until_reseed;
+  unsigned int fork_generation;
+  int seeded;
+  uv_mutex_t mutex;
+};
+
+uvwasi_errno_t uvwasi__random_init(struct uvwasi__random_t* random);
+void uvwasi__random_free(struct uvwasi__random_t* random);
+uvwasi_errno_t uvwasi__random_get(struct uvwasi__random_t* random,
+                                  void* buf,
+                                  size_t buf_len);
+
+#endif /* __UVWASI_RANDOM_H__ */
@@ -8,6 +8,9 @@ extern "C" {
 #include "wasi_types.h"
 #include "uv_mapping.h"
 #include "fd_table.h"
+#include "path_resolver.h"
+#include "poll_oneoff.h"
+#include "random.h"
 
 #define UVWASI_VERSION_MAJOR 0
 #define UVWASI_VERSION_MINOR 0
@@ -22,8 +25,14 @@ extern "C" {
                               UVWASI_STRINGIFY(UVWASI_VERSION_PATCH)
 
 
+struct uvwasi__bundle_s;
+
 typedef struct uvwasi_s {
   struct uvwasi_fd_table_t fds;
+  struct uvwasi__path_cache_t path_cache;
+  struct uvwasi__random_t random;
+  struct uvwasi__poll_t poll;
+  struct uvwasi__bundle_s* bundles;
   size_t argc;
   char** argv;
   char* argv_buf;
@@ -55,6 +64,39 @@ void uvwasi_destroy(uvwasi_t* uvwasi);
 uvwasi_errno_t uvwasi_embedder_remap_fd(uvwasi_t* uvwasi,
                                         const uvwasi_fd_t fd,
                                         uv_file new_host_fd);
+// Returns the host fd behind a WASI fd that has the given rights, which is
+// the fd last passed to uvwasi_embedder_remap_fd() for it, if any. Entries
+// without a host fd, such as bundles, return -1.
+uvwasi_errno_t uvwasi_embedder_get_host_fd(uvwasi_t* uvwasi,
+                                           const uvwasi_fd_t fd,
+                                           uvwasi_rights_t rights,
+                                           uv_file* host_fd);
+// Makes a connected socket stream available to the guest and returns its WASI
+// fd. The WASI fd refers to a duplicate of the host fd of the stream, so the
+// embedder may close the stream at any time. It should stop reading from and
+// writing to it, though. Not supported on Windows.
+uvwasi_errno_t uvwasi_embedder_insert_socket(uvwasi_t* uvwasi,
+                                            uv_stream_t* stream,
+                                            uvwasi_fd_t* fd);
+// Adds a read-only preopened directory that is served from a bundle, see
+// bundle.h for the format, and returns its WASI fd. The data is copied.
+uvwasi_errno_t uvwasi_embedder_add_bundle(uvwasi_t* uvwasi,
+                                          const char* mapped_path,
+                                          const void* data,
+                                          size_t size,
+                                          uvwasi_fd_t* fd);
+// Like uvwasi_embedder_add_bundle(), but maps the bundle from a file.
+uvwasi_errno_t uvwasi_embedder_add_bundle_file(uvwasi_t* uvwasi,
+                                               const char* mapped_path,
+                                               const char* path,
+                                               uvwasi_fd_t* fd);
+// Records the current fd table as the state that uvwasi_embedder_reset()
+// returns to. It can only be called once per uvwasi_t.
+uvwasi_errno_t uvwasi_embedder_snapshot(uvwasi_t* uvwasi);
+// Closes every fd that was opened after uvwasi_embedder_snapshot() and
+// restores the fds that existed then, so that the uvwasi_t can be reused for
+// another guest without calling uvwasi_init() again.
+uvwasi_errno_t uvwasi_embedder_reset(uvwasi_t* uvwasi);
 
 
 // WASI system call API.
@@ -0,0 +1,511 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <errno.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif /* _WIN32 */
+
+#ifndef O_CLOEXEC
+# define O_CLOEXEC 0
+#endif
+
+#include "uv.h"
+#include "uv_mapping.h"
+#include "bundle.h"
+
+
+static uint32_t uvwasi__read_u32(const char* p) {
+  const unsigned char* b = (const unsigned char*) p;
+
+  return (uint32_t) b[0] |
+         ((uint32_t) b[1] << 8) |
+         ((uint32_t) b[2] << 16) |
+         ((uint32_t) b[3] << 24);
+}
+
+
+static uint64_t uvwasi__read_u64(const char* p) {
+  return (uint64_t) uvwasi__read_u32(p) |
+         ((uint64_t) uvwasi__read_u32(p + 4) << 32);
+}
+
+
+static int uvwasi__bundle_name_cmp(const struct uvwasi__bundle_node_t* node,
+                                   const char* name,
+                                   size_t name_len) {
+  size_t len;
+  int r;
+
+  len = node->name_len < name_len ? node->name_len : name_len;
+  r = memcmp(node->name, name, len);
+  if (r != 0)
+    return r;
+  if (node->name_len == name_len)
+    return 0;
+  return node->name_len < name_len ? -1 : 1;
+}
+
+
+/* Decodes the entries of bundle->data and checks that they describe a tree
+   that stays within the buffer, so that no later access needs to. */
+static uvwasi_errno_t uvwasi__bundle_parse(struct uvwasi__bundle_s* bundle) {
+  struct uvwasi__bundle_node_t* nodes;
+  struct uvwasi__bundle_node_t* node;
+  const char* entry;
+  uint64_t i;
+  uint64_t j;
+  uint32_t count;
+  uint32_t name_offset;
+
+  if (bundle->size < UVWASI__BUNDLE_HEADER_SIZE ||
+      memcmp(bundle->data, UVWASI__BUNDLE_MAGIC, 8) != 0 ||
+      uvwasi__read_u32(bundle->data + 8) != UVWASI__BUNDLE_VERSION) {
+    return UVWASI_EINVAL;
+  }
+
+  count = uvwasi__read_u32(bundle->data + 12);
+  if (count == 0 ||
+      count > (bundle->size - UVWASI__BUNDLE_HEADER_SIZE) /
+              UVWASI__BUNDLE_ENTRY_SIZE) {
+    return UVWASI_EINVAL;
+  }
+
+  nodes = malloc(count * sizeof(*nodes));
+  if (nodes == NULL)
+    return UVWASI_ENOMEM;
+
+  for (i = 0; i < count; ++i) {
+    entry = bundle->data + UVWASI__BUNDLE_HEADER_SIZE +
+            i * UVWASI__BUNDLE_ENTRY_SIZE;
+    node = &nodes[i];
+    node->offset = uvwasi__read_u64(entry);
+    node->size = uvwasi__read_u64(entry + 8);
+    name_offset = uvwasi__read_u32(entry + 16);
+    node->name_len = uvwasi__read_u32(entry + 20);
+    node->parent = uvwasi__read_u32(entry + 24);
+    node->type = (uvwasi_filetype_t) uvwasi__read_u32(entry + 28);
+
+    if (name_offset > bundle->size ||
+        node->name_len > bundle->size - name_offset ||
+        node->parent >= count) {
+      goto invalid;
+    }
+
+    node->name = bundle->data + name_offset;
+
+    if (i == UVWASI__BUNDLE_ROOT) {
+      if (node->parent != UVWASI__BUNDLE_ROOT || node->name_len != 0)
+        goto invalid;
+    } else if (node->name_len == 0 ||
+               memchr(node->name, '/', node->name_len) != NULL ||
+               memchr(node->name, '\0', node->name_len) != NULL ||
+               (node->name_len == 1 && node->name[0] == '.') ||
+               (node->name_len == 2 && memcmp(node->name, "..", 2) == 0)) {
+      goto invalid;
+    }
+
+    if (node->type == UVWASI_FILETYPE_REGULAR_FILE) {
+      if (node->offset > bundle->size ||
+          node->size > bundle->size - node->offset) {
+        goto invalid;
+      }
+    } else if (node->type == UVWASI_FILETYPE_DIRECTORY) {
+      /* Children come after their directory, which rules out cycles. */
+      if (node->size != 0 &&
+          (node->offset <= i ||
+           node->offset > count ||
+           node->size > count - node->offset)) {
+        goto invalid;
+      }
+    } else {
+      goto invalid;
+    }
+  }
+
+  /* Every child must point back at its directory, and be sorted. This makes
+     each entry the child of at most one directory. */
+  for (i = 0; i < count; ++i) {
+    node = &nodes[i];
+    if (node->type != UVWASI_FILETYPE_DIRECTORY)
+      continue;
+
+    for (j = node->offset; j < node->offset + node->size; ++j) {
+      if (nodes[j].parent != i)
+        goto invalid;
+      if (j > node->offset &&
+          uvwasi__bundle_name_cmp(&nodes[j - 1],
+                                  nodes[j].name,
+                                  nodes[j].name_len) >= 0) {
+        goto invalid;
+      }
+    }
+  }
+
+  if (nodes[UVWASI__BUNDLE_ROOT].type != UVWASI_FILETYPE_DIRECTORY)
+    goto invalid;
+
+  bundle->nodes = nodes;
+  bundle->node_count = count;
+  return UVWASI_ESUCCESS;
+
+invalid:
+  free(nodes);
+  return UVWASI_EINVAL;
+}
+
+
+uvwasi_errno_t uvwasi__bundle_from_memory(const void* data,
+                                          size_t size,
+                                          struct uvwasi__bundle_s** bundle) {
+  struct uvwasi__bundle_s* b;
+  uvwasi_errno_t err;
+
+  if (data == NULL || bundle == NULL)
+    return UVWASI_EINVAL;
+
+  b = calloc(1, sizeof(*b));
+  if (b == NULL)
+    return UVWASI_ENOMEM;
+
+  b->data = malloc(size == 0 ? 1 : size);
+  if (b->data == NULL) {
+    free(b);
+    return UVWASI_ENOMEM;
+  }
+
+  memcpy(b->data, data, size);
+  b->size = size;
+
+  err = uvwasi__bundle_parse(b);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__bundle_free(b);
+    return err;
+  }
+
+  *bundle = b;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__bundle_from_file(const char* path,
+                                        struct uvwasi__bundle_s** bundle) {
+  struct uvwasi__bundle_s* b;
+  uvwasi_errno_t err;
+#ifdef _WIN32
+  HANDLE mapping;
+  uv_fs_t req;
+  uint64_t size;
+  void* data;
+  uv_file fd;
+  int r;
+
+  if (path == NULL || bundle == NULL)
+    return UVWASI_EINVAL;
+
+  r = uv_fs_open(NULL, &req, path, UV_FS_O_RDONLY, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  if (r < 0)
+    return uvwasi__translate_uv_error(r);
+  fd = r;
+
+  r = uv_fs_fstat(NULL, &req, fd, NULL);
+  size = req.statbuf.st_size;
+  uv_fs_req_cleanup(&req);
+  if (r != 0) {
+    err = uvwasi__translate_uv_error(r);
+    goto close_exit;
+  }
+
+  /* Empty files cannot be mapped, and are not valid bundles anyway. */
+  if (size == 0 || size > SIZE_MAX) {
+    err = UVWASI_EINVAL;
+    goto close_exit;
+  }
+
+  /* The view stays valid after the mapping and file handles are closed. */
+  mapping = CreateFileMappingW((HANDLE) uv_get_osfhandle(fd),
+                               NULL,
+                               PAGE_READONLY,
+                               0,
+                               0,
+                               NULL);
+  if (mapping == NULL) {
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(GetLastError()));
+    goto close_exit;
+  }
+
+  data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T) size);
+  if (data == NULL)
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(GetLastError()));
+  CloseHandle(mapping);
+  if (data == NULL)
+    goto close_exit;
+
+  uv_fs_close(NULL, &req, fd, NULL);
+  uv_fs_req_cleanup(&req);
+
+  b = calloc(1, sizeof(*b));
+  if (b == NULL) {
+    UnmapViewOfFile(data);
+    return UVWASI_ENOMEM;
+  }
+
+  b->data = data;
+  b->size = (size_t) size;
+  b->mapped = 1;
+#else
+  struct stat st;
+  void* data;
+  int fd;
+
+  if (path == NULL || bundle == NULL)
+    return UVWASI_EINVAL;
+
+  fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  if (fstat(fd, &st) != 0) {
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+    close(fd);
+    return err;
+  }
+
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return UVWASI_EINVAL;
+  }
+
+  /* The mapping stays valid after the fd is closed. MAP_PRIVATE does not
+     protect against the file being truncated while it is mapped, reading the
+     pages past the new end then raises SIGBUS. Windows does not allow
+     truncating a mapped file. */
+  data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  b = calloc(1, sizeof(*b));
+  if (b == NULL) {
+    munmap(data, st.st_size);
+    return UVWASI_ENOMEM;
+  }
+
+  b->data = data;
+  b->size = st.st_size;
+  b->mapped = 1;
+#endif /* _WIN32 */
+
+  err = uvwasi__bundle_parse(b);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__bundle_free(b);
+    return err;
+  }
+
+  *bundle = b;
+  return UVWASI_ESUCCESS;
+
+#ifdef _WIN32
+close_exit:
+  uv_fs_close(NULL, &req, fd, NULL);
+  uv_fs_req_cleanup(&req);
+  return err;
+#endif /* _WIN32 */
+}
+
+
+void uvwasi__bundle_free(struct uvwasi__bundle_s* bundle) {
+  if (bundle == NULL)
+    return;
+
+  if (bundle->mapped) {
+#ifdef _WIN32
+    UnmapViewOfFile(bundle->data);
+#else
+    munmap(bundle->data, bundle->size);
+#endif /* _WIN32 */
+  } else {
+    free(bundle->data);
+  }
+
+  free(bundle->nodes);
+  free(bundle);
+}
+
+
+/* Resolves path relative to the directory dir. Like paths on the host, it may
+   not leave dir through "..". Bundles have no symlinks, so there are no
+   lookup flags to honor. */
+uvwasi_errno_t uvwasi__bundle_lookup(const struct uvwasi__bundle_s* bundle,
+                                     uint32_t dir,
+                                     const char* path,
+                                     size_t path_len,
+                                     uint32_t* node) {
+  const struct uvwasi__bundle_node_t* current;
+  const struct uvwasi__bundle_node_t* child;
+  const char* name;
+  const char* end;
+  const char* p;
+  uint64_t low;
+  uint64_t high;
+  uint64_t mid;
+  uint32_t index;
+  size_t name_len;
+  size_t depth;
+  int r;
+
+  if (path_len == 0)
+    return UVWASI_ENOENT;
+  if (path[0] == '/')
+    return UVWASI_ENOTCAPABLE;
+  if (memchr(path, '\0', path_len) != NULL)
+    return UVWASI_EINVAL;
+
+  index = dir;
+  depth = 0;
+  mid = 0;
+  p = path;
+  end = path + path_len;
+
+  while (p < end) {
+    name = p;
+    while (p < end && *p != '/')
+      p++;
+    name_len = p - name;
+    if (p < end)
+      p++;
+
+    current = &bundle->nodes[index];
+    if (current->type != UVWASI_FILETYPE_DIRECTORY)
+      return UVWASI_ENOTDIR;
+
+    if (name_len == 0 || (name_len == 1 && name[0] == '.'))
+      continue;
+
+    if (name_len == 2 && name[0] == '.' && name[1] == '.') {
+      if (depth == 0)
+        return UVWASI_ENOTCAPABLE;
+      depth--;
+      index = current->parent;
+      continue;
+    }
+
+    low = current->offset;
+    high = current->offset + current->size;
+    while (low < high) {
+      mid = low + (high - low) / 2;
+      child = &bundle->nodes[mid];
+      r = uvwasi__bundle_name_cmp(child, name, name_len);
+      if (r == 0)
+        break;
+      if (r < 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    if (low >= high)
+      return UVWASI_ENOENT;
+
+    index = (uint32_t) mid;
+    depth++;
+  }
+
+  /* A trailing slash only matches directories. */
+  if (path[path_len - 1] == '/' &&
+      bundle->nodes[index].type != UVWASI_FILETYPE_DIRECTORY) {
+    return UVWASI_ENOTDIR;
+  }
+
+  *node = index;
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__bundle_filestat(const struct uvwasi__bundle_s* bundle,
+                             uint32_t node,
+                             uvwasi_filestat_t* buf) {
+  const struct uvwasi__bundle_node_t* n;
+
+  n = &bundle->nodes[node];
+  /* Each bundle is its own device, so that (st_dev, st_ino) is unique. */
+  buf->st_dev = (uvwasi_device_t) (uintptr_t) bundle;
+  buf->st_ino = (uvwasi_inode_t) node + 1;
+  buf->st_filetype = n->type;
+  buf->st_nlink = 1;
+  buf->st_size = n->type == UVWASI_FILETYPE_REGULAR_FILE ? n->size : 0;
+  buf->st_atim = 0;
+  buf->st_mtim = 0;
+  buf->st_ctim = 0;
+}
+
+
+size_t uvwasi__bundle_read(const struct uvwasi__bundle_s* bundle,
+                           uint32_t node,
+                           const uvwasi_iovec_t* iovs,
+                           size_t iovs_len,
+                           uvwasi_filesize_t offset) {
+  const struct uvwasi__bundle_node_t* n;
+  const char* data;
+  size_t nread;
+  size_t len;
+  size_t i;
+
+  n = &bundle->nodes[node];
+  if (offset >= n->size)
+    return 0;
+
+  data = bundle->data + n->offset;
+  nread = 0;
+  for (i = 0; i < iovs_len && offset < n->size; ++i) {
+    len = iovs[i].buf_len;
+    if (len > n->size - offset)
+      len = (size_t) (n->size - offset);
+    memcpy(iovs[i].buf, data + offset, len);
+    offset += len;
+    nread += len;
+  }
+
+  return nread;
+}
+
+
+/* Cookies are indices into the children of the directory. */
+void uvwasi__bundle_readdir(const struct uvwasi__bundle_s* bundle,
+                            uint32_t node,
+                            void* buf,
+                            size_t buf_len,
+                            uvwasi_dircookie_t cookie,
+                            size_t* bufused) {
+  const struct uvwasi__bundle_node_t* dir;
+  const struct uvwasi__bundle_node_t* child;
+  uvwasi_dirent_t dirent;
+  size_t available;
+  size_t size_to_cp;
+  uint64_t i;
+
+  dir = &bundle->nodes[node];
+  *bufused = 0;
+
+  for (i = cookie; i < dir->size && *bufused < buf_len; ++i) {
+    child = &bundle->nodes[dir->offset + i];
+    dirent.d_next = i + 1;
+    dirent.d_ino = dir->offset + i + 1;
+    dirent.d_namlen = child->name_len;
+    dirent.d_type = child->type;
+
+    available = buf_len - *bufused;
+    size_to_cp = sizeof(dirent) > available ? available : sizeof(dirent);
+    memcpy((char*)buf + *bufused, &dirent, size_to_cp);
+    *bufused += size_to_cp;
+
+    available = buf_len - *bufused;
+    size_to_cp = child->name_len > available ? available : child->name_len;
+    memcpy((char*)buf + *bufused, child->name, size_to_cp);
+    *bufused += size_to_cp;
+  }
+}
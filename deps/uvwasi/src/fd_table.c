@@ -1,13 +1,17 @@
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
 #ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
 # include <sys/types.h>
 #endif /* _WIN32 */
 
 #include "uv.h"
 #include "fd_table.h"
+#include "bundle.h"
 #include "wasi_types.h"
 #include "uv_mapping.h"
 
@@ -95,6 +99,21 @@
                                     UVWASI_RIGHT_SOCK_SHUTDOWN)
 #define UVWASI__RIGHTS_SOCKET_INHERITING UVWASI__RIGHTS_ALL;
 
+/* Bundles are read-only, and have neither host fds nor symlinks. */
+#define UVWASI__RIGHTS_BUNDLE_FILE_BASE (UVWASI_RIGHT_FD_READ |               \
+                                         UVWASI_RIGHT_FD_SEEK |               \
+                                         UVWASI_RIGHT_FD_TELL |               \
+                                         UVWASI_RIGHT_FD_FILESTAT_GET |       \
+                                         UVWASI_RIGHT_POLL_FD_READWRITE)
+#define UVWASI__RIGHTS_BUNDLE_FILE_INHERITING 0
+
+#define UVWASI__RIGHTS_BUNDLE_DIRECTORY_BASE (UVWASI_RIGHT_PATH_OPEN |        \
+                                              UVWASI_RIGHT_FD_READDIR |       \
+                                              UVWASI_RIGHT_PATH_FILESTAT_GET |\
+                                              UVWASI_RIGHT_FD_FILESTAT_GET)
+#define UVWASI__RIGHTS_BUNDLE_DIRECTORY_INHERITING                            \
+  (UVWASI__RIGHTS_BUNDLE_DIRECTORY_BASE | UVWASI__RIGHTS_BUNDLE_FILE_BASE)
+
 #define UVWASI__RIGHTS_TTY_BASE (UVWASI_RIGHT_FD_READ |                       \
                                  UVWASI_RIGHT_FD_FDSTAT_SET_FLAGS |           \
                                  UVWASI_RIGHT_FD_WRITE |                      \
@@ -175,6 +194,264 @@ static uvwasi_errno_t uvwasi__get_type_and_rights(uv_file fd,
 }
 
 
+#define UVWASI__FD_TABLE_NO_FREE_SLOT UINT32_MAX
+#define UVWASI__PATHS_INIT_SIZE 16
+
+
+uint32_t uvwasi__path_hash(const char* path, size_t len) {
+  uint32_t hash;
+  size_t i;
+
+  /* FNV-1a. */
+  hash = 2166136261u;
+  for (i = 0; i < len; ++i) {
+    hash ^= (unsigned char) path[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+
+static struct uvwasi__path_s* uvwasi__path_from_str(const char* str) {
+  return (struct uvwasi__path_s*) (str - offsetof(struct uvwasi__path_s, str));
+}
+
+
+static uvwasi_errno_t uvwasi__paths_grow(struct uvwasi_fd_table_t* table) {
+  struct uvwasi__path_s** new_paths;
+  struct uvwasi__path_s* entry;
+  struct uvwasi__path_s* next;
+  uint32_t new_size;
+  uint32_t i;
+
+  new_size = table->paths_size == 0 ? UVWASI__PATHS_INIT_SIZE :
+                                      table->paths_size * 2;
+  new_paths = calloc(new_size, sizeof(*new_paths));
+  if (new_paths == NULL)
+    return UVWASI_ENOMEM;
+
+  for (i = 0; i < table->paths_size; ++i) {
+    for (entry = table->paths[i]; entry != NULL; entry = next) {
+      next = entry->next;
+      entry->next = new_paths[entry->hash & (new_size - 1)];
+      new_paths[entry->hash & (new_size - 1)] = entry;
+    }
+  }
+
+  free(table->paths);
+  table->paths = new_paths;
+  table->paths_size = new_size;
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Returns a reference to the interned copy of path, or NULL if memory could
+   not be allocated. */
+static const char* uvwasi__path_intern(struct uvwasi_fd_table_t* table,
+                                       const char* path) {
+  struct uvwasi__path_s* entry;
+  uint32_t hash;
+  size_t len;
+
+  len = strlen(path);
+  hash = uvwasi__path_hash(path, len);
+
+  if (table->paths_size != 0) {
+    entry = table->paths[hash & (table->paths_size - 1)];
+    for (; entry != NULL; entry = entry->next) {
+      if (entry->hash == hash &&
+          entry->len == len &&
+          memcmp(entry->str, path, len) == 0) {
+        entry->refcount++;
+        return entry->str;
+      }
+    }
+  }
+
+  if (table->paths_used >= table->paths_size &&
+      uvwasi__paths_grow(table) != UVWASI_ESUCCESS) {
+    return NULL;
+  }
+
+  entry = malloc(offsetof(struct uvwasi__path_s, str) + len + 1);
+  if (entry == NULL)
+    return NULL;
+
+  memcpy(entry->str, path, len + 1);
+  entry->hash = hash;
+  entry->len = len;
+  entry->refcount = 1;
+  entry->next = table->paths[hash & (table->paths_size - 1)];
+  table->paths[hash & (table->paths_size - 1)] = entry;
+  table->paths_used++;
+  table->paths_bytes += offsetof(struct uvwasi__path_s, str) + len + 1;
+  return entry->str;
+}
+
+
+/* Returns another reference to an already interned path. */
+static const char* uvwasi__path_ref(const char* path) {
+  uvwasi__path_from_str(path)->refcount++;
+  return path;
+}
+
+
+static void uvwasi__path_release(struct uvwasi_fd_table_t* table,
+                                 const char* path) {
+  struct uvwasi__path_s** link;
+  struct uvwasi__path_s* entry;
+
+  if (path == NULL)
+    return;
+
+  entry = uvwasi__path_from_str(path);
+  if (--entry->refcount != 0)
+    return;
+
+  link = &table->paths[entry->hash & (table->paths_size - 1)];
+  while (*link != entry)
+    link = &(*link)->next;
+
+  *link = entry->next;
+  table->paths_used--;
+  table->paths_bytes -= offsetof(struct uvwasi__path_s, str) + entry->len + 1;
+  free(entry);
+}
+
+
+/* Makes threads that pinned the entry in uvwasi_fd_table_get() fail with
+   UVWASI_EBADF instead of using it. */
+static void uvwasi__fd_wrap_retire(struct uvwasi_fd_table_t* table,
+                                   struct uvwasi_fd_wrap_t* entry) {
+  uv_mutex_lock(&table->pin_mutex);
+  entry->generation++;
+  uv_mutex_unlock(&table->pin_mutex);
+}
+
+
+/* Drops a pin, and frees the entry if it was the last one of a detached
+   entry. The caller must not hold the table lock or the entry mutex. */
+static void uvwasi__fd_wrap_unpin(struct uvwasi_fd_table_t* table,
+                                  struct uvwasi_fd_wrap_t* entry) {
+  int last;
+
+  uv_mutex_lock(&table->pin_mutex);
+  entry->pins--;
+  last = entry->pins == 0 && entry->detached == 1;
+  uv_mutex_unlock(&table->pin_mutex);
+
+  if (last == 0)
+    return;
+
+  uvwasi__fd_wrap_close_dir(entry);
+  uv_rwlock_wrlock(&table->rwlock);
+  uvwasi__path_release(table, entry->path);
+  uvwasi__path_release(table, entry->real_path);
+  uv_rwlock_wrunlock(&table->rwlock);
+  uv_mutex_destroy(&entry->mutex);
+  free(entry);
+}
+
+
+/* Releases everything a slot owns and puts it on the free list. */
+static void uvwasi__fd_table_free_slot(struct uvwasi_fd_table_t* table,
+                                       struct uvwasi_fd_wrap_t* entry,
+                                       uvwasi_fd_t index) {
+  uvwasi__fd_wrap_retire(table, entry);
+  uvwasi__fd_wrap_close_dir(entry);
+  uvwasi__path_release(table, entry->path);
+  uvwasi__path_release(table, entry->real_path);
+  entry->path = NULL;
+  entry->real_path = NULL;
+  entry->valid = 0;
+  entry->id = table->free_head;
+  table->free_head = index;
+}
+
+
+/* Closes the host fd of an entry that is being discarded, unless it belongs
+   to the embedder. This is the case for the stdio fds. */
+static void uvwasi__fd_table_close_host_fd(struct uvwasi_fd_wrap_t* entry) {
+  uv_fs_t req;
+
+  if (entry->bundle != NULL || entry->fd <= 2)
+    return;
+
+  uv_fs_close(NULL, &req, entry->fd, NULL);
+  uv_fs_req_cleanup(&req);
+}
+
+
+/* Copies the members of src that describe the file into dst. */
+static void uvwasi__fd_wrap_assign(struct uvwasi_fd_wrap_t* dst,
+                                   const struct uvwasi_fd_wrap_t* src) {
+  memcpy(dst, src, offsetof(struct uvwasi_fd_wrap_t, generation));
+}
+
+
+static void uvwasi__fd_table_free_wraps(struct uvwasi_fd_table_t* table,
+                                        uint32_t from,
+                                        uint32_t to) {
+  uint32_t i;
+
+  for (i = from; i < to; ++i) {
+    uv_mutex_destroy(&table->fds[i]->mutex);
+    free(table->fds[i]);
+    table->fds[i] = NULL;
+  }
+}
+
+
+/* Allocates the entries for the slots [from, to). */
+static uvwasi_errno_t uvwasi__fd_table_alloc_wraps(
+    struct uvwasi_fd_table_t* table,
+    uint32_t from,
+    uint32_t to) {
+  struct uvwasi_fd_wrap_t* entry;
+  uint32_t i;
+
+  for (i = from; i < to; ++i) {
+    entry = calloc(1, sizeof(*entry));
+    if (entry == NULL)
+      goto error_exit;
+
+    if (uv_mutex_init(&entry->mutex) != 0) {
+      free(entry);
+      goto error_exit;
+    }
+
+    table->fds[i] = entry;
+  }
+
+  return UVWASI_ESUCCESS;
+error_exit:
+  uvwasi__fd_table_free_wraps(table, from, i);
+  return UVWASI_ENOMEM;
+}
+
+
+/* Adds the slots [from, to) to the free list so that lower indices are handed
+   out first. */
+static void uvwasi__fd_table_link_free(struct uvwasi_fd_table_t* table,
+                                       uint32_t from,
+                                       uint32_t to) {
+  struct uvwasi_fd_wrap_t* entry;
+  uint32_t i;
+
+  for (i = to; i > from; --i) {
+    entry = table->fds[i - 1];
+    entry->valid = 0;
+    entry->dir = NULL;
+    entry->bundle = NULL;
+    entry->path = NULL;
+    entry->real_path = NULL;
+    entry->id = table->free_head;
+    table->free_head = i - 1;
+  }
+}
+
+
 static uvwasi_errno_t uvwasi__fd_table_insert(struct uvwasi_fd_table_t* table,
                                               uv_file fd,
                                               const char* mapped_path,
@@ -185,49 +462,58 @@ static uvwasi_errno_t uvwasi__fd_table_insert(struct uvwasi_fd_table_t* table,
                                               int preopen,
                                               struct uvwasi_fd_wrap_t** wrap) {
   struct uvwasi_fd_wrap_t* entry;
-  struct uvwasi_fd_wrap_t* new_fds;
+  struct uvwasi_fd_wrap_t** new_fds;
+  const char* interned_path;
+  const char* interned_real_path;
   uint32_t new_size;
-  int index;
-  uint32_t i;
+  uvwasi_fd_t index;
 
-  /* Check that there is room for a new item. If there isn't, grow the table. */
-  if (table->used >= table->size) {
+  /* If there is no free slot, grow the table. */
+  if (table->free_head == UVWASI__FD_TABLE_NO_FREE_SLOT) {
     new_size = table->size * 2;
     new_fds = realloc(table->fds, new_size * sizeof(*new_fds));
     if (new_fds == NULL)
       return UVWASI_ENOMEM;
 
-    for (i = table->size; i < new_size; ++i)
-      new_fds[i].valid = 0;
-
-    index = table->size;
     table->fds = new_fds;
-    table->size = new_size;
-  } else {
-    /* The table is big enough, so find an empty slot for the new data. */
-    index = -1;
-    for (i = 0; i < table->size; ++i) {
-      if (table->fds[i].valid != 1) {
-        index = i;
-        break;
-      }
+    if (uvwasi__fd_table_alloc_wraps(table, table->size, new_size) !=
+        UVWASI_ESUCCESS) {
+      return UVWASI_ENOMEM;
     }
 
-    /* index should never be -1. */
-    if (index == -1)
-      return UVWASI_ENOSPC;
+    uvwasi__fd_table_link_free(table, table->size, new_size);
+    table->size = new_size;
   }
 
-  entry = &table->fds[index];
+  interned_path = uvwasi__path_intern(table, mapped_path);
+  if (interned_path == NULL)
+    return UVWASI_ENOMEM;
+
+  interned_real_path = uvwasi__path_intern(table, real_path);
+  if (interned_real_path == NULL) {
+    uvwasi__path_release(table, interned_path);
+    return UVWASI_ENOMEM;
+  }
+
+  index = table->free_head;
+  entry = table->fds[index];
+  table->free_head = entry->id;
+
   entry->id = index;
   entry->fd = fd;
-  strcpy(entry->path, mapped_path);
-  strcpy(entry->real_path, real_path);
+  entry->path = interned_path;
+  entry->real_path = interned_real_path;
   entry->type = type;
   entry->rights_base = rights_base;
   entry->rights_inheriting = rights_inheriting;
   entry->preopen = preopen;
+  entry->saved = 0;
   entry->valid = 1;
+  entry->dir = NULL;
+  entry->dir_cookie = UVWASI_DIRCOOKIE_START;
+  entry->bundle = NULL;
+  entry->bundle_node = 0;
+  entry->bundle_offset = 0;
   table->used++;
 
   if (wrap != NULL)
@@ -252,10 +538,36 @@ uvwasi_errno_t uvwasi_fd_table_init(struct uvwasi_fd_table_t* table,
 
   table->used = 0;
   table->size = init_size;
-  table->fds = calloc(init_size, sizeof(struct uvwasi_fd_wrap_t));
+  table->free_head = UVWASI__FD_TABLE_NO_FREE_SLOT;
+  table->paths = NULL;
+  table->paths_size = 0;
+  table->paths_used = 0;
+  table->paths_bytes = 0;
+  table->saved = NULL;
+  table->saved_count = 0;
+
+  if (uv_rwlock_init(&table->rwlock) != 0) {
+    table->fds = NULL;
+    return UVWASI_ENOMEM;
+  }
 
-  if (table->fds == NULL)
+  if (uv_mutex_init(&table->pin_mutex) != 0) {
+    uv_rwlock_destroy(&table->rwlock);
+    table->fds = NULL;
     return UVWASI_ENOMEM;
+  }
+
+  table->fds = calloc(init_size, sizeof(*table->fds));
+  if (table->fds == NULL ||
+      uvwasi__fd_table_alloc_wraps(table, 0, init_size) != UVWASI_ESUCCESS) {
+    free(table->fds);
+    table->fds = NULL;
+    uv_mutex_destroy(&table->pin_mutex);
+    uv_rwlock_destroy(&table->rwlock);
+    return UVWASI_ENOMEM;
+  }
+
+  uvwasi__fd_table_link_free(table, 0, init_size);
 
   /* Create the stdio FDs. */
   for (i = 0; i < 3; ++i) {
@@ -293,13 +605,44 @@ error_exit:
 
 
 void uvwasi_fd_table_free(struct uvwasi_fd_table_t* table) {
-  if (table == NULL)
+  struct uvwasi_fd_wrap_t* entry;
+  uint32_t i;
+
+  if (table == NULL || table->fds == NULL)
     return;
 
+  for (i = 0; i < table->size; ++i) {
+    entry = table->fds[i];
+    if (entry->valid != 1)
+      continue;
+
+    if (entry->saved == 0)
+      uvwasi__fd_table_close_host_fd(entry);
+    uvwasi__fd_table_free_slot(table, entry, i);
+  }
+
+  for (i = 0; i < table->saved_count; ++i) {
+    uvwasi__fd_table_close_host_fd(&table->saved[i]);
+    uvwasi__path_release(table, table->saved[i].path);
+    uvwasi__path_release(table, table->saved[i].real_path);
+  }
+
+  uvwasi__fd_table_free_wraps(table, 0, table->size);
+  uv_mutex_destroy(&table->pin_mutex);
+  uv_rwlock_destroy(&table->rwlock);
+  free(table->saved);
   free(table->fds);
+  free(table->paths);
+  table->saved = NULL;
+  table->saved_count = 0;
   table->fds = NULL;
   table->size = 0;
   table->used = 0;
+  table->free_head = UVWASI__FD_TABLE_NO_FREE_SLOT;
+  table->paths = NULL;
+  table->paths_size = 0;
+  table->paths_used = 0;
+  table->paths_bytes = 0;
 }
 
 
@@ -315,13 +658,18 @@ uvwasi_errno_t uvwasi_fd_table_insert_preopen(struct uvwasi_fd_table_t* table,
   if (table == NULL || path == NULL || real_path == NULL)
     return UVWASI_EINVAL;
 
-  err = uvwasi__get_type_and_rights(fd, 0, &type, &base, &inheriting);
+  err = uvwasi__get_type_and_rights(fd,
+                                    UV_FS_O_RDWR,
+                                    &type,
+                                    &base,
+                                    &inheriting);
   if (err != UVWASI_ESUCCESS)
     return err;
 
   if (type != UVWASI_FILETYPE_DIRECTORY)
     return UVWASI_ENOTDIR;
 
+  uv_rwlock_wrlock(&table->rwlock);
   err = uvwasi__fd_table_insert(table,
                                 fd,
                                 path,
@@ -331,10 +679,8 @@ uvwasi_errno_t uvwasi_fd_table_insert_preopen(struct uvwasi_fd_table_t* table,
                                 UVWASI__RIGHTS_DIRECTORY_INHERITING,
                                 1,
                                 NULL);
-  if (err != UVWASI_ESUCCESS)
-    return err;
-
-  return UVWASI_ESUCCESS;
+  uv_rwlock_wrunlock(&table->rwlock);
+  return err;
 }
 
 
@@ -358,6 +704,7 @@ uvwasi_errno_t uvwasi_fd_table_insert_fd(struct uvwasi_fd_table_t* table,
   if (r != UVWASI_ESUCCESS)
     return r;
 
+  uv_rwlock_wrlock(&table->rwlock);
   r = uvwasi__fd_table_insert(table,
                               fd,
                               path,
@@ -367,43 +714,227 @@ uvwasi_errno_t uvwasi_fd_table_insert_fd(struct uvwasi_fd_table_t* table,
                               rights_inheriting & max_inheriting,
                               0,
                               &fd_wrap);
-  if (r != UVWASI_ESUCCESS)
-    return r;
+  if (r == UVWASI_ESUCCESS)
+    uvwasi__fd_wrap_assign(wrap, fd_wrap);
 
-  *wrap = *fd_wrap;
-  return UVWASI_ESUCCESS;
+  uv_rwlock_wrunlock(&table->rwlock);
+  return r;
 }
 
 
-uvwasi_errno_t uvwasi_fd_table_get(const struct uvwasi_fd_table_t* table,
+uvwasi_errno_t uvwasi_fd_table_insert_stream(struct uvwasi_fd_table_t* table,
+                                             uv_stream_t* stream,
+                                             uvwasi_fd_t* id) {
+#ifdef _WIN32
+  /* uv_fileno() returns a SOCKET on Windows, which cannot be used where uvwasi
+     expects a CRT file descriptor. */
+  return UVWASI_ENOTSUP;
+#else
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_filetype_t type;
+  uvwasi_rights_t base;
+  uvwasi_rights_t inheriting;
+  uvwasi_errno_t err;
+  uv_os_fd_t stream_fd;
+  uv_fs_t req;
+  int fd;
+  int r;
+
+  if (table == NULL || stream == NULL || id == NULL)
+    return UVWASI_EINVAL;
+
+  r = uv_fileno((uv_handle_t*) stream, &stream_fd);
+  if (r != 0)
+    return uvwasi__translate_uv_error(r);
+
+  /* The table gets its own host fd, so the stream can be closed at any time
+     without the WASI fd referring to a closed or reused host fd. The open file
+     description is shared, and with it the non-blocking mode. */
+  fd = fcntl(stream_fd, F_DUPFD_CLOEXEC, 3);
+  if (fd == -1)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  err = uvwasi__get_type_and_rights(fd,
+                                    UV_FS_O_RDWR,
+                                    &type,
+                                    &base,
+                                    &inheriting);
+  if (err == UVWASI_ESUCCESS &&
+      type != UVWASI_FILETYPE_SOCKET_STREAM &&
+      type != UVWASI_FILETYPE_SOCKET_DGRAM) {
+    err = UVWASI_ENOTSOCK;
+  }
+
+  if (err == UVWASI_ESUCCESS) {
+    uv_rwlock_wrlock(&table->rwlock);
+    err = uvwasi__fd_table_insert(table,
+                                  fd,
+                                  "",
+                                  "",
+                                  type,
+                                  base,
+                                  inheriting,
+                                  0,
+                                  &wrap);
+    if (err == UVWASI_ESUCCESS)
+      *id = wrap->id;
+
+    uv_rwlock_wrunlock(&table->rwlock);
+  }
+
+  if (err != UVWASI_ESUCCESS) {
+    uv_fs_close(NULL, &req, fd, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+
+  return err;
+#endif /* _WIN32 */
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_insert_bundle(struct uvwasi_fd_table_t* table,
+                                             struct uvwasi__bundle_s* bundle,
+                                             uint32_t node,
+                                             const char* path,
+                                             int preopen,
+                                             uvwasi_rights_t rights_base,
+                                             uvwasi_rights_t rights_inheriting,
+                                             uvwasi_fd_t* id) {
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_filetype_t type;
+  uvwasi_rights_t max_base;
+  uvwasi_rights_t max_inheriting;
+  uvwasi_errno_t err;
+
+  if (table == NULL || bundle == NULL || path == NULL || id == NULL)
+    return UVWASI_EINVAL;
+
+  type = bundle->nodes[node].type;
+  if (type == UVWASI_FILETYPE_DIRECTORY) {
+    max_base = UVWASI__RIGHTS_BUNDLE_DIRECTORY_BASE;
+    max_inheriting = UVWASI__RIGHTS_BUNDLE_DIRECTORY_INHERITING;
+  } else {
+    max_base = UVWASI__RIGHTS_BUNDLE_FILE_BASE;
+    max_inheriting = UVWASI__RIGHTS_BUNDLE_FILE_INHERITING;
+  }
+
+  uv_rwlock_wrlock(&table->rwlock);
+  err = uvwasi__fd_table_insert(table,
+                                -1,
+                                path,
+                                path,
+                                type,
+                                rights_base & max_base,
+                                rights_inheriting & max_inheriting,
+                                preopen,
+                                &wrap);
+  if (err == UVWASI_ESUCCESS) {
+    wrap->bundle = bundle;
+    wrap->bundle_node = node;
+    *id = wrap->id;
+  }
+
+  uv_rwlock_wrunlock(&table->rwlock);
+  return err;
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_get(struct uvwasi_fd_table_t* table,
                                    const uvwasi_fd_t id,
                                    struct uvwasi_fd_wrap_t** wrap,
                                    uvwasi_rights_t rights_base,
                                    uvwasi_rights_t rights_inheriting) {
   struct uvwasi_fd_wrap_t* entry;
+  uint32_t generation;
+  int current;
+
+  if (table == NULL || wrap == NULL)
+    return UVWASI_EINVAL;
+
+  /* The entry is pinned so that it stays allocated, even if it is detached,
+     while this thread waits for it without the table lock. */
+  uv_rwlock_rdlock(&table->rwlock);
+  if (id >= table->size) {
+    uv_rwlock_rdunlock(&table->rwlock);
+    return UVWASI_EBADF;
+  }
+
+  entry = table->fds[id];
+  if (entry->valid != 1 || entry->id != id) {
+    uv_rwlock_rdunlock(&table->rwlock);
+    return UVWASI_EBADF;
+  }
+
+  uv_mutex_lock(&table->pin_mutex);
+  generation = entry->generation;
+  entry->pins++;
+  uv_mutex_unlock(&table->pin_mutex);
+  uv_rwlock_rdunlock(&table->rwlock);
+
+  uv_mutex_lock(&entry->mutex);
+  uv_mutex_lock(&table->pin_mutex);
+  current = entry->generation == generation;
+  uv_mutex_unlock(&table->pin_mutex);
+
+  if (current == 0) {
+    uv_mutex_unlock(&entry->mutex);
+    uvwasi__fd_wrap_unpin(table, entry);
+    return UVWASI_EBADF;
+  }
+
+  /* The entry was still in the table when this thread locked it, so a thread
+     that detached it since holds a pin of its own until it gets the mutex. */
+  uvwasi__fd_wrap_unpin(table, entry);
+
+  /* Validate that the fd has the necessary rights. */
+  if ((~entry->rights_base & rights_base) != 0 ||
+      (~entry->rights_inheriting & rights_inheriting) != 0) {
+    uv_mutex_unlock(&entry->mutex);
+    return UVWASI_ENOTCAPABLE;
+  }
+
+  *wrap = entry;
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Like uvwasi_fd_table_get(), for callers that hold the table lock
+   exclusively. */
+uvwasi_errno_t uvwasi_fd_table_get_nolock(struct uvwasi_fd_table_t* table,
+                                          const uvwasi_fd_t id,
+                                          struct uvwasi_fd_wrap_t** wrap,
+                                          uvwasi_rights_t rights_base,
+                                          uvwasi_rights_t rights_inheriting) {
+  struct uvwasi_fd_wrap_t* entry;
 
   if (table == NULL || wrap == NULL)
     return UVWASI_EINVAL;
   if (id >= table->size)
     return UVWASI_EBADF;
 
-  entry = &table->fds[id];
+  entry = table->fds[id];
 
+  /* Entries are only added and removed with the table locked exclusively, but
+     their rights can change while another thread holds them. */
   if (entry->valid != 1 || entry->id != id)
     return UVWASI_EBADF;
 
+  uv_mutex_lock(&entry->mutex);
+
   /* Validate that the fd has the necessary rights. */
   if ((~entry->rights_base & rights_base) != 0 ||
-      (~entry->rights_inheriting & rights_inheriting) != 0)
+      (~entry->rights_inheriting & rights_inheriting) != 0) {
+    uv_mutex_unlock(&entry->mutex);
     return UVWASI_ENOTCAPABLE;
+  }
 
   *wrap = entry;
   return UVWASI_ESUCCESS;
 }
 
 
-uvwasi_errno_t uvwasi_fd_table_remove(struct uvwasi_fd_table_t* table,
-                                      const uvwasi_fd_t id) {
+uvwasi_errno_t uvwasi_fd_table_remove_nolock(struct uvwasi_fd_table_t* table,
+                                             const uvwasi_fd_t id) {
   struct uvwasi_fd_wrap_t* entry;
 
   if (table == NULL)
@@ -411,12 +942,264 @@ uvwasi_errno_t uvwasi_fd_table_remove(struct uvwasi_fd_table_t* table,
   if (id >= table->size)
     return UVWASI_EBADF;
 
-  entry = &table->fds[id];
+  entry = table->fds[id];
 
   if (entry->valid != 1 || entry->id != id)
     return UVWASI_EBADF;
 
-  entry->valid = 0;
+  uvwasi__fd_table_free_slot(table, entry, id);
+  table->used--;
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Takes the entry for id out of the table and returns it, so that the caller
+   can wait for threads that still hold it without holding the table lock. The
+   slot gets a new, free entry, and can be reused right away. The returned
+   entry is pinned, and the caller releases it with
+   uvwasi_fd_table_free_detached(). */
+uvwasi_errno_t uvwasi_fd_table_detach(struct uvwasi_fd_table_t* table,
+                                      const uvwasi_fd_t id,
+                                      struct uvwasi_fd_wrap_t** wrap) {
+  struct uvwasi_fd_wrap_t* entry;
+  struct uvwasi_fd_wrap_t* spare;
+  uvwasi_errno_t err;
+
+  if (table == NULL || wrap == NULL)
+    return UVWASI_EINVAL;
+
+  spare = calloc(1, sizeof(*spare));
+  if (spare == NULL)
+    return UVWASI_ENOMEM;
+
+  if (uv_mutex_init(&spare->mutex) != 0) {
+    free(spare);
+    return UVWASI_ENOMEM;
+  }
+
+  err = UVWASI_EBADF;
+  uv_rwlock_wrlock(&table->rwlock);
+  if (id < table->size) {
+    entry = table->fds[id];
+    if (entry->valid == 1 && entry->id == id) {
+      table->fds[id] = spare;
+      spare->id = table->free_head;
+      table->free_head = id;
+      table->used--;
+      uv_mutex_lock(&table->pin_mutex);
+      entry->generation++;
+      entry->pins++;
+      entry->detached = 1;
+      uv_mutex_unlock(&table->pin_mutex);
+      *wrap = entry;
+      err = UVWASI_ESUCCESS;
+    }
+  }
+
+  uv_rwlock_wrunlock(&table->rwlock);
+
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_destroy(&spare->mutex);
+    free(spare);
+  }
+
+  return err;
+}
+
+
+/* Releases an entry returned by uvwasi_fd_table_detach(). The caller must not
+   hold its mutex, and its host fd is left to the caller. Threads that were
+   waiting for the entry in uvwasi_fd_table_get() fail with UVWASI_EBADF, and
+   the last of them frees it. */
+void uvwasi_fd_table_free_detached(struct uvwasi_fd_table_t* table,
+                                   struct uvwasi_fd_wrap_t* wrap) {
+  uvwasi__fd_wrap_unpin(table, wrap);
+}
+
+
+/* Moves the entry for src into the slot for dst, replacing whatever dst held.
+   The caller is responsible for closing the host fd of dst. */
+uvwasi_errno_t uvwasi_fd_table_renumber_nolock(struct uvwasi_fd_table_t* table,
+                                               const uvwasi_fd_t dst,
+                                               const uvwasi_fd_t src) {
+  struct uvwasi_fd_wrap_t* dst_entry;
+  struct uvwasi_fd_wrap_t* src_entry;
+
+  if (table == NULL)
+    return UVWASI_EINVAL;
+  if (dst >= table->size || src >= table->size)
+    return UVWASI_EBADF;
+
+  dst_entry = table->fds[dst];
+  src_entry = table->fds[src];
+
+  if (dst_entry->valid != 1 || dst_entry->id != dst ||
+      src_entry->valid != 1 || src_entry->id != src) {
+    return UVWASI_EBADF;
+  }
+
+  if (dst == src)
+    return UVWASI_ESUCCESS;
+
+  uvwasi__fd_wrap_retire(table, dst_entry);
+  uvwasi__fd_wrap_close_dir(dst_entry);
+  uvwasi__path_release(table, dst_entry->path);
+  uvwasi__path_release(table, dst_entry->real_path);
+  uvwasi__fd_wrap_assign(dst_entry, src_entry);
+  dst_entry->id = dst;
+
+  /* The paths and directory stream now belong to dst. */
+  src_entry->path = NULL;
+  src_entry->real_path = NULL;
+  src_entry->dir = NULL;
+  uvwasi__fd_table_free_slot(table, src_entry, src);
   table->used--;
   return UVWASI_ESUCCESS;
 }
+
+
+void uvwasi_fd_table_lock(struct uvwasi_fd_table_t* table) {
+  uv_rwlock_wrlock(&table->rwlock);
+}
+
+
+void uvwasi_fd_table_unlock(struct uvwasi_fd_table_t* table) {
+  uv_rwlock_wrunlock(&table->rwlock);
+}
+
+
+uvwasi_errno_t uvwasi_fd_table_save(struct uvwasi_fd_table_t* table) {
+  struct uvwasi_fd_wrap_t* saved;
+  struct uvwasi_fd_wrap_t* entry;
+  uint32_t count;
+  uint32_t i;
+
+  if (table == NULL)
+    return UVWASI_EINVAL;
+
+  uv_rwlock_wrlock(&table->rwlock);
+  if (table->saved != NULL) {
+    uv_rwlock_wrunlock(&table->rwlock);
+    return UVWASI_EINVAL;
+  }
+
+  saved = malloc(table->used * sizeof(*saved));
+  if (saved == NULL && table->used != 0) {
+    uv_rwlock_wrunlock(&table->rwlock);
+    return UVWASI_ENOMEM;
+  }
+
+  count = 0;
+  for (i = 0; i < table->size; ++i) {
+    entry = table->fds[i];
+    if (entry->valid != 1)
+      continue;
+
+    uv_mutex_lock(&entry->mutex);
+    entry->saved = 1;
+    uvwasi__fd_wrap_assign(&saved[count], entry);
+    uv_mutex_unlock(&entry->mutex);
+    saved[count].path = uvwasi__path_ref(entry->path);
+    saved[count].real_path = uvwasi__path_ref(entry->real_path);
+    saved[count].dir = NULL;
+    saved[count].dir_cookie = UVWASI_DIRCOOKIE_START;
+    count++;
+  }
+
+  table->saved = saved;
+  table->saved_count = count;
+  uv_rwlock_wrunlock(&table->rwlock);
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Closes every entry that is not in the saved table, and puts the saved
+   entries back at their original indices with their original rights. Free
+   slots are then handed out in the same order as after the table was saved.
+   Entries that other threads are using are waited for. */
+uvwasi_errno_t uvwasi_fd_table_restore(struct uvwasi_fd_table_t* table) {
+  struct uvwasi_fd_wrap_t* entry;
+  struct uvwasi_fd_wrap_t* saved;
+  uint32_t i;
+
+  if (table == NULL)
+    return UVWASI_EINVAL;
+
+  uv_rwlock_wrlock(&table->rwlock);
+  if (table->saved == NULL) {
+    uv_rwlock_wrunlock(&table->rwlock);
+    return UVWASI_EINVAL;
+  }
+
+  for (i = 0; i < table->size; ++i) {
+    entry = table->fds[i];
+    if (entry->valid != 1)
+      continue;
+
+    uv_mutex_lock(&entry->mutex);
+    uvwasi__fd_wrap_retire(table, entry);
+    if (entry->saved == 0)
+      uvwasi__fd_table_close_host_fd(entry);
+
+    uvwasi__fd_wrap_close_dir(entry);
+    uvwasi__path_release(table, entry->path);
+    uvwasi__path_release(table, entry->real_path);
+    entry->path = NULL;
+    entry->real_path = NULL;
+    entry->valid = 0;
+    uv_mutex_unlock(&entry->mutex);
+  }
+
+  for (i = 0; i < table->saved_count; ++i) {
+    saved = &table->saved[i];
+    entry = table->fds[saved->id];
+    uvwasi__fd_wrap_assign(entry, saved);
+    entry->path = uvwasi__path_ref(saved->path);
+    entry->real_path = uvwasi__path_ref(saved->real_path);
+  }
+
+  table->free_head = UVWASI__FD_TABLE_NO_FREE_SLOT;
+  for (i = table->size; i > 0; --i) {
+    entry = table->fds[i - 1];
+    if (entry->valid == 1)
+      continue;
+
+    entry->dir = NULL;
+    entry->bundle = NULL;
+    entry->id = table->free_head;
+    table->free_head = i - 1;
+  }
+
+  table->used = table->saved_count;
+  uv_rwlock_wrunlock(&table->rwlock);
+  return UVWASI_ESUCCESS;
+}
+
+
+size_t uvwasi_fd_table_memory_size(struct uvwasi_fd_table_t* table) {
+  size_t size;
+
+  if (table == NULL)
+    return 0;
+
+  uv_rwlock_rdlock(&table->rwlock);
+  size = table->size * (sizeof(*table->fds) + sizeof(**table->fds)) +
+         table->saved_count * sizeof(*table->saved) +
+         table->paths_size * sizeof(*table->paths) +
+         table->paths_bytes;
+  uv_rwlock_rdunlock(&table->rwlock);
+  return size;
+}
+
+
+void uvwasi__fd_wrap_close_dir(struct uvwasi_fd_wrap_t* wrap) {
+  uv_fs_t req;
+
+  if (wrap->dir == NULL)
+    return;
+
+  uv_fs_closedir(NULL, &req, wrap->dir, NULL);
+  uv_fs_req_cleanup(&req);
+  wrap->dir = NULL;
+  wrap->dir_cookie = UVWASI_DIRCOOKIE_START;
+}
@@ -0,0 +1,674 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+# define SLASH '/'
+# define SLASH_STR "/"
+# define IS_SLASH(c) ((c) == '/')
+#else
+# define SLASH '\\'
+# define SLASH_STR "\\"
+# define IS_SLASH(c) ((c) == '/' || (c) == '\\')
+#endif /* _WIN32 */
+
+#ifndef O_CLOEXEC
+# define O_CLOEXEC 0
+#endif
+
+/* Matches the limit Linux places on symlink expansions within one lookup. */
+#define UVWASI__MAX_SYMLINK_EXPANSIONS 40
+
+#include "uvwasi.h"
+#include "uv.h"
+#include "uv_mapping.h"
+#include "fd_table.h"
+#include "path_resolver.h"
+
+
+static int uvwasi__is_absolute_path(const char* path, size_t path_len) {
+  /* TODO(cjihrig): Add a Windows implementation. */
+  return path != NULL && path_len > 0 && path[0] == SLASH;
+}
+
+
+/* Returns 1 if path names prefix itself or something below it. Unlike a plain
+   string comparison, /foo is not considered a prefix of /foobar. */
+static int uvwasi__is_path_prefix(const char* prefix,
+                                  size_t prefix_len,
+                                  const char* path,
+                                  size_t path_len) {
+  if (path_len < prefix_len || 0 != memcmp(prefix, path, prefix_len))
+    return 0;
+
+  return path_len == prefix_len ||
+         IS_SLASH(path[prefix_len]) ||
+         (prefix_len > 0 && IS_SLASH(prefix[prefix_len - 1]));
+}
+
+
+uvwasi_errno_t uvwasi__path_cache_init(struct uvwasi__path_cache_t* cache) {
+  memset(cache->entries, 0, sizeof(cache->entries));
+  cache->clock = 0;
+  if (uv_mutex_init(&cache->mutex) != 0)
+    return UVWASI_ENOMEM;
+
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Drops the entry, which must be in use. */
+static void uvwasi__path_cache_clear(struct uvwasi__path_cache_entry_t* entry) {
+#ifndef _WIN32
+  close(entry->fd);
+#endif /* _WIN32 */
+  free(entry->path);
+  memset(entry, 0, sizeof(*entry));
+}
+
+
+void uvwasi__path_cache_free(struct uvwasi__path_cache_t* cache) {
+  int i;
+
+  for (i = 0; i < UVWASI__PATH_CACHE_SIZE; ++i) {
+    if (cache->entries[i].path != NULL)
+      uvwasi__path_cache_clear(&cache->entries[i]);
+  }
+
+  memset(cache->entries, 0, sizeof(cache->entries));
+  uv_mutex_destroy(&cache->mutex);
+}
+
+
+void uvwasi__path_cache_invalidate(struct uvwasi__path_cache_t* cache,
+                                   const char* path) {
+  struct uvwasi__path_cache_entry_t* entry;
+  size_t len;
+  int i;
+
+  len = strlen(path);
+  uv_mutex_lock(&cache->mutex);
+  for (i = 0; i < UVWASI__PATH_CACHE_SIZE; ++i) {
+    entry = &cache->entries[i];
+    if (entry->path != NULL &&
+        uvwasi__is_path_prefix(path, len, entry->path, entry->len)) {
+      uvwasi__path_cache_clear(entry);
+    }
+  }
+  uv_mutex_unlock(&cache->mutex);
+}
+
+
+#ifndef _WIN32
+/* Returns 1 if the directory at path is cached. If dir_fd is not NULL, it
+   receives a duplicate of the cached fd. */
+static int uvwasi__path_cache_lookup(struct uvwasi__path_cache_t* cache,
+                                     const char* path,
+                                     size_t len,
+                                     int* dir_fd) {
+  struct uvwasi__path_cache_entry_t* entry;
+  uint32_t hash;
+  int found;
+  int i;
+
+  hash = uvwasi__path_hash(path, len);
+  found = 0;
+  uv_mutex_lock(&cache->mutex);
+  for (i = 0; i < UVWASI__PATH_CACHE_SIZE; ++i) {
+    entry = &cache->entries[i];
+    if (entry->path != NULL &&
+        entry->hash == hash &&
+        entry->len == len &&
+        0 == memcmp(entry->path, path, len)) {
+      if (dir_fd != NULL)
+        *dir_fd = fcntl(entry->fd, F_DUPFD_CLOEXEC, 0);
+      found = dir_fd == NULL || *dir_fd != -1;
+      if (found)
+        entry->last_used = ++cache->clock;
+      break;
+    }
+  }
+
+  uv_mutex_unlock(&cache->mutex);
+  return found;
+}
+
+
+/* Remembers that dir_fd is the directory at path. The cache keeps its own
+   duplicate of dir_fd. */
+static void uvwasi__path_cache_insert(struct uvwasi__path_cache_t* cache,
+                                      const char* path,
+                                      size_t len,
+                                      int dir_fd) {
+  struct uvwasi__path_cache_entry_t* entry;
+  struct uvwasi__path_cache_entry_t* victim;
+  char* copy;
+  int i;
+
+  /* The cache is only an optimization, so failing to allocate is not fatal. */
+  copy = malloc(len + 1);
+  if (copy == NULL)
+    return;
+
+  dir_fd = fcntl(dir_fd, F_DUPFD_CLOEXEC, 0);
+  if (dir_fd == -1) {
+    free(copy);
+    return;
+  }
+
+  memcpy(copy, path, len);
+  copy[len] = '\0';
+
+  uv_mutex_lock(&cache->mutex);
+  victim = &cache->entries[0];
+  for (i = 0; i < UVWASI__PATH_CACHE_SIZE; ++i) {
+    entry = &cache->entries[i];
+    if (entry->path == NULL) {
+      victim = entry;
+      break;
+    }
+
+    if (entry->last_used < victim->last_used)
+      victim = entry;
+  }
+
+  if (victim->path != NULL)
+    uvwasi__path_cache_clear(victim);
+  victim->path = copy;
+  victim->len = len;
+  victim->hash = uvwasi__path_hash(path, len);
+  victim->last_used = ++cache->clock;
+  victim->fd = dir_fd;
+  uv_mutex_unlock(&cache->mutex);
+}
+
+
+/* Rewrites the absolute host path in buf, of length *len, relative to the
+   sandbox root. Absolute paths outside of the sandbox are rejected. */
+static uvwasi_errno_t uvwasi__strip_root(const char* root,
+                                         size_t root_len,
+                                         char* buf,
+                                         size_t* len) {
+  if (!uvwasi__is_path_prefix(root, root_len, buf, *len))
+    return UVWASI_ENOTCAPABLE;
+
+  memmove(buf, buf + root_len, *len - root_len + 1);
+  *len -= root_len;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__close_dir_fd(int* dir_fd) {
+  if (*dir_fd != -1)
+    close(*dir_fd);
+
+  *dir_fd = -1;
+}
+
+
+/* Opens the directory at the first len bytes of path, which the resolver has
+   already reached from the root fd without traversing a symlink. It comes
+   from the cache, or its components are opened again, one at a time and
+   without following symlinks, so that the path string is never handed to the
+   kernel as a whole. */
+static uvwasi_errno_t uvwasi__open_resolved_dir(
+    uvwasi_t* uvwasi,
+    const struct uvwasi_fd_wrap_t* fd,
+    char* path,
+    size_t root_len,
+    size_t len,
+    int* dir_fd) {
+  uvwasi_errno_t err;
+  size_t pos;
+  size_t end;
+  int next_fd;
+  char saved;
+
+  if (len > root_len &&
+      uvwasi__path_cache_lookup(&uvwasi->path_cache, path, len, dir_fd)) {
+    return UVWASI_ESUCCESS;
+  }
+
+  *dir_fd = fcntl(fd->fd, F_DUPFD_CLOEXEC, 0);
+  if (*dir_fd == -1)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  /* Every component is preceded by a single slash. */
+  for (pos = root_len; pos < len; pos = end) {
+    end = pos + 1;
+    while (end < len && !IS_SLASH(path[end]))
+      end++;
+
+    saved = path[end];
+    path[end] = '\0';
+    next_fd = openat(*dir_fd,
+                     path + pos + 1,
+                     O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    path[end] = saved;
+    if (next_fd == -1) {
+      err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+      uvwasi__close_dir_fd(dir_fd);
+      return err;
+    }
+
+    uvwasi__close_dir_fd(dir_fd);
+    *dir_fd = next_fd;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+/* Resolves path one component at a time, starting from the directory open as
+   fd. Every intermediate component is opened relative to its parent with
+   O_NOFOLLOW, so symlinks are found and expanded here rather than by the
+   kernel. ".." is applied to the resolved path, and the sandbox check is a
+   matter of never popping above the root, instead of comparing strings after
+   the fact. The final component is only expanded if the caller asked for
+   UVWASI_LOOKUP_SYMLINK_FOLLOW.
+
+   The result is the directory that contains the final component, still open,
+   and the name of the component in it. The caller makes its system call
+   relative to that directory, and must not follow the final component unless
+   it asked for it, with O_NOFOLLOW, AT_SYMLINK_NOFOLLOW and the like. A
+   concurrent change to the host file system can make the call fail, but not
+   redirect it outside of the sandbox. */
+uvwasi_errno_t uvwasi__resolve_path(uvwasi_t* uvwasi,
+                                    const struct uvwasi_fd_wrap_t* fd,
+                                    const char* path,
+                                    size_t path_len,
+                                    struct uvwasi__resolved_path_t* resolved,
+                                    uvwasi_lookupflags_t flags) {
+  char pending[PATH_MAX_BYTES];
+  char link[PATH_MAX_BYTES];
+  char* resolved_path;
+  uvwasi_errno_t err;
+  const char* comp;
+  ssize_t link_size;
+  size_t link_len;
+  size_t pending_len;
+  size_t comp_len;
+  size_t root_len;
+  size_t prev_len;
+  size_t out_len;
+  size_t depth;
+  size_t pos;
+  size_t i;
+  int expansions;
+  int has_name;
+  int follow;
+  int last;
+  int dir_fd;
+  int next_fd;
+
+  resolved->dir_fd = -1;
+  resolved->name = NULL;
+  resolved_path = resolved->host_path;
+
+  /* path_len is the size of the guest buffer, which is not necessarily null
+     terminated. Stop at an embedded null byte, as the old resolver did. */
+  comp = memchr(path, '\0', path_len);
+  pending_len = comp == NULL ? path_len : (size_t) (comp - path);
+  if (pending_len >= sizeof(pending))
+    return UVWASI_ENAMETOOLONG;
+
+  memcpy(pending, path, pending_len);
+  pending[pending_len] = '\0';
+
+  /* A root of "/" is stored without its trailing slash, so that appending
+     components does not produce "//". */
+  root_len = strlen(fd->real_path);
+  if (root_len > 0 && IS_SLASH(fd->real_path[root_len - 1]))
+    root_len--;
+  if (root_len >= PATH_MAX_BYTES)
+    return UVWASI_ENAMETOOLONG;
+
+  if (uvwasi__is_absolute_path(pending, pending_len)) {
+    err = uvwasi__strip_root(fd->real_path, root_len, pending, &pending_len);
+    if (err != UVWASI_ESUCCESS)
+      return err;
+  }
+
+  memcpy(resolved_path, fd->real_path, root_len);
+  out_len = root_len;
+  prev_len = root_len;
+  resolved_path[out_len] = '\0';
+
+  /* dir_fd refers to the directory at resolved_path, or is -1 if it has not
+     been opened yet, because it came from the cache or from "..". */
+  dir_fd = fcntl(fd->fd, F_DUPFD_CLOEXEC, 0);
+  if (dir_fd == -1)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  err = UVWASI_ESUCCESS;
+  follow = (flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) != 0;
+  has_name = 0;
+  expansions = 0;
+  depth = 0;
+  pos = 0;
+
+  for (;;) {
+    while (pos < pending_len && IS_SLASH(pending[pos]))
+      pos++;
+    if (pos == pending_len)
+      break;
+
+    comp = pending + pos;
+    comp_len = 0;
+    while (pos + comp_len < pending_len && !IS_SLASH(comp[comp_len]))
+      comp_len++;
+    pos += comp_len;
+
+    last = 1;
+    for (i = pos; i < pending_len; ++i) {
+      if (!IS_SLASH(pending[i])) {
+        last = 0;
+        break;
+      }
+    }
+
+    if (comp_len == 1 && comp[0] == '.')
+      continue;
+
+    if (comp_len == 2 && comp[0] == '.' && comp[1] == '.') {
+      if (depth == 0) {
+        err = UVWASI_ENOTCAPABLE;
+        goto exit;
+      }
+
+      /* Every component of resolved_path is a real directory, so ".." can be
+         applied to the string. */
+      while (!IS_SLASH(resolved_path[out_len - 1]))
+        out_len--;
+      out_len--;
+      resolved_path[out_len] = '\0';
+      depth--;
+      uvwasi__close_dir_fd(&dir_fd);
+      continue;
+    }
+
+    if (out_len + 1 + comp_len >= PATH_MAX_BYTES) {
+      err = UVWASI_ENAMETOOLONG;
+      goto exit;
+    }
+
+    prev_len = out_len;
+    resolved_path[out_len] = SLASH;
+    memcpy(resolved_path + out_len + 1, comp, comp_len);
+    out_len += 1 + comp_len;
+    resolved_path[out_len] = '\0';
+
+    if (last && !follow) {
+      has_name = 1;
+      break;
+    }
+
+    /* A cached directory is only opened once the walk needs it, by
+       uvwasi__open_resolved_dir(). */
+    if (!last && uvwasi__path_cache_lookup(&uvwasi->path_cache,
+                                           resolved_path,
+                                           out_len,
+                                           NULL)) {
+      uvwasi__close_dir_fd(&dir_fd);
+      depth++;
+      continue;
+    }
+
+    if (dir_fd == -1) {
+      err = uvwasi__open_resolved_dir(uvwasi,
+                                      fd,
+                                      resolved_path,
+                                      root_len,
+                                      prev_len,
+                                      &dir_fd);
+      if (err != UVWASI_ESUCCESS)
+        goto exit;
+    }
+
+    if (!last) {
+      next_fd = openat(dir_fd,
+                       resolved_path + prev_len + 1,
+                       O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (next_fd != -1) {
+        uvwasi__close_dir_fd(&dir_fd);
+        dir_fd = next_fd;
+        depth++;
+        uvwasi__path_cache_insert(&uvwasi->path_cache,
+                                  resolved_path,
+                                  out_len,
+                                  dir_fd);
+        continue;
+      }
+
+      /* Symlinks fail with ELOOP on Linux and macOS, EMLINK on FreeBSD. */
+      if (errno != ELOOP && errno != EMLINK && errno != ENOTDIR) {
+        err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+        goto exit;
+      }
+    }
+
+    link_size = readlinkat(dir_fd,
+                           resolved_path + prev_len + 1,
+                           link,
+                           sizeof(link));
+    if (link_size == -1) {
+      /* EINVAL means that the component is not a symlink. That is fine for
+         the final component, which may also not exist yet. */
+      if (last && (errno == EINVAL || errno == ENOENT)) {
+        has_name = 1;
+        break;
+      }
+
+      if (errno == EINVAL)
+        err = UVWASI_ENOTDIR;
+      else
+        err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+      goto exit;
+    }
+
+    link_len = (size_t) link_size;
+    if (link_len >= sizeof(link)) {
+      err = UVWASI_ENAMETOOLONG;
+      goto exit;
+    }
+
+    if (++expansions > UVWASI__MAX_SYMLINK_EXPANSIONS) {
+      err = UVWASI_ELOOP;
+      goto exit;
+    }
+
+    link[link_len] = '\0';
+    out_len = prev_len;
+    resolved_path[out_len] = '\0';
+
+    /* Absolute targets restart the walk from the root, if they are inside of
+       the sandbox at all. */
+    if (uvwasi__is_absolute_path(link, link_len)) {
+      err = uvwasi__strip_root(fd->real_path, root_len, link, &link_len);
+      if (err != UVWASI_ESUCCESS)
+        goto exit;
+
+      out_len = root_len;
+      resolved_path[out_len] = '\0';
+      depth = 0;
+      uvwasi__close_dir_fd(&dir_fd);
+    }
+
+    /* Replace the consumed part of pending with the symlink's target. The
+       remainder starts with a slash unless it is empty. */
+    if (link_len + pending_len - pos >= sizeof(pending)) {
+      err = UVWASI_ENAMETOOLONG;
+      goto exit;
+    }
+
+    memmove(pending + link_len, pending + pos, pending_len - pos + 1);
+    memcpy(pending, link, link_len);
+    pending_len = link_len + pending_len - pos;
+    pos = 0;
+  }
+
+  /* Without a final component, the path names the directory itself. */
+  if (!has_name)
+    prev_len = out_len;
+
+  if (dir_fd == -1) {
+    err = uvwasi__open_resolved_dir(uvwasi,
+                                    fd,
+                                    resolved_path,
+                                    root_len,
+                                    prev_len,
+                                    &dir_fd);
+    if (err != UVWASI_ESUCCESS)
+      goto exit;
+  }
+
+  if (has_name)
+    resolved->name = resolved_path + prev_len + 1;
+  else
+    resolved->name = ".";
+  resolved->dir_fd = dir_fd;
+  dir_fd = -1;
+
+  if (out_len == 0) {
+    resolved_path[0] = SLASH;
+    resolved_path[1] = '\0';
+  }
+
+exit:
+  uvwasi__close_dir_fd(&dir_fd);
+  return err;
+}
+
+
+void uvwasi__resolved_path_free(struct uvwasi__resolved_path_t* resolved) {
+  uvwasi__close_dir_fd(&resolved->dir_fd);
+}
+#else
+uvwasi_errno_t uvwasi__resolve_path(uvwasi_t* uvwasi,
+                                    const struct uvwasi_fd_wrap_t* fd,
+                                    const char* path,
+                                    size_t path_len,
+                                    struct uvwasi__resolved_path_t* resolved,
+                                    uvwasi_lookupflags_t flags) {
+  /* TODO(cjihrig): path_len is treated as a size. Need to verify if path_len is
+     really a string length or a size. Also need to verify if it is null
+     terminated. */
+  uv_fs_t realpath_req;
+  uvwasi_errno_t err;
+  char* abs_path;
+  char* tok;
+  char* ptr;
+  int realpath_size;
+  int abs_size;
+  int input_is_absolute;
+  char* resolved_path;
+  int r;
+  int i;
+
+  resolved->dir_fd = -1;
+  resolved->name = resolved->host_path;
+  resolved_path = resolved->host_path;
+  err = UVWASI_ESUCCESS;
+  input_is_absolute = uvwasi__is_absolute_path(path, path_len);
+
+  if (1 == input_is_absolute) {
+    /* TODO(cjihrig): Revisit this. Copying is probably not necessary here. */
+    abs_size = path_len;
+    abs_path = malloc(abs_size);
+    if (abs_path == NULL) {
+      err = UVWASI_ENOMEM;
+      goto exit;
+    }
+
+    memcpy(abs_path, path, abs_size);
+  } else {
+    /* Resolve the relative path to fd's real path. */
+    abs_size = path_len + strlen(fd->real_path) + 2;
+    abs_path = malloc(abs_size);
+    if (abs_path == NULL) {
+      err = UVWASI_ENOMEM;
+      goto exit;
+    }
+
+    r = snprintf(abs_path, abs_size, "%s/%s", fd->real_path, path);
+    if (r <= 0) {
+      err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+      goto exit;
+    }
+  }
+
+  /* On Windows, convert slashes to backslashes. */
+  for (i = 0; i < abs_size; ++i) {
+    if (abs_path[i] == '/')
+      abs_path[i] = SLASH;
+  }
+
+  ptr = resolved_path;
+  tok = strtok(abs_path, SLASH_STR);
+  for (; tok != NULL; tok = strtok(NULL, SLASH_STR)) {
+    if (0 == strcmp(tok, "."))
+      continue;
+
+    if (0 == strcmp(tok, "..")) {
+      while (*ptr != SLASH && ptr != resolved_path)
+        ptr--;
+      *ptr = '\0';
+      continue;
+    }
+
+    /* On Windows, prevent a leading slash in the path. */
+    if (ptr == resolved_path)
+      r = sprintf(ptr, "%s", tok);
+    else
+      r = sprintf(ptr, "%c%s", SLASH, tok);
+
+    if (r < 1) { /* At least one character should have been written. */
+      err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+      goto exit;
+    }
+
+    ptr += r;
+  }
+
+  if ((flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) == UVWASI_LOOKUP_SYMLINK_FOLLOW) {
+    r = uv_fs_realpath(NULL, &realpath_req, resolved_path, NULL);
+    if (r == 0) {
+      realpath_size = strlen(realpath_req.ptr) + 1;
+      if (realpath_size > PATH_MAX_BYTES) {
+        err = UVWASI_ENOBUFS;
+        uv_fs_req_cleanup(&realpath_req);
+        goto exit;
+      }
+
+      memcpy(resolved_path, realpath_req.ptr, realpath_size);
+    } else if (r != UV_ENOENT) {
+      /* Report errors except ENOENT. */
+      err = uvwasi__translate_uv_error(r);
+      uv_fs_req_cleanup(&realpath_req);
+      goto exit;
+    }
+
+    uv_fs_req_cleanup(&realpath_req);
+  }
+
+  /* Verify that the resolved path is still in the sandbox. */
+  if (!uvwasi__is_path_prefix(fd->real_path,
+                              strlen(fd->real_path),
+                              resolved_path,
+                              strlen(resolved_path))) {
+    err = UVWASI_ENOTCAPABLE;
+    goto exit;
+  }
+
+exit:
+  free(abs_path);
+  return err;
+}
+
+
+void uvwasi__resolved_path_free(struct uvwasi__resolved_path_t* resolved) {
+  (void) resolved;
+}
+#endif /* _WIN32 */
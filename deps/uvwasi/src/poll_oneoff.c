@@ -0,0 +1,536 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/ioctl.h>
+# include <sys/types.h>
+# include <unistd.h>
+#endif /* _WIN32 */
+
+#include "uv.h"
+#include "uvwasi.h"
+#include "poll_oneoff.h"
+#include "uv_mapping.h"
+#include "fd_table.h"
+#include "bundle.h"
+
+#define UVWASI__NANOS_PER_MILLI 1000000
+
+
+struct uvwasi__poll_state_s;
+
+/* One uv_poll_t is created per distinct host file descriptor. libuv does not
+   allow the same descriptor to be watched by two handles in one loop, so
+   subscriptions for the same fd share a handle and OR their events. */
+struct uvwasi__poll_fd_s {
+  uv_poll_t handle;
+  uv_file fd;
+  int events;
+  int flags;
+  int active;
+  struct uvwasi__poll_state_s* state;
+};
+
+struct uvwasi__poll_state_s {
+  uv_loop_t* loop;
+  uv_timer_t timer;
+  int timer_active;
+  const uvwasi_subscription_t* subs;
+  size_t nsubscriptions;
+  uint64_t* deadlines;
+  struct uvwasi__poll_fd_s** sub_handles;
+  char* done;
+  struct uvwasi__poll_fd_s* handles;
+  size_t handle_count;
+  uvwasi_event_t* out;
+  size_t nevents;
+};
+
+
+static uint64_t uvwasi__poll_ns_to_ms(uint64_t ns) {
+  /* Round up so that the timer never fires before the requested timeout. */
+  return ns / UVWASI__NANOS_PER_MILLI +
+         (ns % UVWASI__NANOS_PER_MILLI != 0 ? 1 : 0);
+}
+
+
+static void uvwasi__poll_record(struct uvwasi__poll_state_s* state,
+                                size_t index,
+                                uvwasi_errno_t error,
+                                uvwasi_filesize_t nbytes,
+                                uvwasi_eventrwflags_t flags) {
+  uvwasi_event_t* event;
+
+  if (state->done[index] != 0)
+    return;
+
+  state->done[index] = 1;
+  event = &state->out[state->nevents++];
+  event->userdata = state->subs[index].userdata;
+  event->error = error;
+  event->type = state->subs[index].type;
+  event->u.fd_readwrite.nbytes = nbytes;
+  event->u.fd_readwrite.flags = flags;
+}
+
+
+static uvwasi_errno_t uvwasi__poll_clock_timeout(
+                                              uvwasi_t* uvwasi,
+                                              const uvwasi_subscription_t* sub,
+                                              uvwasi_timestamp_t* timeout) {
+  uvwasi_timestamp_t now;
+  uvwasi_errno_t err;
+
+  switch (sub->u.clock.clock_id) {
+    case UVWASI_CLOCK_MONOTONIC:
+    case UVWASI_CLOCK_REALTIME:
+    case UVWASI_CLOCK_PROCESS_CPUTIME_ID:
+    case UVWASI_CLOCK_THREAD_CPUTIME_ID:
+      break;
+    default:
+      return UVWASI_EINVAL;
+  }
+
+  if ((sub->u.clock.flags & UVWASI_SUBSCRIPTION_CLOCK_ABSTIME) == 0) {
+    *timeout = sub->u.clock.timeout;
+    return UVWASI_ESUCCESS;
+  }
+
+  err = uvwasi_clock_time_get(uvwasi, sub->u.clock.clock_id, 0, &now);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  *timeout = sub->u.clock.timeout > now ? sub->u.clock.timeout - now : 0;
+  return UVWASI_ESUCCESS;
+}
+
+
+static int uvwasi__poll_fd_is_pollable(uv_file fd) {
+#ifdef _WIN32
+  /* uv_poll_t only supports sockets on Windows, and WASI fds are CRT fds. */
+  return 0;
+#else
+  /* Regular files, directories, and most character devices (/dev/null, for
+     example) cannot be watched with epoll and friends. They are always
+     considered ready. */
+  switch (uv_guess_handle(fd)) {
+    case UV_TTY:
+    case UV_NAMED_PIPE:
+    case UV_TCP:
+    case UV_UDP:
+      return 1;
+    default:
+      return 0;
+  }
+#endif /* _WIN32 */
+}
+
+
+/* Bundle entries are always ready, like regular files. */
+static uvwasi_filesize_t uvwasi__poll_bundle_nbytes(
+    const struct uvwasi_fd_wrap_t* wrap,
+    uvwasi_eventtype_t type) {
+  uvwasi_filesize_t size;
+
+  if (type != UVWASI_EVENTTYPE_FD_READ)
+    return 0;
+
+  size = wrap->bundle->nodes[wrap->bundle_node].size;
+  if (wrap->bundle->nodes[wrap->bundle_node].type !=
+        UVWASI_FILETYPE_REGULAR_FILE ||
+      wrap->bundle_offset >= size) {
+    return 0;
+  }
+
+  return size - wrap->bundle_offset;
+}
+
+
+static uvwasi_filesize_t uvwasi__poll_file_nbytes(uv_file fd,
+                                                  uvwasi_eventtype_t type) {
+  uvwasi_filetype_t filetype;
+  uvwasi_filesize_t size;
+  uv_fs_t req;
+  int r;
+#ifdef _WIN32
+  int64_t offset;
+#else
+  off_t offset;
+#endif /* _WIN32 */
+
+  if (type != UVWASI_EVENTTYPE_FD_READ)
+    return 0;
+
+  r = uv_fs_fstat(NULL, &req, fd, NULL);
+  size = req.statbuf.st_size;
+  filetype = uvwasi__stat_to_filetype(&req.statbuf);
+  uv_fs_req_cleanup(&req);
+  if (r != 0 || filetype != UVWASI_FILETYPE_REGULAR_FILE)
+    return 0;
+
+#ifdef _WIN32
+  offset = _lseeki64(fd, 0, SEEK_CUR);
+#else
+  offset = lseek(fd, 0, SEEK_CUR);
+#endif /* _WIN32 */
+
+  if (offset < 0 || (uvwasi_filesize_t) offset >= size)
+    return 0;
+
+  return size - offset;
+}
+
+
+static uvwasi_filesize_t uvwasi__poll_readable_nbytes(uv_file fd) {
+#if !defined(_WIN32) && defined(FIONREAD)
+  int available;
+
+  if (ioctl(fd, FIONREAD, &available) == 0 && available > 0)
+    return available;
+#endif /* !defined(_WIN32) && defined(FIONREAD) */
+
+  return 0;
+}
+
+
+static struct uvwasi__poll_fd_s* uvwasi__poll_get_handle(
+                                           struct uvwasi__poll_state_s* state,
+                                           uv_file fd) {
+  struct uvwasi__poll_fd_s* pfd;
+  size_t i;
+
+  for (i = 0; i < state->handle_count; ++i) {
+    if (state->handles[i].fd == fd)
+      return &state->handles[i];
+  }
+
+  pfd = &state->handles[state->handle_count++];
+  pfd->fd = fd;
+  pfd->events = 0;
+  pfd->flags = -1;
+  pfd->active = 0;
+  pfd->state = state;
+  return pfd;
+}
+
+
+static void uvwasi__poll_fd_cb(uv_poll_t* handle, int status, int events) {
+  struct uvwasi__poll_state_s* state;
+  struct uvwasi__poll_fd_s* pfd;
+  const uvwasi_subscription_t* sub;
+  uvwasi_eventrwflags_t flags;
+  size_t i;
+
+  pfd = (struct uvwasi__poll_fd_s*) handle->data;
+  state = pfd->state;
+  flags = (events & UV_DISCONNECT) ? UVWASI_EVENT_FD_READWRITE_HANGUP : 0;
+
+  for (i = 0; i < state->nsubscriptions; ++i) {
+    if (state->sub_handles[i] != pfd)
+      continue;
+
+    sub = &state->subs[i];
+
+    if (status < 0) {
+      uvwasi__poll_record(state, i, uvwasi__translate_uv_error(status), 0, 0);
+    } else if (sub->type == UVWASI_EVENTTYPE_FD_READ &&
+               (events & (UV_READABLE | UV_DISCONNECT)) != 0) {
+      uvwasi__poll_record(state,
+                          i,
+                          UVWASI_ESUCCESS,
+                          uvwasi__poll_readable_nbytes(pfd->fd),
+                          flags);
+    } else if (sub->type == UVWASI_EVENTTYPE_FD_WRITE &&
+               (events & UV_WRITABLE) != 0) {
+      uvwasi__poll_record(state, i, UVWASI_ESUCCESS, 0, flags);
+    }
+  }
+}
+
+
+static void uvwasi__poll_timer_cb(uv_timer_t* handle) {
+  struct uvwasi__poll_state_s* state;
+  uint64_t remaining;
+  uint64_t now;
+  size_t i;
+
+  state = (struct uvwasi__poll_state_s*) handle->data;
+  remaining = UINT64_MAX;
+  now = uv_hrtime();
+
+  for (i = 0; i < state->nsubscriptions; ++i) {
+    if (state->subs[i].type != UVWASI_EVENTTYPE_CLOCK || state->done[i] != 0)
+      continue;
+
+    if (state->deadlines[i] <= now)
+      uvwasi__poll_record(state, i, UVWASI_ESUCCESS, 0, 0);
+    else if (state->deadlines[i] - now < remaining)
+      remaining = state->deadlines[i] - now;
+  }
+
+  /* The loop's clock has millisecond granularity, so the timer can fire
+     slightly before the earliest nanosecond deadline. Rearm in that case. */
+  if (state->nevents == 0 && remaining != UINT64_MAX) {
+    uv_timer_start(handle,
+                   uvwasi__poll_timer_cb,
+                   uvwasi__poll_ns_to_ms(remaining),
+                   0);
+  }
+}
+
+
+uvwasi_errno_t uvwasi__poll_init(struct uvwasi__poll_t* poll) {
+  poll->loop = NULL;
+  if (uv_mutex_init(&poll->mutex) != 0)
+    return UVWASI_ENOMEM;
+
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__poll_free(struct uvwasi__poll_t* poll) {
+  if (poll->loop != NULL) {
+    uv_loop_close(poll->loop);
+    free(poll->loop);
+    poll->loop = NULL;
+  }
+
+  uv_mutex_destroy(&poll->mutex);
+}
+
+
+/* Returns the loop of `uvwasi`, locked, or initializes `temp` if another
+   thread is using it. */
+static uvwasi_errno_t uvwasi__poll_acquire_loop(uvwasi_t* uvwasi,
+                                                uv_loop_t* temp,
+                                                uv_loop_t** loop) {
+  struct uvwasi__poll_t* poll;
+  int r;
+
+  poll = &uvwasi->poll;
+  if (uv_mutex_trylock(&poll->mutex) == 0) {
+    if (poll->loop == NULL) {
+      poll->loop = malloc(sizeof(*poll->loop));
+      if (poll->loop == NULL) {
+        uv_mutex_unlock(&poll->mutex);
+        return UVWASI_ENOMEM;
+      }
+
+      r = uv_loop_init(poll->loop);
+      if (r != 0) {
+        free(poll->loop);
+        poll->loop = NULL;
+        uv_mutex_unlock(&poll->mutex);
+        return uvwasi__translate_uv_error(r);
+      }
+    }
+
+    /* The loop's cached time is from the previous call. */
+    uv_update_time(poll->loop);
+    *loop = poll->loop;
+    return UVWASI_ESUCCESS;
+  }
+
+  r = uv_loop_init(temp);
+  if (r != 0)
+    return uvwasi__translate_uv_error(r);
+
+  *loop = temp;
+  return UVWASI_ESUCCESS;
+}
+
+
+static void uvwasi__poll_release_loop(uvwasi_t* uvwasi, uv_loop_t* loop) {
+  if (loop == uvwasi->poll.loop)
+    uv_mutex_unlock(&uvwasi->poll.mutex);
+  else
+    uv_loop_close(loop);
+}
+
+
+static void uvwasi__poll_cleanup(struct uvwasi__poll_state_s* state) {
+  struct uvwasi__poll_fd_s* pfd;
+  size_t i;
+
+  for (i = 0; i < state->handle_count; ++i) {
+    pfd = &state->handles[i];
+    if (pfd->active != 0)
+      uv_close((uv_handle_t*) &pfd->handle, NULL);
+  }
+
+  if (state->timer_active != 0)
+    uv_close((uv_handle_t*) &state->timer, NULL);
+
+  /* Run the loop once more to process the close callbacks. */
+  uv_run(state->loop, UV_RUN_DEFAULT);
+
+#ifndef _WIN32
+  /* uv_poll_init() puts the fd into non-blocking mode. uvwasi performs
+     blocking I/O on the same fd, so restore the original flags. */
+  for (i = 0; i < state->handle_count; ++i) {
+    pfd = &state->handles[i];
+    if (pfd->flags >= 0 && (pfd->flags & O_NONBLOCK) == 0)
+      fcntl(pfd->fd, F_SETFL, pfd->flags);
+  }
+#endif /* _WIN32 */
+}
+
+
+uvwasi_errno_t uvwasi__poll_oneoff(uvwasi_t* uvwasi,
+                                   const uvwasi_subscription_t* in,
+                                   uvwasi_event_t* out,
+                                   size_t nsubscriptions,
+                                   size_t* nevents) {
+  struct uvwasi__poll_state_s state;
+  struct uvwasi__poll_fd_s* pfd;
+  uv_loop_t temp_loop;
+  struct uvwasi_fd_wrap_t* wrap;
+  const uvwasi_subscription_t* sub;
+  uvwasi_timestamp_t timeout;
+  uvwasi_timestamp_t min_timeout;
+  uvwasi_filesize_t nbytes;
+  uvwasi_errno_t err;
+  uv_file fd;
+  uint64_t start;
+  size_t i;
+  int r;
+
+  memset(&state, 0, sizeof(state));
+  state.subs = in;
+  state.nsubscriptions = nsubscriptions;
+  state.out = out;
+  state.deadlines = calloc(nsubscriptions, sizeof(*state.deadlines));
+  state.sub_handles = calloc(nsubscriptions, sizeof(*state.sub_handles));
+  state.done = calloc(nsubscriptions, sizeof(*state.done));
+  state.handles = calloc(nsubscriptions, sizeof(*state.handles));
+
+  if (state.deadlines == NULL || state.sub_handles == NULL ||
+      state.done == NULL || state.handles == NULL) {
+    err = UVWASI_ENOMEM;
+    goto exit;
+  }
+
+  err = uvwasi__poll_acquire_loop(uvwasi, &temp_loop, &state.loop);
+  if (err != UVWASI_ESUCCESS)
+    goto exit;
+
+  start = uv_hrtime();
+  min_timeout = UINT64_MAX;
+
+  for (i = 0; i < nsubscriptions; ++i) {
+    sub = &in[i];
+
+    switch (sub->type) {
+      case UVWASI_EVENTTYPE_CLOCK:
+        err = uvwasi__poll_clock_timeout(uvwasi, sub, &timeout);
+        if (err != UVWASI_ESUCCESS) {
+          uvwasi__poll_record(&state, i, err, 0, 0);
+          break;
+        }
+
+        if (timeout > UINT64_MAX - start)
+          state.deadlines[i] = UINT64_MAX;
+        else
+          state.deadlines[i] = start + timeout;
+        if (timeout == 0)
+          uvwasi__poll_record(&state, i, UVWASI_ESUCCESS, 0, 0);
+        else if (timeout < min_timeout)
+          min_timeout = timeout;
+        break;
+
+      case UVWASI_EVENTTYPE_FD_READ:
+      case UVWASI_EVENTTYPE_FD_WRITE:
+        err = uvwasi_fd_table_get(&uvwasi->fds,
+                                  sub->u.fd_readwrite.fd,
+                                  &wrap,
+                                  UVWASI_RIGHT_POLL_FD_READWRITE,
+                                  0);
+        if (err != UVWASI_ESUCCESS) {
+          uvwasi__poll_record(&state, i, err, 0, 0);
+          break;
+        }
+
+        /* Only the host fd is kept, and the entry is released before
+           blocking, so that other threads can use or close it meanwhile. The
+           same fd may also appear in several subscriptions. */
+        fd = -1;
+        nbytes = 0;
+        if (wrap->bundle != NULL)
+          nbytes = uvwasi__poll_bundle_nbytes(wrap, sub->type);
+        else if (uvwasi__poll_fd_is_pollable(wrap->fd) == 0)
+          nbytes = uvwasi__poll_file_nbytes(wrap->fd, sub->type);
+        else
+          fd = wrap->fd;
+        uv_mutex_unlock(&wrap->mutex);
+
+        if (fd == -1) {
+          uvwasi__poll_record(&state, i, UVWASI_ESUCCESS, nbytes, 0);
+          break;
+        }
+
+        pfd = uvwasi__poll_get_handle(&state, fd);
+        if (sub->type == UVWASI_EVENTTYPE_FD_READ)
+          pfd->events |= UV_READABLE | UV_DISCONNECT;
+        else
+          pfd->events |= UV_WRITABLE;
+        state.sub_handles[i] = pfd;
+        break;
+
+      default:
+        uvwasi__poll_record(&state, i, UVWASI_EINVAL, 0, 0);
+        break;
+    }
+  }
+
+  for (i = 0; i < state.handle_count; ++i) {
+    pfd = &state.handles[i];
+#ifndef _WIN32
+    pfd->flags = fcntl(pfd->fd, F_GETFL);
+#endif /* _WIN32 */
+    pfd->handle.data = pfd;
+    r = uv_poll_init(state.loop, &pfd->handle, pfd->fd);
+    if (r == 0) {
+      pfd->active = 1;
+      r = uv_poll_start(&pfd->handle, pfd->events, uvwasi__poll_fd_cb);
+    }
+
+    /* Report the failure on every subscription sharing this fd. */
+    if (r != 0)
+      uvwasi__poll_fd_cb(&pfd->handle, r, 0);
+  }
+
+  if (state.nevents > 0) {
+    /* Something is ready already. Don't block, but still pick up any fds
+       that are ready right now. */
+    if (state.handle_count > 0)
+      uv_run(state.loop, UV_RUN_NOWAIT);
+  } else {
+    if (min_timeout != UINT64_MAX) {
+      uv_timer_init(state.loop, &state.timer);
+      state.timer.data = &state;
+      state.timer_active = 1;
+      uv_timer_start(&state.timer,
+                     uvwasi__poll_timer_cb,
+                     uvwasi__poll_ns_to_ms(min_timeout),
+                     0);
+    }
+
+    while (state.nevents == 0) {
+      if (uv_run(state.loop, UV_RUN_ONCE) == 0 && state.nevents == 0)
+        break;
+    }
+  }
+
+  uvwasi__poll_cleanup(&state);
+  uvwasi__poll_release_loop(uvwasi, state.loop);
+  *nevents = state.nevents;
+  err = UVWASI_ESUCCESS;
+
+exit:
+  free(state.deadlines);
+  free(state.sub_handles);
+  free(state.done);
+  free(state.handles);
+  return err;
+}
@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <pthread.h>
+#endif /* _WIN32 */
+
+#include "uvwasi.h"
+#include "uv.h"
+#include "uv_mapping.h"
+#include "random.h"
+
+#define UVWASI__CHACHA20_BLOCK_SIZE 64
+#define UVWASI__CHACHA20_ROUNDS 20
+
+#define UVWASI__ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define UVWASI__QUARTER_ROUND(x, a, b, c, d)                                  \
+  do {                                                                        \
+    x[a] += x[b]; x[d] = UVWASI__ROTL32(x[d] ^ x[a], 16);                     \
+    x[c] += x[d]; x[b] = UVWASI__ROTL32(x[b] ^ x[c], 12);                     \
+    x[a] += x[b]; x[d] = UVWASI__ROTL32(x[d] ^ x[a], 8);                      \
+    x[c] += x[d]; x[b] = UVWASI__ROTL32(x[b] ^ x[c], 7);                      \
+  } while (0)
+
+/* Incremented in the child after fork(), so that the child reseeds instead of
+   handing out the same bytes as its parent. */
+static unsigned int uvwasi__random_fork_generation = 0;
+static uv_once_t uvwasi__random_once = UV_ONCE_INIT;
+
+
+#ifndef _WIN32
+static void uvwasi__random_on_fork(void) {
+  uvwasi__random_fork_generation++;
+}
+#endif /* _WIN32 */
+
+
+static void uvwasi__random_watch_fork(void) {
+#ifndef _WIN32
+  pthread_atfork(NULL, NULL, uvwasi__random_on_fork);
+#endif /* _WIN32 */
+}
+
+
+static uint32_t uvwasi__load32_le(const unsigned char* p) {
+  return (uint32_t) p[0] |
+         ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) |
+         ((uint32_t) p[3] << 24);
+}
+
+
+static void uvwasi__store32_le(unsigned char* p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+
+/* The ChaCha20 block function from RFC 8439. */
+static void uvwasi__chacha20_block(const uint32_t input[16],
+                                   unsigned char* out) {
+  uint32_t x[16];
+  int i;
+
+  memcpy(x, input, sizeof(x));
+  for (i = 0; i < UVWASI__CHACHA20_ROUNDS; i += 2) {
+    UVWASI__QUARTER_ROUND(x, 0, 4, 8, 12);
+    UVWASI__QUARTER_ROUND(x, 1, 5, 9, 13);
+    UVWASI__QUARTER_ROUND(x, 2, 6, 10, 14);
+    UVWASI__QUARTER_ROUND(x, 3, 7, 11, 15);
+    UVWASI__QUARTER_ROUND(x, 0, 5, 10, 15);
+    UVWASI__QUARTER_ROUND(x, 1, 6, 11, 12);
+    UVWASI__QUARTER_ROUND(x, 2, 7, 8, 13);
+    UVWASI__QUARTER_ROUND(x, 3, 4, 9, 14);
+  }
+
+  for (i = 0; i < 16; i++)
+    uvwasi__store32_le(out + i * 4, x[i] + input[i]);
+}
+
+
+/* Fills the buffer with the ChaCha20 stream of the current key, and replaces
+   the key with the start of it. Every key is only used once, so the nonce and
+   counter always start at zero. */
+static void uvwasi__random_refill(struct uvwasi__random_t* random) {
+  uint32_t input[16];
+  size_t offset;
+  int i;
+
+  input[0] = 0x61707865;
+  input[1] = 0x3320646e;
+  input[2] = 0x79622d32;
+  input[3] = 0x6b206574;
+  memcpy(input + 4, random->key, sizeof(random->key));
+  input[12] = 0;
+  input[13] = 0;
+  input[14] = 0;
+  input[15] = 0;
+
+  for (offset = 0;
+       offset < UVWASI__RANDOM_BUF_SIZE;
+       offset += UVWASI__CHACHA20_BLOCK_SIZE) {
+    uvwasi__chacha20_block(input, random->buf + offset);
+    input[12]++;
+  }
+
+  for (i = 0; i < UVWASI__RANDOM_KEY_SIZE / 4; i++)
+    random->key[i] = uvwasi__load32_le(random->buf + i * 4);
+
+  memset(random->buf, 0, UVWASI__RANDOM_KEY_SIZE);
+  memset(input, 0, sizeof(input));
+  random->available = UVWASI__RANDOM_BUF_SIZE - UVWASI__RANDOM_KEY_SIZE;
+}
+
+
+/* Mixes a key from the host into the current one, and drops any bytes that
+   were generated with the old key. */
+static uvwasi_errno_t uvwasi__random_seed(struct uvwasi__random_t* random) {
+  unsigned char seed[UVWASI__RANDOM_KEY_SIZE];
+  int i;
+  int r;
+
+  r = uv_random(NULL, NULL, seed, sizeof(seed), 0, NULL);
+  if (r != 0)
+    return uvwasi__translate_uv_error(r);
+
+  for (i = 0; i < UVWASI__RANDOM_KEY_SIZE / 4; i++)
+    random->key[i] ^= uvwasi__load32_le(seed + i * 4);
+
+  memset(seed, 0, sizeof(seed));
+  memset(random->buf, 0, sizeof(random->buf));
+  random->available = 0;
+  random->until_reseed = UVWASI__RANDOM_RESEED_BYTES;
+  random->fork_generation = uvwasi__random_fork_generation;
+  random->seeded = 1;
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi__random_init(struct uvwasi__random_t* random) {
+  uv_once(&uvwasi__random_once, uvwasi__random_watch_fork);
+  memset(random->key, 0, sizeof(random->key));
+  memset(random->buf, 0, sizeof(random->buf));
+  random->available = 0;
+  random->until_reseed = 0;
+  random->fork_generation = 0;
+  random->seeded = 0;
+  if (uv_mutex_init(&random->mutex) != 0)
+    return UVWASI_ENOMEM;
+
+  return UVWASI_ESUCCESS;
+}
+
+
+void uvwasi__random_free(struct uvwasi__random_t* random) {
+  memset(random->key, 0, sizeof(random->key));
+  memset(random->buf, 0, sizeof(random->buf));
+  random->available = 0;
+  uv_mutex_destroy(&random->mutex);
+}
+
+
+uvwasi_errno_t uvwasi__random_get(struct uvwasi__random_t* random,
+                                  void* buf,
+                                  size_t buf_len) {
+  unsigned char* out;
+  unsigned char* chunk;
+  uvwasi_errno_t err;
+  size_t n;
+
+  out = buf;
+  err = UVWASI_ESUCCESS;
+  uv_mutex_lock(&random->mutex);
+
+  while (buf_len > 0) {
+    if (random->seeded == 0 ||
+        random->until_reseed == 0 ||
+        random->fork_generation != uvwasi__random_fork_generation) {
+      err = uvwasi__random_seed(random);
+      if (err != UVWASI_ESUCCESS)
+        break;
+    }
+
+    if (random->available == 0)
+      uvwasi__random_refill(random);
+
+    n = buf_len;
+    if (n > random->available)
+      n = random->available;
+    if (n > random->until_reseed)
+      n = random->until_reseed;
+
+    chunk = random->buf + UVWASI__RANDOM_BUF_SIZE - random->available;
+    memcpy(out, chunk, n);
+    memset(chunk, 0, n);
+    out += n;
+    buf_len -= n;
+    random->available -= n;
+    random->until_reseed -= n;
+  }
+
+  uv_mutex_unlock(&random->mutex);
+  return err;
+}
@@ -1,19 +1,17 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 
 #ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
 # include <sched.h>
+# include <sys/stat.h>
 # include <sys/types.h>
+# include <sys/socket.h>
 # include <unistd.h>
 # include <dirent.h>
 # include <time.h>
-# define SLASH '/'
-# define SLASH_STR "/"
-# define IS_SLASH(c) ((c) == '/')
-#else
-# define SLASH '\\'
-# define SLASH_STR "\\"
-# define IS_SLASH(c) ((c) == '/' || (c) == '\\')
 #endif /* _WIN32 */
 
 #define UVWASI__READDIR_NUM_ENTRIES 1
@@ -22,133 +20,68 @@
 #include "uv.h"
 #include "uv_mapping.h"
 #include "fd_table.h"
+#include "path_resolver.h"
+#include "bundle.h"
 #include "clocks.h"
+#include "poll_oneoff.h"
+#include "random.h"
 
 
-static int uvwasi__is_absolute_path(const char* path, size_t path_len) {
-  /* TODO(cjihrig): Add a Windows implementation. */
-  return path != NULL && path_len > 0 && path[0] == SLASH;
+#ifndef _WIN32
+/* Path system calls are made relative to the directory that the resolver
+   returns, with the *at() functions, which libuv has no equivalent of. They
+   return libuv error codes, like the uv_fs_*() functions do. */
+
+/* Like uv_fs_utime(), with the times interpreted the same way. */
+static int uvwasi__utimensat(int dir_fd,
+                             const char* name,
+                             double atime,
+                             double mtime,
+                             int flags) {
+  struct timespec ts[2];
+
+  ts[0].tv_sec = (time_t) atime;
+  ts[0].tv_nsec = (long) ((atime - ts[0].tv_sec) * 1e9);
+  ts[1].tv_sec = (time_t) mtime;
+  ts[1].tv_nsec = (long) ((mtime - ts[1].tv_sec) * 1e9);
+  if (utimensat(dir_fd, name, ts, flags) != 0)
+    return uv_translate_sys_error(errno);
+
+  return 0;
 }
 
 
-static uvwasi_errno_t uvwasi__resolve_path(const struct uvwasi_fd_wrap_t* fd,
-                                           const char* path,
-                                           size_t path_len,
-                                           char* resolved_path,
-                                           uvwasi_lookupflags_t flags) {
-  /* TODO(cjihrig): path_len is treated as a size. Need to verify if path_len is
-     really a string length or a size. Also need to verify if it is null
-     terminated. */
-  uv_fs_t realpath_req;
-  uvwasi_errno_t err;
-  char* abs_path;
-  char* tok;
-  char* ptr;
-  int realpath_size;
-  int abs_size;
-  int input_is_absolute;
-  int r;
-#ifdef _WIN32
-  int i;
-#endif /* _WIN32 */
-
-  err = UVWASI_ESUCCESS;
-  input_is_absolute = uvwasi__is_absolute_path(path, path_len);
-
-  if (1 == input_is_absolute) {
-    /* TODO(cjihrig): Revisit this. Copying is probably not necessary here. */
-    abs_size = path_len;
-    abs_path = malloc(abs_size);
-    if (abs_path == NULL) {
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
-
-    memcpy(abs_path, path, abs_size);
-  } else {
-    /* Resolve the relative path to fd's real path. */
-    abs_size = path_len + strlen(fd->real_path) + 2;
-    abs_path = malloc(abs_size);
-    if (abs_path == NULL) {
-      err = UVWASI_ENOMEM;
-      goto exit;
-    }
-
-    r = snprintf(abs_path, abs_size, "%s/%s", fd->real_path, path);
-    if (r <= 0) {
-      err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
-      goto exit;
-    }
-  }
-
-#ifdef _WIN32
-  /* On Windows, convert slashes to backslashes. */
-  for (i = 0; i < abs_size; ++i) {
-    if (abs_path[i] == '/')
-      abs_path[i] = SLASH;
-  }
-#endif /* _WIN32 */
-
-  ptr = resolved_path;
-  tok = strtok(abs_path, SLASH_STR);
-  for (; tok != NULL; tok = strtok(NULL, SLASH_STR)) {
-    if (0 == strcmp(tok, "."))
-      continue;
-
-    if (0 == strcmp(tok, "..")) {
-      while (*ptr != SLASH && ptr != resolved_path)
-        ptr--;
-      *ptr = '\0';
-      continue;
-    }
-
-#ifdef _WIN32
-    /* On Windows, prevent a leading slash in the path. */
-    if (ptr == resolved_path)
-      r = sprintf(ptr, "%s", tok);
-    else
-#endif /* _WIN32 */
-    r = sprintf(ptr, "%c%s", SLASH, tok);
-
-    if (r < 1) { /* At least one character should have been written. */
-      err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
-      goto exit;
-    }
-
-    ptr += r;
-  }
-
-  if ((flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) == UVWASI_LOOKUP_SYMLINK_FOLLOW) {
-    r = uv_fs_realpath(NULL, &realpath_req, resolved_path, NULL);
-    if (r == 0) {
-      realpath_size = strlen(realpath_req.ptr) + 1;
-      if (realpath_size > PATH_MAX_BYTES) {
-        err = UVWASI_ENOBUFS;
-        uv_fs_req_cleanup(&realpath_req);
-        goto exit;
-      }
-
-      memcpy(resolved_path, realpath_req.ptr, realpath_size);
-    } else if (r != UV_ENOENT) {
-      /* Report errors except ENOENT. */
-      err = uvwasi__translate_uv_error(r);
-      uv_fs_req_cleanup(&realpath_req);
-      goto exit;
-    }
-
-    uv_fs_req_cleanup(&realpath_req);
-  }
-
-  /* Verify that the resolved path is still in the sandbox. */
-  if (resolved_path != strstr(resolved_path, fd->real_path)) {
-    err = UVWASI_ENOTCAPABLE;
-    goto exit;
-  }
-
-exit:
-  free(abs_path);
-  return err;
+#ifdef __APPLE__
+# define UVWASI__ST_TIME(st, name) ((st)->st_##name##timespec)
+#else
+# define UVWASI__ST_TIME(st, name) ((st)->st_##name##tim)
+#endif /* __APPLE__ */
+
+/* Like uv_fs_stat() and uv_fs_lstat(). */
+static int uvwasi__fstatat(int dir_fd,
+                           const char* name,
+                           int flags,
+                           uv_stat_t* buf) {
+  struct stat st;
+
+  if (fstatat(dir_fd, name, &st, flags) != 0)
+    return uv_translate_sys_error(errno);
+
+  memset(buf, 0, sizeof(*buf));
+  buf->st_dev = st.st_dev;
+  buf->st_mode = st.st_mode;
+  buf->st_nlink = st.st_nlink;
+  buf->st_ino = st.st_ino;
+  buf->st_size = st.st_size;
+  buf->st_atim.tv_sec = UVWASI__ST_TIME(&st, a).tv_sec;
+  buf->st_atim.tv_nsec = UVWASI__ST_TIME(&st, a).tv_nsec;
+  buf->st_mtim.tv_sec = UVWASI__ST_TIME(&st, m).tv_sec;
+  buf->st_mtim.tv_nsec = UVWASI__ST_TIME(&st, m).tv_nsec;
+  buf->st_ctim.tv_sec = UVWASI__ST_TIME(&st, c).tv_sec;
+  buf->st_ctim.tv_nsec = UVWASI__ST_TIME(&st, c).tv_nsec;
+  return 0;
 }
+#endif /* _WIN32 */
 
 
 static uvwasi_errno_t uvwasi__lseek(uv_file fd,
@@ -185,9 +118,54 @@ static uvwasi_errno_t uvwasi__lseek(uv_file fd,
 }
 
 
+#ifndef _WIN32
+/* On Unix, uv_buf_t mirrors struct iovec, which has the same layout as the
+   WASI iovec types. Guest iovecs can therefore be handed to libuv as-is,
+   without allocating and copying a uv_buf_t array on every read/write. These
+   typedefs fail to compile if that assumption is ever broken. */
+#define UVWASI__IOVEC_COMPATIBLE(type)                                        \
+  (sizeof(type) == sizeof(uv_buf_t) &&                                        \
+   offsetof(type, buf) == offsetof(uv_buf_t, base) &&                         \
+   offsetof(type, buf_len) == offsetof(uv_buf_t, len))
+
+typedef char uvwasi__iovec_layout_check[
+    UVWASI__IOVEC_COMPATIBLE(uvwasi_iovec_t) ? 1 : -1];
+typedef char uvwasi__ciovec_layout_check[
+    UVWASI__IOVEC_COMPATIBLE(uvwasi_ciovec_t) ? 1 : -1];
+
+#undef UVWASI__IOVEC_COMPATIBLE
+#endif /* _WIN32 */
+
+
+/* Bundle entries keep their file position in the fd table. */
+static uvwasi_errno_t uvwasi__bundle_seek(struct uvwasi_fd_wrap_t* wrap,
+                                          uvwasi_filedelta_t offset,
+                                          uvwasi_whence_t whence,
+                                          uvwasi_filesize_t* newoffset) {
+  uvwasi_filesize_t base;
+
+  if (whence == UVWASI_WHENCE_CUR)
+    base = wrap->bundle_offset;
+  else if (whence == UVWASI_WHENCE_END)
+    base = wrap->bundle->nodes[wrap->bundle_node].size;
+  else if (whence == UVWASI_WHENCE_SET)
+    base = 0;
+  else
+    return UVWASI_EINVAL;
+
+  if (offset < 0 && (uvwasi_filesize_t) -offset > base)
+    return UVWASI_EINVAL;
+
+  wrap->bundle_offset = base + offset;
+  *newoffset = wrap->bundle_offset;
+  return UVWASI_ESUCCESS;
+}
+
+
 static uvwasi_errno_t uvwasi__setup_iovs(uv_buf_t** buffers,
                                          const uvwasi_iovec_t* iovs,
                                          size_t iovs_len) {
+#ifdef _WIN32
   uv_buf_t* bufs;
   size_t i;
 
@@ -199,6 +177,9 @@ static uvwasi_errno_t uvwasi__setup_iovs(uv_buf_t** buffers,
     bufs[i] = uv_buf_init(iovs[i].buf, iovs[i].buf_len);
 
   *buffers = bufs;
+#else
+  *buffers = (uv_buf_t*) iovs;
+#endif /* _WIN32 */
   return UVWASI_ESUCCESS;
 }
 
@@ -206,6 +187,7 @@ static uvwasi_errno_t uvwasi__setup_iovs(uv_buf_t** buffers,
 static uvwasi_errno_t uvwasi__setup_ciovs(uv_buf_t** buffers,
                                           const uvwasi_ciovec_t* iovs,
                                           size_t iovs_len) {
+#ifdef _WIN32
   uv_buf_t* bufs;
   size_t i;
 
@@ -217,10 +199,27 @@ static uvwasi_errno_t uvwasi__setup_ciovs(uv_buf_t** buffers,
     bufs[i] = uv_buf_init((char*)iovs[i].buf, iovs[i].buf_len);
 
   *buffers = bufs;
+#else
+  *buffers = (uv_buf_t*) iovs;
+#endif /* _WIN32 */
   return UVWASI_ESUCCESS;
 }
 
 
+/* Host fds in the saved fd table are kept open for uvwasi_embedder_reset().
+   Bundle entries have no host fd. */
+static int uvwasi__owns_host_fd(const struct uvwasi_fd_wrap_t* wrap) {
+  return wrap->bundle == NULL && wrap->saved == 0;
+}
+
+
+static void uvwasi__free_iovs(uv_buf_t* bufs) {
+#ifdef _WIN32
+  free(bufs);
+#endif /* _WIN32 */
+}
+
+
 uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, uvwasi_options_t* options) {
   uv_fs_t realpath_req;
   uv_fs_t open_req;
@@ -236,11 +235,29 @@ uvwasi_errno_t uvwasi_init(uvwasi_t* uvwasi, uvwasi_options_t* options) {
   if (uvwasi == NULL || options == NULL || options->fd_table_size == 0)
     return UVWASI_EINVAL;
 
+  err = uvwasi__path_cache_init(&uvwasi->path_cache);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  err = uvwasi__random_init(&uvwasi->random);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__path_cache_free(&uvwasi->path_cache);
+    return err;
+  }
+
+  err = uvwasi__poll_init(&uvwasi->poll);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__random_free(&uvwasi->random);
+    uvwasi__path_cache_free(&uvwasi->path_cache);
+    return err;
+  }
+
   uvwasi->argv_buf = NULL;
   uvwasi->argv = NULL;
   uvwasi->env_buf = NULL;
   uvwasi->env = NULL;
   uvwasi->fds.fds = NULL;
+  uvwasi->bundles = NULL;
 
   args_size = 0;
   for (i = 0; i < options->argc; ++i)
@@ -356,10 +373,21 @@ exit:
 
 
 void uvwasi_destroy(uvwasi_t* uvwasi) {
+  struct uvwasi__bundle_s* bundle;
+
   if (uvwasi == NULL)
     return;
 
   uvwasi_fd_table_free(&uvwasi->fds);
+  while (uvwasi->bundles != NULL) {
+    bundle = uvwasi->bundles;
+    uvwasi->bundles = bundle->next;
+    uvwasi__bundle_free(bundle);
+  }
+
+  uvwasi__path_cache_free(&uvwasi->path_cache);
+  uvwasi__random_free(&uvwasi->random);
+  uvwasi__poll_free(&uvwasi->poll);
   free(uvwasi->argv_buf);
   free(uvwasi->argv);
   free(uvwasi->env_buf);
@@ -385,10 +413,119 @@ uvwasi_errno_t uvwasi_embedder_remap_fd(uvwasi_t* uvwasi,
     return err;
 
   wrap->fd = new_host_fd;
+  uv_mutex_unlock(&wrap->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_embedder_get_host_fd(uvwasi_t* uvwasi,
+                                           const uvwasi_fd_t fd,
+                                           uvwasi_rights_t rights,
+                                           uv_file* host_fd) {
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_errno_t err;
+
+  if (uvwasi == NULL || host_fd == NULL)
+    return UVWASI_EINVAL;
+
+  err = uvwasi_fd_table_get(&uvwasi->fds, fd, &wrap, rights, 0);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  *host_fd = wrap->fd;
+  uv_mutex_unlock(&wrap->mutex);
+  return UVWASI_ESUCCESS;
+}
+
+
+uvwasi_errno_t uvwasi_embedder_insert_socket(uvwasi_t* uvwasi,
+                                            uv_stream_t* stream,
+                                            uvwasi_fd_t* fd) {
+  if (uvwasi == NULL || stream == NULL || fd == NULL)
+    return UVWASI_EINVAL;
+
+  return uvwasi_fd_table_insert_stream(&uvwasi->fds, stream, fd);
+}
+
+
+static uvwasi_errno_t uvwasi__insert_bundle(uvwasi_t* uvwasi,
+                                            struct uvwasi__bundle_s* bundle,
+                                            const char* mapped_path,
+                                            uvwasi_fd_t* fd) {
+  uvwasi_errno_t err;
+
+  err = uvwasi_fd_table_insert_bundle(&uvwasi->fds,
+                                      bundle,
+                                      UVWASI__BUNDLE_ROOT,
+                                      mapped_path,
+                                      1,
+                                      ~(uvwasi_rights_t) 0,
+                                      ~(uvwasi_rights_t) 0,
+                                      fd);
+  if (err != UVWASI_ESUCCESS) {
+    uvwasi__bundle_free(bundle);
+    return err;
+  }
+
+  bundle->next = uvwasi->bundles;
+  uvwasi->bundles = bundle;
   return UVWASI_ESUCCESS;
 }
 
 
+uvwasi_errno_t uvwasi_embedder_add_bundle(uvwasi_t* uvwasi,
+                                          const char* mapped_path,
+                                          const void* data,
+                                          size_t size,
+                                          uvwasi_fd_t* fd) {
+  struct uvwasi__bundle_s* bundle;
+  uvwasi_errno_t err;
+
+  if (uvwasi == NULL || mapped_path == NULL || data == NULL || fd == NULL)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__bundle_from_memory(data, size, &bundle);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  return uvwasi__insert_bundle(uvwasi, bundle, mapped_path, fd);
+}
+
+
+uvwasi_errno_t uvwasi_embedder_add_bundle_file(uvwasi_t* uvwasi,
+                                               const char* mapped_path,
+                                               const char* path,
+                                               uvwasi_fd_t* fd) {
+  struct uvwasi__bundle_s* bundle;
+  uvwasi_errno_t err;
+
+  if (uvwasi == NULL || mapped_path == NULL || path == NULL || fd == NULL)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__bundle_from_file(path, &bundle);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  return uvwasi__insert_bundle(uvwasi, bundle, mapped_path, fd);
+}
+
+
+uvwasi_errno_t uvwasi_embedder_snapshot(uvwasi_t* uvwasi) {
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  return uvwasi_fd_table_save(&uvwasi->fds);
+}
+
+
+uvwasi_errno_t uvwasi_embedder_reset(uvwasi_t* uvwasi) {
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  return uvwasi_fd_table_restore(&uvwasi->fds);
+}
+
+
 uvwasi_errno_t uvwasi_args_get(uvwasi_t* uvwasi, char** argv, char* argv_buf) {
   size_t i;
 
@@ -546,9 +683,10 @@ uvwasi_errno_t uvwasi_fd_advise(uvwasi_t* uvwasi,
 #ifdef POSIX_FADV_NORMAL
   r = posix_fadvise(wrap->fd, offset, len, mapped_advice);
   if (r != 0)
-    return uvwasi__translate_uv_error(uv_translate_sys_error(r));
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(r));
 #endif /* POSIX_FADV_NORMAL */
-  return UVWASI_ESUCCESS;
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -580,22 +718,22 @@ uvwasi_errno_t uvwasi_fd_allocate(uvwasi_t* uvwasi,
 #if defined(__POSIX__)
   r = posix_fallocate(wrap->fd, offset, len);
   if (r != 0)
-    return uvwasi__translate_uv_error(uv_translate_sys_error(r));
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(r));
 #else
   r = uv_fs_fstat(NULL, &req, wrap->fd, NULL);
   st_size = req.statbuf.st_size;
   uv_fs_req_cleanup(&req);
-  if (r != 0)
-    return uvwasi__translate_uv_error(r);
-
-  if (st_size < offset + len) {
+  if (r != 0) {
+    err = uvwasi__translate_uv_error(r);
+  } else if (st_size < offset + len) {
     r = uv_fs_ftruncate(NULL, &req, wrap->fd, offset + len, NULL);
     if (r != 0)
-      return uvwasi__translate_uv_error(r);
+      err = uvwasi__translate_uv_error(r);
   }
 #endif /* __POSIX__ */
 
-  return UVWASI_ESUCCESS;
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -608,17 +746,25 @@ uvwasi_errno_t uvwasi_fd_close(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
   if (uvwasi == NULL)
     return UVWASI_EINVAL;
 
-  err = uvwasi_fd_table_get(&uvwasi->fds, fd, &wrap, 0, 0);
+  err = uvwasi_fd_table_detach(&uvwasi->fds, fd, &wrap);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_close(NULL, &req, wrap->fd, NULL);
-  uv_fs_req_cleanup(&req);
+  /* The fd is gone from the table, so only a thread that already held the
+     entry can still use it. Wait for it before closing the host fd. */
+  uv_mutex_lock(&wrap->mutex);
+  r = 0;
+  if (uvwasi__owns_host_fd(wrap)) {
+    r = uv_fs_close(NULL, &req, wrap->fd, NULL);
+    uv_fs_req_cleanup(&req);
+  }
 
+  uv_mutex_unlock(&wrap->mutex);
+  uvwasi_fd_table_free_detached(&uvwasi->fds, wrap);
   if (r != 0)
     return uvwasi__translate_uv_error(r);
 
-  return uvwasi_fd_table_remove(&uvwasi->fds, fd);
+  return UVWASI_ESUCCESS;
 }
 
 
@@ -641,6 +787,7 @@ uvwasi_errno_t uvwasi_fd_datasync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
 
   r = uv_fs_fdatasync(NULL, &req, wrap->fd, NULL);
   uv_fs_req_cleanup(&req);
+  uv_mutex_unlock(&wrap->mutex);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -668,13 +815,31 @@ uvwasi_errno_t uvwasi_fd_fdstat_get(uvwasi_t* uvwasi,
   buf->fs_filetype = wrap->type;
   buf->fs_rights_base = wrap->rights_base;
   buf->fs_rights_inheriting = wrap->rights_inheriting;
+  if (wrap->bundle != NULL) {
+    uv_mutex_unlock(&wrap->mutex);
+    buf->fs_flags = 0;
+    return UVWASI_ESUCCESS;
+  }
 #ifdef _WIN32
+  uv_mutex_unlock(&wrap->mutex);
   buf->fs_flags = 0;  /* TODO(cjihrig): Missing Windows support. */
 #else
   r = fcntl(wrap->fd, F_GETFL);
+  uv_mutex_unlock(&wrap->mutex);
   if (r < 0)
     return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
-  buf->fs_flags = r;
+
+  buf->fs_flags = 0;
+  if ((r & O_APPEND) == O_APPEND)
+    buf->fs_flags |= UVWASI_FDFLAG_APPEND;
+#ifdef O_DSYNC
+  if ((r & O_DSYNC) == O_DSYNC)
+    buf->fs_flags |= UVWASI_FDFLAG_DSYNC;
+#endif /* O_DSYNC */
+  if ((r & O_NONBLOCK) == O_NONBLOCK)
+    buf->fs_flags |= UVWASI_FDFLAG_NONBLOCK;
+  if ((r & O_SYNC) == O_SYNC)
+    buf->fs_flags |= UVWASI_FDFLAG_SYNC;
 #endif /* _WIN32 */
 
   return UVWASI_ESUCCESS;
@@ -730,6 +895,7 @@ uvwasi_errno_t uvwasi_fd_fdstat_set_flags(uvwasi_t* uvwasi,
     mapped_flags |= O_SYNC;
 
   r = fcntl(wrap->fd, F_SETFL, mapped_flags);
+  uv_mutex_unlock(&wrap->mutex);
   if (r < 0)
     return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
 
@@ -754,16 +920,17 @@ uvwasi_errno_t uvwasi_fd_fdstat_set_rights(uvwasi_t* uvwasi,
     return err;
 
   /* Check for attempts to add new permissions. */
-  if ((fs_rights_base | wrap->rights_base) > wrap->rights_base)
-    return UVWASI_ENOTCAPABLE;
-  if ((fs_rights_inheriting | wrap->rights_inheriting) >
+  if ((fs_rights_base | wrap->rights_base) > wrap->rights_base ||
+      (fs_rights_inheriting | wrap->rights_inheriting) >
       wrap->rights_inheriting) {
-    return UVWASI_ENOTCAPABLE;
+    err = UVWASI_ENOTCAPABLE;
+  } else {
+    wrap->rights_base = fs_rights_base;
+    wrap->rights_inheriting = fs_rights_inheriting;
   }
 
-  wrap->rights_base = fs_rights_base;
-  wrap->rights_inheriting = fs_rights_inheriting;
-  return UVWASI_ESUCCESS;
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -786,7 +953,14 @@ uvwasi_errno_t uvwasi_fd_filestat_get(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  if (wrap->bundle != NULL) {
+    uvwasi__bundle_filestat(wrap->bundle, wrap->bundle_node, buf);
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
   r = uv_fs_fstat(NULL, &req, wrap->fd, NULL);
+  uv_mutex_unlock(&wrap->mutex);
   if (r != 0) {
     uv_fs_req_cleanup(&req);
     return uvwasi__translate_uv_error(r);
@@ -821,6 +995,7 @@ uvwasi_errno_t uvwasi_fd_filestat_set_size(uvwasi_t* uvwasi,
 
   r = uv_fs_ftruncate(NULL, &req, wrap->fd, st_size, NULL);
   uv_fs_req_cleanup(&req);
+  uv_mutex_unlock(&wrap->mutex);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -859,6 +1034,7 @@ uvwasi_errno_t uvwasi_fd_filestat_set_times(uvwasi_t* uvwasi,
   /* TODO(cjihrig): st_atim and st_mtim should not be unconditionally passed. */
   r = uv_fs_futime(NULL, &req, wrap->fd, st_atim, st_mtim, NULL);
   uv_fs_req_cleanup(&req);
+  uv_mutex_unlock(&wrap->mutex);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -891,14 +1067,27 @@ uvwasi_errno_t uvwasi_fd_pread(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  if (wrap->bundle != NULL) {
+    *nread = uvwasi__bundle_read(wrap->bundle,
+                                 wrap->bundle_node,
+                                 iovs,
+                                 iovs_len,
+                                 offset);
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
   err = uvwasi__setup_iovs(&bufs, iovs, iovs_len);
-  if (err != UVWASI_ESUCCESS)
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
     return err;
+  }
 
   r = uv_fs_read(NULL, &req, wrap->fd, bufs, iovs_len, offset, NULL);
+  uv_mutex_unlock(&wrap->mutex);
   uvread = req.result;
   uv_fs_req_cleanup(&req);
-  free(bufs);
+  uvwasi__free_iovs(bufs);
 
   if (r < 0)
     return uvwasi__translate_uv_error(r);
@@ -920,12 +1109,15 @@ uvwasi_errno_t uvwasi_fd_prestat_get(uvwasi_t* uvwasi,
   err = uvwasi_fd_table_get(&uvwasi->fds, fd, &wrap, 0, 0);
   if (err != UVWASI_ESUCCESS)
     return err;
-  if (wrap->preopen != 1)
-    return UVWASI_EINVAL;
+  if (wrap->preopen != 1) {
+    err = UVWASI_EINVAL;
+  } else {
+    buf->pr_type = UVWASI_PREOPENTYPE_DIR;
+    buf->u.dir.pr_name_len = strlen(wrap->path) + 1;
+  }
 
-  buf->pr_type = UVWASI_PREOPENTYPE_DIR;
-  buf->u.dir.pr_name_len = strlen(wrap->path) + 1;
-  return UVWASI_ESUCCESS;
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -943,15 +1135,21 @@ uvwasi_errno_t uvwasi_fd_prestat_dir_name(uvwasi_t* uvwasi,
   err = uvwasi_fd_table_get(&uvwasi->fds, fd, &wrap, 0, 0);
   if (err != UVWASI_ESUCCESS)
     return err;
-  if (wrap->preopen != 1)
-    return UVWASI_EBADF;
+  if (wrap->preopen != 1) {
+    err = UVWASI_EBADF;
+    goto exit;
+  }
 
   size = strlen(wrap->path) + 1;
-  if (size > path_len)
-    return UVWASI_ENOBUFS;
+  if (size > path_len) {
+    err = UVWASI_ENOBUFS;
+    goto exit;
+  }
 
   memcpy(path, wrap->path, size);
-  return UVWASI_ESUCCESS;
+exit:
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -980,13 +1178,16 @@ uvwasi_errno_t uvwasi_fd_pwrite(uvwasi_t* uvwasi,
     return err;
 
   err = uvwasi__setup_ciovs(&bufs, iovs, iovs_len);
-  if (err != UVWASI_ESUCCESS)
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
     return err;
+  }
 
   r = uv_fs_write(NULL, &req, wrap->fd, bufs, iovs_len, offset, NULL);
+  uv_mutex_unlock(&wrap->mutex);
   uvwritten = req.result;
   uv_fs_req_cleanup(&req);
-  free(bufs);
+  uvwasi__free_iovs(bufs);
 
   if (r < 0)
     return uvwasi__translate_uv_error(r);
@@ -1015,14 +1216,28 @@ uvwasi_errno_t uvwasi_fd_read(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  if (wrap->bundle != NULL) {
+    *nread = uvwasi__bundle_read(wrap->bundle,
+                                 wrap->bundle_node,
+                                 iovs,
+                                 iovs_len,
+                                 wrap->bundle_offset);
+    wrap->bundle_offset += *nread;
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
   err = uvwasi__setup_iovs(&bufs, iovs, iovs_len);
-  if (err != UVWASI_ESUCCESS)
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
     return err;
+  }
 
   r = uv_fs_read(NULL, &req, wrap->fd, bufs, iovs_len, -1, NULL);
+  uv_mutex_unlock(&wrap->mutex);
   uvread = req.result;
   uv_fs_req_cleanup(&req);
-  free(bufs);
+  uvwasi__free_iovs(bufs);
 
   if (r < 0)
     return uvwasi__translate_uv_error(r);
@@ -1032,14 +1247,72 @@ uvwasi_errno_t uvwasi_fd_read(uvwasi_t* uvwasi,
 }
 
 
+/* Positions the directory stream cached on wrap so that the next entry read
+   from it is the one identified by cookie. The stream is opened on first use
+   and stays open until the fd is closed or renumbered, so sequential calls do
+   not reopen the directory and scan it up to the cookie again. */
+static uvwasi_errno_t uvwasi__readdir_seek(struct uvwasi_fd_wrap_t* wrap,
+                                           uvwasi_dircookie_t cookie) {
+  uv_fs_t req;
+  int r;
+#ifdef _WIN32
+  uv_dirent_t dirent;
+
+  /* Without seekdir(), moving backwards means starting over. */
+  if (wrap->dir != NULL && cookie < wrap->dir_cookie)
+    uvwasi__fd_wrap_close_dir(wrap);
+#endif /* _WIN32 */
+
+  if (wrap->dir == NULL) {
+    r = uv_fs_opendir(NULL, &req, wrap->real_path, NULL);
+    if (r != 0)
+      return uvwasi__translate_uv_error(r);
+
+    wrap->dir = req.ptr;
+    wrap->dir_cookie = UVWASI_DIRCOOKIE_START;
+    uv_fs_req_cleanup(&req);
+  }
+
+  if (cookie == wrap->dir_cookie)
+    return UVWASI_ESUCCESS;
+
+#ifdef _WIN32
+  wrap->dir->dirents = &dirent;
+  wrap->dir->nentries = 1;
+
+  while (wrap->dir_cookie < cookie) {
+    r = uv_fs_readdir(NULL, &req, wrap->dir, NULL);
+    uv_fs_req_cleanup(&req);
+
+    if (r < 0) {
+      uvwasi__fd_wrap_close_dir(wrap);
+      return uvwasi__translate_uv_error(r);
+    }
+
+    if (r == 0)
+      break;
+
+    wrap->dir_cookie++;
+  }
+#else
+  if (cookie == UVWASI_DIRCOOKIE_START)
+    rewinddir(wrap->dir->dir);
+  else
+    seekdir(wrap->dir->dir, cookie);
+
+  wrap->dir_cookie = cookie;
+#endif /* _WIN32 */
+
+  return UVWASI_ESUCCESS;
+}
+
+
 uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
                                  uvwasi_fd_t fd,
                                  void* buf,
                                  size_t buf_len,
                                  uvwasi_dircookie_t cookie,
                                  size_t* bufused) {
-  /* TODO(cjihrig): Support Windows where seekdir() and telldir() are used. */
-  /* TODO(cjihrig): Avoid opening and closing the directory on each call. */
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_dirent_t dirent;
   uv_dirent_t dirents[UVWASI__READDIR_NUM_ENTRIES];
@@ -1064,32 +1337,36 @@ uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  /* Open the directory. */
-  r = uv_fs_opendir(NULL, &req, wrap->real_path, NULL);
-  if (r != 0)
-    return uvwasi__translate_uv_error(r);
+  if (wrap->bundle != NULL) {
+    uvwasi__bundle_readdir(wrap->bundle,
+                           wrap->bundle_node,
+                           buf,
+                           buf_len,
+                           cookie,
+                           bufused);
+    uv_mutex_unlock(&wrap->mutex);
+    return UVWASI_ESUCCESS;
+  }
+
+  /* Position the cached directory stream at the requested entry. */
+  err = uvwasi__readdir_seek(wrap, cookie);
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
 
   /* Setup for reading the directory. */
-  dir = req.ptr;
+  dir = wrap->dir;
   dir->dirents = dirents;
   dir->nentries = UVWASI__READDIR_NUM_ENTRIES;
-  uv_fs_req_cleanup(&req);
-
-#ifndef _WIN32
-  /* TODO(cjihrig): Need a Windows equivalent of this logic. */
-  /* Seek to the proper location in the directory. */
-  if (cookie != UVWASI_DIRCOOKIE_START)
-    seekdir(dir->dir, cookie);
-#endif
 
   /* Read the directory entries into the provided buffer. */
-  err = UVWASI_ESUCCESS;
   *bufused = 0;
   while (0 != (r = uv_fs_readdir(NULL, &req, dir, NULL))) {
     if (r < 0) {
       err = uvwasi__translate_uv_error(r);
       uv_fs_req_cleanup(&req);
-      goto exit;
+      goto error_exit;
     }
 
     for (i = 0; i < r; i++) {
@@ -1102,12 +1379,14 @@ uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
       if (tell < 0) {
         err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
         uv_fs_req_cleanup(&req);
-        goto exit;
+        goto error_exit;
       }
 #else
-      tell = 0; /* TODO(cjihrig): Need to support Windows. */
+      /* Windows has no telldir(), so cookies are entry indices there. */
+      tell = (long) wrap->dir_cookie + 1;
 #endif /* _WIN32 */
 
+      wrap->dir_cookie = (uvwasi_dircookie_t) tell;
       name_len = strlen(dirents[i].name);
       dirent.d_next = (uvwasi_dircookie_t) tell;
       /* TODO(cjihrig): Missing ino libuv (and Windows) support. fstat()? */
@@ -1148,23 +1427,25 @@ uvwasi_errno_t uvwasi_fd_readdir(uvwasi_t* uvwasi,
       /* Write the entry name to the buffer. */
       available = buf_len - *bufused;
       size_to_cp = name_len > available ? available : name_len;
-      memcpy((char*)buf + *bufused, &dirents[i].name, size_to_cp);
+      memcpy((char*)buf + *bufused, dirents[i].name, size_to_cp);
       *bufused += size_to_cp;
     }
 
     uv_fs_req_cleanup(&req);
 
+    /* An entry that was truncated is read again through its cookie on the
+       next call, which seeks the stream back to it. */
     if (*bufused >= buf_len)
       break;
   }
 
-exit:
-  /* Close the directory. */
-  r = uv_fs_closedir(NULL, &req, dir, NULL);
-  uv_fs_req_cleanup(&req);
-  if (r != 0)
-    return uvwasi__translate_uv_error(r);
+  uv_mutex_unlock(&wrap->mutex);
+  return UVWASI_ESUCCESS;
 
+error_exit:
+  /* The stream position is unknown after an error. Start over next time. */
+  uvwasi__fd_wrap_close_dir(wrap);
+  uv_mutex_unlock(&wrap->mutex);
   return err;
 }
 
@@ -1181,23 +1462,42 @@ uvwasi_errno_t uvwasi_fd_renumber(uvwasi_t* uvwasi,
   if (uvwasi == NULL)
     return UVWASI_EINVAL;
 
-  err = uvwasi_fd_table_get(&uvwasi->fds, from, &from_wrap, 0, 0);
+  /* Only one thread can hold the table lock exclusively, and threads that
+     hold a single entry never wait for another one, so the order in which
+     the two entries are taken does not matter. */
+  uvwasi_fd_table_lock(&uvwasi->fds);
+  err = uvwasi_fd_table_get_nolock(&uvwasi->fds, from, &from_wrap, 0, 0);
   if (err != UVWASI_ESUCCESS)
-    return err;
+    goto exit;
 
-  err = uvwasi_fd_table_get(&uvwasi->fds, to, &to_wrap, 0, 0);
-  if (err != UVWASI_ESUCCESS)
-    return err;
+  /* Renumbering an fd to itself only checks that it is valid. */
+  if (from == to) {
+    uv_mutex_unlock(&from_wrap->mutex);
+    goto exit;
+  }
 
-  r = uv_fs_close(NULL, &req, to_wrap->fd, NULL);
-  uv_fs_req_cleanup(&req);
-  if (r != 0)
-    return uvwasi__translate_uv_error(r);
+  err = uvwasi_fd_table_get_nolock(&uvwasi->fds, to, &to_wrap, 0, 0);
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&from_wrap->mutex);
+    goto exit;
+  }
+
+  r = 0;
+  if (uvwasi__owns_host_fd(to_wrap)) {
+    r = uv_fs_close(NULL, &req, to_wrap->fd, NULL);
+    uv_fs_req_cleanup(&req);
+  }
 
-  memcpy(to_wrap, from_wrap, sizeof(*to_wrap));
-  to_wrap->id = to;
+  if (r != 0)
+    err = uvwasi__translate_uv_error(r);
+  else
+    err = uvwasi_fd_table_renumber_nolock(&uvwasi->fds, to, from);
 
-  return uvwasi_fd_table_remove(&uvwasi->fds, from);
+  uv_mutex_unlock(&to_wrap->mutex);
+  uv_mutex_unlock(&from_wrap->mutex);
+exit:
+  uvwasi_fd_table_unlock(&uvwasi->fds);
+  return err;
 }
 
 
@@ -1216,7 +1516,13 @@ uvwasi_errno_t uvwasi_fd_seek(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  return uvwasi__lseek(wrap->fd, offset, whence, newoffset);
+  if (wrap->bundle != NULL)
+    err = uvwasi__bundle_seek(wrap, offset, whence, newoffset);
+  else
+    err = uvwasi__lseek(wrap->fd, offset, whence, newoffset);
+
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -1239,6 +1545,7 @@ uvwasi_errno_t uvwasi_fd_sync(uvwasi_t* uvwasi, uvwasi_fd_t fd) {
 
   r = uv_fs_fsync(NULL, &req, wrap->fd, NULL);
   uv_fs_req_cleanup(&req);
+  uv_mutex_unlock(&wrap->mutex);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -1260,7 +1567,13 @@ uvwasi_errno_t uvwasi_fd_tell(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  return uvwasi__lseek(wrap->fd, 0, UVWASI_WHENCE_CUR, offset);
+  if (wrap->bundle != NULL)
+    *offset = wrap->bundle_offset;
+  else
+    err = uvwasi__lseek(wrap->fd, 0, UVWASI_WHENCE_CUR, offset);
+
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
 }
 
 
@@ -1284,13 +1597,16 @@ uvwasi_errno_t uvwasi_fd_write(uvwasi_t* uvwasi,
     return err;
 
   err = uvwasi__setup_ciovs(&bufs, iovs, iovs_len);
-  if (err != UVWASI_ESUCCESS)
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
     return err;
+  }
 
   r = uv_fs_write(NULL, &req, wrap->fd, bufs, iovs_len, -1, NULL);
+  uv_mutex_unlock(&wrap->mutex);
   uvwritten = req.result;
   uv_fs_req_cleanup(&req);
-  free(bufs);
+  uvwasi__free_iovs(bufs);
 
   if (r < 0)
     return uvwasi__translate_uv_error(r);
@@ -1304,7 +1620,7 @@ uvwasi_errno_t uvwasi_path_create_directory(uvwasi_t* uvwasi,
                                             uvwasi_fd_t fd,
                                             const char* path,
                                             size_t path_len) {
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
   uvwasi_errno_t err;
@@ -1321,12 +1637,26 @@ uvwasi_errno_t uvwasi_path_create_directory(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap, path, path_len, resolved_path, 0);
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
+                             path,
+                             path_len,
+                             &resolved,
+                             0);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_mkdir(NULL, &req, resolved_path, 0777, NULL);
+#ifndef _WIN32
+  r = 0;
+  if (mkdirat(resolved.dir_fd, resolved.name, 0777) != 0)
+    r = uv_translate_sys_error(errno);
+  (void) req;
+#else
+  r = uv_fs_mkdir(NULL, &req, resolved.host_path, 0777, NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -1341,10 +1671,11 @@ uvwasi_errno_t uvwasi_path_filestat_get(uvwasi_t* uvwasi,
                                         const char* path,
                                         size_t path_len,
                                         uvwasi_filestat_t* buf) {
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
   uvwasi_errno_t err;
+  uint32_t node;
   int r;
 
   if (uvwasi == NULL || path == NULL || buf == NULL)
@@ -1358,19 +1689,50 @@ uvwasi_errno_t uvwasi_path_filestat_get(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap, path, path_len, resolved_path, flags);
+  if (wrap->bundle != NULL) {
+    err = uvwasi__bundle_lookup(wrap->bundle,
+                                wrap->bundle_node,
+                                path,
+                                path_len,
+                                &node);
+    if (err == UVWASI_ESUCCESS)
+      uvwasi__bundle_filestat(wrap->bundle, node, buf);
+
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
+                             path,
+                             path_len,
+                             &resolved,
+                             flags);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_stat(NULL, &req, resolved_path, NULL);
-  if (r != 0) {
-    uv_fs_req_cleanup(&req);
+  /* The resolver only expands the final component when asked to. Otherwise,
+     it must not be followed here either, or a symlink could lead out of the
+     sandbox. */
+#ifndef _WIN32
+  r = uvwasi__fstatat(resolved.dir_fd,
+                      resolved.name,
+                      (flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) != 0 ?
+                          0 : AT_SYMLINK_NOFOLLOW,
+                      &req.statbuf);
+#else
+  if ((flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) != 0)
+    r = uv_fs_stat(NULL, &req, resolved.host_path, NULL);
+  else
+    r = uv_fs_lstat(NULL, &req, resolved.host_path, NULL);
+  uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved);
+  if (r != 0)
     return uvwasi__translate_uv_error(r);
-  }
 
   uvwasi__stat_to_filestat(&req.statbuf, buf);
-  uv_fs_req_cleanup(&req);
-
   return UVWASI_ESUCCESS;
 }
 
@@ -1384,7 +1746,7 @@ uvwasi_errno_t uvwasi_path_filestat_set_times(uvwasi_t* uvwasi,
                                               uvwasi_timestamp_t st_mtim,
                                               uvwasi_fstflags_t fst_flags) {
   /* TODO(cjihrig): libuv does not currently support nanosecond precision. */
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
   uvwasi_errno_t err;
@@ -1406,13 +1768,30 @@ uvwasi_errno_t uvwasi_path_filestat_set_times(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap, path, path_len, resolved_path, flags);
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
+                             path,
+                             path_len,
+                             &resolved,
+                             flags);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
   /* TODO(cjihrig): st_atim and st_mtim should not be unconditionally passed. */
-  r = uv_fs_utime(NULL, &req, resolved_path, st_atim, st_mtim, NULL);
+#ifndef _WIN32
+  r = uvwasi__utimensat(resolved.dir_fd,
+                        resolved.name,
+                        st_atim,
+                        st_mtim,
+                        (flags & UVWASI_LOOKUP_SYMLINK_FOLLOW) != 0 ?
+                            0 : AT_SYMLINK_NOFOLLOW);
+  (void) req;
+#else
+  r = uv_fs_utime(NULL, &req, resolved.host_path, st_atim, st_mtim, NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
@@ -1429,8 +1808,8 @@ uvwasi_errno_t uvwasi_path_link(uvwasi_t* uvwasi,
                                 uvwasi_fd_t new_fd,
                                 const char* new_path,
                                 size_t new_path_len) {
-  char resolved_old_path[PATH_MAX_BYTES];
-  char resolved_new_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved_old;
+  struct uvwasi__resolved_path_t resolved_new;
   struct uvwasi_fd_wrap_t* old_wrap;
   struct uvwasi_fd_wrap_t* new_wrap;
   uvwasi_errno_t err;
@@ -1448,36 +1827,99 @@ uvwasi_errno_t uvwasi_path_link(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  err = uvwasi__resolve_path(uvwasi,
+                             old_wrap,
+                             old_path,
+                             old_path_len,
+                             &resolved_old,
+                             old_flags);
+  uv_mutex_unlock(&old_wrap->mutex);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
   err = uvwasi_fd_table_get(&uvwasi->fds,
                             new_fd,
                             &new_wrap,
                             UVWASI_RIGHT_PATH_LINK_TARGET,
                             0);
   if (err != UVWASI_ESUCCESS)
-    return err;
-
-  err = uvwasi__resolve_path(old_wrap,
-                             old_path,
-                             old_path_len,
-                             resolved_old_path,
-                             old_flags);
-  if (err != UVWASI_ESUCCESS)
-    return err;
+    goto exit;
 
-  err = uvwasi__resolve_path(new_wrap,
+  err = uvwasi__resolve_path(uvwasi,
+                             new_wrap,
                              new_path,
                              new_path_len,
-                             resolved_new_path,
+                             &resolved_new,
                              0);
+  uv_mutex_unlock(&new_wrap->mutex);
   if (err != UVWASI_ESUCCESS)
-    return err;
+    goto exit;
 
-  r = uv_fs_link(NULL, &req, resolved_old_path, resolved_new_path, NULL);
+  /* The resolver has already expanded the source if it was asked to, so the
+     link is never followed here. */
+#ifndef _WIN32
+  r = 0;
+  if (linkat(resolved_old.dir_fd,
+             resolved_old.name,
+             resolved_new.dir_fd,
+             resolved_new.name,
+             0) != 0) {
+    r = uv_translate_sys_error(errno);
+  }
+  (void) req;
+#else
+  r = uv_fs_link(NULL,
+                 &req,
+                 resolved_old.host_path,
+                 resolved_new.host_path,
+                 NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved_new);
   if (r != 0)
-    return uvwasi__translate_uv_error(r);
+    err = uvwasi__translate_uv_error(r);
 
-  return UVWASI_ESUCCESS;
+exit:
+  uvwasi__resolved_path_free(&resolved_old);
+  return err;
+}
+
+
+/* Opens an entry below a bundle directory. The rights that creating or
+   truncating a file need are never granted on bundles, so path_open() has
+   already rejected those flags. */
+static uvwasi_errno_t uvwasi__bundle_open(uvwasi_t* uvwasi,
+                                          struct uvwasi__bundle_s* bundle,
+                                          uint32_t dir,
+                                          const char* path,
+                                          size_t path_len,
+                                          uvwasi_oflags_t o_flags,
+                                          uvwasi_rights_t fs_rights_base,
+                                          uvwasi_rights_t fs_rights_inheriting,
+                                          uvwasi_fd_t* fd) {
+  uvwasi_errno_t err;
+  uint32_t node;
+
+  err = uvwasi__bundle_lookup(bundle, dir, path, path_len, &node);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if ((o_flags & UVWASI_O_EXCL) != 0)
+    return UVWASI_EEXIST;
+
+  if ((o_flags & UVWASI_O_DIRECTORY) != 0 &&
+      bundle->nodes[node].type != UVWASI_FILETYPE_DIRECTORY) {
+    return UVWASI_ENOTDIR;
+  }
+
+  return uvwasi_fd_table_insert_bundle(&uvwasi->fds,
+                                       bundle,
+                                       node,
+                                       "",
+                                       0,
+                                       fs_rights_base,
+                                       fs_rights_inheriting,
+                                       fd);
 }
 
 
@@ -1491,11 +1933,13 @@ uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
                                 uvwasi_rights_t fs_rights_inheriting,
                                 uvwasi_fdflags_t fs_flags,
                                 uvwasi_fd_t* fd) {
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   uvwasi_rights_t needed_inheriting;
   uvwasi_rights_t needed_base;
   struct uvwasi_fd_wrap_t* dirfd_wrap;
   struct uvwasi_fd_wrap_t wrap;
+  struct uvwasi__bundle_s* bundle;
+  uint32_t bundle_node;
   uvwasi_errno_t err;
   uv_fs_t req;
   int flags;
@@ -1560,34 +2004,68 @@ uvwasi_errno_t uvwasi_path_open(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(dirfd_wrap,
+  /* The new entry is inserted with the table locked, so dirfd is released
+     first. Bundles stay alive until uvwasi_destroy() is called. */
+  if (dirfd_wrap->bundle != NULL) {
+    bundle = dirfd_wrap->bundle;
+    bundle_node = dirfd_wrap->bundle_node;
+    uv_mutex_unlock(&dirfd_wrap->mutex);
+    return uvwasi__bundle_open(uvwasi,
+                               bundle,
+                               bundle_node,
+                               path,
+                               path_len,
+                               o_flags,
+                               fs_rights_base,
+                               fs_rights_inheriting,
+                               fd);
+  }
+
+  err = uvwasi__resolve_path(uvwasi,
+                             dirfd_wrap,
                              path,
                              path_len,
-                             resolved_path,
+                             &resolved,
                              dirflags);
+  uv_mutex_unlock(&dirfd_wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_open(NULL, &req, resolved_path, flags, 0666, NULL);
+  /* Without UVWASI_LOOKUP_SYMLINK_FOLLOW, a symlink in the final component
+     fails with ELOOP instead of being opened. */
+  if ((dirflags & UVWASI_LOOKUP_SYMLINK_FOLLOW) == 0)
+    flags |= UV_FS_O_NOFOLLOW;
+#ifndef _WIN32
+  r = openat(resolved.dir_fd, resolved.name, flags | O_CLOEXEC, 0666);
+  if (r == -1)
+    r = uv_translate_sys_error(errno);
+#else
+  r = uv_fs_open(NULL, &req, resolved.host_path, flags, 0666, NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
 
-  if (r < 0)
+  if (r < 0) {
+    uvwasi__resolved_path_free(&resolved);
     return uvwasi__translate_uv_error(r);
+  }
 
   err = uvwasi_fd_table_insert_fd(&uvwasi->fds,
                                   r,
                                   flags,
-                                  resolved_path,
+                                  resolved.host_path,
                                   fs_rights_base,
                                   fs_rights_inheriting,
                                   &wrap);
+  uvwasi__resolved_path_free(&resolved);
   if (err != UVWASI_ESUCCESS)
     goto close_file_and_error_exit;
 
   /* Not all platforms support UV_FS_O_DIRECTORY, so enforce it here as well. */
   if ((o_flags & UVWASI_O_DIRECTORY) != 0 &&
       wrap.type != UVWASI_FILETYPE_DIRECTORY) {
-    uvwasi_fd_table_remove(&uvwasi->fds, wrap.id);
+    uvwasi_fd_table_lock(&uvwasi->fds);
+    uvwasi_fd_table_remove_nolock(&uvwasi->fds, wrap.id);
+    uvwasi_fd_table_unlock(&uvwasi->fds);
     err = UVWASI_ENOTDIR;
     goto close_file_and_error_exit;
   }
@@ -1609,12 +2087,16 @@ uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
                                     char* buf,
                                     size_t buf_len,
                                     size_t* bufused) {
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
+#ifndef _WIN32
+  ssize_t r;
+#else
   uv_fs_t req;
   size_t len;
   int r;
+#endif /* _WIN32 */
 
   if (uvwasi == NULL || path == NULL || buf == NULL || bufused == NULL)
     return UVWASI_EINVAL;
@@ -1627,11 +2109,34 @@ uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap, path, path_len, resolved_path, 0);
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
+                             path,
+                             path_len,
+                             &resolved,
+                             0);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_readlink(NULL, &req, resolved_path, NULL);
+#ifndef _WIN32
+  r = readlinkat(resolved.dir_fd, resolved.name, buf, buf_len);
+  if (r == -1)
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+  uvwasi__resolved_path_free(&resolved);
+  if (r == -1)
+    return err;
+
+  /* The target is not null terminated, and a target that fills the buffer
+     may have been truncated. */
+  if ((size_t) r >= buf_len)
+    return UVWASI_ENOBUFS;
+
+  buf[r] = '\0';
+  *bufused = r + 1;
+  return UVWASI_ESUCCESS;
+#else
+  r = uv_fs_readlink(NULL, &req, resolved.host_path, NULL);
   if (r != 0) {
     uv_fs_req_cleanup(&req);
     return uvwasi__translate_uv_error(r);
@@ -1648,6 +2153,7 @@ uvwasi_errno_t uvwasi_path_readlink(uvwasi_t* uvwasi,
   *bufused = len + 1;
   uv_fs_req_cleanup(&req);
   return UVWASI_ESUCCESS;
+#endif /* _WIN32 */
 }
 
 
@@ -1655,7 +2161,7 @@ uvwasi_errno_t uvwasi_path_remove_directory(uvwasi_t* uvwasi,
                                             uvwasi_fd_t fd,
                                             const char* path,
                                             size_t path_len) {
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
   uvwasi_errno_t err;
@@ -1672,16 +2178,31 @@ uvwasi_errno_t uvwasi_path_remove_directory(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap, path, path_len, resolved_path, 0);
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
+                             path,
+                             path_len,
+                             &resolved,
+                             0);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_rmdir(NULL, &req, resolved_path, NULL);
+#ifndef _WIN32
+  r = 0;
+  if (unlinkat(resolved.dir_fd, resolved.name, AT_REMOVEDIR) != 0)
+    r = uv_translate_sys_error(errno);
+  (void) req;
+#else
+  r = uv_fs_rmdir(NULL, &req, resolved.host_path, NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
 
+  uvwasi__path_cache_invalidate(&uvwasi->path_cache, resolved.host_path);
   return UVWASI_ESUCCESS;
 }
 
@@ -1693,8 +2214,8 @@ uvwasi_errno_t uvwasi_path_rename(uvwasi_t* uvwasi,
                                   uvwasi_fd_t new_fd,
                                   const char* new_path,
                                   size_t new_path_len) {
-  char resolved_old_path[PATH_MAX_BYTES];
-  char resolved_new_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved_old;
+  struct uvwasi__resolved_path_t resolved_new;
   struct uvwasi_fd_wrap_t* old_wrap;
   struct uvwasi_fd_wrap_t* new_wrap;
   uvwasi_errno_t err;
@@ -1712,36 +2233,63 @@ uvwasi_errno_t uvwasi_path_rename(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
+  err = uvwasi__resolve_path(uvwasi,
+                             old_wrap,
+                             old_path,
+                             old_path_len,
+                             &resolved_old,
+                             0);
+  uv_mutex_unlock(&old_wrap->mutex);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
   err = uvwasi_fd_table_get(&uvwasi->fds,
                             new_fd,
                             &new_wrap,
                             UVWASI_RIGHT_PATH_RENAME_TARGET,
                             0);
   if (err != UVWASI_ESUCCESS)
-    return err;
-
-  err = uvwasi__resolve_path(old_wrap,
-                             old_path,
-                             old_path_len,
-                             resolved_old_path,
-                             0);
-  if (err != UVWASI_ESUCCESS)
-    return err;
+    goto exit;
 
-  err = uvwasi__resolve_path(new_wrap,
+  err = uvwasi__resolve_path(uvwasi,
+                             new_wrap,
                              new_path,
                              new_path_len,
-                             resolved_new_path,
+                             &resolved_new,
                              0);
+  uv_mutex_unlock(&new_wrap->mutex);
   if (err != UVWASI_ESUCCESS)
-    return err;
+    goto exit;
 
-  r = uv_fs_rename(NULL, &req, resolved_old_path, resolved_new_path, NULL);
+#ifndef _WIN32
+  r = 0;
+  if (renameat(resolved_old.dir_fd,
+               resolved_old.name,
+               resolved_new.dir_fd,
+               resolved_new.name) != 0) {
+    r = uv_translate_sys_error(errno);
+  }
+  (void) req;
+#else
+  r = uv_fs_rename(NULL,
+                   &req,
+                   resolved_old.host_path,
+                   resolved_new.host_path,
+                   NULL);
   uv_fs_req_cleanup(&req);
-  if (r != 0)
-    return uvwasi__translate_uv_error(r);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved_new);
+  if (r != 0) {
+    err = uvwasi__translate_uv_error(r);
+    goto exit;
+  }
 
-  return UVWASI_ESUCCESS;
+  uvwasi__path_cache_invalidate(&uvwasi->path_cache, resolved_old.host_path);
+  uvwasi__path_cache_invalidate(&uvwasi->path_cache, resolved_new.host_path);
+
+exit:
+  uvwasi__resolved_path_free(&resolved_old);
+  return err;
 }
 
 
@@ -1751,7 +2299,7 @@ uvwasi_errno_t uvwasi_path_symlink(uvwasi_t* uvwasi,
                                    uvwasi_fd_t fd,
                                    const char* new_path,
                                    size_t new_path_len) {
-  char resolved_new_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uvwasi_errno_t err;
   uv_fs_t req;
@@ -1768,20 +2316,31 @@ uvwasi_errno_t uvwasi_path_symlink(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap,
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
                              new_path,
                              new_path_len,
-                             resolved_new_path,
+                             &resolved,
                              0);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
+#ifndef _WIN32
+  r = 0;
+  if (symlinkat(old_path, resolved.dir_fd, resolved.name) != 0)
+    r = uv_translate_sys_error(errno);
+  (void) req;
+#else
   /* Windows support may require setting the flags option. */
-  r = uv_fs_symlink(NULL, &req, old_path, resolved_new_path, 0, NULL);
+  r = uv_fs_symlink(NULL, &req, old_path, resolved.host_path, 0, NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved);
   if (r != 0)
     return uvwasi__translate_uv_error(r);
 
+  uvwasi__path_cache_invalidate(&uvwasi->path_cache, resolved.host_path);
   return UVWASI_ESUCCESS;
 }
 
@@ -1790,7 +2349,7 @@ uvwasi_errno_t uvwasi_path_unlink_file(uvwasi_t* uvwasi,
                                        uvwasi_fd_t fd,
                                        const char* path,
                                        size_t path_len) {
-  char resolved_path[PATH_MAX_BYTES];
+  struct uvwasi__resolved_path_t resolved;
   struct uvwasi_fd_wrap_t* wrap;
   uv_fs_t req;
   uvwasi_errno_t err;
@@ -1807,16 +2366,31 @@ uvwasi_errno_t uvwasi_path_unlink_file(uvwasi_t* uvwasi,
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  err = uvwasi__resolve_path(wrap, path, path_len, resolved_path, 0);
+  err = uvwasi__resolve_path(uvwasi,
+                             wrap,
+                             path,
+                             path_len,
+                             &resolved,
+                             0);
+  uv_mutex_unlock(&wrap->mutex);
   if (err != UVWASI_ESUCCESS)
     return err;
 
-  r = uv_fs_unlink(NULL, &req, resolved_path, NULL);
+#ifndef _WIN32
+  r = 0;
+  if (unlinkat(resolved.dir_fd, resolved.name, 0) != 0)
+    r = uv_translate_sys_error(errno);
+  (void) req;
+#else
+  r = uv_fs_unlink(NULL, &req, resolved.host_path, NULL);
   uv_fs_req_cleanup(&req);
+#endif /* _WIN32 */
+  uvwasi__resolved_path_free(&resolved);
 
   if (r != 0)
     return uvwasi__translate_uv_error(r);
 
+  uvwasi__path_cache_invalidate(&uvwasi->path_cache, resolved.host_path);
   return UVWASI_ESUCCESS;
 }
 
@@ -1826,8 +2400,12 @@ uvwasi_errno_t uvwasi_poll_oneoff(uvwasi_t* uvwasi,
                                   uvwasi_event_t* out,
                                   size_t nsubscriptions,
                                   size_t* nevents) {
-  /* TODO(cjihrig): Implement this. */
-  return UVWASI_ENOTSUP;
+  if (uvwasi == NULL || in == NULL || out == NULL || nevents == NULL ||
+      nsubscriptions == 0) {
+    return UVWASI_EINVAL;
+  }
+
+  return uvwasi__poll_oneoff(uvwasi, in, out, nsubscriptions, nevents);
 }
 
 
@@ -1856,16 +2434,10 @@ uvwasi_errno_t uvwasi_proc_raise(uvwasi_t* uvwasi, uvwasi_signal_t sig) {
 
 
 uvwasi_errno_t uvwasi_random_get(uvwasi_t* uvwasi, void* buf, size_t buf_len) {
-  int r;
-
   if (uvwasi == NULL || buf == NULL)
     return UVWASI_EINVAL;
 
-  r = uv_random(NULL, NULL, buf, buf_len, 0, NULL);
-  if (r != 0)
-    return uvwasi__translate_uv_error(r);
-
-  return UVWASI_ESUCCESS;
+  return uvwasi__random_get(&uvwasi->random, buf, buf_len);
 }
 
 
@@ -1884,6 +2456,28 @@ uvwasi_errno_t uvwasi_sched_yield(uvwasi_t* uvwasi) {
 }
 
 
+#ifndef _WIN32
+static uvwasi_errno_t uvwasi__get_socket(uvwasi_t* uvwasi,
+                                         uvwasi_fd_t sock,
+                                         struct uvwasi_fd_wrap_t** wrap,
+                                         uvwasi_rights_t rights) {
+  uvwasi_errno_t err;
+
+  err = uvwasi_fd_table_get(&uvwasi->fds, sock, wrap, rights, 0);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if ((*wrap)->type != UVWASI_FILETYPE_SOCKET_STREAM &&
+      (*wrap)->type != UVWASI_FILETYPE_SOCKET_DGRAM) {
+    uv_mutex_unlock(&(*wrap)->mutex);
+    return UVWASI_ENOTSOCK;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+#endif /* _WIN32 */
+
+
 uvwasi_errno_t uvwasi_sock_recv(uvwasi_t* uvwasi,
                                 uvwasi_fd_t sock,
                                 const uvwasi_iovec_t* ri_data,
@@ -1891,9 +2485,68 @@ uvwasi_errno_t uvwasi_sock_recv(uvwasi_t* uvwasi,
                                 uvwasi_riflags_t ri_flags,
                                 size_t* ro_datalen,
                                 uvwasi_roflags_t* ro_flags) {
-  /* TODO(cjihrig): Waiting to implement, pending
-                    https://github.com/WebAssembly/WASI/issues/4 */
+#ifdef _WIN32
+  /* Sockets cannot be inserted into the fd table on Windows, see
+     uvwasi_fd_table_insert_stream(). */
   return UVWASI_ENOTSUP;
+#else
+  struct uvwasi_fd_wrap_t* wrap;
+  struct msghdr msg;
+  uv_buf_t* bufs;
+  uvwasi_errno_t err;
+  ssize_t r;
+  int flags;
+
+  if (uvwasi == NULL ||
+      ri_data == NULL ||
+      ro_datalen == NULL ||
+      ro_flags == NULL) {
+    return UVWASI_EINVAL;
+  }
+
+  if ((ri_flags & ~(UVWASI_SOCK_RECV_PEEK | UVWASI_SOCK_RECV_WAITALL)) != 0)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__get_socket(uvwasi, sock, &wrap, UVWASI_RIGHT_FD_READ);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  err = uvwasi__setup_iovs(&bufs, ri_data, ri_data_len);
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  flags = 0;
+  if ((ri_flags & UVWASI_SOCK_RECV_PEEK) != 0)
+    flags |= MSG_PEEK;
+  if ((ri_flags & UVWASI_SOCK_RECV_WAITALL) != 0)
+    flags |= MSG_WAITALL;
+
+  /* uv_buf_t is layout compatible with struct iovec on Unix. */
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec*) bufs;
+  msg.msg_iovlen = ri_data_len;
+
+  do
+    r = recvmsg(wrap->fd, &msg, flags);
+  while (r == -1 && errno == EINTR);
+
+  uv_mutex_unlock(&wrap->mutex);
+  uvwasi__free_iovs(bufs);
+
+  /* Sockets attached from libuv streams are non-blocking. Guests see this
+     through fd_fdstat_get() and wait for readiness with poll_oneoff(). */
+  if (r == -1)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  *ro_datalen = (size_t) r;
+  *ro_flags = 0;
+  if ((msg.msg_flags & MSG_TRUNC) != 0)
+    *ro_flags |= UVWASI_SOCK_RECV_DATA_TRUNCATED;
+
+  return UVWASI_ESUCCESS;
+#endif /* _WIN32 */
 }
 
 
@@ -1903,16 +2556,89 @@ uvwasi_errno_t uvwasi_sock_send(uvwasi_t* uvwasi,
                                 size_t si_data_len,
                                 uvwasi_siflags_t si_flags,
                                 size_t* so_datalen) {
-  /* TODO(cjihrig): Waiting to implement, pending
-                    https://github.com/WebAssembly/WASI/issues/4 */
+#ifdef _WIN32
   return UVWASI_ENOTSUP;
+#else
+  struct uvwasi_fd_wrap_t* wrap;
+  struct msghdr msg;
+  uv_buf_t* bufs;
+  uvwasi_errno_t err;
+  ssize_t r;
+  int flags;
+
+  if (uvwasi == NULL || si_data == NULL || so_datalen == NULL)
+    return UVWASI_EINVAL;
+
+  err = uvwasi__get_socket(uvwasi, sock, &wrap, UVWASI_RIGHT_FD_WRITE);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  err = uvwasi__setup_ciovs(&bufs, si_data, si_data_len);
+  if (err != UVWASI_ESUCCESS) {
+    uv_mutex_unlock(&wrap->mutex);
+    return err;
+  }
+
+  flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif /* MSG_NOSIGNAL */
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec*) bufs;
+  msg.msg_iovlen = si_data_len;
+
+  do
+    r = sendmsg(wrap->fd, &msg, flags);
+  while (r == -1 && errno == EINTR);
+
+  uv_mutex_unlock(&wrap->mutex);
+  uvwasi__free_iovs(bufs);
+
+  if (r == -1)
+    return uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  *so_datalen = (size_t) r;
+  return UVWASI_ESUCCESS;
+#endif /* _WIN32 */
 }
 
 
 uvwasi_errno_t uvwasi_sock_shutdown(uvwasi_t* uvwasi,
                                     uvwasi_fd_t sock,
                                     uvwasi_sdflags_t how) {
-  /* TODO(cjihrig): Waiting to implement, pending
-                    https://github.com/WebAssembly/WASI/issues/4 */
+#ifdef _WIN32
   return UVWASI_ENOTSUP;
+#else
+  struct uvwasi_fd_wrap_t* wrap;
+  uvwasi_errno_t err;
+  int host_how;
+
+  if (uvwasi == NULL)
+    return UVWASI_EINVAL;
+
+  switch (how) {
+    case UVWASI_SHUT_RD:
+      host_how = SHUT_RD;
+      break;
+    case UVWASI_SHUT_WR:
+      host_how = SHUT_WR;
+      break;
+    case UVWASI_SHUT_RD | UVWASI_SHUT_WR:
+      host_how = SHUT_RDWR;
+      break;
+    default:
+      return UVWASI_EINVAL;
+  }
+
+  err = uvwasi__get_socket(uvwasi, sock, &wrap, UVWASI_RIGHT_SOCK_SHUTDOWN);
+  if (err != UVWASI_ESUCCESS)
+    return err;
+
+  if (shutdown(wrap->fd, host_how) != 0)
+    err = uvwasi__translate_uv_error(uv_translate_sys_error(errno));
+
+  uv_mutex_unlock(&wrap->mutex);
+  return err;
+#endif /* _WIN32 */
 }
@@ -9,8 +9,12 @@
       },
       'include_dirs': ['include'],
       'sources': [
+        'src/bundle.c',
         'src/clocks.c',
         'src/fd_table.c',
+        'src/path_resolver.c',
+        'src/poll_oneoff.c',
+        'src/random.c',
         'src/uv_mapping.c',
         'src/uvwasi.c',
       ],
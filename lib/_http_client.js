@@ -30,6 +30,7 @@ const {
   _checkIsHttpToken: checkIsHttpToken,
   debug,
   freeParser,
+  headerOffsets,
   parsers,
   HTTPParser,
   prepareError,
@@ -662,7 +663,8 @@ function tickOnSocket(req, socket) {
   const parser = parsers.alloc();
   req.socket = socket;
   parser.initialize(HTTPParser.RESPONSE,
-                    new HTTPClientAsyncResource('HTTPINCOMINGMESSAGE', req));
+                    new HTTPClientAsyncResource('HTTPINCOMINGMESSAGE', req),
+                    headerOffsets);
   parser.socket = socket;
   parser.outgoing = req;
   req.parser = parser;
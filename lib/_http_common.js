@@ -45,6 +45,13 @@ const kOnExecute = HTTPParser.kOnExecute | 0;
 
 const MAX_HEADER_PAIRS = 2000;
 
+// Parsers that are initialized with this array pass the headers of a message
+// as a Buffer and write the offsets of the names and values in it here, see
+// parserOnHeadersComplete(). It holds their count, the offset of each name
+// and value, and the end of the last value. Messages with more headers than
+// fit are passed as an array of strings instead.
+const headerOffsets = new Uint32Array(2 * MAX_HEADER_PAIRS + 2);
+
 // Only called in the slow case where slow means
 // that the request headers were either fragmented
 // across multiple TCP packets or too large to be
@@ -91,13 +98,25 @@ function parserOnHeadersComplete(versionMajor, versionMinor, headers, method,
   incoming.url = url;
   incoming.upgrade = upgrade;
 
-  var n = headers.length;
+  if (!Array.isArray(headers)) {
+    // `headers` is a Buffer with the names and values, which are only turned
+    // into strings when they are used. The offsets have to be copied, the
+    // array is shared by all parsers.
+    const count = headerOffsets[0];
+    const offsets = headerOffsets.slice(1, count + 2);
+    let n = count;
+    if (parser.maxHeaderPairs > 0)
+      n = Math.min(n, parser.maxHeaderPairs);
+    incoming._addFlatHeaderLines(headers, offsets, count, n);
+  } else {
+    var n = headers.length;
 
-  // If parser.maxHeaderPairs <= 0 assume that there's no limit.
-  if (parser.maxHeaderPairs > 0)
-    n = Math.min(n, parser.maxHeaderPairs);
+    // If parser.maxHeaderPairs <= 0 assume that there's no limit.
+    if (parser.maxHeaderPairs > 0)
+      n = Math.min(n, parser.maxHeaderPairs);
 
-  incoming._addHeaderLines(headers, n);
+    incoming._addHeaderLines(headers, n);
+  }
 
   if (typeof method === 'number') {
     // server only
@@ -242,6 +261,7 @@ module.exports = {
   CRLF: '\r\n',
   debug,
   freeParser,
+  headerOffsets,
   methods,
   parsers,
   kIncomingMessage,
@@ -25,6 +25,8 @@ const { Object } = primordials;
 
 const Stream = require('stream');
 
+const kFlatHeaders = Symbol('kFlatHeaders');
+
 function readStart(socket) {
   if (socket && !socket._paused && socket.readable)
     socket.resume();
@@ -57,6 +59,7 @@ function IncomingMessage(socket) {
   this.complete = false;
   this.headers = {};
   this.rawHeaders = [];
+  this[kFlatHeaders] = null;
   this.trailers = {};
   this.rawTrailers = [];
 
@@ -123,6 +126,110 @@ IncomingMessage.prototype.destroy = function destroy(error) {
 };
 
 
+// Headers that are passed to _addFlatHeaderLines() only become strings once
+// `headers` or `rawHeaders` is used. Until then, both are own accessors of
+// the message, which turn back into the plain data properties that the
+// constructor created on first use. Keys, enumeration order and
+// util.inspect() output are therefore the same as for other messages.
+const kHeadersAccessor = {
+  configurable: true,
+  enumerable: true,
+  get() {
+    decodeFlatHeaders(this);
+    return this.headers;
+  },
+  set(val) {
+    decodeFlatHeaders(this);
+    this.headers = val;
+  }
+};
+
+const kRawHeadersAccessor = {
+  configurable: true,
+  enumerable: true,
+  get() {
+    decodeFlatHeaders(this);
+    return this.rawHeaders;
+  },
+  set(val) {
+    decodeFlatHeaders(this);
+    this.rawHeaders = val;
+  }
+};
+
+
+// `bytes` holds `count` header names and values, which start at `offsets[i]`
+// and end where the next one starts. The last one ends at `offsets[count]`.
+// Like in _addHeaderLines(), all of them are in `rawHeaders` but only the
+// first `n` are added to `headers`.
+IncomingMessage.prototype._addFlatHeaderLines = _addFlatHeaderLines;
+function _addFlatHeaderLines(bytes, offsets, count, n) {
+  this[kFlatHeaders] = {
+    bytes,
+    offsets,
+    count,
+    n,
+    headers: this.headers,
+    rawHeaders: this.rawHeaders
+  };
+  Object.defineProperty(this, 'headers', kHeadersAccessor);
+  Object.defineProperty(this, 'rawHeaders', kRawHeadersAccessor);
+}
+
+function decodeFlatHeaders(msg) {
+  const flat = msg[kFlatHeaders];
+  msg[kFlatHeaders] = null;
+
+  const { bytes, offsets, count, n } = flat;
+  const headers = new Array(count);
+  for (let i = 0; i < count; i++)
+    headers[i] = bytes.latin1Slice(offsets[i], offsets[i + 1]);
+
+  // Redefining the properties keeps their position among the own keys.
+  Object.defineProperty(msg, 'headers', {
+    configurable: true,
+    enumerable: true,
+    writable: true,
+    value: flat.headers
+  });
+  Object.defineProperty(msg, 'rawHeaders', {
+    configurable: true,
+    enumerable: true,
+    writable: true,
+    value: headers
+  });
+
+  const dest = flat.headers;
+  for (let i = 0; i < n; i += 2)
+    msg._addHeaderLine(headers[i], headers[i + 1], dest);
+}
+
+
+// Returns the same value as `msg.headers[name]` without turning the other
+// headers into strings if they are not used yet. `name` must be lowercase and
+// be a header whose values are joined with ', ', like `expect` and `te`.
+function getHeader(msg, name) {
+  const flat = msg[kFlatHeaders];
+  if (flat === undefined || flat === null ||
+      msg._addHeaderLine !== _addHeaderLine) {
+    return msg.headers[name];
+  }
+
+  const { bytes, offsets, n } = flat;
+  let value;
+  for (let i = 0; i < n; i += 2) {
+    if (offsets[i + 1] - offsets[i] !== name.length)
+      continue;
+    const field = bytes.latin1Slice(offsets[i], offsets[i + 1]);
+    if (field !== name && field.toLowerCase() !== name)
+      continue;
+    const next = bytes.latin1Slice(offsets[i + 1], offsets[i + 2]);
+    value = value === undefined ? next : `${value}, ${next}`;
+  }
+  return value;
+}
+
+
 IncomingMessage.prototype._addHeaderLines = _addHeaderLines;
 function _addHeaderLines(headers, n) {
   if (headers && headers.length) {
@@ -297,6 +404,7 @@ IncomingMessage.prototype._dump = function _dump() {
 };
 
 module.exports = {
+  getHeader,
   IncomingMessage,
   readStart,
   readStop
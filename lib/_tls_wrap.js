@@ -67,6 +67,7 @@ const kHandshakeTimeout = Symbol('handshake-timeout');
 const kRes = Symbol('res');
 const kSNICallback = Symbol('snicallback');
 const kEnableTrace = Symbol('enableTrace');
+const kKTLS = Symbol('ktls');
 
 const noop = () => {};
 
@@ -374,6 +375,11 @@ function TLSSocket(socket, opts) {
       'options.enableTrace', 'boolean', enableTrace);
   }
 
+  if (tlsOptions.ktls != null && typeof tlsOptions.ktls !== 'boolean') {
+    throw new ERR_INVALID_ARG_TYPE(
+      'options.ktls', 'boolean', tlsOptions.ktls);
+  }
+
   if (tlsOptions.ALPNProtocols)
     tls.convertALPNProtocols(tlsOptions.ALPNProtocols, tlsOptions);
 
@@ -580,6 +586,9 @@ TLSSocket.prototype._init = function(socket, wrap) {
   if (requestCert || rejectUnauthorized)
     ssl.setVerifyMode(requestCert, rejectUnauthorized);
 
+  if (options.ktls)
+    ssl.enableKTLS();
+
   if (options.isServer) {
     ssl.onhandshakestart = onhandshakestart;
     ssl.onhandshakedone = onhandshakedone;
@@ -840,6 +849,13 @@ TLSSocket.prototype.getPeerCertificate = function(detailed) {
   return null;
 };
 
+TLSSocket.prototype.getKTLS = function() {
+  if (this._handle)
+    return this._handle.getKTLS();
+
+  return null;
+};
+
 TLSSocket.prototype.getCertificate = function() {
   if (this._handle) {
     // It's not a peer cert, but the formatting is identical.
@@ -929,6 +945,7 @@ function tlsConnectionListener(rawSocket) {
     ALPNProtocols: this.ALPNProtocols,
     SNICallback: this[kSNICallback] || SNICallback,
     enableTrace: this[kEnableTrace],
+    ktls: this[kKTLS],
     pauseOnConnect: this.pauseOnConnect,
   });
 
@@ -1053,6 +1070,11 @@ function Server(options, listener) {
   }
 
   this[kEnableTrace] = options.enableTrace;
+
+  if (options.ktls != null && typeof options.ktls !== 'boolean') {
+    throw new ERR_INVALID_ARG_TYPE('options.ktls', 'boolean', options.ktls);
+  }
+  this[kKTLS] = options.ktls;
 }
 
 Object.setPrototypeOf(Server.prototype, net.Server.prototype);
@@ -1416,7 +1438,8 @@ exports.connect = function connect(...args) {
     session: options.session,
     ALPNProtocols: options.ALPNProtocols,
     requestOCSP: options.requestOCSP,
-    enableTrace: options.enableTrace
+    enableTrace: options.enableTrace,
+    ktls: options.ktls
   });
 
   tlssock[kConnectOptions] = options;
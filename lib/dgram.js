@@ -35,6 +35,7 @@ const {
 } = require('internal/net');
 const {
   ERR_INVALID_ARG_TYPE,
+  ERR_INVALID_ARG_VALUE,
   ERR_MISSING_ARGS,
   ERR_SOCKET_ALREADY_BOUND,
   ERR_SOCKET_BAD_BUFFER_SIZE,
@@ -88,6 +89,7 @@ const exceptionWithHostPort = errors.exceptionWithHostPort;
 function Socket(type, listener) {
   EventEmitter.call(this);
   let lookup;
+  let recvBatch;
   let recvBufferSize;
   let sendBufferSize;
 
@@ -96,11 +98,12 @@ function Socket(type, listener) {
     options = type;
     type = options.type;
     lookup = options.lookup;
+    recvBatch = options.recvBatch;
     recvBufferSize = options.recvBufferSize;
     sendBufferSize = options.sendBufferSize;
   }
 
-  const handle = newHandle(type, lookup);
+  const handle = newHandle(type, lookup, recvBatch);
   handle[owner_symbol] = this;
 
   this[async_id_symbol] = handle.getAsyncId();
@@ -636,7 +639,93 @@ Socket.prototype.send = function(buffer,
   }
 };
 
-function doSend(ex, self, ip, list, address, port, callback) {
+// Valid combinations
+// For connectionless sockets
+// sendBatch(messages, port, address, callback)
+// sendBatch(messages, port, address)
+// sendBatch(messages, port, callback)
+// sendBatch(messages, port)
+// For connected sockets
+// sendBatch(messages, callback)
+// sendBatch(messages)
+//
+// Each message is sent as a datagram of its own, see Socket#send() for what a
+// message can be. Where possible, they are sent with a single system call.
+Socket.prototype.sendBatch = function(messages, port, address, callback) {
+  const state = this[kStateSymbol];
+  const connected = state.connectState === CONNECT_STATE_CONNECTED;
+
+  if (!Array.isArray(messages))
+    throw new ERR_INVALID_ARG_TYPE('messages', 'Array', messages);
+  if (messages.length === 0)
+    throw new ERR_INVALID_ARG_VALUE('messages', messages, 'must not be empty');
+
+  const lists = new Array(messages.length);
+  for (let i = 0; i < messages.length; i++) {
+    const message = messages[i];
+    let list;
+    if (typeof message === 'string') {
+      list = [ Buffer.from(message) ];
+    } else if (isUint8Array(message)) {
+      list = [ message ];
+    } else if (!Array.isArray(message) || !(list = fixBufferList(message))) {
+      throw new ERR_INVALID_ARG_TYPE(`messages[${i}]`,
+                                     ['Buffer', 'Uint8Array', 'string',
+                                      'Array'],
+                                     message);
+    }
+    if (list.length === 0)
+      list.push(Buffer.alloc(0));
+    lists[i] = list;
+  }
+
+  if (connected) {
+    if (typeof port === 'function') {
+      callback = port;
+      port = undefined;
+    }
+    if (port || address)
+      throw new ERR_SOCKET_DGRAM_IS_CONNECTED();
+  } else {
+    port = validatePort(port);
+    if (typeof address === 'function') {
+      callback = address;
+      address = undefined;
+    } else if (address && typeof address !== 'string') {
+      throw new ERR_INVALID_ARG_TYPE('address', ['string', 'falsy'], address);
+    }
+  }
+
+  if (typeof callback !== 'function')
+    callback = undefined;
+
+  healthCheck(this);
+
+  if (state.bindState === BIND_STATE_UNBOUND)
+    this.bind({ port: 0, exclusive: true }, null);
+
+  if (state.bindState !== BIND_STATE_BOUND) {
+    enqueue(this, this.sendBatch.bind(this, lists, port, address, callback));
+    return;
+  }
+
+  const afterDns = (ex, ip) => {
+    defaultTriggerAsyncIdScope(
+      this[async_id_symbol],
+      doSend,
+      ex, this, ip, lists, address, port, callback, true
+    );
+  };
+
+  if (!connected) {
+    state.handle.lookup(address, afterDns);
+  } else {
+    afterDns(null, null);
+  }
+};
+
+// With `batch`, `list` is a list of datagrams that are each a list of chunks.
+function doSend(ex, self, ip, list, address, port, callback, batch) {
   const state = self[kStateSymbol];
 
   if (ex) {
@@ -661,10 +750,18 @@ function doSend(ex, self, ip, list, address, port, callback) {
   }
 
   let err;
-  if (port)
+  if (batch) {
+    if (port) {
+      err = state.handle.sendBatch(req, list, list.length, port, ip,
+                                   !!callback);
+    } else {
+      err = state.handle.sendBatch(req, list, list.length, !!callback);
+    }
+  } else if (port) {
     err = state.handle.send(req, list, list.length, port, ip, !!callback);
-  else
+  } else {
     err = state.handle.send(req, list, list.length, !!callback);
+  }
 
   if (err >= 1) {
     // Synchronous finish. The return code is msg_length + 1 so that we can
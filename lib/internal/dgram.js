@@ -1,6 +1,9 @@
 'use strict';
 const { codes } = require('internal/errors');
-const { UDP } = internalBinding('udp_wrap');
+const {
+  constants: { UV_UDP_RECVMMSG },
+  UDP
+} = internalBinding('udp_wrap');
 const { guessHandleType } = internalBinding('util');
 const { isInt32 } = require('internal/validators');
 const { UV_EINVAL } = internalBinding('uv');
@@ -18,7 +21,14 @@ function lookup6(lookup, address, callback) {
   return lookup(address || '::1', 6, callback);
 }
 
-function newHandle(type, lookup) {
+// With `recvBatch`, the handle receives several datagrams with one system
+// call where the platform supports it.
+function newHandle(type, lookup, recvBatch) {
+  if (recvBatch !== undefined && typeof recvBatch !== 'boolean') {
+    throw new ERR_INVALID_ARG_TYPE('options.recvBatch', 'boolean', recvBatch);
+  }
+  const flags = recvBatch ? UV_UDP_RECVMMSG : 0;
+
   if (lookup === undefined) {
     if (dns === undefined) {
       dns = require('dns');
@@ -30,19 +40,20 @@ function newHandle(type, lookup) {
   }
 
   if (type === 'udp4') {
-    const handle = new UDP();
+    const handle = new UDP(flags);
 
     handle.lookup = lookup4.bind(handle, lookup);
     return handle;
   }
 
   if (type === 'udp6') {
-    const handle = new UDP();
+    const handle = new UDP(flags);
 
     handle.lookup = lookup6.bind(handle, lookup);
     handle.bind = handle.bind6;
     handle.connect = handle.connect6;
     handle.send = handle.send6;
+    handle.sendBatch = handle.sendBatch6;
     return handle;
   }
 
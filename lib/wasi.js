@@ -1,10 +1,55 @@
 'use strict';
 /* global WebAssembly */
-const { Array, ArrayPrototype, Object } = primordials;
-const { ERR_INVALID_ARG_TYPE } = require('internal/errors').codes;
+const { Array, ArrayPrototype, Math, Object, SafeMap } = primordials;
+const { Buffer } = require('buffer');
+const {
+  ERR_INVALID_ARG_TYPE,
+  ERR_INVALID_ARG_VALUE,
+  ERR_SERVER_NOT_RUNNING,
+  ERR_SOCKET_CLOSED
+} = require('internal/errors').codes;
 const { emitExperimentalWarning } = require('internal/util');
-const { WASI: _WASI } = internalBinding('wasi');
+const { isArrayBufferView } = require('internal/util/types');
+const { validateString, validateUint32 } = require('internal/validators');
+const {
+  WASI: _WASI,
+  deserializeModule,
+  serializeModule
+} = internalBinding('wasi');
 const kSetMemory = Symbol('setMemory');
+const kGetStats = Symbol('getStats');
+const kAsyncOptions = Symbol('asyncOptions');
+const kReset = Symbol('reset');
+const kExitCode = Symbol('exitCode');
+const kFlushOutput = Symbol('flushOutput');
+const kMemory = Symbol('memory');
+
+// The layout of a bundle, see deps/uvwasi/include/bundle.h.
+const kBundleMagic = 'UVWASIB\0';
+const kBundleVersion = 1;
+const kBundleHeaderSize = 16;
+const kBundleEntrySize = 32;
+const kFiletypeDirectory = 3;
+const kFiletypeRegularFile = 4;
+
+// V8 optimizes compiled modules in the background without signaling when it
+// is done, so cache entries are written this long after compiling, or when
+// the process exits if that happens first.
+const kCacheWriteDelay = 5000;
+
+// In async mode, the guest runs on a worker thread that owns a synchronous
+// WASI instance. Blocking syscalls then only ever block that thread.
+const kAsyncWorkerSource = `
+'use strict';
+const { workerData } = require('worker_threads');
+const { WASI } = require('wasi');
+const { module, options } = workerData;
+const wasi = new WASI(options);
+const instance = new WebAssembly.Instance(module, {
+  wasi_unstable: wasi.wasiImport
+});
+wasi.start(instance);
+`;
 
 emitExperimentalWarning('WASI');
 
@@ -14,8 +59,47 @@ class WASI {
     if (options === null || typeof options !== 'object')
       throw new ERR_INVALID_ARG_TYPE('options', 'object', options);
 
-    // eslint-disable-next-line prefer-const
-    let { args, env, preopens } = options;
+    const {
+      env, preopens, bundles, sockets, async, stats, returnOnExit, stdout,
+      shared, context
+    } = options;
+    let { args } = options;
+
+    if (context !== undefined) {
+      validateUint32(context, 'options.context', true);
+      // The sandbox is configured by the instance that created the context.
+      const fixed = { args, env, preopens, bundles, sockets, async, shared };
+      for (const name in fixed) {
+        if (fixed[name] !== undefined) {
+          throw new ERR_INVALID_ARG_VALUE(
+            'options.context', context, `cannot be used with options.${name}`);
+        }
+      }
+    }
+
+    if (shared !== undefined && typeof shared !== 'boolean')
+      throw new ERR_INVALID_ARG_TYPE('options.shared', 'boolean', shared);
+
+    if (shared === true && async === true) {
+      throw new ERR_INVALID_ARG_VALUE(
+        'options.shared', shared, 'cannot be used with options.async');
+    }
+
+    if (async !== undefined && typeof async !== 'boolean')
+      throw new ERR_INVALID_ARG_TYPE('options.async', 'boolean', async);
+
+    if (stats !== undefined && typeof stats !== 'boolean')
+      throw new ERR_INVALID_ARG_TYPE('options.stats', 'boolean', stats);
+
+    if (returnOnExit !== undefined && typeof returnOnExit !== 'boolean') {
+      throw new ERR_INVALID_ARG_TYPE(
+        'options.returnOnExit', 'boolean', returnOnExit);
+    }
+
+    if (stdout !== undefined && stdout !== 'direct' && stdout !== 'buffered') {
+      throw new ERR_INVALID_ARG_VALUE(
+        'options.stdout', stdout, "must be 'direct' or 'buffered'");
+    }
 
     if (Array.isArray(args))
       args = ArrayPrototype.map(args, (arg) => { return String(arg); });
@@ -37,28 +121,142 @@ class WASI {
     }
 
     const preopenArray = [];
+    // Pairs of guest paths and either packed bundles or bundle file paths.
+    const bundleArray = [];
 
     if (typeof preopens === 'object' && preopens !== null) {
       Object.keys(preopens).forEach((key) => {
-        preopenArray.push(String(key));
-        preopenArray.push(String(preopens[key]));
+        const value = preopens[key];
+        if (isArrayBufferView(value)) {
+          bundleArray.push(String(key), value);
+        } else if (typeof value === 'object' && value !== null) {
+          bundleArray.push(String(key), createBundle(value));
+        } else {
+          preopenArray.push(String(key));
+          preopenArray.push(String(value));
+        }
       });
     } else if (preopens !== undefined) {
       throw new ERR_INVALID_ARG_TYPE('options.preopens', 'Object', preopens);
     }
 
-    const wrap = new _WASI(args, envPairs, preopenArray);
+    if (typeof bundles === 'object' && bundles !== null) {
+      Object.keys(bundles).forEach((key) => {
+        bundleArray.push(String(key), String(bundles[key]));
+      });
+    } else if (bundles !== undefined) {
+      throw new ERR_INVALID_ARG_TYPE('options.bundles', 'Object', bundles);
+    }
+
+    const socketHandles = [];
 
-    for (const prop in wrap) {
-      wrap[prop] = wrap[prop].bind(wrap);
+    if (Array.isArray(sockets)) {
+      // Handles cannot be passed to the worker thread used in async mode.
+      if (async === true && sockets.length > 0) {
+        throw new ERR_INVALID_ARG_VALUE(
+          'options.sockets', sockets, 'cannot be used with options.async');
+      }
+      // Handles belong to the event loop of the thread that created them.
+      if (shared === true && sockets.length > 0) {
+        throw new ERR_INVALID_ARG_VALUE(
+          'options.sockets', sockets, 'cannot be used with options.shared');
+      }
+      if (process.platform === 'win32' && sockets.length > 0) {
+        throw new ERR_INVALID_ARG_VALUE(
+          'options.sockets', sockets, 'is not supported on Windows');
+      }
+      sockets.forEach((socket, i) => {
+        socketHandles.push(getSocketHandle(socket, `options.sockets[${i}]`));
+      });
+    } else if (sockets !== undefined) {
+      throw new ERR_INVALID_ARG_TYPE('options.sockets', 'Array', sockets);
     }
 
+    if (async === true) {
+      // The WASI instance is created on the worker thread by start(), from a
+      // copy of the validated options that only contains plain data.
+      const asyncEnv = {};
+      for (const key in env) {
+        if (env[key] !== undefined)
+          asyncEnv[key] = `${env[key]}`;
+      }
+
+      const asyncPreopens = {};
+      for (let i = 0; i < preopenArray.length; i += 2)
+        asyncPreopens[preopenArray[i]] = preopenArray[i + 1];
+
+      const asyncBundles = {};
+      for (let i = 0; i < bundleArray.length; i += 2) {
+        if (typeof bundleArray[i + 1] === 'string')
+          asyncBundles[bundleArray[i]] = bundleArray[i + 1];
+        else
+          asyncPreopens[bundleArray[i]] = bundleArray[i + 1];
+      }
+
+      this[kSetMemory] = undefined;
+      this[kMemory] = undefined;
+      this[kGetStats] = undefined;
+      this[kReset] = undefined;
+      this[kFlushOutput] = undefined;
+      this[kExitCode] = 0;
+      this[kAsyncOptions] = {
+        args,
+        env: asyncEnv,
+        preopens: asyncPreopens,
+        bundles: asyncBundles,
+        stdout
+      };
+      this.context = undefined;
+      this.wasiImport = undefined;
+      return;
+    }
+
+    // The binding installs the syscalls as own properties of the wrap that
+    // do not depend on their receiver, so they can be imported as they are.
+    const wrap = new _WASI(args,
+                           envPairs,
+                           preopenArray,
+                           bundleArray,
+                           socketHandles,
+                           stats === true,
+                           stdout === 'buffered' ? writeOutput : undefined,
+                           context);
+
     this[kSetMemory] = wrap._setMemory;
     delete wrap._setMemory;
+    this[kMemory] = undefined;
+    this[kGetStats] = wrap._getStats;
+    delete wrap._getStats;
+    this[kReset] = wrap._reset;
+    delete wrap._reset;
+    this[kFlushOutput] = wrap._flushOutput;
+    delete wrap._flushOutput;
+    // Other threads attach to a shared context by its id.
+    this.context = shared === true ? wrap._share() : context;
+    delete wrap._share;
+    this[kExitCode] = 0;
+    if (returnOnExit === true) {
+      // Throwing unwinds the guest, which cannot catch JavaScript exceptions,
+      // back to start().
+      wrap.proc_exit = (code) => {
+        this[kExitCode] = code >>> 0;
+        throw kExitCode;
+      };
+    }
+    this[kAsyncOptions] = undefined;
     this.wasiImport = wrap;
+
+    // The guest now uses duplicates of the host fds of the sockets, which it
+    // owns. Closing the handles keeps the event loop from reading, writing or
+    // accepting connections on them as well.
+    if (sockets !== undefined)
+      sockets.forEach(closeSocket);
   }
 
   start(instance) {
+    if (this[kAsyncOptions] !== undefined)
+      return startAsync(this[kAsyncOptions], instance);
+
     if (!(instance instanceof WebAssembly.Instance)) {
       throw new ERR_INVALID_ARG_TYPE(
         'instance', 'WebAssembly.Instance', instance);
@@ -69,7 +267,12 @@ class WASI {
     if (exports === null || typeof exports !== 'object')
       throw new ERR_INVALID_ARG_TYPE('instance.exports', 'Object', exports);
 
-    const { memory } = exports;
+    let { memory } = exports;
+
+    // Modules that import their memory, such as threaded ones, do not always
+    // export it too.
+    if (memory === undefined)
+      memory = this[kMemory];
 
     if (!(memory instanceof WebAssembly.Memory)) {
       throw new ERR_INVALID_ARG_TYPE(
@@ -77,13 +280,306 @@ class WASI {
     }
 
     this[kSetMemory](memory);
+    this[kExitCode] = 0;
+
+    try {
+      if (exports._start)
+        exports._start();
+      else if (exports.__wasi_unstable_reactor_start)
+        exports.__wasi_unstable_reactor_start();
+    } catch (err) {
+      if (err !== kExitCode)
+        throw err;
+    } finally {
+      this[kFlushOutput]();
+    }
+
+    return this[kExitCode];
+  }
+
+  setMemory(memory) {
+    if (!(memory instanceof WebAssembly.Memory))
+      throw new ERR_INVALID_ARG_TYPE('memory', 'WebAssembly.Memory', memory);
+
+    // In async mode, the memory is created on the worker thread.
+    if (this[kSetMemory] !== undefined) {
+      this[kMemory] = memory;
+      this[kSetMemory](memory);
+    }
+  }
+
+  reset() {
+    // In async mode, every call to start() uses a new WASI instance.
+    if (this[kReset] !== undefined) {
+      this[kFlushOutput]();
+      this[kReset]();
+    }
+  }
+
+  getStats() {
+    // In async mode, the syscalls are made on another thread.
+    if (this[kGetStats] === undefined)
+      return {};
+
+    return this[kGetStats]();
+  }
+}
+
+
+// Receives the buffered output of a guest, see WASI::FlushOutput(). The
+// guest runs synchronously and cannot wait for 'drain', so the return value
+// of write() is ignored. Asynchronous streams keep the chunks in memory until
+// the event loop runs again, as documented for the stdout option.
+function writeOutput(fd, chunk) {
+  if (fd === 1)
+    process.stdout.write(chunk);
+  else
+    process.stderr.write(chunk);
+}
+
+
+// Only connected TCP sockets and listening TCP servers can be passed to the
+// guest. Data buffered by a socket would never reach the guest or the peer,
+// because the socket is closed once the guest owns it.
+function getSocketHandle(socket, name) {
+  const net = require('net');
+  const { TCP } = internalBinding('tcp_wrap');
+
+  if (socket instanceof net.Socket) {
+    if (socket.destroyed)
+      throw new ERR_SOCKET_CLOSED();
+    if (!socket._handle || socket.connecting)
+      throw new ERR_INVALID_ARG_VALUE(name, socket, 'is not connected');
+    if (!(socket._handle instanceof TCP))
+      throw new ERR_INVALID_ARG_VALUE(name, socket, 'is not a TCP socket');
+    if (socket.readableLength > 0 || socket.writableLength > 0)
+      throw new ERR_INVALID_ARG_VALUE(name, socket, 'has buffered data');
+    return socket._handle;
+  }
 
-    if (exports._start)
-      exports._start();
-    else if (exports.__wasi_unstable_reactor_start)
-      exports.__wasi_unstable_reactor_start();
+  if (socket instanceof net.Server) {
+    if (!socket._handle)
+      throw new ERR_SERVER_NOT_RUNNING();
+    if (!(socket._handle instanceof TCP))
+      throw new ERR_INVALID_ARG_VALUE(name, socket, 'is not a TCP server');
+    return socket._handle;
   }
+
+  throw new ERR_INVALID_ARG_TYPE(name, ['net.Socket', 'net.Server'], socket);
+}
+
+
+function closeSocket(socket) {
+  const net = require('net');
+
+  if (socket instanceof net.Server)
+    socket.close();
+  else
+    socket.destroy();
+}
+
+
+// Packs a tree of directories and files into the bundle format. Directories
+// are listed breadth first, so that the children of each directory are
+// consecutive entries.
+function createBundle(tree) {
+  if (typeof tree !== 'object' || tree === null || isArrayBufferView(tree))
+    throw new ERR_INVALID_ARG_TYPE('tree', 'Object', tree);
+
+  const entries = [{ name: Buffer.alloc(0), parent: 0, value: tree }];
+  let nameSize = 0;
+  let dataSize = 0;
+
+  for (let i = 0; i < entries.length; i++) {
+    const entry = entries[i];
+    if (isArrayBufferView(entry.value) || typeof entry.value === 'string') {
+      entry.data = isArrayBufferView(entry.value) ?
+        Buffer.from(entry.value.buffer, entry.value.byteOffset,
+                    entry.value.byteLength) :
+        Buffer.from(entry.value);
+      dataSize += entry.data.length;
+      continue;
+    }
+
+    if (typeof entry.value !== 'object' || entry.value === null) {
+      throw new ERR_INVALID_ARG_TYPE(
+        'tree', ['Object', 'string', 'Buffer', 'TypedArray', 'DataView'],
+        entry.value);
+    }
+
+    const children = Object.keys(entry.value).map((name) => {
+      if (name === '' || name === '.' || name === '..' ||
+          name.includes('/') || name.includes('\0')) {
+        throw new ERR_INVALID_ARG_VALUE('tree', name,
+                                        'contains an invalid file name');
+      }
+      return { name: Buffer.from(name), parent: i, value: entry.value[name] };
+    });
+    children.sort((a, b) => Buffer.compare(a.name, b.name));
+    entry.first = entries.length;
+    entry.count = children.length;
+    for (const child of children) {
+      nameSize += child.name.length;
+      entries.push(child);
+    }
+  }
+
+  const bundle = Buffer.alloc(kBundleHeaderSize +
+                              entries.length * kBundleEntrySize +
+                              nameSize + dataSize);
+  let nameOffset = kBundleHeaderSize + entries.length * kBundleEntrySize;
+  let dataOffset = nameOffset + nameSize;
+
+  bundle.write(kBundleMagic, 0, 'latin1');
+  bundle.writeUInt32LE(kBundleVersion, 8);
+  bundle.writeUInt32LE(entries.length, 12);
+  entries.forEach((entry, i) => {
+    const offset = kBundleHeaderSize + i * kBundleEntrySize;
+    let start = entry.first;
+    let size = entry.count;
+    let type = kFiletypeDirectory;
+
+    if (entry.data !== undefined) {
+      start = dataOffset;
+      size = entry.data.length;
+      type = kFiletypeRegularFile;
+      dataOffset += entry.data.copy(bundle, dataOffset);
+    } else if (size === 0) {
+      start = 0;
+    }
+
+    writeUInt64LE(bundle, start, offset);
+    writeUInt64LE(bundle, size, offset + 8);
+    bundle.writeUInt32LE(nameOffset, offset + 16);
+    bundle.writeUInt32LE(entry.name.length, offset + 20);
+    bundle.writeUInt32LE(entry.parent, offset + 24);
+    bundle.writeUInt32LE(type, offset + 28);
+    nameOffset += entry.name.copy(bundle, nameOffset);
+  });
+
+  return bundle;
+}
+
+
+function writeUInt64LE(buffer, value, offset) {
+  buffer.writeUInt32LE(value % 0x100000000, offset);
+  buffer.writeUInt32LE(Math.floor(value / 0x100000000), offset + 4);
+}
+
+
+// Compiles the module at `path`. With a cache directory, the compiled code is
+// stored under a key that covers the wire bytes and everything that V8 checks
+// before it accepts serialized code, and reused by later calls.
+async function compile(path, options = {}) {
+  if (options === null || typeof options !== 'object')
+    throw new ERR_INVALID_ARG_TYPE('options', 'Object', options);
+
+  const { cache } = options;
+  if (cache !== undefined)
+    validateString(cache, 'options.cache');
+
+  const fs = require('fs');
+  const bytes = await fs.promises.readFile(path);
+  if (cache === undefined)
+    return WebAssembly.compile(bytes);
+
+  const file = require('path').join(cache, `${cacheKey(bytes)}.wasmcache`);
+  let serialized;
+  try {
+    serialized = await fs.promises.readFile(file);
+  } catch (err) {
+    if (err.code !== 'ENOENT')
+      throw err;
+  }
+
+  if (serialized !== undefined) {
+    const module = deserializeModule(serialized, bytes);
+    if (module !== undefined)
+      return module;
+  }
+
+  const module = await WebAssembly.compile(bytes);
+  scheduleCacheWrite(module, cache, file);
+  return module;
+}
+
+
+function cacheKey(bytes) {
+  const { createHash } = require('crypto');
+  return createHash('sha256')
+    .update(bytes)
+    .update(`\0${process.versions.v8}\0${process.arch}\0`)
+    .update(`${process.execArgv.join(' ')}\0${process.env.NODE_OPTIONS}`)
+    .digest('hex');
+}
+
+
+// Cache entries that have not been written yet, by file name.
+const pendingCacheWrites = new SafeMap();
+
+function scheduleCacheWrite(module, dir, file) {
+  if (pendingCacheWrites.has(file))
+    return;
+
+  const { setTimeout } = require('timers');
+  const timer = setTimeout(writeCacheEntry, kCacheWriteDelay, file);
+  timer.unref();
+  pendingCacheWrites.set(file, { module, dir, timer });
+  if (pendingCacheWrites.size === 1)
+    process.on('exit', writePendingCacheEntries);
+}
+
+
+function writePendingCacheEntries() {
+  for (const file of pendingCacheWrites.keys())
+    writeCacheEntry(file);
+}
+
+
+function writeCacheEntry(file) {
+  const { module, dir, timer } = pendingCacheWrites.get(file);
+  require('timers').clearTimeout(timer);
+  pendingCacheWrites.delete(file);
+  if (pendingCacheWrites.size === 0)
+    process.removeListener('exit', writePendingCacheEntries);
+
+  const serialized = serializeModule(module);
+  if (serialized === undefined)
+    return;
+
+  // The cache is only an optimization, so failing to update it is ignored.
+  // Entries are renamed into place so that readers never see partial ones.
+  const fs = require('fs');
+  const tmp = `${file}.${process.pid}.tmp`;
+  try {
+    fs.mkdirSync(dir, { recursive: true });
+    fs.writeFileSync(tmp, serialized);
+    fs.renameSync(tmp, file);
+  } catch {
+    try {
+      fs.unlinkSync(tmp);
+    } catch {}
+  }
+}
+
+
+function startAsync(options, module) {
+  if (!(module instanceof WebAssembly.Module))
+    throw new ERR_INVALID_ARG_TYPE('module', 'WebAssembly.Module', module);
+
+  const { Worker } = require('internal/worker');
+  // The experimental warning has already been emitted on this thread.
+  const worker = new Worker(kAsyncWorkerSource, {
+    eval: true,
+    execArgv: ['--no-warnings'],
+    workerData: { module, options }
+  });
+
+  return new Promise((resolve, reject) => {
+    worker.once('error', reject);
+    worker.once('exit', resolve);
+  });
 }
 
 
-module.exports = { WASI };
+module.exports = { WASI, compile, createBundle };
@@ -647,6 +647,7 @@
         'src/node_version.h',
         'src/node_v8_platform-inl.h',
         'src/node_wasi.h',
+        'src/node_wasi_memory.h',
         'src/node_watchdog.h',
         'src/node_worker.h',
         'src/pipe_wrap.h',
@@ -1114,6 +1115,7 @@
         'test/cctest/test_aliased_buffer.cc',
         'test/cctest/test_base64.cc',
         'test/cctest/test_node_postmortem_metadata.cc',
+        'test/cctest/test_node_wasi_memory.cc',
         'test/cctest/test_environment.cc',
         'test/cctest/test_linked_binding.cc',
         'test/cctest/test_per_process.cc',
@@ -1121,6 +1123,7 @@
         'test/cctest/test_traced_value.cc',
         'test/cctest/test_util.cc',
         'test/cctest/test_url.cc',
+        'test/cctest/test_uvwasi_fd_table.cc',
       ],
 
       'conditions': [
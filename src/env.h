@@ -493,6 +493,8 @@ class IsolateData : public MemoryRetainer {
 #undef VP
 
   std::unordered_map<nghttp2_rcbuf*, v8::Eternal<v8::String>> http2_static_strs;
+  // Indexed like kWellKnownHeaderNames in node_http_parser.cc.
+  std::vector<v8::Eternal<v8::String>> http_parser_header_names;
   inline v8::Isolate* isolate() const;
   IsolateData(const IsolateData&) = delete;
   IsolateData& operator=(const IsolateData&) = delete;
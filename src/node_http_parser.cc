@@ -32,6 +32,8 @@
 
 #include <cstdlib>  // free()
 #include <cstring>  // strdup(), strchr()
+#include <memory>
+#include <vector>
 
 
 // This is a binding to llhttp (https://github.com/nodejs/llhttp)
@@ -62,9 +64,11 @@ using v8::Int32;
 using v8::Integer;
 using v8::Local;
 using v8::MaybeLocal;
+using v8::NewStringType;
 using v8::Object;
 using v8::String;
 using v8::Uint32;
+using v8::Uint32Array;
 using v8::Undefined;
 using v8::Value;
 
@@ -76,59 +80,164 @@ const uint32_t kOnExecute = 4;
 // Any more fields than this will be flushed into JS
 const size_t kMaxHeaderFieldsCount = 32;
 
-// helper class for the Parser
-struct StringPtr {
-  StringPtr() {
-    on_heap_ = false;
-    Reset();
+// Header names that are passed to JS as eternal strings instead of new ones,
+// in the casings that clients and servers commonly send.
+const char* const kWellKnownHeaderNames[] = {
+  "Accept", "accept",
+  "Accept-Encoding", "accept-encoding",
+  "Accept-Language", "accept-language",
+  "Authorization", "authorization",
+  "Cache-Control", "cache-control",
+  "Connection", "connection",
+  "Content-Encoding", "content-encoding",
+  "Content-Length", "content-length",
+  "Content-Type", "content-type",
+  "Cookie", "cookie",
+  "Date", "date",
+  "ETag", "etag",
+  "Expect", "expect",
+  "Host", "host",
+  "If-Modified-Since", "if-modified-since",
+  "If-None-Match", "if-none-match",
+  "Keep-Alive", "keep-alive",
+  "Last-Modified", "last-modified",
+  "Location", "location",
+  "Origin", "origin",
+  "Pragma", "pragma",
+  "Referer", "referer",
+  "Server", "server",
+  "Set-Cookie", "set-cookie",
+  "Transfer-Encoding", "transfer-encoding",
+  "Upgrade", "upgrade",
+  "User-Agent", "user-agent",
+  "Vary", "vary",
+  "X-Forwarded-For", "x-forwarded-for",
+  "X-Forwarded-Proto", "x-forwarded-proto",
+  "X-Requested-With", "x-requested-with"
+};
+const size_t kWellKnownHeaderNamesCount = arraysize(kWellKnownHeaderNames);
+
+// Storage for the strings that are split across reads, and so cannot point
+// into the input. Strings are copied into chunks that are only released all
+// at once, by Reset() at the start of the next message, except for a chunk
+// that only held a string that has since moved to a larger chunk.
+class HeaderSlab {
+ public:
+  // Returns a copy of prev followed by str. When prev is the last copy that
+  // was made, str is appended to it in place if there is room, and otherwise
+  // its space is given back once it has been moved to a new chunk, which is
+  // twice the size that is needed so that a string that grows one byte at a
+  // time is only moved a logarithmic number of times.
+  const char* Append(const char* prev,
+                     size_t prev_size,
+                     const char* str,
+                     size_t size) {
+    bool moved = false;
+    if (prev != nullptr && !chunks_.empty()) {
+      Chunk& chunk = chunks_.back();
+      if (prev + prev_size == chunk.data.get() + chunk.used) {
+        if (chunk.size - chunk.used >= size) {
+          memcpy(chunk.data.get() + chunk.used, str, size);
+          chunk.used += size;
+          return prev;
+        }
+        // There is no room after prev, so it cannot be placed in this chunk
+        // again and Allocate() starts a new one; prev stays readable.
+        chunk.used -= prev_size;
+        moved = true;
+      }
+    }
+
+    char* s = Allocate(prev_size + size);
+    if (prev_size > 0)
+      memcpy(s, prev, prev_size);
+    memcpy(s + prev_size, str, size);
+
+    if (moved && chunks_[chunks_.size() - 2].used == 0)
+      chunks_.erase(chunks_.end() - 2);
+    return s;
   }
 
 
-  ~StringPtr() {
-    Reset();
+  // Keeps the first chunk for the next message, unless it was enlarged for a
+  // single long string.
+  void Reset() {
+    if (!chunks_.empty() && chunks_[0].size == kChunkSize) {
+      chunks_.resize(1);
+      chunks_[0].used = 0;
+    } else {
+      chunks_.clear();
+    }
   }
 
 
-  // If str_ does not point to a heap string yet, this function makes it do
-  // so. This is called at the end of each http_parser_execute() so as not
-  // to leak references. See issue #2438 and test-http-parser-bad-ref.js.
-  void Save() {
-    if (!on_heap_ && size_ > 0) {
-      char* s = new char[size_];
-      memcpy(s, str_, size_);
-      str_ = s;
-      on_heap_ = true;
+  size_t size() const {
+    size_t size = 0;
+    for (const Chunk& chunk : chunks_)
+      size += chunk.size;
+    return size;
+  }
+
+ private:
+  static const size_t kChunkSize = 4096;
+
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t size;
+    size_t used;
+  };
+
+  char* Allocate(size_t size) {
+    if (chunks_.empty() || chunks_.back().size - chunks_.back().used < size) {
+      Chunk chunk;
+      chunk.size = size > kChunkSize / 2 ? 2 * size : kChunkSize;
+      chunk.data.reset(new char[chunk.size]);
+      chunk.used = 0;
+      chunks_.push_back(std::move(chunk));
     }
+
+    Chunk& chunk = chunks_.back();
+    char* s = chunk.data.get() + chunk.used;
+    chunk.used += size;
+    return s;
   }
 
+  std::vector<Chunk> chunks_;
+};
 
-  void Reset() {
-    if (on_heap_) {
-      delete[] str_;
-      on_heap_ = false;
+// helper class for the Parser
+struct StringPtr {
+  StringPtr() {
+    Reset();
+  }
+
+
+  // If str_ does not point to the slab yet, this function makes it do so.
+  // This is called at the end of each http_parser_execute() so as not to
+  // leak references. See issue #2438 and test-http-parser-bad-ref.js.
+  void Save(HeaderSlab* slab) {
+    if (!on_slab_ && size_ > 0) {
+      str_ = slab->Append(nullptr, 0, str_, size_);
+      on_slab_ = true;
     }
+  }
+
 
+  // The slab memory is released by the parser, not here.
+  void Reset() {
     str_ = nullptr;
+    on_slab_ = false;
     size_ = 0;
   }
 
 
-  void Update(const char* str, size_t size) {
+  void Update(const char* str, size_t size, HeaderSlab* slab) {
     if (str_ == nullptr) {
       str_ = str;
-    } else if (on_heap_ || str_ + size_ != str) {
-      // Non-consecutive input, make a copy on the heap.
-      // TODO(bnoordhuis) Use slab allocation, O(n) allocs is bad.
-      char* s = new char[size_ + size];
-      memcpy(s, str_, size_);
-      memcpy(s + size_, str, size);
-
-      if (on_heap_)
-        delete[] str_;
-      else
-        on_heap_ = true;
-
-      str_ = s;
+    } else if (on_slab_ || str_ + size_ != str) {
+      // Non-consecutive input, make a copy on the slab.
+      str_ = slab->Append(str_, size_, str, size);
+      on_slab_ = true;
     }
     size_ += size;
   }
@@ -142,8 +251,40 @@ struct StringPtr {
   }
 
 
+  // Like ToString(), but returns an eternal string for well-known names.
+  Local<String> ToHeaderName(Environment* env) const {
+    if (str_ == nullptr)
+      return String::Empty(env->isolate());
+
+    for (size_t i = 0; i < kWellKnownHeaderNamesCount; i++) {
+      const char* name = kWellKnownHeaderNames[i];
+      if (name[0] != str_[0] || strlen(name) != size_ ||
+          memcmp(name, str_, size_) != 0) {
+        continue;
+      }
+
+      auto& names = env->isolate_data()->http_parser_header_names;
+      if (names.empty())
+        names.resize(kWellKnownHeaderNamesCount);
+      v8::Eternal<String>& eternal = names[i];
+      if (eternal.IsEmpty()) {
+        Local<String> str =
+            String::NewFromOneByte(env->isolate(),
+                                   reinterpret_cast<const uint8_t*>(name),
+                                   NewStringType::kInternalized,
+                                   size_).ToLocalChecked();
+        eternal.Set(env->isolate(), str);
+        return str;
+      }
+      return eternal.Get(env->isolate());
+    }
+
+    return ToString(env);
+  }
+
+
   const char* str_;
-  bool on_heap_;
+  bool on_slab_;
   size_t size_;
 };
 
@@ -158,6 +299,10 @@ class Parser : public AsyncWrap, public StreamListener {
 
   void MemoryInfo(MemoryTracker* tracker) const override {
     tracker->TrackField("current_buffer", current_buffer_);
+    tracker->TrackFieldWithSize("header_slab", slab_.size());
+    tracker->TrackFieldWithSize("flat_header_bytes", flat_bytes_.capacity());
+    tracker->TrackFieldWithSize("flat_header_starts",
+                                flat_starts_.capacity() * sizeof(uint32_t));
   }
 
   SET_MEMORY_INFO_NAME(Parser)
@@ -167,6 +312,11 @@ class Parser : public AsyncWrap, public StreamListener {
     num_fields_ = num_values_ = 0;
     url_.Reset();
     status_message_.Reset();
+    // Nothing refers to the strings of the previous message anymore.
+    slab_.Reset();
+    flat_ = !header_offsets_.IsEmpty();
+    flat_bytes_.clear();
+    flat_starts_.clear();
     return 0;
   }
 
@@ -177,7 +327,7 @@ class Parser : public AsyncWrap, public StreamListener {
       return rv;
     }
 
-    url_.Update(at, length);
+    url_.Update(at, length, &slab_);
     return 0;
   }
 
@@ -188,7 +338,7 @@ class Parser : public AsyncWrap, public StreamListener {
       return rv;
     }
 
-    status_message_.Update(at, length);
+    status_message_.Update(at, length, &slab_);
     return 0;
   }
 
@@ -199,6 +349,15 @@ class Parser : public AsyncWrap, public StreamListener {
       return rv;
     }
 
+    if (flat_) {
+      if (num_fields_ == num_values_) {
+        num_fields_++;
+        flat_starts_.push_back(flat_bytes_.size());
+      }
+      flat_bytes_.insert(flat_bytes_.end(), at, at + length);
+      return 0;
+    }
+
     if (num_fields_ == num_values_) {
       // start of new field name
       num_fields_++;
@@ -214,7 +373,7 @@ class Parser : public AsyncWrap, public StreamListener {
     CHECK_LT(num_fields_, kMaxHeaderFieldsCount);
     CHECK_EQ(num_fields_, num_values_ + 1);
 
-    fields_[num_fields_ - 1].Update(at, length);
+    fields_[num_fields_ - 1].Update(at, length, &slab_);
 
     return 0;
   }
@@ -226,6 +385,15 @@ class Parser : public AsyncWrap, public StreamListener {
       return rv;
     }
 
+    if (flat_) {
+      if (num_values_ != num_fields_) {
+        num_values_++;
+        flat_starts_.push_back(flat_bytes_.size());
+      }
+      flat_bytes_.insert(flat_bytes_.end(), at, at + length);
+      return 0;
+    }
+
     if (num_values_ != num_fields_) {
       // start of new header value
       num_values_++;
@@ -235,7 +403,7 @@ class Parser : public AsyncWrap, public StreamListener {
     CHECK_LT(num_values_, arraysize(values_));
     CHECK_EQ(num_values_, num_fields_);
 
-    values_[num_values_ - 1].Update(at, length);
+    values_[num_values_ - 1].Update(at, length, &slab_);
 
     return 0;
   }
@@ -272,7 +440,14 @@ class Parser : public AsyncWrap, public StreamListener {
     for (size_t i = 0; i < arraysize(argv); i++)
       argv[i] = undefined;
 
-    if (have_flushed_) {
+    if (flat_) {
+      // Headers were collected without a limit, pass them all at once.
+      argv[A_HEADERS] = FlatHeaders();
+      if (parser_.type == HTTP_REQUEST)
+        argv[A_URL] = url_.ToString(env());
+      // Trailers, if any, are passed the usual way.
+      flat_ = false;
+    } else if (have_flushed_) {
       // Slow case, flush remaining headers.
       Flush();
     } else {
@@ -430,15 +605,19 @@ class Parser : public AsyncWrap, public StreamListener {
 
 
   void Save() {
-    url_.Save();
-    status_message_.Save();
+    url_.Save(&slab_);
+    status_message_.Save(&slab_);
+
+    // Flat headers are copied as they are parsed.
+    if (flat_)
+      return;
 
     for (size_t i = 0; i < num_fields_; i++) {
-      fields_[i].Save();
+      fields_[i].Save(&slab_);
     }
 
     for (size_t i = 0; i < num_values_; i++) {
-      values_[i].Save();
+      values_[i].Save(&slab_);
     }
   }
 
@@ -492,6 +671,16 @@ class Parser : public AsyncWrap, public StreamListener {
     // Should always be called from the same context.
     CHECK_EQ(env, parser->env());
 
+    // If a Uint32Array is passed, headers are passed to JS as a Buffer with
+    // their offsets written to the array, see FlatHeaders().
+    if (args[2]->IsUint32Array()) {
+      parser->header_offsets_.Reset(env->isolate(),
+                                    args[2].As<Uint32Array>());
+    } else {
+      CHECK(args[2]->IsUndefined());
+      parser->header_offsets_.Reset();
+    }
+
     AsyncWrap::ProviderType provider =
         (type == HTTP_REQUEST ?
             AsyncWrap::PROVIDER_HTTPINCOMINGMESSAGE
@@ -711,7 +900,7 @@ class Parser : public AsyncWrap, public StreamListener {
     Local<Value> headers_v[kMaxHeaderFieldsCount * 2];
 
     for (size_t i = 0; i < num_values_; ++i) {
-      headers_v[i * 2] = fields_[i].ToString(env());
+      headers_v[i * 2] = fields_[i].ToHeaderName(env());
       headers_v[i * 2 + 1] = values_[i].ToString(env());
     }
 
@@ -719,6 +908,43 @@ class Parser : public AsyncWrap, public StreamListener {
   }
 
 
+  // Returns the header names and values of the message as a single Buffer.
+  // Their offsets into it are written to `header_offsets_`: the number of
+  // names and values, the start of each, and the end of the last value.
+  // JS land only makes strings of them when they are used. If the offsets
+  // do not fit, the headers are returned as an array like CreateHeaders().
+  Local<Value> FlatHeaders() {
+    size_t count = 2 * num_values_;
+    size_t length = flat_bytes_.size();
+    // A field without a value is ignored, like in CreateHeaders().
+    if (flat_starts_.size() > count) {
+      length = flat_starts_[count];
+      flat_starts_.resize(count);
+    }
+
+    Local<Uint32Array> offsets = header_offsets_.Get(env()->isolate());
+    if (count == 0 || count + 2 > offsets->Length()) {
+      std::vector<Local<Value>> headers_v(count);
+      for (size_t i = 0; i < count; i++) {
+        size_t end = i + 1 < count ? flat_starts_[i + 1] : length;
+        headers_v[i] = OneByteString(env()->isolate(),
+                                     flat_bytes_.data() + flat_starts_[i],
+                                     end - flat_starts_[i]);
+      }
+      return Array::New(env()->isolate(), headers_v.data(), count);
+    }
+
+    uint32_t* data = reinterpret_cast<uint32_t*>(
+        static_cast<char*>(offsets->Buffer()->GetContents().Data()) +
+        offsets->ByteOffset());
+    data[0] = count;
+    memcpy(data + 1, flat_starts_.data(), count * sizeof(data[0]));
+    data[count + 1] = length;
+
+    return Buffer::Copy(env(), flat_bytes_.data(), length).ToLocalChecked();
+  }
+
+
   // spill headers and request path to JS land
   void Flush() {
     HandleScope scope(env()->isolate());
@@ -751,10 +977,12 @@ class Parser : public AsyncWrap, public StreamListener {
     header_nread_ = 0;
     url_.Reset();
     status_message_.Reset();
+    slab_.Reset();
     num_fields_ = 0;
     num_values_ = 0;
     have_flushed_ = false;
     got_exception_ = false;
+    flat_ = false;
   }
 
 
@@ -785,6 +1013,11 @@ class Parser : public AsyncWrap, public StreamListener {
   StringPtr values_[kMaxHeaderFieldsCount];  // header values
   StringPtr url_;
   StringPtr status_message_;
+  HeaderSlab slab_;
+  v8::Global<Uint32Array> header_offsets_;
+  bool flat_ = false;
+  std::vector<char> flat_bytes_;
+  std::vector<uint32_t> flat_starts_;
   size_t num_fields_;
   size_t num_values_;
   bool have_flushed_;
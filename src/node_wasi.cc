@@ -1,19 +1,35 @@
 #include "env-inl.h"
 #include "base_object-inl.h"
 #include "debug_utils.h"
+#include "memory_tracker-inl.h"
 #include "util-inl.h"
 #include "node.h"
+#include "node_buffer.h"
+#include "node_errors.h"
+#include "node_mutex.h"
 #include "uv.h"
 #include "uvwasi.h"
 #include "node_wasi.h"
+#include "node_wasi_memory.h"
+#include "stream_wrap.h"
+#include "histogram-inl.h"
+#include "tracing/trace_event.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
 
 namespace node {
 namespace wasi {
 
+// Guest iovec arrays are usually short. Marshal them on the stack and only
+// fall back to the heap for unusually long lists.
+static constexpr size_t kStackIovecCount = 16;
+
 static inline bool is_access_oob(size_t mem_size,
                                  uint32_t offset,
-                                 uint32_t buf_size) {
-  return offset + buf_size > mem_size;
+                                 uint64_t buf_size) {
+  return static_cast<uint64_t>(offset) + buf_size > mem_size;
 }
 
 #define WASI_DEBUG(wasi, format_string, ...)                                  \
@@ -69,36 +85,249 @@ using v8::Array;
 using v8::ArrayBuffer;
 using v8::BigInt;
 using v8::Context;
+using v8::ConstructorBehavior;
+using v8::Function;
+using v8::FunctionCallback;
 using v8::FunctionCallbackInfo;
 using v8::FunctionTemplate;
+using v8::HandleScope;
+using v8::Integer;
+using v8::Isolate;
 using v8::Local;
+using v8::Map;
+using v8::Number;
 using v8::Object;
+using v8::SharedArrayBuffer;
 using v8::String;
 using v8::Uint32;
+using v8::Undefined;
 using v8::Value;
+using v8::WasmModuleObject;
+
+
+// Every syscall is installed on the wrap object as a plain function whose
+// callback data is the wrap itself. Guests can then call the imports directly,
+// without a JS bound function in between or a receiver check on each call.
+static constexpr struct {
+  const char* name;
+  WASI::SyscallCallback callback;
+} kSyscalls[] = {
+  { "args_get", WASI::ArgsGet },
+  { "args_sizes_get", WASI::ArgsSizesGet },
+  { "clock_res_get", WASI::ClockResGet },
+  { "clock_time_get", WASI::ClockTimeGet },
+  { "environ_get", WASI::EnvironGet },
+  { "environ_sizes_get", WASI::EnvironSizesGet },
+  { "fd_advise", WASI::FdAdvise },
+  { "fd_allocate", WASI::FdAllocate },
+  { "fd_close", WASI::FdClose },
+  { "fd_datasync", WASI::FdDatasync },
+  { "fd_fdstat_get", WASI::FdFdstatGet },
+  { "fd_fdstat_set_flags", WASI::FdFdstatSetFlags },
+  { "fd_fdstat_set_rights", WASI::FdFdstatSetRights },
+  { "fd_filestat_get", WASI::FdFilestatGet },
+  { "fd_filestat_set_size", WASI::FdFilestatSetSize },
+  { "fd_filestat_set_times", WASI::FdFilestatSetTimes },
+  { "fd_pread", WASI::FdPread },
+  { "fd_prestat_get", WASI::FdPrestatGet },
+  { "fd_prestat_dir_name", WASI::FdPrestatDirName },
+  { "fd_pwrite", WASI::FdPwrite },
+  { "fd_read", WASI::FdRead },
+  { "fd_readdir", WASI::FdReaddir },
+  { "fd_renumber", WASI::FdRenumber },
+  { "fd_seek", WASI::FdSeek },
+  { "fd_sync", WASI::FdSync },
+  { "fd_tell", WASI::FdTell },
+  { "fd_write", WASI::FdWrite },
+  { "path_create_directory", WASI::PathCreateDirectory },
+  { "path_filestat_get", WASI::PathFilestatGet },
+  { "path_filestat_set_times", WASI::PathFilestatSetTimes },
+  { "path_link", WASI::PathLink },
+  { "path_open", WASI::PathOpen },
+  { "path_readlink", WASI::PathReadlink },
+  { "path_remove_directory", WASI::PathRemoveDirectory },
+  { "path_rename", WASI::PathRename },
+  { "path_symlink", WASI::PathSymlink },
+  { "path_unlink_file", WASI::PathUnlinkFile },
+  { "poll_oneoff", WASI::PollOneoff },
+  { "proc_exit", WASI::ProcExit },
+  { "proc_raise", WASI::ProcRaise },
+  { "random_get", WASI::RandomGet },
+  { "sched_yield", WASI::SchedYield },
+  { "sock_recv", WASI::SockRecv },
+  { "sock_send", WASI::SockSend },
+  { "sock_shutdown", WASI::SockShutdown }
+};
+
+static constexpr size_t kSyscallCount = arraysize(kSyscalls);
+
+// Helpers for lib/wasi.js, which removes them from the wrap before handing it
+// to the guest.
+static const struct {
+  const char* name;
+  FunctionCallback callback;
+} kInternalMethods[] = {
+  { "_flushOutput", WASI::_FlushOutput },
+  { "_getStats", WASI::_GetStats },
+  { "_reset", WASI::_Reset },
+  { "_setMemory", WASI::_SetMemory },
+  { "_share", WASI::_Share }
+};
+
+// Syscall latencies are recorded with two significant digits, from 1ns up to
+// one hour.
+static constexpr int64_t kLatencyHighest = 3600ll * 1000 * 1000 * 1000;
+static constexpr int kLatencyFigures = 2;
+
+// Buffered output is flushed once this many bytes are pending.
+static constexpr size_t kOutputBufferSize = 64 * 1024;
+
+// Contexts that can be attached to from other threads, by the id returned
+// from _share(). A context lives as long as any WASI instance that uses it.
+static Mutex shared_contexts_mutex;
+static std::unordered_map<uint32_t, std::weak_ptr<uvwasi_t>> shared_contexts;
+static uint32_t next_shared_context_id = 1;
+
+
+// Syscalls are installed through Dispatch() so that they can be traced and
+// measured. When neither is enabled, the only cost is a single branch on
+// flags that are combined before testing them.
+template <size_t kIndex>
+void WASI::Dispatch(const FunctionCallbackInfo<Value>& args) {
+  WASI* wasi;
+  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.Data().As<Object>());
+  if (LIKELY((*wasi->trace_category_state_ | wasi->stats_enabled_) == 0))
+    return kSyscalls[kIndex].callback(wasi, args);
+  wasi->Measure(kIndex, args);
+}
+
+
+void WASI::Measure(size_t index, const FunctionCallbackInfo<Value>& args) {
+  const char* name = kSyscalls[index].name;
+  const bool tracing = *trace_category_state_ != 0;
+
+  if (tracing)
+    TRACE_EVENT_BEGIN0(TRACING_CATEGORY_NODE1(wasi), name);
+  const uint64_t start = uv_hrtime();
+  kSyscalls[index].callback(this, args);
+  const uint64_t elapsed = uv_hrtime() - start;
+  if (tracing)
+    TRACE_EVENT_END0(TRACING_CATEGORY_NODE1(wasi), name);
+
+  if (stats_enabled_ == 0)
+    return;
+
+  SyscallStats& stats = stats_[index];
+  if (!stats.latency)
+    stats.latency.reset(new Histogram(1, kLatencyHighest, kLatencyFigures));
+  stats.count++;
+  stats.latency->Record(static_cast<int64_t>(elapsed));
+}
+
+
+template <size_t... kIndices>
+static void InstallSyscalls(Environment* env,
+                            Local<Object> object,
+                            std::index_sequence<kIndices...>) {
+  static constexpr FunctionCallback kDispatchers[] = {
+    WASI::Dispatch<kIndices>...
+  };
+  Local<Context> context = env->context();
+
+  for (size_t i = 0; i < kSyscallCount; i++) {
+    Local<String> name = OneByteString(env->isolate(), kSyscalls[i].name);
+    Local<Function> fn =
+        Function::New(context, kDispatchers[i], object, 0,
+                      ConstructorBehavior::kThrow).ToLocalChecked();
+    fn->SetName(name);
+    object->Set(context, name, fn).ToChecked();
+  }
+}
 
 
 WASI::WASI(Environment* env,
            Local<Object> object,
-           uvwasi_options_t* options) : BaseObject(env, object) {
-  CHECK_EQ(uvwasi_init(&uvw_, options), UVWASI_ESUCCESS);
+           std::shared_ptr<uvwasi_t> uvw,
+           bool collect_stats)
+    : BaseObject(env, object),
+      context_(std::move(uvw)),
+      uvw_(context_.get()),
+      trace_category_state_(TRACE_EVENT_API_GET_CATEGORY_GROUP_ENABLED(
+          TRACING_CATEGORY_NODE1(wasi))),
+      stats_enabled_(collect_stats ? 1 : 0) {
+  if (collect_stats)
+    stats_.resize(kSyscallCount);
+
+  InstallSyscalls(env, object, std::make_index_sequence<kSyscallCount>());
+
+  Local<Context> context = env->context();
+  for (const auto& method : kInternalMethods) {
+    Local<String> name = OneByteString(env->isolate(), method.name);
+    Local<Function> fn =
+        Function::New(context, method.callback, object, 0,
+                      ConstructorBehavior::kThrow).ToLocalChecked();
+    fn->SetName(name);
+    object->Set(context, name, fn).ToChecked();
+  }
+
   memory_.Reset();
+  memory_buffer_.Reset();
 }
 
 
 WASI::~WASI() {
-  uvwasi_destroy(&uvw_);
+  free(output_);
+  memory_.Reset();
+  memory_buffer_.Reset();
+}
+
+
+// The uvwasi fd table is thread-safe, so a context can be used by WASI
+// instances on several threads at once. It is destroyed with the last one.
+static std::shared_ptr<uvwasi_t> CreateContext(uvwasi_options_t* options) {
+  uvwasi_t* uvw = new uvwasi_t;
+  CHECK_EQ(uvwasi_init(uvw, options), UVWASI_ESUCCESS);
+  return std::shared_ptr<uvwasi_t>(uvw, [](uvwasi_t* uvw) {
+    uvwasi_destroy(uvw);
+    delete uvw;
+  });
 }
 
 
 void WASI::New(const FunctionCallbackInfo<Value>& args) {
   CHECK(args.IsConstructCall());
-  CHECK_EQ(args.Length(), 3);
+  CHECK_EQ(args.Length(), 8);
   CHECK(args[0]->IsArray());
   CHECK(args[1]->IsArray());
   CHECK(args[2]->IsArray());
+  CHECK(args[3]->IsArray());
+  CHECK(args[4]->IsArray());
+  CHECK(args[5]->IsBoolean());
+  CHECK(args[6]->IsFunction() || args[6]->IsUndefined());
+  CHECK(args[7]->IsUint32() || args[7]->IsUndefined());
 
   Environment* env = Environment::GetCurrent(args);
+
+  // Attaching to a shared context, whose fds are set up by its creator.
+  if (args[7]->IsUint32()) {
+    std::shared_ptr<uvwasi_t> context;
+    {
+      Mutex::ScopedLock lock(shared_contexts_mutex);
+      auto it = shared_contexts.find(args[7].As<Uint32>()->Value());
+      if (it != shared_contexts.end())
+        context = it->second.lock();
+    }
+    if (!context)
+      return THROW_ERR_INVALID_ARG_VALUE(env, "WASI context is not available");
+
+    WASI* wasi = new WASI(env, args.This(), std::move(context),
+                          args[5]->IsTrue());
+    wasi->shared_id_ = args[7].As<Uint32>()->Value();
+    if (args[6]->IsFunction())
+      wasi->output_callback_.Reset(env->isolate(), args[6].As<Function>());
+    return;
+  }
+
   Local<Context> context = env->context();
   Local<Array> argv = args[0].As<Array>();
   const uint32_t argc = argv->Length();
@@ -146,7 +375,60 @@ void WASI::New(const FunctionCallbackInfo<Value>& args) {
     index++;
   }
 
-  new WASI(env, args.This(), &options);
+  WASI* wasi = new WASI(env, args.This(), CreateContext(&options),
+                        args[5]->IsTrue());
+  if (args[6]->IsFunction())
+    wasi->output_callback_.Reset(env->isolate(), args[6].As<Function>());
+
+  // Bundles are preopened after the host directories. Each is either packed
+  // in a buffer, which is copied, or a file that is mapped.
+  Local<Array> bundles = args[3].As<Array>();
+  CHECK_EQ(bundles->Length() % 2, 0);
+  uvwasi_errno_t bundle_err = UVWASI_ESUCCESS;
+  for (uint32_t i = 0;
+       i < bundles->Length() && bundle_err == UVWASI_ESUCCESS;
+       i += 2) {
+    auto mapped = bundles->Get(context, i).ToLocalChecked();
+    auto bundle = bundles->Get(context, i + 1).ToLocalChecked();
+    CHECK(mapped->IsString());
+    node::Utf8Value mapped_path(env->isolate(), mapped);
+    uvwasi_fd_t fd;
+    if (bundle->IsArrayBufferView()) {
+      ArrayBufferViewContents<char> data(bundle);
+      bundle_err = uvwasi_embedder_add_bundle(wasi->uvw_,
+                                              *mapped_path,
+                                              data.data(),
+                                              data.length(),
+                                              &fd);
+    } else {
+      CHECK(bundle->IsString());
+      node::Utf8Value path(env->isolate(), bundle);
+      bundle_err = uvwasi_embedder_add_bundle_file(wasi->uvw_,
+                                                   *mapped_path,
+                                                   *path,
+                                                   &fd);
+    }
+  }
+
+  // Sockets get the fds that follow the preopens, in the order given. The
+  // fd table keeps a duplicate of their host fds.
+  Local<Array> sockets = args[4].As<Array>();
+  uvwasi_errno_t socket_err = UVWASI_ESUCCESS;
+  for (uint32_t i = 0;
+       i < sockets->Length() && bundle_err == UVWASI_ESUCCESS &&
+         socket_err == UVWASI_ESUCCESS;
+       i++) {
+    auto handle = sockets->Get(context, i).ToLocalChecked();
+    CHECK(handle->IsObject());
+    uv_stream_t* stream =
+        LibuvStreamWrap::From(env, handle.As<Object>())->stream();
+    CHECK_NOT_NULL(stream);
+    uvwasi_fd_t fd;
+    socket_err = uvwasi_embedder_insert_socket(wasi->uvw_, stream, &fd);
+  }
+
+  // This is the state that reset() returns to.
+  CHECK_EQ(uvwasi_embedder_snapshot(wasi->uvw_), UVWASI_ESUCCESS);
 
   if (options.argv != nullptr) {
     for (uint32_t i = 0; i < argc; i++)
@@ -159,11 +441,36 @@ void WASI::New(const FunctionCallbackInfo<Value>& args) {
       free(options.envp[i]);
     delete[] options.envp;
   }
+
+  if (bundle_err != UVWASI_ESUCCESS)
+    THROW_ERR_INVALID_ARG_VALUE(env, "Cannot load WASI bundle");
+  else if (socket_err != UVWASI_ESUCCESS)
+    THROW_ERR_WASI_SOCKET(env, "Cannot pass socket to WASI");
 }
 
 
-void WASI::ArgsGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::MemoryInfo(MemoryTracker* tracker) const {
+  tracker->TrackField("memory", memory_);
+  tracker->TrackFieldWithSize("uvwasi_fd_table",
+                              uvwasi_fd_table_memory_size(&uvw_->fds));
+  tracker->TrackFieldWithSize("uvwasi_argv",
+                              uvw_->argc * sizeof(*uvw_->argv) +
+                                  uvw_->argv_buf_size);
+  tracker->TrackFieldWithSize("uvwasi_env",
+                              uvw_->envc * sizeof(*uvw_->env) +
+                                  uvw_->env_buf_size);
+
+  size_t stats_size = stats_.capacity() * sizeof(stats_[0]);
+  for (const SyscallStats& stats : stats_) {
+    if (stats.latency)
+      stats_size += stats.latency->GetMemorySize();
+  }
+  tracker->TrackFieldWithSize("stats", stats_size);
+  tracker->TrackFieldWithSize("output", output_capacity_);
+}
+
+
+void WASI::ArgsGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t argv_offset;
   uint32_t argv_buf_offset;
   char* memory;
@@ -171,20 +478,19 @@ void WASI::ArgsGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, argv_offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, argv_buf_offset);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "args_get(%d, %d)\n", argv_offset, argv_buf_offset);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args,
                          mem_size,
                          argv_buf_offset,
-                         wasi->uvw_.argv_buf_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, argv_offset, wasi->uvw_.argc * 4);
-  char** argv = new char*[wasi->uvw_.argc];
+                         wasi->uvw_->argv_buf_size);
+  CHECK_BOUNDS_OR_RETURN(args, mem_size, argv_offset, wasi->uvw_->argc * 4);
+  char** argv = new char*[wasi->uvw_->argc];
   char* argv_buf = &memory[argv_buf_offset];
-  uvwasi_errno_t err = uvwasi_args_get(&wasi->uvw_, argv, argv_buf);
+  uvwasi_errno_t err = uvwasi_args_get(wasi->uvw_, argv, argv_buf);
 
   if (err == UVWASI_ESUCCESS) {
-    for (size_t i = 0; i < wasi->uvw_.argc; i++) {
+    for (size_t i = 0; i < wasi->uvw_->argc; i++) {
       uint32_t offset = argv_buf_offset + (argv[i] - argv[0]);
       wasi->writeUInt32(memory, offset, argv_offset + (i * 4));
     }
@@ -195,8 +501,7 @@ void WASI::ArgsGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::ArgsSizesGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::ArgsSizesGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t argc_offset;
   uint32_t argv_buf_offset;
   char* memory;
@@ -204,14 +509,13 @@ void WASI::ArgsSizesGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, argc_offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, argv_buf_offset);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "args_sizes_get(%d, %d)\n", argc_offset, argv_buf_offset);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, argc_offset, 4);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, argv_buf_offset, 4);
   size_t argc;
   size_t argv_buf_size;
-  uvwasi_errno_t err = uvwasi_args_sizes_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_args_sizes_get(wasi->uvw_,
                                              &argc,
                                              &argv_buf_size);
   if (err == UVWASI_ESUCCESS) {
@@ -223,8 +527,7 @@ void WASI::ArgsSizesGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::ClockResGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::ClockResGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t clock_id;
   uint32_t resolution_ptr;
   char* memory;
@@ -232,12 +535,11 @@ void WASI::ClockResGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, clock_id);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, resolution_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "clock_res_get(%d, %d)\n", clock_id, resolution_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, resolution_ptr, 8);
   uvwasi_timestamp_t resolution;
-  uvwasi_errno_t err = uvwasi_clock_res_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_clock_res_get(wasi->uvw_,
                                             clock_id,
                                             &resolution);
   if (err == UVWASI_ESUCCESS)
@@ -247,8 +549,7 @@ void WASI::ClockResGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::ClockTimeGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::ClockTimeGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t clock_id;
   uint64_t precision;
   uint32_t time_ptr;
@@ -258,7 +559,6 @@ void WASI::ClockTimeGet(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, clock_id);
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Uint64, precision);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, time_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "clock_time_get(%d, %d, %d)\n",
              clock_id,
@@ -267,7 +567,7 @@ void WASI::ClockTimeGet(const FunctionCallbackInfo<Value>& args) {
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, time_ptr, 8);
   uvwasi_timestamp_t time;
-  uvwasi_errno_t err = uvwasi_clock_time_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_clock_time_get(wasi->uvw_,
                                              clock_id,
                                              precision,
                                              &time);
@@ -278,8 +578,7 @@ void WASI::ClockTimeGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::EnvironGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::EnvironGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t environ_offset;
   uint32_t environ_buf_offset;
   char* memory;
@@ -287,22 +586,21 @@ void WASI::EnvironGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, environ_offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, environ_buf_offset);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "environ_get(%d, %d)\n", environ_offset, environ_buf_offset);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args,
                          mem_size,
                          environ_buf_offset,
-                         wasi->uvw_.env_buf_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, environ_offset, wasi->uvw_.envc * 4);
-  std::vector<char*> environment(wasi->uvw_.envc);
+                         wasi->uvw_->env_buf_size);
+  CHECK_BOUNDS_OR_RETURN(args, mem_size, environ_offset, wasi->uvw_->envc * 4);
+  std::vector<char*> environment(wasi->uvw_->envc);
   char* environ_buf = &memory[environ_buf_offset];
-  uvwasi_errno_t err = uvwasi_environ_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_environ_get(wasi->uvw_,
                                           environment.data(),
                                           environ_buf);
 
   if (err == UVWASI_ESUCCESS) {
-    for (size_t i = 0; i < wasi->uvw_.envc; i++) {
+    for (size_t i = 0; i < wasi->uvw_->envc; i++) {
       uint32_t offset = environ_buf_offset + (environment[i] - environment[0]);
       wasi->writeUInt32(memory, offset, environ_offset + (i * 4));
     }
@@ -312,8 +610,8 @@ void WASI::EnvironGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::EnvironSizesGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::EnvironSizesGet(WASI* wasi,
+                           const FunctionCallbackInfo<Value>& args) {
   uint32_t envc_offset;
   uint32_t env_buf_offset;
   char* memory;
@@ -321,14 +619,13 @@ void WASI::EnvironSizesGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, envc_offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, env_buf_offset);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "environ_sizes_get(%d, %d)\n", envc_offset, env_buf_offset);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, envc_offset, 4);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, env_buf_offset, 4);
   size_t envc;
   size_t env_buf_size;
-  uvwasi_errno_t err = uvwasi_environ_sizes_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_environ_sizes_get(wasi->uvw_,
                                                 &envc,
                                                 &env_buf_size);
   if (err == UVWASI_ESUCCESS) {
@@ -340,8 +637,7 @@ void WASI::EnvironSizesGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdAdvise(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdAdvise(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint64_t offset;
   uint64_t len;
@@ -351,20 +647,18 @@ void WASI::FdAdvise(const FunctionCallbackInfo<Value>& args) {
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Uint64, offset);
   UNWRAP_BIGINT_OR_RETURN(args, args[2], Uint64, len);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, advice);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "fd_advise(%d, %d, %d, %d)\n",
              fd,
              offset,
              len,
              advice);
-  uvwasi_errno_t err = uvwasi_fd_advise(&wasi->uvw_, fd, offset, len, advice);
+  uvwasi_errno_t err = uvwasi_fd_advise(wasi->uvw_, fd, offset, len, advice);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdAllocate(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdAllocate(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint64_t offset;
   uint64_t len;
@@ -372,39 +666,33 @@ void WASI::FdAllocate(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Uint64, offset);
   UNWRAP_BIGINT_OR_RETURN(args, args[2], Uint64, len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_allocate(%d, %d, %d)\n", fd, offset, len);
-  uvwasi_errno_t err = uvwasi_fd_allocate(&wasi->uvw_, fd, offset, len);
+  uvwasi_errno_t err = uvwasi_fd_allocate(wasi->uvw_, fd, offset, len);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdClose(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdClose(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   RETURN_IF_BAD_ARG_COUNT(args, 1);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_close(%d)\n", fd);
-  uvwasi_errno_t err = uvwasi_fd_close(&wasi->uvw_, fd);
+  uvwasi_errno_t err = uvwasi_fd_close(wasi->uvw_, fd);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdDatasync(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdDatasync(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   RETURN_IF_BAD_ARG_COUNT(args, 1);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_datasync(%d)\n", fd);
-  uvwasi_errno_t err = uvwasi_fd_datasync(&wasi->uvw_, fd);
+  uvwasi_errno_t err = uvwasi_fd_datasync(wasi->uvw_, fd);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdFdstatGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdFdstatGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t buf;
   char* memory;
@@ -412,40 +700,35 @@ void WASI::FdFdstatGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, buf);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_fdstat_get(%d, %d)\n", fd, buf);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, buf, 24);
+  CHECK_BOUNDS_OR_RETURN(args, mem_size, buf, kFdstatSize);
   uvwasi_fdstat_t stats;
-  uvwasi_errno_t err = uvwasi_fd_fdstat_get(&wasi->uvw_, fd, &stats);
+  uvwasi_errno_t err = uvwasi_fd_fdstat_get(wasi->uvw_, fd, &stats);
 
   if (err == UVWASI_ESUCCESS) {
-    wasi->writeUInt8(memory, stats.fs_filetype, buf);
-    wasi->writeUInt16(memory, stats.fs_flags, buf + 2);
-    wasi->writeUInt64(memory, stats.fs_rights_base, buf + 8);
-    wasi->writeUInt64(memory, stats.fs_rights_inheriting, buf + 16);
+    WriteFdstat(memory, stats, buf);
   }
 
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdFdstatSetFlags(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdFdstatSetFlags(WASI* wasi,
+                            const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint16_t flags;
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, flags);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_fdstat_set_flags(%d, %d)\n", fd, flags);
-  uvwasi_errno_t err = uvwasi_fd_fdstat_set_flags(&wasi->uvw_, fd, flags);
+  uvwasi_errno_t err = uvwasi_fd_fdstat_set_flags(wasi->uvw_, fd, flags);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdFdstatSetRights(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdFdstatSetRights(WASI* wasi,
+                             const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint64_t fs_rights_base;
   uint64_t fs_rights_inheriting;
@@ -453,13 +736,12 @@ void WASI::FdFdstatSetRights(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Uint64, fs_rights_base);
   UNWRAP_BIGINT_OR_RETURN(args, args[2], Uint64, fs_rights_inheriting);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "fd_fdstat_set_rights(%d, %d, %d)\n",
              fd,
              fs_rights_base,
              fs_rights_inheriting);
-  uvwasi_errno_t err = uvwasi_fd_fdstat_set_rights(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_fd_fdstat_set_rights(wasi->uvw_,
                                                    fd,
                                                    fs_rights_base,
                                                    fs_rights_inheriting);
@@ -467,8 +749,7 @@ void WASI::FdFdstatSetRights(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdFilestatGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdFilestatGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t buf;
   char* memory;
@@ -476,44 +757,35 @@ void WASI::FdFilestatGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, buf);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_filestat_get(%d, %d)\n", fd, buf);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, buf, 56);
+  CHECK_BOUNDS_OR_RETURN(args, mem_size, buf, kFilestatSize);
   uvwasi_filestat_t stats;
-  uvwasi_errno_t err = uvwasi_fd_filestat_get(&wasi->uvw_, fd, &stats);
+  uvwasi_errno_t err = uvwasi_fd_filestat_get(wasi->uvw_, fd, &stats);
 
   if (err == UVWASI_ESUCCESS) {
-    wasi->writeUInt64(memory, stats.st_dev, buf);
-    wasi->writeUInt64(memory, stats.st_ino, buf + 8);
-    wasi->writeUInt8(memory, stats.st_filetype, buf + 16);
-    wasi->writeUInt32(memory, stats.st_nlink, buf + 20);
-    wasi->writeUInt64(memory, stats.st_size, buf + 24);
-    wasi->writeUInt64(memory, stats.st_atim, buf + 32);
-    wasi->writeUInt64(memory, stats.st_mtim, buf + 40);
-    wasi->writeUInt64(memory, stats.st_ctim, buf + 48);
+    WriteFilestat(memory, stats, buf);
   }
 
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdFilestatSetSize(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdFilestatSetSize(WASI* wasi,
+                             const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint64_t st_size;
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Uint64, st_size);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_filestat_set_size(%d, %d)\n", fd, st_size);
-  uvwasi_errno_t err = uvwasi_fd_filestat_set_size(&wasi->uvw_, fd, st_size);
+  uvwasi_errno_t err = uvwasi_fd_filestat_set_size(wasi->uvw_, fd, st_size);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdFilestatSetTimes(WASI* wasi,
+                              const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint64_t st_atim;
   uint64_t st_mtim;
@@ -523,14 +795,13 @@ void WASI::FdFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Uint64, st_atim);
   UNWRAP_BIGINT_OR_RETURN(args, args[2], Uint64, st_mtim);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, fst_flags);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "fd_filestat_set_times(%d, %d, %d, %d)\n",
              fd,
              st_atim,
              st_mtim,
              fst_flags);
-  uvwasi_errno_t err = uvwasi_fd_filestat_set_times(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_fd_filestat_set_times(wasi->uvw_,
                                                     fd,
                                                     st_atim,
                                                     st_mtim,
@@ -539,8 +810,7 @@ void WASI::FdFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdPread(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdPread(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t iovs_ptr;
   uint32_t iovs_len;
@@ -554,7 +824,6 @@ void WASI::FdPread(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, iovs_len);
   UNWRAP_BIGINT_OR_RETURN(args, args[3], Uint64, offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, nread_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "uvwasi_fd_pread(%d, %d, %d, %d, %d)\n",
              fd,
@@ -563,51 +832,37 @@ void WASI::FdPread(const FunctionCallbackInfo<Value>& args) {
              offset,
              nread_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, iovs_ptr, iovs_len * 8);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, nread_ptr, 4);
-  uvwasi_iovec_t* iovs =
-    static_cast<uvwasi_iovec_t*>(calloc(iovs_len, sizeof(*iovs)));
-
-  if (iovs == nullptr) {
-    args.GetReturnValue().Set(UVWASI_ENOMEM);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         iovs_ptr,
+                         static_cast<uint64_t>(iovs_len) * kIovecSize);
+  MaybeStackBuffer<uvwasi_iovec_t, kStackIovecCount> iovs(iovs_len);
+  uvwasi_errno_t err = wasi->readIovecs(memory,
+                                        mem_size,
+                                        iovs_ptr,
+                                        iovs_len,
+                                        *iovs);
+  if (err != UVWASI_ESUCCESS) {
+    args.GetReturnValue().Set(err);
     return;
   }
 
-  for (uint32_t i = 0; i < iovs_len; ++i) {
-    uint32_t buf_ptr;
-    uint32_t buf_len;
-
-    wasi->readUInt32(memory, &buf_ptr, iovs_ptr);
-    wasi->readUInt32(memory, &buf_len, iovs_ptr + 4);
-
-    if (is_access_oob(mem_size, buf_ptr, buf_len)) {
-      free(iovs);
-      args.GetReturnValue().Set(UVWASI_EOVERFLOW);
-      return;
-    }
-
-    iovs_ptr += 8;
-    iovs[i].buf = static_cast<void*>(&memory[buf_ptr]);
-    iovs[i].buf_len = buf_len;
-  }
-
   size_t nread;
-  uvwasi_errno_t err = uvwasi_fd_pread(&wasi->uvw_,
-                                       fd,
-                                       iovs,
-                                       iovs_len,
-                                       offset,
-                                       &nread);
+  err = uvwasi_fd_pread(wasi->uvw_,
+                        fd,
+                        *iovs,
+                        iovs_len,
+                        offset,
+                        &nread);
   if (err == UVWASI_ESUCCESS)
     wasi->writeUInt32(memory, nread, nread_ptr);
 
-  free(iovs);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdPrestatGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdPrestatGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t buf;
   char* memory;
@@ -615,12 +870,11 @@ void WASI::FdPrestatGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, buf);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_prestat_get(%d, %d)\n", fd, buf);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, buf, 8);
   uvwasi_prestat_t prestat;
-  uvwasi_errno_t err = uvwasi_fd_prestat_get(&wasi->uvw_, fd, &prestat);
+  uvwasi_errno_t err = uvwasi_fd_prestat_get(wasi->uvw_, fd, &prestat);
 
   if (err == UVWASI_ESUCCESS) {
     wasi->writeUInt32(memory, prestat.pr_type, buf);
@@ -631,8 +885,8 @@ void WASI::FdPrestatGet(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdPrestatDirName(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdPrestatDirName(WASI* wasi,
+                            const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t path_ptr;
   uint32_t path_len;
@@ -642,11 +896,10 @@ void WASI::FdPrestatDirName(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_prestat_dir_name(%d, %d, %d)\n", fd, path_ptr, path_len);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
-  uvwasi_errno_t err = uvwasi_fd_prestat_dir_name(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_fd_prestat_dir_name(wasi->uvw_,
                                                   fd,
                                                   &memory[path_ptr],
                                                   path_len);
@@ -654,8 +907,7 @@ void WASI::FdPrestatDirName(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdPwrite(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdPwrite(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t iovs_ptr;
   uint32_t iovs_len;
@@ -669,7 +921,6 @@ void WASI::FdPwrite(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, iovs_len);
   UNWRAP_BIGINT_OR_RETURN(args, args[3], Uint64, offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, nwritten_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "uvwasi_fd_pwrite(%d, %d, %d, %d, %d)\n",
              fd,
@@ -678,51 +929,37 @@ void WASI::FdPwrite(const FunctionCallbackInfo<Value>& args) {
              offset,
              nwritten_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, iovs_ptr, iovs_len * 8);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, nwritten_ptr, 4);
-  uvwasi_ciovec_t* iovs =
-    static_cast<uvwasi_ciovec_t*>(calloc(iovs_len, sizeof(*iovs)));
-
-  if (iovs == nullptr) {
-    args.GetReturnValue().Set(UVWASI_ENOMEM);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         iovs_ptr,
+                         static_cast<uint64_t>(iovs_len) * kIovecSize);
+  MaybeStackBuffer<uvwasi_ciovec_t, kStackIovecCount> iovs(iovs_len);
+  uvwasi_errno_t err = wasi->readIovecs(memory,
+                                        mem_size,
+                                        iovs_ptr,
+                                        iovs_len,
+                                        *iovs);
+  if (err != UVWASI_ESUCCESS) {
+    args.GetReturnValue().Set(err);
     return;
   }
 
-  for (uint32_t i = 0; i < iovs_len; ++i) {
-    uint32_t buf_ptr;
-    uint32_t buf_len;
-
-    wasi->readUInt32(memory, &buf_ptr, iovs_ptr);
-    wasi->readUInt32(memory, &buf_len, iovs_ptr + 4);
-
-    if (is_access_oob(mem_size, buf_ptr, buf_len)) {
-      free(iovs);
-      args.GetReturnValue().Set(UVWASI_EOVERFLOW);
-      return;
-    }
-
-    iovs_ptr += 8;
-    iovs[i].buf = static_cast<void*>(&memory[buf_ptr]);
-    iovs[i].buf_len = buf_len;
-  }
-
   size_t nwritten;
-  uvwasi_errno_t err = uvwasi_fd_pwrite(&wasi->uvw_,
-                                        fd,
-                                        iovs,
-                                        iovs_len,
-                                        offset,
-                                        &nwritten);
+  err = uvwasi_fd_pwrite(wasi->uvw_,
+                         fd,
+                         *iovs,
+                         iovs_len,
+                         offset,
+                         &nwritten);
   if (err == UVWASI_ESUCCESS)
     wasi->writeUInt32(memory, nwritten, nwritten_ptr);
 
-  free(iovs);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdRead(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdRead(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t iovs_ptr;
   uint32_t iovs_len;
@@ -734,7 +971,6 @@ void WASI::FdRead(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, iovs_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, iovs_len);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, nread_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "fd_read(%d, %d, %d, %d)\n",
              fd,
@@ -742,50 +978,36 @@ void WASI::FdRead(const FunctionCallbackInfo<Value>& args) {
              iovs_len,
              nread_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, iovs_ptr, iovs_len * 8);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, nread_ptr, 4);
-  uvwasi_iovec_t* iovs =
-    static_cast<uvwasi_iovec_t*>(calloc(iovs_len, sizeof(*iovs)));
-
-  if (iovs == nullptr) {
-    args.GetReturnValue().Set(UVWASI_ENOMEM);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         iovs_ptr,
+                         static_cast<uint64_t>(iovs_len) * kIovecSize);
+  MaybeStackBuffer<uvwasi_iovec_t, kStackIovecCount> iovs(iovs_len);
+  uvwasi_errno_t err = wasi->readIovecs(memory,
+                                        mem_size,
+                                        iovs_ptr,
+                                        iovs_len,
+                                        *iovs);
+  if (err != UVWASI_ESUCCESS) {
+    args.GetReturnValue().Set(err);
     return;
   }
 
-  for (uint32_t i = 0; i < iovs_len; ++i) {
-    uint32_t buf_ptr;
-    uint32_t buf_len;
-
-    wasi->readUInt32(memory, &buf_ptr, iovs_ptr);
-    wasi->readUInt32(memory, &buf_len, iovs_ptr + 4);
-
-    if (is_access_oob(mem_size, buf_ptr, buf_len)) {
-      free(iovs);
-      args.GetReturnValue().Set(UVWASI_EOVERFLOW);
-      return;
-    }
-
-    iovs_ptr += 8;
-    iovs[i].buf = static_cast<void*>(&memory[buf_ptr]);
-    iovs[i].buf_len = buf_len;
-  }
-
   size_t nread;
-  uvwasi_errno_t err = uvwasi_fd_read(&wasi->uvw_,
-                                      fd,
-                                      iovs,
-                                      iovs_len,
-                                      &nread);
+  err = uvwasi_fd_read(wasi->uvw_,
+                       fd,
+                       *iovs,
+                       iovs_len,
+                       &nread);
   if (err == UVWASI_ESUCCESS)
     wasi->writeUInt32(memory, nread, nread_ptr);
 
-  free(iovs);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdReaddir(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdReaddir(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t buf_ptr;
   uint32_t buf_len;
@@ -799,7 +1021,6 @@ void WASI::FdReaddir(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, buf_len);
   UNWRAP_BIGINT_OR_RETURN(args, args[3], Uint64, cookie);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, bufused_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "uvwasi_fd_readdir(%d, %d, %d, %d, %d)\n",
              fd,
@@ -811,7 +1032,7 @@ void WASI::FdReaddir(const FunctionCallbackInfo<Value>& args) {
   CHECK_BOUNDS_OR_RETURN(args, mem_size, buf_ptr, buf_len);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, bufused_ptr, 4);
   size_t bufused;
-  uvwasi_errno_t err = uvwasi_fd_readdir(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_fd_readdir(wasi->uvw_,
                                          fd,
                                          &memory[buf_ptr],
                                          buf_len,
@@ -824,22 +1045,19 @@ void WASI::FdReaddir(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdRenumber(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdRenumber(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t from;
   uint32_t to;
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, from);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, to);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_renumber(%d, %d)\n", from, to);
-  uvwasi_errno_t err = uvwasi_fd_renumber(&wasi->uvw_, from, to);
+  uvwasi_errno_t err = uvwasi_fd_renumber(wasi->uvw_, from, to);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdSeek(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdSeek(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   int64_t offset;
   uint8_t whence;
@@ -851,7 +1069,6 @@ void WASI::FdSeek(const FunctionCallbackInfo<Value>& args) {
   UNWRAP_BIGINT_OR_RETURN(args, args[1], Int64, offset);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, whence);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, newoffset_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "fd_seek(%d, %d, %d, %d)\n",
              fd,
@@ -861,7 +1078,7 @@ void WASI::FdSeek(const FunctionCallbackInfo<Value>& args) {
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, newoffset_ptr, 8);
   uvwasi_filesize_t newoffset;
-  uvwasi_errno_t err = uvwasi_fd_seek(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_fd_seek(wasi->uvw_,
                                       fd,
                                       offset,
                                       whence,
@@ -873,20 +1090,17 @@ void WASI::FdSeek(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdSync(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdSync(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   RETURN_IF_BAD_ARG_COUNT(args, 1);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_sync(%d)\n", fd);
-  uvwasi_errno_t err = uvwasi_fd_sync(&wasi->uvw_, fd);
+  uvwasi_errno_t err = uvwasi_fd_sync(wasi->uvw_, fd);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::FdTell(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdTell(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t offset_ptr;
   char* memory;
@@ -894,12 +1108,11 @@ void WASI::FdTell(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, offset_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "fd_tell(%d, %d)\n", fd, offset_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, offset_ptr, 8);
   uvwasi_filesize_t offset;
-  uvwasi_errno_t err = uvwasi_fd_tell(&wasi->uvw_, fd, &offset);
+  uvwasi_errno_t err = uvwasi_fd_tell(wasi->uvw_, fd, &offset);
 
   if (err == UVWASI_ESUCCESS)
     wasi->writeUInt64(memory, offset, offset_ptr);
@@ -908,8 +1121,7 @@ void WASI::FdTell(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::FdWrite(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::FdWrite(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t iovs_ptr;
   uint32_t iovs_len;
@@ -921,7 +1133,6 @@ void WASI::FdWrite(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, iovs_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, iovs_len);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, nwritten_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "fd_write(%d, %d, %d, %d)\n",
              fd,
@@ -929,50 +1140,74 @@ void WASI::FdWrite(const FunctionCallbackInfo<Value>& args) {
              iovs_len,
              nwritten_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, iovs_ptr, iovs_len * 8);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, nwritten_ptr, 4);
-  uvwasi_ciovec_t* iovs =
-    static_cast<uvwasi_ciovec_t*>(calloc(iovs_len, sizeof(*iovs)));
-
-  if (iovs == nullptr) {
-    args.GetReturnValue().Set(UVWASI_ENOMEM);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         iovs_ptr,
+                         static_cast<uint64_t>(iovs_len) * kIovecSize);
+  MaybeStackBuffer<uvwasi_ciovec_t, kStackIovecCount> iovs(iovs_len);
+  uvwasi_errno_t err = wasi->readIovecs(memory,
+                                        mem_size,
+                                        iovs_ptr,
+                                        iovs_len,
+                                        *iovs);
+  if (err != UVWASI_ESUCCESS) {
+    args.GetReturnValue().Set(err);
     return;
   }
 
-  for (uint32_t i = 0; i < iovs_len; ++i) {
-    uint32_t buf_ptr;
-    uint32_t buf_len;
-
-    wasi->readUInt32(memory, &buf_ptr, iovs_ptr);
-    wasi->readUInt32(memory, &buf_len, iovs_ptr + 4);
-
-    if (is_access_oob(mem_size, buf_ptr, buf_len)) {
-      free(iovs);
-      args.GetReturnValue().Set(UVWASI_EOVERFLOW);
+  // Writes to the host's stdout and stderr are buffered when requested. The
+  // guest can renumber those fds, so they are recognized by their host fd.
+  uv_file host_fd;
+  if (!wasi->output_callback_.IsEmpty() &&
+      uvwasi_embedder_get_host_fd(wasi->uvw_,
+                                  fd,
+                                  UVWASI_RIGHT_FD_WRITE,
+                                  &host_fd) == UVWASI_ESUCCESS &&
+      (host_fd == 1 || host_fd == 2)) {
+    size_t total = 0;
+    for (uint32_t i = 0; i < iovs_len; i++)
+      total += iovs[i].buf_len;
+    if (total < kOutputBufferSize) {
+      // Flushing runs JavaScript, so guest memory is not touched afterwards.
+      wasi->writeUInt32(memory, total, nwritten_ptr);
+      if (wasi->BufferOutput(host_fd, *iovs, iovs_len))
+        args.GetReturnValue().Set(UVWASI_ESUCCESS);
       return;
     }
 
-    iovs_ptr += 8;
-    iovs[i].buf = static_cast<void*>(&memory[buf_ptr]);
-    iovs[i].buf_len = buf_len;
+    // Larger writes are not copied. They are written directly once the
+    // pending output has been flushed, which runs JavaScript, so guest memory
+    // is looked up again.
+    if (!wasi->FlushOutput())
+      return;
+    GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
+    err = wasi->readIovecs(memory,
+                           mem_size,
+                           iovs_ptr,
+                           iovs_len,
+                           *iovs);
+    if (err != UVWASI_ESUCCESS) {
+      args.GetReturnValue().Set(err);
+      return;
+    }
   }
 
   size_t nwritten;
-  uvwasi_errno_t err = uvwasi_fd_write(&wasi->uvw_,
-                                       fd,
-                                       iovs,
-                                       iovs_len,
-                                       &nwritten);
+  err = uvwasi_fd_write(wasi->uvw_,
+                        fd,
+                        *iovs,
+                        iovs_len,
+                        &nwritten);
   if (err == UVWASI_ESUCCESS)
     wasi->writeUInt32(memory, nwritten, nwritten_ptr);
 
-  free(iovs);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::PathCreateDirectory(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathCreateDirectory(WASI* wasi,
+                               const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t path_ptr;
   uint32_t path_len;
@@ -982,7 +1217,6 @@ void WASI::PathCreateDirectory(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_create_directory(%d, %d, %d)\n",
              fd,
@@ -990,7 +1224,7 @@ void WASI::PathCreateDirectory(const FunctionCallbackInfo<Value>& args) {
              path_len);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
-  uvwasi_errno_t err = uvwasi_path_create_directory(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_create_directory(wasi->uvw_,
                                                     fd,
                                                     &memory[path_ptr],
                                                     path_len);
@@ -998,8 +1232,8 @@ void WASI::PathCreateDirectory(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathFilestatGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathFilestatGet(WASI* wasi,
+                           const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t flags;
   uint32_t path_ptr;
@@ -1013,7 +1247,6 @@ void WASI::PathFilestatGet(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, path_len);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, buf_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_filestat_get(%d, %d, %d, %d, %d)\n",
              fd,
@@ -1021,31 +1254,24 @@ void WASI::PathFilestatGet(const FunctionCallbackInfo<Value>& args) {
              path_len);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, buf_ptr, 56);
+  CHECK_BOUNDS_OR_RETURN(args, mem_size, buf_ptr, kFilestatSize);
   uvwasi_filestat_t stats;
-  uvwasi_errno_t err = uvwasi_path_filestat_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_filestat_get(wasi->uvw_,
                                                 fd,
                                                 flags,
                                                 &memory[path_ptr],
                                                 path_len,
                                                 &stats);
   if (err == UVWASI_ESUCCESS) {
-    wasi->writeUInt64(memory, stats.st_dev, buf_ptr);
-    wasi->writeUInt64(memory, stats.st_ino, buf_ptr + 8);
-    wasi->writeUInt8(memory, stats.st_filetype, buf_ptr + 16);
-    wasi->writeUInt32(memory, stats.st_nlink, buf_ptr + 20);
-    wasi->writeUInt64(memory, stats.st_size, buf_ptr + 24);
-    wasi->writeUInt64(memory, stats.st_atim, buf_ptr + 32);
-    wasi->writeUInt64(memory, stats.st_mtim, buf_ptr + 40);
-    wasi->writeUInt64(memory, stats.st_ctim, buf_ptr + 48);
+    WriteFilestat(memory, stats, buf_ptr);
   }
 
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::PathFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathFilestatSetTimes(WASI* wasi,
+                                const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t flags;
   uint32_t path_ptr;
@@ -1063,7 +1289,6 @@ void WASI::PathFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
   UNWRAP_BIGINT_OR_RETURN(args, args[4], Uint64, st_atim);
   UNWRAP_BIGINT_OR_RETURN(args, args[5], Uint64, st_mtim);
   CHECK_TO_TYPE_OR_RETURN(args, args[6], Uint32, fst_flags);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_filestat_set_times(%d, %d, %d, %d, %d, %d, %d)\n",
              fd,
@@ -1075,7 +1300,7 @@ void WASI::PathFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
              fst_flags);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
-  uvwasi_errno_t err = uvwasi_path_filestat_set_times(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_filestat_set_times(wasi->uvw_,
                                                       fd,
                                                       flags,
                                                       &memory[path_ptr],
@@ -1087,8 +1312,7 @@ void WASI::PathFilestatSetTimes(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathLink(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathLink(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t old_fd;
   uint32_t old_flags;
   uint32_t old_path_ptr;
@@ -1106,7 +1330,6 @@ void WASI::PathLink(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, new_fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[5], Uint32, new_path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[6], Uint32, new_path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_link(%d, %d, %d, %d, %d, %d, %d)\n",
              old_fd,
@@ -1119,7 +1342,7 @@ void WASI::PathLink(const FunctionCallbackInfo<Value>& args) {
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, old_path_ptr, old_path_len);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, new_path_ptr, new_path_len);
-  uvwasi_errno_t err = uvwasi_path_link(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_link(wasi->uvw_,
                                         old_fd,
                                         old_flags,
                                         &memory[old_path_ptr],
@@ -1131,8 +1354,7 @@ void WASI::PathLink(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathOpen(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathOpen(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t dirfd;
   uint32_t dirflags;
   uint32_t path_ptr;
@@ -1154,7 +1376,6 @@ void WASI::PathOpen(const FunctionCallbackInfo<Value>& args) {
   UNWRAP_BIGINT_OR_RETURN(args, args[6], Uint64, fs_rights_inheriting);
   CHECK_TO_TYPE_OR_RETURN(args, args[7], Uint32, fs_flags);
   CHECK_TO_TYPE_OR_RETURN(args, args[8], Uint32, fd_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_open(%d, %d, %d, %d, %d, %d, %d, %d, %d)\n",
              dirfd,
@@ -1170,7 +1391,7 @@ void WASI::PathOpen(const FunctionCallbackInfo<Value>& args) {
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, fd_ptr, 4);
   uvwasi_fd_t fd;
-  uvwasi_errno_t err = uvwasi_path_open(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_open(wasi->uvw_,
                                         dirfd,
                                         dirflags,
                                         &memory[path_ptr],
@@ -1187,8 +1408,7 @@ void WASI::PathOpen(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathReadlink(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathReadlink(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t path_ptr;
   uint32_t path_len;
@@ -1204,7 +1424,6 @@ void WASI::PathReadlink(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, buf_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, buf_len);
   CHECK_TO_TYPE_OR_RETURN(args, args[5], Uint32, bufused_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_readlink(%d, %d, %d, %d, %d, %d)\n",
              fd,
@@ -1218,7 +1437,7 @@ void WASI::PathReadlink(const FunctionCallbackInfo<Value>& args) {
   CHECK_BOUNDS_OR_RETURN(args, mem_size, buf_ptr, buf_len);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, bufused_ptr, 4);
   size_t bufused;
-  uvwasi_errno_t err = uvwasi_path_readlink(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_readlink(wasi->uvw_,
                                         fd,
                                         &memory[path_ptr],
                                         path_len,
@@ -1232,8 +1451,8 @@ void WASI::PathReadlink(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathRemoveDirectory(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathRemoveDirectory(WASI* wasi,
+                               const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t path_ptr;
   uint32_t path_len;
@@ -1243,7 +1462,6 @@ void WASI::PathRemoveDirectory(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_remove_directory(%d, %d, %d)\n",
              fd,
@@ -1251,7 +1469,7 @@ void WASI::PathRemoveDirectory(const FunctionCallbackInfo<Value>& args) {
              path_len);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
-  uvwasi_errno_t err = uvwasi_path_remove_directory(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_remove_directory(wasi->uvw_,
                                                     fd,
                                                     &memory[path_ptr],
                                                     path_len);
@@ -1259,8 +1477,7 @@ void WASI::PathRemoveDirectory(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathRename(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathRename(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t old_fd;
   uint32_t old_path_ptr;
   uint32_t old_path_len;
@@ -1276,7 +1493,6 @@ void WASI::PathRename(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, new_fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, new_path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[5], Uint32, new_path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_rename(%d, %d, %d, %d, %d, %d)\n",
              old_fd,
@@ -1288,7 +1504,7 @@ void WASI::PathRename(const FunctionCallbackInfo<Value>& args) {
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, old_path_ptr, old_path_len);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, new_path_ptr, new_path_len);
-  uvwasi_errno_t err = uvwasi_path_rename(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_rename(wasi->uvw_,
                                           old_fd,
                                           &memory[old_path_ptr],
                                           old_path_len,
@@ -1299,8 +1515,7 @@ void WASI::PathRename(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathSymlink(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathSymlink(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t old_path_ptr;
   uint32_t old_path_len;
   uint32_t fd;
@@ -1314,7 +1529,6 @@ void WASI::PathSymlink(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, new_path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, new_path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "path_symlink(%d, %d, %d, %d, %d)\n",
              old_path_ptr,
@@ -1325,7 +1539,7 @@ void WASI::PathSymlink(const FunctionCallbackInfo<Value>& args) {
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, old_path_ptr, old_path_len);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, new_path_ptr, new_path_len);
-  uvwasi_errno_t err = uvwasi_path_symlink(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_symlink(wasi->uvw_,
                                            &memory[old_path_ptr],
                                            old_path_len,
                                            fd,
@@ -1335,8 +1549,7 @@ void WASI::PathSymlink(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PathUnlinkFile(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PathUnlinkFile(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t fd;
   uint32_t path_ptr;
   uint32_t path_len;
@@ -1346,11 +1559,10 @@ void WASI::PathUnlinkFile(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, fd);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, path_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, path_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "path_unlink_file(%d, %d, %d)\n", fd, path_ptr, path_len);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, path_ptr, path_len);
-  uvwasi_errno_t err = uvwasi_path_unlink_file(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_path_unlink_file(wasi->uvw_,
                                                fd,
                                                &memory[path_ptr],
                                                path_len);
@@ -1358,8 +1570,7 @@ void WASI::PathUnlinkFile(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::PollOneoff(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::PollOneoff(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t in_ptr;
   uint32_t out_ptr;
   uint32_t nsubscriptions;
@@ -1371,7 +1582,6 @@ void WASI::PollOneoff(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, out_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, nsubscriptions);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, nevents_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "poll_oneoff(%d, %d, %d, %d)\n",
              in_ptr,
@@ -1379,8 +1589,15 @@ void WASI::PollOneoff(const FunctionCallbackInfo<Value>& args) {
              nsubscriptions,
              nevents_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, in_ptr, nsubscriptions * 56);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, out_ptr, nsubscriptions * 32);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         in_ptr,
+                         static_cast<uint64_t>(nsubscriptions) *
+                             kSubscriptionSize);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         out_ptr,
+                         static_cast<uint64_t>(nsubscriptions) * kEventSize);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, nevents_ptr, 4);
 
   uvwasi_subscription_t* in =
@@ -1401,26 +1618,12 @@ void WASI::PollOneoff(const FunctionCallbackInfo<Value>& args) {
   }
 
   for (uint32_t i = 0; i < nsubscriptions; ++i) {
-    uvwasi_subscription_t sub = in[i];
-    wasi->readUInt64(memory, &sub.userdata, in_ptr);
-    wasi->readUInt8(memory, &sub.type, in_ptr + 8);
-
-    if (sub.type == UVWASI_EVENTTYPE_CLOCK) {
-      wasi->readUInt64(memory, &sub.u.clock.identifier, in_ptr + 16);
-      wasi->readUInt32(memory, &sub.u.clock.clock_id, in_ptr + 24);
-      wasi->readUInt64(memory, &sub.u.clock.timeout, in_ptr + 32);
-      wasi->readUInt64(memory, &sub.u.clock.precision, in_ptr + 40);
-      wasi->readUInt16(memory, &sub.u.clock.flags, in_ptr + 48);
-    } else if (sub.type == UVWASI_EVENTTYPE_FD_READ ||
-               sub.type == UVWASI_EVENTTYPE_FD_WRITE) {
-      wasi->readUInt32(memory, &sub.u.fd_readwrite.fd, in_ptr + 16);
-    }
-
-    in_ptr += 56;
+    ReadSubscription(memory, &in[i], in_ptr);
+    in_ptr += kSubscriptionSize;
   }
 
   size_t nevents;
-  uvwasi_errno_t err = uvwasi_poll_oneoff(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_poll_oneoff(wasi->uvw_,
                                           in,
                                           out,
                                           nsubscriptions,
@@ -1428,20 +1631,9 @@ void WASI::PollOneoff(const FunctionCallbackInfo<Value>& args) {
   if (err == UVWASI_ESUCCESS) {
     wasi->writeUInt32(memory, nevents, nevents_ptr);
 
-    for (uint32_t i = 0; i < nsubscriptions; ++i) {
-      uvwasi_event_t event = out[i];
-
-      wasi->writeUInt64(memory, event.userdata, out_ptr);
-      wasi->writeUInt16(memory, event.error, out_ptr + 8);
-      wasi->writeUInt8(memory, event.type, out_ptr + 10);
-
-      if (event.type == UVWASI_EVENTTYPE_FD_READ ||
-          event.type == UVWASI_EVENTTYPE_FD_WRITE) {
-        wasi->writeUInt64(memory, event.u.fd_readwrite.nbytes, out_ptr + 16);
-        wasi->writeUInt16(memory, event.u.fd_readwrite.flags, out_ptr + 24);
-      }
-
-      out_ptr += 32;
+    for (uint32_t i = 0; i < nevents; ++i) {
+      WriteEvent(memory, out[i], out_ptr);
+      out_ptr += kEventSize;
     }
   }
 
@@ -1451,31 +1643,30 @@ void WASI::PollOneoff(const FunctionCallbackInfo<Value>& args) {
 }
 
 
-void WASI::ProcExit(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::ProcExit(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t code;
   RETURN_IF_BAD_ARG_COUNT(args, 1);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, code);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "proc_exit(%d)\n", code);
-  args.GetReturnValue().Set(uvwasi_proc_exit(&wasi->uvw_, code));
+  wasi->FlushOutput();
+  // uvwasi_proc_exit() would terminate the whole process. Going through the
+  // Environment only stops the current thread when the guest runs in a worker,
+  // as it does for WASI instances in async mode.
+  wasi->env()->Exit(code);
 }
 
 
-void WASI::ProcRaise(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::ProcRaise(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t sig;
   RETURN_IF_BAD_ARG_COUNT(args, 1);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, sig);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "proc_raise(%d)\n", sig);
-  uvwasi_errno_t err = uvwasi_proc_raise(&wasi->uvw_, sig);
+  uvwasi_errno_t err = uvwasi_proc_raise(wasi->uvw_, sig);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::RandomGet(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::RandomGet(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t buf_ptr;
   uint32_t buf_len;
   char* memory;
@@ -1483,35 +1674,31 @@ void WASI::RandomGet(const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, buf_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, buf_len);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "random_get(%d, %d)\n", buf_ptr, buf_len);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, buf_ptr, buf_len);
-  uvwasi_errno_t err = uvwasi_random_get(&wasi->uvw_,
+  uvwasi_errno_t err = uvwasi_random_get(wasi->uvw_,
                                          &memory[buf_ptr],
                                          buf_len);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::SchedYield(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::SchedYield(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   RETURN_IF_BAD_ARG_COUNT(args, 0);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "sched_yield()\n");
-  uvwasi_errno_t err = uvwasi_sched_yield(&wasi->uvw_);
+  uvwasi_errno_t err = uvwasi_sched_yield(wasi->uvw_);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::SockRecv(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::SockRecv(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t sock;
   uint32_t ri_data_ptr;
   uint32_t ri_data_len;
   uint16_t ri_flags;
   uint32_t ro_datalen_ptr;
-  uint16_t ro_flags_ptr;
+  uint32_t ro_flags_ptr;
   char* memory;
   size_t mem_size;
   RETURN_IF_BAD_ARG_COUNT(args, 6);
@@ -1521,7 +1708,6 @@ void WASI::SockRecv(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, ri_flags);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, ro_datalen_ptr);
   CHECK_TO_TYPE_OR_RETURN(args, args[5], Uint32, ro_flags_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "sock_recv(%d, %d, %d, %d, %d, %d)\n",
              sock,
@@ -1531,56 +1717,42 @@ void WASI::SockRecv(const FunctionCallbackInfo<Value>& args) {
              ro_datalen_ptr,
              ro_flags_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, ri_data_ptr, ri_data_len * 8);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, ro_datalen_ptr, 4);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, ro_flags_ptr, 4);
-  uvwasi_iovec_t* ri_data =
-    static_cast<uvwasi_iovec_t*>(calloc(ri_data_len, sizeof(*ri_data)));
-
-  if (ri_data == nullptr) {
-    args.GetReturnValue().Set(UVWASI_ENOMEM);
+  CHECK_BOUNDS_OR_RETURN(args, mem_size, ro_flags_ptr, 2);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         ri_data_ptr,
+                         static_cast<uint64_t>(ri_data_len) * kIovecSize);
+  MaybeStackBuffer<uvwasi_iovec_t, kStackIovecCount> ri_data(ri_data_len);
+  uvwasi_errno_t err = wasi->readIovecs(memory,
+                                        mem_size,
+                                        ri_data_ptr,
+                                        ri_data_len,
+                                        *ri_data);
+  if (err != UVWASI_ESUCCESS) {
+    args.GetReturnValue().Set(err);
     return;
   }
 
-  for (uint32_t i = 0; i < ri_data_len; ++i) {
-    uint32_t buf_ptr;
-    uint32_t buf_len;
-
-    wasi->readUInt32(memory, &buf_ptr, ri_data_ptr);
-    wasi->readUInt32(memory, &buf_len, ri_data_ptr + 4);
-
-    if (is_access_oob(mem_size, buf_ptr, buf_len)) {
-      free(ri_data);
-      args.GetReturnValue().Set(UVWASI_EOVERFLOW);
-      return;
-    }
-
-    ri_data_ptr += 8;
-    ri_data[i].buf = static_cast<void*>(&memory[buf_ptr]);
-    ri_data[i].buf_len = buf_len;
-  }
-
   size_t ro_datalen;
   uvwasi_roflags_t ro_flags;
-  uvwasi_errno_t err = uvwasi_sock_recv(&wasi->uvw_,
-                                        sock,
-                                        ri_data,
-                                        ri_data_len,
-                                        ri_flags,
-                                        &ro_datalen,
-                                        &ro_flags);
+  err = uvwasi_sock_recv(wasi->uvw_,
+                         sock,
+                         *ri_data,
+                         ri_data_len,
+                         ri_flags,
+                         &ro_datalen,
+                         &ro_flags);
   if (err == UVWASI_ESUCCESS) {
     wasi->writeUInt32(memory, ro_datalen, ro_datalen_ptr);
-    wasi->writeUInt32(memory, ro_flags, ro_flags_ptr);
+    wasi->writeUInt16(memory, ro_flags, ro_flags_ptr);
   }
 
-  free(ri_data);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::SockSend(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::SockSend(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t sock;
   uint32_t si_data_ptr;
   uint32_t si_data_len;
@@ -1594,7 +1766,6 @@ void WASI::SockSend(const FunctionCallbackInfo<Value>& args) {
   CHECK_TO_TYPE_OR_RETURN(args, args[2], Uint32, si_data_len);
   CHECK_TO_TYPE_OR_RETURN(args, args[3], Uint32, si_flags);
   CHECK_TO_TYPE_OR_RETURN(args, args[4], Uint32, so_datalen_ptr);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi,
              "sock_send(%d, %d, %d, %d, %d)\n",
              sock,
@@ -1603,59 +1774,44 @@ void WASI::SockSend(const FunctionCallbackInfo<Value>& args) {
              si_flags,
              so_datalen_ptr);
   GET_BACKING_STORE_OR_RETURN(wasi, args, &memory, &mem_size);
-  CHECK_BOUNDS_OR_RETURN(args, mem_size, si_data_ptr, si_data_len * 8);
   CHECK_BOUNDS_OR_RETURN(args, mem_size, so_datalen_ptr, 4);
-  uvwasi_ciovec_t* si_data =
-    static_cast<uvwasi_ciovec_t*>(calloc(si_data_len, sizeof(*si_data)));
-
-  if (si_data == nullptr) {
-    args.GetReturnValue().Set(UVWASI_ENOMEM);
+  CHECK_BOUNDS_OR_RETURN(args,
+                         mem_size,
+                         si_data_ptr,
+                         static_cast<uint64_t>(si_data_len) * kIovecSize);
+  MaybeStackBuffer<uvwasi_ciovec_t, kStackIovecCount> si_data(si_data_len);
+  uvwasi_errno_t err = wasi->readIovecs(memory,
+                                        mem_size,
+                                        si_data_ptr,
+                                        si_data_len,
+                                        *si_data);
+  if (err != UVWASI_ESUCCESS) {
+    args.GetReturnValue().Set(err);
     return;
   }
 
-  for (uint32_t i = 0; i < si_data_len; ++i) {
-    uint32_t buf_ptr;
-    uint32_t buf_len;
-
-    wasi->readUInt32(memory, &buf_ptr, si_data_ptr);
-    wasi->readUInt32(memory, &buf_len, si_data_ptr + 4);
-
-    if (is_access_oob(mem_size, buf_ptr, buf_len)) {
-      free(si_data);
-      args.GetReturnValue().Set(UVWASI_EOVERFLOW);
-      return;
-    }
-
-    si_data_ptr += 8;
-    si_data[i].buf = static_cast<void*>(&memory[buf_ptr]);
-    si_data[i].buf_len = buf_len;
-  }
-
   size_t so_datalen;
-  uvwasi_errno_t err = uvwasi_sock_send(&wasi->uvw_,
-                                        sock,
-                                        si_data,
-                                        si_data_len,
-                                        si_flags,
-                                        &so_datalen);
+  err = uvwasi_sock_send(wasi->uvw_,
+                         sock,
+                         *si_data,
+                         si_data_len,
+                         si_flags,
+                         &so_datalen);
   if (err == UVWASI_ESUCCESS)
     wasi->writeUInt32(memory, so_datalen, so_datalen_ptr);
 
-  free(si_data);
   args.GetReturnValue().Set(err);
 }
 
 
-void WASI::SockShutdown(const FunctionCallbackInfo<Value>& args) {
-  WASI* wasi;
+void WASI::SockShutdown(WASI* wasi, const FunctionCallbackInfo<Value>& args) {
   uint32_t sock;
   uint8_t how;
   RETURN_IF_BAD_ARG_COUNT(args, 2);
   CHECK_TO_TYPE_OR_RETURN(args, args[0], Uint32, sock);
   CHECK_TO_TYPE_OR_RETURN(args, args[1], Uint32, how);
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
   WASI_DEBUG(wasi, "sock_shutdown(%d, %d)\n", sock, how);
-  uvwasi_errno_t err = uvwasi_sock_shutdown(&wasi->uvw_, sock, how);
+  uvwasi_errno_t err = uvwasi_sock_shutdown(wasi->uvw_, sock, how);
   args.GetReturnValue().Set(err);
 }
 
@@ -1664,88 +1820,253 @@ void WASI::_SetMemory(const FunctionCallbackInfo<Value>& args) {
   WASI* wasi;
   CHECK_EQ(args.Length(), 1);
   CHECK(args[0]->IsObject());
-  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.This());
+  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.Data().As<Object>());
   wasi->memory_.Reset(wasi->env()->isolate(), args[0].As<Object>());
+  wasi->memory_buffer_.Reset();
+  wasi->memory_data_ = nullptr;
+  wasi->memory_length_ = 0;
+}
+
+
+void WASI::_Reset(const FunctionCallbackInfo<Value>& args) {
+  WASI* wasi;
+  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.Data().As<Object>());
+  // The memory is replaced by the next call to start().
+  CHECK_EQ(uvwasi_embedder_reset(wasi->uvw_), UVWASI_ESUCCESS);
+}
+
+
+// Makes the context available to other threads and returns its id, which
+// is passed back to the constructor to attach to it.
+void WASI::_Share(const FunctionCallbackInfo<Value>& args) {
+  WASI* wasi;
+  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.Data().As<Object>());
+  if (wasi->shared_id_ == 0) {
+    Mutex::ScopedLock lock(shared_contexts_mutex);
+    // Drop the contexts whose instances are all gone.
+    for (auto it = shared_contexts.begin(); it != shared_contexts.end();) {
+      if (it->second.expired())
+        it = shared_contexts.erase(it);
+      else
+        ++it;
+    }
+    wasi->shared_id_ = next_shared_context_id++;
+    shared_contexts.emplace(wasi->shared_id_, wasi->context_);
+  }
+  args.GetReturnValue().Set(wasi->shared_id_);
+}
+
+
+void WASI::_FlushOutput(const FunctionCallbackInfo<Value>& args) {
+  WASI* wasi;
+  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.Data().As<Object>());
+  wasi->FlushOutput();
+}
+
+
+void WASI::_GetStats(const FunctionCallbackInfo<Value>& args) {
+  WASI* wasi;
+  ASSIGN_OR_RETURN_UNWRAP(&wasi, args.Data().As<Object>());
+  Environment* env = wasi->env();
+  Isolate* isolate = env->isolate();
+  Local<Context> context = env->context();
+  Local<Object> result = Object::New(isolate);
+
+  for (size_t i = 0; i < wasi->stats_.size(); i++) {
+    const SyscallStats& stats = wasi->stats_[i];
+    if (stats.count == 0)
+      continue;
+
+    Histogram* latency = stats.latency.get();
+    Local<Map> percentiles = Map::New(isolate);
+    latency->Percentiles([&](double key, double value) {
+      percentiles->Set(context,
+                       Number::New(isolate, key),
+                       Number::New(isolate, value)).ToLocalChecked();
+    });
+
+    Local<Object> entry = Object::New(isolate);
+    auto set = [&](const char* key, Local<Value> value) {
+      entry->Set(context, OneByteString(isolate, key), value).ToChecked();
+    };
+    set("count", Number::New(isolate, static_cast<double>(stats.count)));
+    set("min", Number::New(isolate, static_cast<double>(latency->Min())));
+    set("max", Number::New(isolate, static_cast<double>(latency->Max())));
+    set("mean", Number::New(isolate, latency->Mean()));
+    set("stddev", Number::New(isolate, latency->Stddev()));
+    set("percentiles", percentiles);
+    result->Set(context,
+                OneByteString(isolate, kSyscalls[i].name),
+                entry).ToChecked();
+  }
+
+  args.GetReturnValue().Set(result);
 }
 
 
 void WASI::readUInt8(char* memory, uint8_t* value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  CHECK_NOT_NULL(value);
-  *value = memory[offset] & 0xFF;
+  *value = ReadLE<uint8_t>(memory, offset);
 }
 
 
 void WASI::readUInt16(char* memory, uint16_t* value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  CHECK_NOT_NULL(value);
-  *value = (memory[offset] & 0xFF) |
-           ((memory[offset + 1] & 0xFF) << 8);
+  *value = ReadLE<uint16_t>(memory, offset);
 }
 
 
 void WASI::readUInt32(char* memory, uint32_t* value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  CHECK_NOT_NULL(value);
-  *value = (memory[offset] & 0xFF) |
-           ((memory[offset + 1] & 0xFF) << 8) |
-           ((memory[offset + 2] & 0xFF) << 16) |
-           ((memory[offset + 3] & 0xFF) << 24);
+  *value = ReadLE<uint32_t>(memory, offset);
 }
 
 
 void WASI::readUInt64(char* memory, uint64_t* value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  CHECK_NOT_NULL(value);
-  uint64_t low = (memory[offset] & 0xFF) |
-                 ((memory[offset + 1] & 0xFF) << 8) |
-                 ((memory[offset + 2] & 0xFF) << 16) |
-                 ((memory[offset + 3] & 0xFF) << 24);
-  uint64_t high = (memory[offset + 4] & 0xFF) |
-                  ((memory[offset + 5] & 0xFF) << 8) |
-                  ((memory[offset + 6] & 0xFF) << 16) |
-                  ((memory[offset + 7] & 0xFF) << 24);
-  *value = (high << 32) + low;
+  *value = ReadLE<uint64_t>(memory, offset);
 }
 
 
 void WASI::writeUInt8(char* memory, uint8_t value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  memory[offset] = value & 0xFF;
+  WriteLE<uint8_t>(memory, value, offset);
 }
 
 
 void WASI::writeUInt16(char* memory, uint16_t value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  memory[offset++] = value & 0xFF;
-  memory[offset] = (value >> 8) & 0xFF;
+  WriteLE<uint16_t>(memory, value, offset);
 }
 
 
 void WASI::writeUInt32(char* memory, uint32_t value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  memory[offset++] = value & 0xFF;
-  memory[offset++] = (value >> 8) & 0xFF;
-  memory[offset++] = (value >> 16) & 0xFF;
-  memory[offset] = (value >> 24) & 0xFF;
+  WriteLE<uint32_t>(memory, value, offset);
 }
 
 
 void WASI::writeUInt64(char* memory, uint64_t value, uint32_t offset) {
-  CHECK_NOT_NULL(memory);
-  memory[offset++] = value & 0xFF;
-  memory[offset++] = (value >> 8) & 0xFF;
-  memory[offset++] = (value >> 16) & 0xFF;
-  memory[offset++] = (value >> 24) & 0xFF;
-  memory[offset++] = (value >> 32) & 0xFF;
-  memory[offset++] = (value >> 40) & 0xFF;
-  memory[offset++] = (value >> 48) & 0xFF;
-  memory[offset] = (value >> 56) & 0xFF;
+  WriteLE<uint64_t>(memory, value, offset);
+}
+
+
+template <typename T>
+uvwasi_errno_t WASI::readIovecs(char* memory,
+                                size_t mem_size,
+                                uint32_t iovs_ptr,
+                                uint32_t iovs_len,
+                                T* iovs) {
+  if (is_access_oob(mem_size,
+                    iovs_ptr,
+                    static_cast<uint64_t>(iovs_len) * kIovecSize))
+    return UVWASI_EOVERFLOW;
+
+  for (uint32_t i = 0; i < iovs_len; ++i) {
+    uint32_t buf_ptr;
+    uint32_t buf_len;
+
+    readUInt32(memory, &buf_ptr, iovs_ptr);
+    readUInt32(memory, &buf_len, iovs_ptr + 4);
+
+    if (is_access_oob(mem_size, buf_ptr, buf_len))
+      return UVWASI_EOVERFLOW;
+
+    iovs_ptr += kIovecSize;
+    iovs[i].buf = static_cast<void*>(&memory[buf_ptr]);
+    iovs[i].buf_len = buf_len;
+  }
+
+  return UVWASI_ESUCCESS;
+}
+
+
+// Appends a guest write to the output buffer. Output to stdout and stderr
+// shares the buffer, and switching between them flushes it first, so that
+// the two streams stay in order. Single writes are smaller than
+// kOutputBufferSize, so the buffer never grows past twice that size. Returns
+// false if flushing threw.
+bool WASI::BufferOutput(uv_file host_fd,
+                        const uvwasi_ciovec_t* iovs,
+                        size_t iovs_len) {
+  size_t total = 0;
+  for (size_t i = 0; i < iovs_len; i++)
+    total += iovs[i].buf_len;
+
+  // Pending output for the other stream is moved into a Buffer right away,
+  // because iovs point into guest memory and must be read before any
+  // JavaScript runs.
+  Local<Object> previous;
+  const uv_file previous_fd = output_fd_;
+  if (host_fd != output_fd_ && output_length_ > 0) {
+    const bool ok = Buffer::New(env()->isolate(), output_, output_length_)
+                        .ToLocal(&previous);
+    output_ = nullptr;
+    output_length_ = output_capacity_ = 0;
+    if (!ok)
+      return false;
+  }
+
+  output_fd_ = host_fd;
+  if (output_length_ + total > output_capacity_) {
+    output_capacity_ = std::max(kOutputBufferSize, output_length_ + total);
+    output_ = Realloc(output_, output_capacity_);
+  }
+  for (size_t i = 0; i < iovs_len; i++) {
+    if (iovs[i].buf_len == 0)
+      continue;
+    memcpy(output_ + output_length_, iovs[i].buf, iovs[i].buf_len);
+    output_length_ += iovs[i].buf_len;
+  }
+
+  if (!previous.IsEmpty()) {
+    Local<Value> argv[] = { Integer::New(env()->isolate(), previous_fd),
+                            previous };
+    if (output_callback_.Get(env()->isolate())
+            ->Call(env()->context(), Undefined(env()->isolate()),
+                   arraysize(argv), argv).IsEmpty()) {
+      return false;
+    }
+  }
+
+  if (output_length_ >= kOutputBufferSize)
+    return FlushOutput();
+  return true;
+}
+
+
+// Hands the pending output to lib/wasi.js, which writes it to the matching
+// process stream. The buffer itself becomes the Buffer that is passed along.
+bool WASI::FlushOutput() {
+  if (output_length_ == 0)
+    return true;
+
+  Isolate* isolate = env()->isolate();
+  HandleScope handle_scope(isolate);
+  Local<Object> chunk;
+  const bool ok =
+      Buffer::New(isolate, output_, output_length_).ToLocal(&chunk);
+  output_ = nullptr;
+  output_length_ = output_capacity_ = 0;
+  if (!ok)
+    return false;
+
+  Local<Value> argv[] = { Integer::New(isolate, output_fd_), chunk };
+  return !output_callback_.Get(isolate)
+              ->Call(env()->context(), Undefined(isolate),
+                     arraysize(argv), argv).IsEmpty();
 }
 
 
 uvwasi_errno_t WASI::backingStore(char** store, size_t* byte_length) {
   Environment* env = this->env();
+
+  // Growing a WebAssembly.Memory detaches its current ArrayBuffer, which
+  // drops the buffer's length to zero. While the cached buffer still has the
+  // length it was cached with, the cached data pointer remains valid.
+  if (memory_data_ != nullptr) {
+    Local<ArrayBuffer> ab =
+        PersistentToLocal::Default(env->isolate(), memory_buffer_);
+    if (ab->ByteLength() == memory_length_) {
+      *byte_length = memory_length_;
+      *store = memory_data_;
+      return UVWASI_ESUCCESS;
+    }
+  }
+
   Local<Object> memory = PersistentToLocal::Default(env->isolate(),
                                                     this->memory_);
   Local<Value> prop;
@@ -1753,6 +2074,16 @@ uvwasi_errno_t WASI::backingStore(char** store, size_t* byte_length) {
   if (!memory->Get(env->context(), env->buffer_string()).ToLocal(&prop))
     return UVWASI_EINVAL;
 
+  // Growing a shared memory replaces its buffer without detaching the old
+  // one, so the buffer of a shared memory is not cached.
+  if (prop->IsSharedArrayBuffer()) {
+    SharedArrayBuffer::Contents contents =
+        prop.As<SharedArrayBuffer>()->GetContents();
+    *byte_length = contents.ByteLength();
+    *store = static_cast<char*>(contents.Data());
+    return UVWASI_ESUCCESS;
+  }
+
   if (!prop->IsArrayBuffer())
     return UVWASI_EINVAL;
 
@@ -1760,10 +2091,62 @@ uvwasi_errno_t WASI::backingStore(char** store, size_t* byte_length) {
   ArrayBuffer::Contents contents = ab->GetContents();
   *byte_length = contents.ByteLength();
   *store = static_cast<char*>(contents.Data());
+
+  // A zero length buffer is indistinguishable from a detached one, so only
+  // cache memories that have at least one page.
+  if (*byte_length > 0) {
+    memory_buffer_.Reset(env->isolate(), ab);
+    memory_data_ = *store;
+    memory_length_ = *byte_length;
+  } else {
+    memory_buffer_.Reset();
+    memory_data_ = nullptr;
+    memory_length_ = 0;
+  }
+
   return UVWASI_ESUCCESS;
 }
 
 
+// Returns the compiled code of a WebAssembly.Module for the module cache in
+// lib/wasi.js, or undefined if V8 cannot serialize it.
+static void SerializeModule(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  CHECK(args[0]->IsWebAssemblyCompiledModule());
+  v8::OwnedBuffer serialized =
+      args[0].As<WasmModuleObject>()->GetCompiledModule().Serialize();
+  if (serialized.size == 0)
+    return;
+
+  Local<Object> buffer;
+  if (Buffer::Copy(env,
+                   reinterpret_cast<const char*>(serialized.buffer.get()),
+                   serialized.size).ToLocal(&buffer)) {
+    args.GetReturnValue().Set(buffer);
+  }
+}
+
+
+// Recreates a WebAssembly.Module from SerializeModule() output and the wire
+// bytes it was compiled from. V8 compiles the wire bytes instead if the
+// serialized code does not match this V8 version, its flags or the CPU.
+static void DeserializeModule(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  CHECK(args[0]->IsArrayBufferView());
+  CHECK(args[1]->IsArrayBufferView());
+  ArrayBufferViewContents<uint8_t> serialized(args[0]);
+  ArrayBufferViewContents<uint8_t> wire_bytes(args[1]);
+
+  Local<WasmModuleObject> module;
+  if (WasmModuleObject::DeserializeOrCompile(
+          env->isolate(),
+          { serialized.data(), serialized.length() },
+          { wire_bytes.data(), wire_bytes.length() }).ToLocal(&module)) {
+    args.GetReturnValue().Set(module);
+  }
+}
+
+
 static void Initialize(Local<Object> target,
                        Local<Value> unused,
                        Local<Context> context,
@@ -1775,59 +2158,12 @@ static void Initialize(Local<Object> target,
   tmpl->InstanceTemplate()->SetInternalFieldCount(1);
   tmpl->SetClassName(wasi_wrap_string);
 
-  env->SetProtoMethod(tmpl, "args_get", WASI::ArgsGet);
-  env->SetProtoMethod(tmpl, "args_sizes_get", WASI::ArgsSizesGet);
-  env->SetProtoMethod(tmpl, "clock_res_get", WASI::ClockResGet);
-  env->SetProtoMethod(tmpl, "clock_time_get", WASI::ClockTimeGet);
-  env->SetProtoMethod(tmpl, "environ_get", WASI::EnvironGet);
-  env->SetProtoMethod(tmpl, "environ_sizes_get", WASI::EnvironSizesGet);
-  env->SetProtoMethod(tmpl, "fd_advise", WASI::FdAdvise);
-  env->SetProtoMethod(tmpl, "fd_allocate", WASI::FdAllocate);
-  env->SetProtoMethod(tmpl, "fd_close", WASI::FdClose);
-  env->SetProtoMethod(tmpl, "fd_datasync", WASI::FdDatasync);
-  env->SetProtoMethod(tmpl, "fd_fdstat_get", WASI::FdFdstatGet);
-  env->SetProtoMethod(tmpl, "fd_fdstat_set_flags", WASI::FdFdstatSetFlags);
-  env->SetProtoMethod(tmpl, "fd_fdstat_set_rights", WASI::FdFdstatSetRights);
-  env->SetProtoMethod(tmpl, "fd_filestat_get", WASI::FdFilestatGet);
-  env->SetProtoMethod(tmpl, "fd_filestat_set_size", WASI::FdFilestatSetSize);
-  env->SetProtoMethod(tmpl, "fd_filestat_set_times", WASI::FdFilestatSetTimes);
-  env->SetProtoMethod(tmpl, "fd_pread", WASI::FdPread);
-  env->SetProtoMethod(tmpl, "fd_prestat_get", WASI::FdPrestatGet);
-  env->SetProtoMethod(tmpl, "fd_prestat_dir_name", WASI::FdPrestatDirName);
-  env->SetProtoMethod(tmpl, "fd_pwrite", WASI::FdPwrite);
-  env->SetProtoMethod(tmpl, "fd_read", WASI::FdRead);
-  env->SetProtoMethod(tmpl, "fd_readdir", WASI::FdReaddir);
-  env->SetProtoMethod(tmpl, "fd_renumber", WASI::FdRenumber);
-  env->SetProtoMethod(tmpl, "fd_seek", WASI::FdSeek);
-  env->SetProtoMethod(tmpl, "fd_sync", WASI::FdSync);
-  env->SetProtoMethod(tmpl, "fd_tell", WASI::FdTell);
-  env->SetProtoMethod(tmpl, "fd_write", WASI::FdWrite);
-  env->SetProtoMethod(tmpl, "path_create_directory", WASI::PathCreateDirectory);
-  env->SetProtoMethod(tmpl, "path_filestat_get", WASI::PathFilestatGet);
-  env->SetProtoMethod(tmpl,
-                      "path_filestat_set_times",
-                      WASI::PathFilestatSetTimes);
-  env->SetProtoMethod(tmpl, "path_link", WASI::PathLink);
-  env->SetProtoMethod(tmpl, "path_open", WASI::PathOpen);
-  env->SetProtoMethod(tmpl, "path_readlink", WASI::PathReadlink);
-  env->SetProtoMethod(tmpl, "path_remove_directory", WASI::PathRemoveDirectory);
-  env->SetProtoMethod(tmpl, "path_rename", WASI::PathRename);
-  env->SetProtoMethod(tmpl, "path_symlink", WASI::PathSymlink);
-  env->SetProtoMethod(tmpl, "path_unlink_file", WASI::PathUnlinkFile);
-  env->SetProtoMethod(tmpl, "poll_oneoff", WASI::PollOneoff);
-  env->SetProtoMethod(tmpl, "proc_exit", WASI::ProcExit);
-  env->SetProtoMethod(tmpl, "proc_raise", WASI::ProcRaise);
-  env->SetProtoMethod(tmpl, "random_get", WASI::RandomGet);
-  env->SetProtoMethod(tmpl, "sched_yield", WASI::SchedYield);
-  env->SetProtoMethod(tmpl, "sock_recv", WASI::SockRecv);
-  env->SetProtoMethod(tmpl, "sock_send", WASI::SockSend);
-  env->SetProtoMethod(tmpl, "sock_shutdown", WASI::SockShutdown);
-
-  env->SetProtoMethod(tmpl, "_setMemory", WASI::_SetMemory);
-
   target->Set(env->context(),
               wasi_wrap_string,
               tmpl->GetFunction(context).ToLocalChecked()).ToChecked();
+
+  env->SetMethod(target, "serializeModule", SerializeModule);
+  env->SetMethod(target, "deserializeModule", DeserializeModule);
 }
 
 
@@ -4,8 +4,12 @@
 #if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
 
 #include "base_object.h"
+#include "histogram.h"
 #include "uvwasi.h"
 
+#include <memory>
+#include <vector>
+
 namespace node {
 namespace wasi {
 
@@ -14,68 +18,127 @@ class WASI : public BaseObject {
  public:
   WASI(Environment* env,
        v8::Local<v8::Object> object,
-       uvwasi_options_t* options);
+       std::shared_ptr<uvwasi_t> uvw,
+       bool collect_stats);
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
-  SET_NO_MEMORY_INFO()
+  void MemoryInfo(MemoryTracker* tracker) const override;
   SET_MEMORY_INFO_NAME(WASI)
   SET_SELF_SIZE(WASI)
 
-  static void ArgsGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void ArgsSizesGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void ClockResGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void ClockTimeGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void EnvironGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void EnvironSizesGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdAdvise(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdAllocate(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdClose(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdDatasync(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdFdstatGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdFdstatSetFlags(const v8::FunctionCallbackInfo<v8::Value>& args);
+  // Syscalls receive the instance that Dispatch() already unwrapped.
+  typedef void (*SyscallCallback)(
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  static void ArgsGet(WASI* wasi,
+                      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void ArgsSizesGet(WASI* wasi,
+                           const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void ClockResGet(WASI* wasi,
+                          const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void ClockTimeGet(WASI* wasi,
+                           const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void EnvironGet(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void EnvironSizesGet(WASI* wasi,
+                              const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdAdvise(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdAllocate(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdClose(WASI* wasi,
+                      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdDatasync(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdFdstatGet(WASI* wasi,
+                          const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdFdstatSetFlags(WASI* wasi,
+                               const v8::FunctionCallbackInfo<v8::Value>& args);
   static void FdFdstatSetRights(
-    const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdFilestatGet(const v8::FunctionCallbackInfo<v8::Value>& args);
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdFilestatGet(WASI* wasi,
+                            const v8::FunctionCallbackInfo<v8::Value>& args);
   static void FdFilestatSetSize(
-    const v8::FunctionCallbackInfo<v8::Value>& args);
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
   static void FdFilestatSetTimes(
-    const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdPread(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdPrestatGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdPrestatDirName(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdPwrite(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdRead(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdReaddir(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdRenumber(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdSeek(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdSync(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdTell(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void FdWrite(const v8::FunctionCallbackInfo<v8::Value>& args);
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdPread(WASI* wasi,
+                      const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdPrestatGet(WASI* wasi,
+                           const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdPrestatDirName(WASI* wasi,
+                               const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdPwrite(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdRead(WASI* wasi,
+                     const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdReaddir(WASI* wasi,
+                        const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdRenumber(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdSeek(WASI* wasi,
+                     const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdSync(WASI* wasi,
+                     const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdTell(WASI* wasi,
+                     const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void FdWrite(WASI* wasi,
+                      const v8::FunctionCallbackInfo<v8::Value>& args);
   static void PathCreateDirectory(
-    const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathFilestatGet(const v8::FunctionCallbackInfo<v8::Value>& args);
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathFilestatGet(WASI* wasi,
+                              const v8::FunctionCallbackInfo<v8::Value>& args);
   static void PathFilestatSetTimes(
-    const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathLink(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathOpen(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathReadlink(const v8::FunctionCallbackInfo<v8::Value>& args);
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathLink(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathOpen(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathReadlink(WASI* wasi,
+                           const v8::FunctionCallbackInfo<v8::Value>& args);
   static void PathRemoveDirectory(
-    const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathRename(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathSymlink(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PathUnlinkFile(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void PollOneoff(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void ProcExit(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void ProcRaise(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void RandomGet(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void SchedYield(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void SockRecv(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void SockSend(const v8::FunctionCallbackInfo<v8::Value>& args);
-  static void SockShutdown(const v8::FunctionCallbackInfo<v8::Value>& args);
+      WASI* wasi, const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathRename(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathSymlink(WASI* wasi,
+                          const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PathUnlinkFile(WASI* wasi,
+                             const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void PollOneoff(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void ProcExit(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void ProcRaise(WASI* wasi,
+                        const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void RandomGet(WASI* wasi,
+                        const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SchedYield(WASI* wasi,
+                         const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SockRecv(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SockSend(WASI* wasi,
+                       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void SockShutdown(WASI* wasi,
+                           const v8::FunctionCallbackInfo<v8::Value>& args);
 
   static void _SetMemory(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void _GetStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void _Reset(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void _FlushOutput(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void _Share(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  // Calls the syscall at kIndex in the syscall table, see node_wasi.cc.
+  template <size_t kIndex>
+  static void Dispatch(const v8::FunctionCallbackInfo<v8::Value>& args);
 
  private:
+  struct SyscallStats {
+    uint64_t count = 0;
+    // Latencies in nanoseconds, allocated on the first call.
+    std::unique_ptr<Histogram> latency;
+  };
+
   ~WASI() override;
+  void Measure(size_t index, const v8::FunctionCallbackInfo<v8::Value>& args);
   inline void readUInt8(char* memory, uint8_t* value, uint32_t offset);
   inline void readUInt16(char* memory, uint16_t* value, uint32_t offset);
   inline void readUInt32(char* memory, uint32_t* value, uint32_t offset);
@@ -84,9 +147,39 @@ class WASI : public BaseObject {
   inline void writeUInt16(char* memory, uint16_t value, uint32_t offset);
   inline void writeUInt32(char* memory, uint32_t value, uint32_t offset);
   inline void writeUInt64(char* memory, uint64_t value, uint32_t offset);
+  template <typename T>
+  inline uvwasi_errno_t readIovecs(char* memory,
+                                   size_t mem_size,
+                                   uint32_t iovs_ptr,
+                                   uint32_t iovs_len,
+                                   T* iovs);
   uvwasi_errno_t backingStore(char** store, size_t* byte_length);
-  uvwasi_t uvw_;
+  bool BufferOutput(uv_file host_fd,
+                    const uvwasi_ciovec_t* iovs,
+                    size_t iovs_len);
+  bool FlushOutput();
+  // Shared with the WASI instances on other threads that attached to it.
+  std::shared_ptr<uvwasi_t> context_;
+  uvwasi_t* uvw_;
+  // Nonzero once the context can be attached to, see _Share().
+  uint32_t shared_id_ = 0;
   v8::Persistent<v8::Object> memory_;
+  // Cached view of memory_.buffer, see backingStore().
+  v8::Persistent<v8::ArrayBuffer> memory_buffer_;
+  char* memory_data_ = nullptr;
+  size_t memory_length_ = 0;
+  // Indexed like the syscall table, and empty unless stats were requested.
+  std::vector<SyscallStats> stats_;
+  // Nonzero while the node.wasi trace category is enabled.
+  const uint8_t* trace_category_state_;
+  uint8_t stats_enabled_;
+  // Guest writes to the host's stdout and stderr, while output is buffered.
+  // The buffer is handed over to output_callback_ when it is flushed.
+  v8::Global<v8::Function> output_callback_;
+  char* output_ = nullptr;
+  size_t output_length_ = 0;
+  size_t output_capacity_ = 0;
+  uv_file output_fd_ = -1;
 };
 
 
@@ -0,0 +1,214 @@
+#ifndef SRC_NODE_WASI_MEMORY_H_
+#define SRC_NODE_WASI_MEMORY_H_
+
+#if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "uvwasi.h"
+
+namespace node {
+namespace wasi {
+
+// WebAssembly memory is always little endian. The accessors below are
+// templated on the byte order of the host so that little endian hosts compile
+// each access down to a single unaligned load or store, while big endian
+// hosts pay for a byte swap. The template parameter also lets both variants be
+// tested on any host.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool kHostIsLittleEndian = false;
+#else
+constexpr bool kHostIsLittleEndian = true;
+#endif
+
+inline uint8_t ByteSwap(uint8_t value) {
+  return value;
+}
+
+inline uint16_t ByteSwap(uint16_t value) {
+  return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+
+inline uint32_t ByteSwap(uint32_t value) {
+  return ((value & 0x000000FF) << 24) |
+         ((value & 0x0000FF00) << 8) |
+         ((value & 0x00FF0000) >> 8) |
+         ((value & 0xFF000000) >> 24);
+}
+
+inline uint64_t ByteSwap(uint64_t value) {
+  return (static_cast<uint64_t>(ByteSwap(static_cast<uint32_t>(value))) << 32) |
+         ByteSwap(static_cast<uint32_t>(value >> 32));
+}
+
+template <typename T, bool kLittleEndianHost = kHostIsLittleEndian>
+inline T ReadLE(const char* memory, uint32_t offset) {
+  static_assert(std::is_unsigned<T>::value, "T must be an unsigned integer");
+  T value;
+  memcpy(&value, memory + offset, sizeof(value));
+  return kLittleEndianHost ? value : ByteSwap(value);
+}
+
+template <typename T, bool kLittleEndianHost = kHostIsLittleEndian>
+inline void WriteLE(char* memory, T value, uint32_t offset) {
+  static_assert(std::is_unsigned<T>::value, "T must be an unsigned integer");
+  if (!kLittleEndianHost)
+    value = ByteSwap(value);
+  memcpy(memory + offset, &value, sizeof(value));
+}
+
+// Sizes of the records as laid out in guest memory.
+constexpr uint32_t kFdstatSize = 24;
+constexpr uint32_t kFilestatSize = 56;
+constexpr uint32_t kIovecSize = 8;
+constexpr uint32_t kSubscriptionSize = 56;
+constexpr uint32_t kEventSize = 32;
+
+// uvwasi's structs mirror the guest layout on common 64-bit ABIs. When they
+// do, whole records are copied with a single memcpy() on little endian hosts.
+// Otherwise, e.g. on 32-bit x86 where 64-bit members are only 4-byte aligned,
+// the records are marshalled one field at a time.
+constexpr bool kFdstatMatchesGuest =
+    sizeof(uvwasi_fdstat_t) == kFdstatSize &&
+    offsetof(uvwasi_fdstat_t, fs_filetype) == 0 &&
+    offsetof(uvwasi_fdstat_t, fs_flags) == 2 &&
+    offsetof(uvwasi_fdstat_t, fs_rights_base) == 8 &&
+    offsetof(uvwasi_fdstat_t, fs_rights_inheriting) == 16;
+
+constexpr bool kFilestatMatchesGuest =
+    sizeof(uvwasi_filestat_t) == kFilestatSize &&
+    offsetof(uvwasi_filestat_t, st_dev) == 0 &&
+    offsetof(uvwasi_filestat_t, st_ino) == 8 &&
+    offsetof(uvwasi_filestat_t, st_filetype) == 16 &&
+    offsetof(uvwasi_filestat_t, st_nlink) == 20 &&
+    offsetof(uvwasi_filestat_t, st_size) == 24 &&
+    offsetof(uvwasi_filestat_t, st_atim) == 32 &&
+    offsetof(uvwasi_filestat_t, st_mtim) == 40 &&
+    offsetof(uvwasi_filestat_t, st_ctim) == 48;
+
+constexpr bool kSubscriptionMatchesGuest =
+    sizeof(uvwasi_subscription_t) == kSubscriptionSize &&
+    offsetof(uvwasi_subscription_t, userdata) == 0 &&
+    offsetof(uvwasi_subscription_t, type) == 8 &&
+    offsetof(uvwasi_subscription_t, u.clock.identifier) == 16 &&
+    offsetof(uvwasi_subscription_t, u.clock.clock_id) == 24 &&
+    offsetof(uvwasi_subscription_t, u.clock.timeout) == 32 &&
+    offsetof(uvwasi_subscription_t, u.clock.precision) == 40 &&
+    offsetof(uvwasi_subscription_t, u.clock.flags) == 48 &&
+    offsetof(uvwasi_subscription_t, u.fd_readwrite.fd) == 16;
+
+constexpr bool kEventMatchesGuest =
+    sizeof(uvwasi_event_t) == kEventSize &&
+    offsetof(uvwasi_event_t, userdata) == 0 &&
+    offsetof(uvwasi_event_t, error) == 8 &&
+    offsetof(uvwasi_event_t, type) == 10 &&
+    offsetof(uvwasi_event_t, u.fd_readwrite.nbytes) == 16 &&
+    offsetof(uvwasi_event_t, u.fd_readwrite.flags) == 24;
+
+// The record writers also zero the padding between fields, so that no host
+// stack contents leak into guest memory through a bulk copy.
+template <bool kLittleEndianHost = kHostIsLittleEndian>
+inline void WriteFdstat(char* memory,
+                        const uvwasi_fdstat_t& stats,
+                        uint32_t offset) {
+  if (kLittleEndianHost && kFdstatMatchesGuest) {
+    memcpy(memory + offset, &stats, kFdstatSize);
+    memory[offset + 1] = 0;
+    memset(memory + offset + 4, 0, 4);
+    return;
+  }
+
+  WriteLE<uint8_t, kLittleEndianHost>(memory, stats.fs_filetype, offset);
+  WriteLE<uint8_t, kLittleEndianHost>(memory, 0, offset + 1);
+  WriteLE<uint16_t, kLittleEndianHost>(memory, stats.fs_flags, offset + 2);
+  WriteLE<uint32_t, kLittleEndianHost>(memory, 0, offset + 4);
+  WriteLE<uint64_t, kLittleEndianHost>(memory,
+                                       stats.fs_rights_base,
+                                       offset + 8);
+  WriteLE<uint64_t, kLittleEndianHost>(memory,
+                                       stats.fs_rights_inheriting,
+                                       offset + 16);
+}
+
+template <bool kLittleEndianHost = kHostIsLittleEndian>
+inline void WriteFilestat(char* memory,
+                          const uvwasi_filestat_t& stats,
+                          uint32_t offset) {
+  if (kLittleEndianHost && kFilestatMatchesGuest) {
+    memcpy(memory + offset, &stats, kFilestatSize);
+    memset(memory + offset + 17, 0, 3);
+    return;
+  }
+
+  WriteLE<uint64_t, kLittleEndianHost>(memory, stats.st_dev, offset);
+  WriteLE<uint64_t, kLittleEndianHost>(memory, stats.st_ino, offset + 8);
+  WriteLE<uint8_t, kLittleEndianHost>(memory, stats.st_filetype, offset + 16);
+  memset(memory + offset + 17, 0, 3);
+  WriteLE<uint32_t, kLittleEndianHost>(memory, stats.st_nlink, offset + 20);
+  WriteLE<uint64_t, kLittleEndianHost>(memory, stats.st_size, offset + 24);
+  WriteLE<uint64_t, kLittleEndianHost>(memory, stats.st_atim, offset + 32);
+  WriteLE<uint64_t, kLittleEndianHost>(memory, stats.st_mtim, offset + 40);
+  WriteLE<uint64_t, kLittleEndianHost>(memory, stats.st_ctim, offset + 48);
+}
+
+template <bool kLittleEndianHost = kHostIsLittleEndian>
+inline void WriteEvent(char* memory,
+                       const uvwasi_event_t& event,
+                       uint32_t offset) {
+  if (kLittleEndianHost && kEventMatchesGuest) {
+    memcpy(memory + offset, &event, kEventSize);
+    memset(memory + offset + 11, 0, 5);
+    memset(memory + offset + 26, 0, 6);
+    return;
+  }
+
+  memset(memory + offset, 0, kEventSize);
+  WriteLE<uint64_t, kLittleEndianHost>(memory, event.userdata, offset);
+  WriteLE<uint16_t, kLittleEndianHost>(memory, event.error, offset + 8);
+  WriteLE<uint8_t, kLittleEndianHost>(memory, event.type, offset + 10);
+  WriteLE<uint64_t, kLittleEndianHost>(memory,
+                                       event.u.fd_readwrite.nbytes,
+                                       offset + 16);
+  WriteLE<uint16_t, kLittleEndianHost>(memory,
+                                       event.u.fd_readwrite.flags,
+                                       offset + 24);
+}
+
+template <bool kLittleEndianHost = kHostIsLittleEndian>
+inline void ReadSubscription(const char* memory,
+                             uvwasi_subscription_t* sub,
+                             uint32_t offset) {
+  if (kLittleEndianHost && kSubscriptionMatchesGuest) {
+    memcpy(sub, memory + offset, kSubscriptionSize);
+    return;
+  }
+
+  sub->userdata = ReadLE<uint64_t, kLittleEndianHost>(memory, offset);
+  sub->type = ReadLE<uint8_t, kLittleEndianHost>(memory, offset + 8);
+
+  if (sub->type == UVWASI_EVENTTYPE_CLOCK) {
+    sub->u.clock.identifier =
+        ReadLE<uint64_t, kLittleEndianHost>(memory, offset + 16);
+    sub->u.clock.clock_id =
+        ReadLE<uint32_t, kLittleEndianHost>(memory, offset + 24);
+    sub->u.clock.timeout =
+        ReadLE<uint64_t, kLittleEndianHost>(memory, offset + 32);
+    sub->u.clock.precision =
+        ReadLE<uint64_t, kLittleEndianHost>(memory, offset + 40);
+    sub->u.clock.flags =
+        ReadLE<uint16_t, kLittleEndianHost>(memory, offset + 48);
+  } else if (sub->type == UVWASI_EVENTTYPE_FD_READ ||
+             sub->type == UVWASI_EVENTTYPE_FD_WRITE) {
+    sub->u.fd_readwrite.fd =
+        ReadLE<uint32_t, kLittleEndianHost>(memory, offset + 16);
+  }
+}
+
+}  // namespace wasi
+}  // namespace node
+
+#endif  // defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#endif  // SRC_NODE_WASI_MEMORY_H_
@@ -31,10 +31,18 @@
 #include "stream_base-inl.h"
 #include "util-inl.h"
 
+#include <openssl/kdf.h>
+
+#ifdef __linux__
+#include <netinet/in.h>  // IPPROTO_TCP
+#include <sys/socket.h>
+#endif
+
 namespace node {
 
 using crypto::SecureContext;
 using crypto::SSLWrap;
+using v8::Boolean;
 using v8::Context;
 using v8::DontDelete;
 using v8::EscapableHandleScope;
@@ -50,6 +58,137 @@ using v8::Signature;
 using v8::String;
 using v8::Value;
 
+#ifdef __linux__
+namespace {
+
+// From <linux/tcp.h> and <linux/tls.h>, which the headers of older
+// distributions do not have.
+constexpr int kTCPULP = 31;
+constexpr int kSOLTLS = 282;
+constexpr int kTLSTX = 1;
+constexpr int kTLSRX = 2;
+constexpr int kTLSSetRecordType = 1;
+constexpr int kTLSGetRecordType = 2;
+constexpr uint16_t kTLSCipherAESGCM128 = 51;
+constexpr uint16_t kTLSCipherAESGCM256 = 52;
+
+constexpr unsigned char kTLSRecordTypeAlert = 21;
+constexpr size_t kGCMSaltLength = 4;
+
+// struct tls12_crypto_info_aes_gcm_128 and _256.
+template <size_t kKeyLength>
+struct KTLSCryptoInfo {
+  uint16_t version;
+  uint16_t cipher_type;
+  unsigned char iv[8];
+  unsigned char key[kKeyLength];
+  unsigned char salt[kGCMSaltLength];
+  unsigned char rec_seq[8];
+};
+
+// Returns the kernel's cipher type for the cipher of `ssl`, or 0 if the
+// kernel can't take over the connection.
+uint16_t GetKTLSCipherType(const SSL* ssl, size_t* key_length) {
+  if (SSL_version(ssl) != TLS1_2_VERSION)
+    return 0;
+
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+  if (cipher == nullptr)
+    return 0;
+
+  switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+    case NID_aes_128_gcm:
+      *key_length = 16;
+      return kTLSCipherAESGCM128;
+    case NID_aes_256_gcm:
+      *key_length = 32;
+      return kTLSCipherAESGCM256;
+    default:
+      return 0;
+  }
+}
+
+template <size_t kKeyLength>
+bool SetKTLSCryptoInfo(int fd,
+                       int direction,
+                       uint16_t cipher_type,
+                       const unsigned char* key,
+                       const unsigned char* salt) {
+  KTLSCryptoInfo<kKeyLength> info;
+  info.version = TLS1_2_VERSION;
+  info.cipher_type = cipher_type;
+  memcpy(info.key, key, kKeyLength);
+  memcpy(info.salt, salt, kGCMSaltLength);
+  // The Finished message was the only record sent with these keys.
+  memset(info.rec_seq, 0, sizeof(info.rec_seq));
+  info.rec_seq[sizeof(info.rec_seq) - 1] = 1;
+  // The explicit part of the nonce only has to be unique, the kernel
+  // increments it along with the sequence number.
+  memcpy(info.iv, info.rec_seq, sizeof(info.iv));
+
+  int err = setsockopt(fd, kSOLTLS, direction, &info, sizeof(info));
+  OPENSSL_cleanse(&info, sizeof(info));
+  return err == 0;
+}
+
+// Derives the key block of RFC 5246, section 6.3, and installs the write key
+// and nonce salt of the client or the server in one direction of `fd`.
+// With AES-GCM, the key block holds no MAC keys, just the client and server
+// keys followed by their salts.
+bool SetKTLSKeys(SSL* ssl, int fd, bool tx) {
+  size_t key_length;
+  uint16_t cipher_type = GetKTLSCipherType(ssl, &key_length);
+  if (cipher_type == 0)
+    return false;
+
+  unsigned char master_key[SSL_MAX_MASTER_KEY_LENGTH];
+  size_t master_key_length = SSL_SESSION_get_master_key(
+      SSL_get_session(ssl), master_key, sizeof(master_key));
+
+  static const char kLabel[] = "key expansion";
+  unsigned char random[2 * SSL3_RANDOM_SIZE];
+  SSL_get_server_random(ssl, random, SSL3_RANDOM_SIZE);
+  SSL_get_client_random(ssl, random + SSL3_RANDOM_SIZE, SSL3_RANDOM_SIZE);
+
+  unsigned char key_block[2 * (32 + kGCMSaltLength)];
+  size_t key_block_length = 2 * (key_length + kGCMSaltLength);
+  const EVP_MD* md =
+      SSL_CIPHER_get_handshake_digest(SSL_get_current_cipher(ssl));
+  crypto::EVPKeyCtxPointer ctx(EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF,
+                                                   nullptr));
+  bool ok = ctx &&
+      md != nullptr &&
+      EVP_PKEY_derive_init(ctx.get()) > 0 &&
+      EVP_PKEY_CTX_set_tls1_prf_md(ctx.get(), md) > 0 &&
+      EVP_PKEY_CTX_set1_tls1_prf_secret(
+          ctx.get(), master_key, master_key_length) > 0 &&
+      EVP_PKEY_CTX_add1_tls1_prf_seed(
+          ctx.get(), kLabel, sizeof(kLabel) - 1) > 0 &&
+      EVP_PKEY_CTX_add1_tls1_prf_seed(ctx.get(), random, sizeof(random)) > 0 &&
+      EVP_PKEY_derive(ctx.get(), key_block, &key_block_length) > 0;
+  OPENSSL_cleanse(master_key, sizeof(master_key));
+
+  if (ok) {
+    // The client writes with the first key and salt, the server with the
+    // second.
+    size_t index = (SSL_is_server(ssl) != 0) == tx ? 1 : 0;
+    const unsigned char* key = key_block + index * key_length;
+    const unsigned char* salt =
+        key_block + 2 * key_length + index * kGCMSaltLength;
+    int direction = tx ? kTLSTX : kTLSRX;
+    if (key_length == 16)
+      ok = SetKTLSCryptoInfo<16>(fd, direction, cipher_type, key, salt);
+    else
+      ok = SetKTLSCryptoInfo<32>(fd, direction, cipher_type, key, salt);
+  }
+
+  OPENSSL_cleanse(key_block, sizeof(key_block));
+  return ok;
+}
+
+}  // anonymous namespace
+#endif  // __linux__
+
 TLSWrap::TLSWrap(Environment* env,
                  Local<Object> obj,
                  Kind kind,
@@ -225,6 +364,14 @@ void TLSWrap::Start(const FunctionCallbackInfo<Value>& args) {
 
 
 void TLSWrap::SSLInfoCallback(const SSL* ssl_, int where, int ret) {
+  if ((where & SSL_CB_WRITE_ALERT) == SSL_CB_WRITE_ALERT) {
+    TLSWrap* c = static_cast<TLSWrap*>(SSL_get_app_data(ssl_));
+    // `ret` is the alert level and description, EncOut() sends it.
+    if (c->ktls_tx_)
+      c->ktls_alert_ = ret;
+    return;
+  }
+
   if (!(where & (SSL_CB_HANDSHAKE_START | SSL_CB_HANDSHAKE_DONE)))
     return;
 
@@ -259,6 +406,19 @@ void TLSWrap::SSLInfoCallback(const SSL* ssl_, int where, int ret) {
 
     c->established_ = true;
 
+    if (c->ktls_requested_) {
+      // The kernel would need the keys of the new session.
+      SSL_set_options(ssl, SSL_OP_NO_RENEGOTIATION);
+      // Records that OpenSSL has buffered already can't be handed over to
+      // the kernel. The write direction waits for EncOut() to flush the
+      // handshake.
+      if (!c->ktls_rx_ &&
+          BIO_pending(c->enc_in_) == 0 &&
+          !SSL_has_pending(ssl)) {
+        c->ktls_rx_ = c->StartKTLS(false);
+      }
+    }
+
     if (object->Get(env->context(), env->onhandshakedone_string())
           .ToLocal(&callback) && callback->IsFunction()) {
       c->MakeCallback(callback.As<Function>(), 0, nullptr);
@@ -299,6 +459,31 @@ void TLSWrap::EncOut() {
     return;
   }
 
+  // Once the handshake is flushed, and before OpenSSL encrypts any
+  // application data, decide whether the kernel takes over. ClearIn() holds
+  // on to the clear text written in the meantime.
+  if (ktls_requested_ &&
+      established_ &&
+      current_empty_write_ == nullptr &&
+      BIO_pending(enc_out_) == 0) {
+    ktls_requested_ = false;
+    ktls_tx_ = StartKTLS(true);
+    ClearIn();
+    if (write_size_ != 0) {
+      Debug(this, "Returning from EncOut(), kernel TLS write in progress");
+      return;
+    }
+  }
+
+  // OpenSSL lost track of the write sequence when the kernel took over, so
+  // anything it encrypted since can't be sent. That is only ever an alert.
+  if (ktls_tx_) {
+    size_t pending = BIO_pending(enc_out_);
+    if (pending != 0)
+      crypto::NodeBIO::FromBIO(enc_out_)->Read(nullptr, pending);
+    SendKTLSAlert();
+  }
+
   // No encrypted output ready to write to the underlying stream.
   if (BIO_pending(enc_out_) == 0) {
     Debug(this, "No pending encrypted output");
@@ -384,7 +569,12 @@ void TLSWrap::OnStreamAfterWrite(WriteWrap* req_wrap, int status) {
   }
 
   // Commit
-  crypto::NodeBIO::FromBIO(enc_out_)->Read(nullptr, write_size_);
+  if (ktls_tx_) {
+    // The clear text that ClearIn() held on to has been written.
+    pending_cleartext_input_.clear();
+  } else {
+    crypto::NodeBIO::FromBIO(enc_out_)->Read(nullptr, write_size_);
+  }
 
   // Ensure that the progress will be made and `InvokeQueued` will be called.
   ClearIn();
@@ -495,6 +685,11 @@ void TLSWrap::ClearOut() {
     return;
   }
 
+  if (ktls_rx_) {
+    Debug(this, "Returning from ClearOut(), kernel TLS decrypts");
+    return;
+  }
+
   crypto::MarkPopErrorOnReturn mark_pop_error_on_return;
 
   char out[kClearOutChunkSize];
@@ -578,6 +773,29 @@ void TLSWrap::ClearIn() {
     return;
   }
 
+  if (ktls_requested_ && established_) {
+    Debug(this, "Returning from ClearIn(), kernel TLS undecided");
+    return;
+  }
+
+  if (ktls_tx_) {
+    // The buffer is released once the write has finished.
+    if (write_size_ != 0) {
+      Debug(this, "Returning from ClearIn(), write currently in progress");
+      return;
+    }
+    uv_buf_t buf = uv_buf_init(pending_cleartext_input_.data(),
+                               pending_cleartext_input_.size());
+    int err = WriteKTLS(&buf, 1);
+    if (err != 0) {
+      Debug(this, "Got error %d from the underlying stream", err);
+      pending_cleartext_input_.clear();
+      write_callback_scheduled_ = true;
+      InvokeQueued(err);
+    }
+    return;
+  }
+
   AllocatedBuffer data = std::move(pending_cleartext_input_);
   crypto::MarkPopErrorOnReturn mark_pop_error_on_return;
 
@@ -613,6 +831,154 @@ void TLSWrap::ClearIn() {
 }
 
 
+bool TLSWrap::StartKTLS(bool tx) {
+#ifdef __linux__
+  size_t key_length;
+  if (GetKTLSCipherType(ssl_.get(), &key_length) == 0) {
+    Debug(this, "Kernel TLS does not support the negotiated cipher");
+    return false;
+  }
+
+  // The file descriptor of anything but a TCP socket, including another
+  // TLSWrap, is not where the records go.
+  if (underlying_stream()->GetAsyncWrap()->provider_type() !=
+      AsyncWrap::PROVIDER_TCPWRAP) {
+    Debug(this, "Kernel TLS needs a TCP socket");
+    return false;
+  }
+
+  int fd = underlying_stream()->GetFD();
+  if (fd < 0)
+    return false;
+
+  // Fails with ENOENT if the tls module is not available.
+  if (!ktls_ulp_) {
+    if (setsockopt(fd, IPPROTO_TCP, kTCPULP, "tls", sizeof("tls")) != 0) {
+      Debug(this, "Kernel TLS is not available (%d)", errno);
+      return false;
+    }
+    ktls_ulp_ = true;
+  }
+
+  if (!SetKTLSKeys(ssl_.get(), fd, tx)) {
+    Debug(this, "Kernel TLS refused the %s keys", tx ? "write" : "read");
+    return false;
+  }
+
+  Debug(this, "Kernel TLS %s enabled", tx ? "write" : "read");
+  return true;
+#else
+  return false;
+#endif  // __linux__
+}
+
+
+int TLSWrap::WriteKTLS(uv_buf_t* bufs, size_t count) {
+  size_t length = 0;
+  for (size_t i = 0; i < count; i++)
+    length += bufs[i].len;
+
+  Debug(this, "Writing %zu bytes of clear text to the underlying stream",
+        length);
+  StreamWriteResult res = underlying_stream()->Write(bufs, count);
+  if (res.err != 0)
+    return res.err;
+
+  write_size_ = length;
+  if (!res.async) {
+    Debug(this, "Write finished synchronously");
+    // Simulate asynchronous finishing, like EncOut() does.
+    env()->SetImmediate([this](Environment* env) {
+      OnStreamAfterWrite(nullptr, 0);
+    }, object());
+  }
+  return 0;
+}
+
+
+void TLSWrap::SendKTLSAlert() {
+#ifdef __linux__
+  if (ktls_alert_ == -1)
+    return;
+
+  unsigned char alert[] = {
+    static_cast<unsigned char>(ktls_alert_ >> 8),  // Level
+    static_cast<unsigned char>(ktls_alert_ & 0xff)  // Description
+  };
+  ktls_alert_ = -1;
+
+  union {
+    char buf[CMSG_SPACE(sizeof(kTLSRecordTypeAlert))];
+    struct cmsghdr align;
+  } control;
+  memset(&control, 0, sizeof(control));
+
+  struct iovec iov = { alert, sizeof(alert) };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = kSOLTLS;
+  cmsg->cmsg_type = kTLSSetRecordType;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(kTLSRecordTypeAlert));
+  *CMSG_DATA(cmsg) = kTLSRecordTypeAlert;
+
+  // Alerts are best effort, like when OpenSSL sends them, the socket may
+  // already be full or shut down.
+  ssize_t n;
+  do {
+    n = sendmsg(underlying_stream()->GetFD(), &msg, MSG_NOSIGNAL);
+  } while (n == -1 && errno == EINTR);
+  Debug(this, "Sent alert %d through kernel TLS, result %zd", alert[1], n);
+#endif  // __linux__
+}
+
+
+int TLSWrap::ReadKTLSControlRecord() {
+#ifdef __linux__
+  // A control record is at the head of the socket, which read() refuses to
+  // return. Only a close_notify alert is expected, which is an orderly EOF.
+  unsigned char data[2];
+  union {
+    char buf[CMSG_SPACE(sizeof(kTLSRecordTypeAlert))];
+    struct cmsghdr align;
+  } control;
+
+  struct iovec iov = { data, sizeof(data) };
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  ssize_t n;
+  do {
+    n = recvmsg(underlying_stream()->GetFD(), &msg, 0);
+  } while (n == -1 && errno == EINTR);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (n != sizeof(data) ||
+      cmsg == nullptr ||
+      cmsg->cmsg_level != kSOLTLS ||
+      cmsg->cmsg_type != kTLSGetRecordType ||
+      *CMSG_DATA(cmsg) != kTLSRecordTypeAlert) {
+    Debug(this, "Unexpected record through kernel TLS");
+    return UV_EPROTO;
+  }
+
+  Debug(this, "Received alert %d through kernel TLS", data[1]);
+  return data[1] == SSL3_AD_CLOSE_NOTIFY ? UV_EOF : UV_EPROTO;
+#else
+  return UV_EPROTO;
+#endif  // __linux__
+}
+
+
 std::string TLSWrap::diagnostic_name() const {
   std::string name = "TLSWrap ";
   if (is_server())
@@ -678,6 +1044,21 @@ void TLSWrap::ClearError() {
 }
 
 
+// With kernel TLS, clear text can be written synchronously like on any other
+// socket, as long as no write is queued ahead of it.
+int TLSWrap::DoTryWrite(uv_buf_t** bufs, size_t* count) {
+  if (!ktls_tx_ ||
+      ssl_ == nullptr ||
+      write_size_ != 0 ||
+      current_write_ != nullptr ||
+      current_empty_write_ != nullptr) {
+    return 0;
+  }
+
+  return underlying_stream()->DoTryWrite(bufs, count);
+}
+
+
 // Called by StreamBase::Write() to request async write of clear text into SSL.
 // TODO(@sam-github) Should there be a TLSWrap::DoTryWrite()?
 int TLSWrap::DoWrite(WriteWrap* w,
@@ -693,6 +1074,15 @@ int TLSWrap::DoWrite(WriteWrap* w,
     return UV_EPROTO;
   }
 
+  if (ktls_tx_) {
+    CHECK_NULL(current_write_);
+    current_write_ = w;
+    int err = WriteKTLS(bufs, count);
+    if (err != 0)
+      current_write_ = nullptr;
+    return err;
+  }
+
   size_t length = 0;
   size_t i;
   for (i = 0; i < count; i++)
@@ -737,6 +1127,27 @@ int TLSWrap::DoWrite(WriteWrap* w,
   }
 
   AllocatedBuffer data;
+
+  // Until EncOut() has decided whether the kernel encrypts, the data waits
+  // for ClearIn().
+  if (ktls_requested_ && established_) {
+    Debug(this, "Saving data until kernel TLS is decided");
+    data = env()->AllocateManaged(length);
+    size_t offset = 0;
+    for (i = 0; i < count; i++) {
+      memcpy(data.data() + offset, bufs[i].base, bufs[i].len);
+      offset += bufs[i].len;
+    }
+    CHECK_EQ(pending_cleartext_input_.size(), 0);
+    pending_cleartext_input_ = std::move(data);
+
+    // Whatever ClearIn() ends up doing, Done() must not be called from here.
+    env()->SetImmediate([this](Environment* env) {
+      EncOut();
+    }, object());
+    return 0;
+  }
+
   crypto::MarkPopErrorOnReturn mark_pop_error_on_return;
 
   int written = 0;
@@ -790,6 +1201,10 @@ int TLSWrap::DoWrite(WriteWrap* w,
 uv_buf_t TLSWrap::OnStreamAlloc(size_t suggested_size) {
   CHECK_NOT_NULL(ssl_);
 
+  // The kernel decrypts, read straight into the buffer of the listener.
+  if (ktls_rx_)
+    return EmitAlloc(suggested_size);
+
   size_t size = suggested_size;
   char* base = crypto::NodeBIO::FromBIO(enc_in_)->PeekWritable(&size);
   return uv_buf_init(base, size);
@@ -798,6 +1213,18 @@ uv_buf_t TLSWrap::OnStreamAlloc(size_t suggested_size) {
 
 void TLSWrap::OnStreamRead(ssize_t nread, const uv_buf_t& buf) {
   Debug(this, "Read %zd bytes from underlying stream", nread);
+  if (ktls_rx_) {
+    if (nread == UV_EIO)
+      nread = ReadKTLSControlRecord();
+    if (nread == UV_EOF) {
+      if (eof_)
+        return;
+      eof_ = true;
+    }
+    EmitRead(nread, buf);
+    return;
+  }
+
   if (nread < 0)  {
     // Error should be emitted only after all data was read
     ClearOut();
@@ -951,6 +1378,28 @@ void TLSWrap::EnableTrace(
 #endif
 }
 
+void TLSWrap::EnableKTLS(const FunctionCallbackInfo<Value>& args) {
+  TLSWrap* wrap;
+  ASSIGN_OR_RETURN_UNWRAP(&wrap, args.Holder());
+  CHECK(!wrap->established_);
+  wrap->ktls_requested_ = true;
+}
+
+void TLSWrap::GetKTLS(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  TLSWrap* wrap;
+  ASSIGN_OR_RETURN_UNWRAP(&wrap, args.Holder());
+
+  Local<Object> info = Object::New(env->isolate());
+  info->Set(env->context(),
+            FIXED_ONE_BYTE_STRING(env->isolate(), "tx"),
+            Boolean::New(env->isolate(), wrap->ktls_tx_)).Check();
+  info->Set(env->context(),
+            FIXED_ONE_BYTE_STRING(env->isolate(), "rx"),
+            Boolean::New(env->isolate(), wrap->ktls_rx_)).Check();
+  args.GetReturnValue().Set(info);
+}
+
 void TLSWrap::DestroySSL(const FunctionCallbackInfo<Value>& args) {
   TLSWrap* wrap;
   ASSIGN_OR_RETURN_UNWRAP(&wrap, args.Holder());
@@ -1132,6 +1581,8 @@ void TLSWrap::Initialize(Local<Object> target,
   env->SetProtoMethod(t, "enableSessionCallbacks", EnableSessionCallbacks);
   env->SetProtoMethod(t, "enableKeylogCallback", EnableKeylogCallback);
   env->SetProtoMethod(t, "enableTrace", EnableTrace);
+  env->SetProtoMethod(t, "enableKTLS", EnableKTLS);
+  env->SetProtoMethod(t, "getKTLS", GetKTLS);
   env->SetProtoMethod(t, "destroySSL", DestroySSL);
   env->SetProtoMethod(t, "enableCertCb", EnableCertCb);
 
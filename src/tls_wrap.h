@@ -70,6 +70,7 @@ class TLSWrap : public AsyncWrap,
   int ReadStart() override;  // Exposed to JS
   int ReadStop() override;   // Exposed to JS
   int DoShutdown(ShutdownWrap* req_wrap) override;
+  int DoTryWrite(uv_buf_t** bufs, size_t* count) override;
   int DoWrite(WriteWrap* w,
               uv_buf_t* bufs,
               size_t count,
@@ -126,6 +127,15 @@ class TLSWrap : public AsyncWrap,
   void ClearIn();  // SSL_write() clear data "in" to SSL.
   void ClearOut();  // SSL_read() clear text "out" from SSL.
 
+  // Kernel TLS: once the handshake is done, the kernel can encrypt ("tx")
+  // and decrypt ("rx") the records on the socket, and clear text is written
+  // to and read from the underlying stream directly. Only TLS 1.2 with
+  // AES-GCM is supported, anything else stays with OpenSSL.
+  bool StartKTLS(bool tx);  // Install the keys of one direction.
+  int WriteKTLS(uv_buf_t* bufs, size_t count);  // Clear data to the socket.
+  void SendKTLSAlert();  // Send the alert OpenSSL tried to send.
+  int ReadKTLSControlRecord();  // Read a non-application data record.
+
   // Call Done() on outstanding WriteWrap request.
   bool InvokeQueued(int status, const char* error_str = nullptr);
 
@@ -164,6 +174,8 @@ class TLSWrap : public AsyncWrap,
       const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableTrace(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableCertCb(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void EnableKTLS(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetKTLS(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void DestroySSL(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void GetServername(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetServername(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -183,6 +195,13 @@ class TLSWrap : public AsyncWrap,
   bool started_ = false;
   bool established_ = false;
   bool shutdown_ = false;
+  // Kernel TLS was asked for, and the write direction is still undecided.
+  bool ktls_requested_ = false;
+  bool ktls_ulp_ = false;
+  bool ktls_tx_ = false;
+  bool ktls_rx_ = false;
+  // Alert that OpenSSL wrote while the kernel encrypts, see SendKTLSAlert().
+  int ktls_alert_ = -1;
   std::string error_;
   int cycle_depth_ = 0;
 
@@ -51,6 +51,12 @@ class SendWrap : public ReqWrap<uv_udp_send_t> {
   SendWrap(Environment* env, Local<Object> req_wrap_obj, bool have_callback);
   inline bool have_callback() const;
   size_t msg_size;
+  // A batch of datagrams is sent with one request per datagram. The first is
+  // the request of this ReqWrap, the others are in `batch_reqs`. The callback
+  // runs once all of them have finished, with the first error, if any.
+  std::unique_ptr<uv_udp_send_t[]> batch_reqs;
+  size_t pending_reqs = 1;
+  int status = 0;
 
   SET_NO_MEMORY_INFO()
   SET_MEMORY_INFO_NAME(SendWrap)
@@ -74,16 +80,23 @@ inline bool SendWrap::have_callback() const {
 }
 
 
-UDPWrap::UDPWrap(Environment* env, Local<Object> object)
+UDPWrap::UDPWrap(Environment* env, Local<Object> object, unsigned int flags)
     : HandleWrap(env,
                  object,
                  reinterpret_cast<uv_handle_t*>(&handle_),
                  AsyncWrap::PROVIDER_UDPWRAP) {
-  int r = uv_udp_init(env->event_loop(), &handle_);
+  CHECK_EQ(flags & ~UV_UDP_RECVMMSG, 0);
+  int r = uv_udp_init_ex(env->event_loop(), &handle_, AF_UNSPEC | flags);
   CHECK_EQ(r, 0);  // can't fail anyway
 }
 
 
+bool UDPWrap::InRecvBatchBuffer(const char* data) const {
+  const char* start = recv_batch_buffer_.get();
+  return start != nullptr && data >= start && data < start + kRecvBatchSize;
+}
+
+
 void UDPWrap::Initialize(Local<Object> target,
                          Local<Value> unused,
                          Local<Context> context,
@@ -119,6 +132,8 @@ void UDPWrap::Initialize(Local<Object> target,
   env->SetProtoMethod(t, "bind6", Bind6);
   env->SetProtoMethod(t, "connect6", Connect6);
   env->SetProtoMethod(t, "send6", Send6);
+  env->SetProtoMethod(t, "sendBatch", SendBatch);
+  env->SetProtoMethod(t, "sendBatch6", SendBatch6);
   env->SetProtoMethod(t, "disconnect", Disconnect);
   env->SetProtoMethod(t, "recvStart", RecvStart);
   env->SetProtoMethod(t, "recvStop", RecvStop);
@@ -160,6 +175,7 @@ void UDPWrap::Initialize(Local<Object> target,
 
   Local<Object> constants = Object::New(env->isolate());
   NODE_DEFINE_CONSTANT(constants, UV_UDP_IPV6ONLY);
+  NODE_DEFINE_CONSTANT(constants, UV_UDP_RECVMMSG);
   target->Set(context,
               env->constants_string(),
               constants).Check();
@@ -169,7 +185,11 @@ void UDPWrap::Initialize(Local<Object> target,
 void UDPWrap::New(const FunctionCallbackInfo<Value>& args) {
   CHECK(args.IsConstructCall());
   Environment* env = Environment::GetCurrent(args);
-  new UDPWrap(env, args.This());
+  // new UDP([flags])
+  unsigned int flags = 0;
+  if (args[0]->IsUint32())
+    flags = args[0].As<Uint32>()->Value();
+  new UDPWrap(env, args.This(), flags);
 }
 
 
@@ -552,6 +572,151 @@ void UDPWrap::Send6(const FunctionCallbackInfo<Value>& args) {
 }
 
 
+// Like DoSend(), but each element of the list is the list of chunks of one
+// datagram. As many datagrams as possible are sent right away with
+// uv_udp_try_send2(), which uses sendmmsg() where available, and the rest are
+// queued, from where libuv sends them in batches as well.
+void UDPWrap::DoSendBatch(const FunctionCallbackInfo<Value>& args,
+                          int family) {
+  Environment* env = Environment::GetCurrent(args);
+
+  UDPWrap* wrap;
+  ASSIGN_OR_RETURN_UNWRAP(&wrap,
+                          args.Holder(),
+                          args.GetReturnValue().Set(UV_EBADF));
+
+  CHECK(args.Length() == 4 || args.Length() == 6);
+  CHECK(args[0]->IsObject());
+  CHECK(args[1]->IsArray());
+  CHECK(args[2]->IsUint32());
+
+  bool sendto = args.Length() == 6;
+  if (sendto) {
+    // sendBatch(req, lists, lists.length, port, address, hasCallback)
+    CHECK(args[3]->IsUint32());
+    CHECK(args[4]->IsString());
+    CHECK(args[5]->IsBoolean());
+  } else {
+    // sendBatch(req, lists, lists.length, hasCallback)
+    CHECK(args[3]->IsBoolean());
+  }
+
+  Local<Object> req_wrap_obj = args[0].As<Object>();
+  Local<Array> lists = args[1].As<Array>();
+  size_t count = args[2].As<Uint32>()->Value();
+  const bool have_callback = sendto ? args[5]->IsTrue() : args[3]->IsTrue();
+  CHECK_GT(count, 0);
+
+  // The chunks of all datagrams are in one array, `bufs[i]` points to the
+  // first chunk of the i-th datagram.
+  MaybeStackBuffer<unsigned int, 16> nbufs(count);
+  size_t total_chunks = 0;
+  for (size_t i = 0; i < count; i++) {
+    Local<Value> list = lists->Get(env->context(), i).ToLocalChecked();
+    CHECK(list->IsArray());
+    nbufs[i] = list.As<Array>()->Length();
+    CHECK_GT(nbufs[i], 0);
+    total_chunks += nbufs[i];
+  }
+
+  MaybeStackBuffer<uv_buf_t, 64> chunks(total_chunks);
+  MaybeStackBuffer<uv_buf_t*, 16> bufs(count);
+  size_t msg_size = 0;
+  size_t chunk = 0;
+  for (size_t i = 0; i < count; i++) {
+    Local<Array> list =
+        lists->Get(env->context(), i).ToLocalChecked().As<Array>();
+    bufs[i] = &chunks[chunk];
+    for (size_t j = 0; j < nbufs[i]; j++) {
+      Local<Value> buffer = list->Get(env->context(), j).ToLocalChecked();
+      size_t length = Buffer::Length(buffer);
+      chunks[chunk++] = uv_buf_init(Buffer::Data(buffer), length);
+      msg_size += length;
+    }
+  }
+
+  int err = 0;
+  struct sockaddr_storage addr_storage;
+  sockaddr* addr = nullptr;
+  if (sendto) {
+    const unsigned short port = args[3].As<Uint32>()->Value();
+    node::Utf8Value address(env->isolate(), args[4]);
+    err = sockaddr_for_family(family, address.out(), port, &addr_storage);
+    if (err == 0) {
+      addr = reinterpret_cast<sockaddr*>(&addr_storage);
+    }
+  }
+
+  size_t sent = 0;
+  if (err == 0 && !UNLIKELY(env->options()->test_udp_no_try_send)) {
+    MaybeStackBuffer<sockaddr*, 16> addrs(count);
+    for (size_t i = 0; i < count; i++)
+      addrs[i] = addr;
+    err = uv_udp_try_send2(&wrap->handle_, count, *bufs, *nbufs, *addrs, 0);
+    if (err == UV_ENOSYS || err == UV_EAGAIN) {
+      err = 0;
+    } else if (err >= 0) {
+      sent = err;
+      err = 0;
+      if (sent == count) {
+        // + 1 so that the JS side can distinguish 0-length async sends from
+        // 0-length sync sends.
+        args.GetReturnValue().Set(static_cast<uint32_t>(msg_size) + 1);
+        return;
+      }
+    }
+  }
+
+  if (err == 0) {
+    AsyncHooks::DefaultTriggerAsyncIdScope trigger_scope(wrap);
+    SendWrap* req_wrap = new SendWrap(env, req_wrap_obj, have_callback);
+    req_wrap->msg_size = msg_size;
+    req_wrap->pending_reqs = count - sent;
+
+    err = req_wrap->Dispatch(uv_udp_send,
+                             &wrap->handle_,
+                             bufs[sent],
+                             nbufs[sent],
+                             addr,
+                             OnSend);
+    if (err) {
+      delete req_wrap;
+    } else if (count - sent > 1) {
+      size_t extra = count - sent - 1;
+      req_wrap->batch_reqs.reset(new uv_udp_send_t[extra]);
+      for (size_t i = 0; i < extra; i++) {
+        uv_udp_send_t* req = &req_wrap->batch_reqs[i];
+        req->data = req_wrap;
+        int r = uv_udp_send(req,
+                            &wrap->handle_,
+                            bufs[sent + 1 + i],
+                            nbufs[sent + 1 + i],
+                            addr,
+                            OnSend);
+        if (r != 0) {
+          // The datagrams that were queued still finish the request.
+          req_wrap->status = r;
+          req_wrap->pending_reqs -= extra - i;
+          break;
+        }
+      }
+    }
+  }
+
+  args.GetReturnValue().Set(err);
+}
+
+
+void UDPWrap::SendBatch(const FunctionCallbackInfo<Value>& args) {
+  DoSendBatch(args, AF_INET);
+}
+
+
+void UDPWrap::SendBatch6(const FunctionCallbackInfo<Value>& args) {
+  DoSendBatch(args, AF_INET6);
+}
+
+
 void UDPWrap::RecvStart(const FunctionCallbackInfo<Value>& args) {
   UDPWrap* wrap;
   ASSIGN_OR_RETURN_UNWRAP(&wrap,
@@ -576,7 +741,14 @@ void UDPWrap::RecvStop(const FunctionCallbackInfo<Value>& args) {
 
 
 void UDPWrap::OnSend(uv_udp_send_t* req, int status) {
-  std::unique_ptr<SendWrap> req_wrap{static_cast<SendWrap*>(req->data)};
+  SendWrap* send_wrap = static_cast<SendWrap*>(req->data);
+  if (send_wrap->status == 0)
+    send_wrap->status = status;
+  if (--send_wrap->pending_reqs > 0)
+    return;
+
+  std::unique_ptr<SendWrap> req_wrap{send_wrap};
+  status = req_wrap->status;
   if (req_wrap->have_callback()) {
     Environment* env = req_wrap->env();
     HandleScope handle_scope(env->isolate());
@@ -594,6 +766,12 @@ void UDPWrap::OnAlloc(uv_handle_t* handle,
                       size_t suggested_size,
                       uv_buf_t* buf) {
   UDPWrap* wrap = static_cast<UDPWrap*>(handle->data);
+  if (uv_udp_using_recvmmsg(&wrap->handle_)) {
+    if (!wrap->recv_batch_buffer_)
+      wrap->recv_batch_buffer_.reset(new char[kRecvBatchSize]);
+    *buf = uv_buf_init(wrap->recv_batch_buffer_.get(), kRecvBatchSize);
+    return;
+  }
   *buf = wrap->env()->AllocateManaged(suggested_size).release();
 }
 
@@ -605,7 +783,11 @@ void UDPWrap::OnRecv(uv_udp_t* handle,
   UDPWrap* wrap = static_cast<UDPWrap*>(handle->data);
   Environment* env = wrap->env();
 
-  AllocatedBuffer buf(env, *buf_);
+  // The batch buffer is reused, so datagrams in it are copied out.
+  const bool batched = wrap->InRecvBatchBuffer(buf_->base);
+  AllocatedBuffer buf(env);
+  if (!batched)
+    buf = AllocatedBuffer(env, *buf_);
   if (nread == 0 && addr == nullptr) {
     return;
   }
@@ -626,8 +808,12 @@ void UDPWrap::OnRecv(uv_udp_t* handle,
     return;
   }
 
-  buf.Resize(nread);
-  argv[2] = buf.ToBuffer().ToLocalChecked();
+  if (batched) {
+    argv[2] = Buffer::Copy(env, buf_->base, nread).ToLocalChecked();
+  } else {
+    buf.Resize(nread);
+    argv[2] = buf.ToBuffer().ToLocalChecked();
+  }
   argv[3] = AddressToJS(env, addr);
   wrap->MakeCallback(env->onmessage_string(), arraysize(argv), argv);
 }
@@ -0,0 +1,26 @@
+'use strict';
+
+require('../common');
+
+const runBenchmark = require('../common/benchmark');
+
+runBenchmark('wasi',
+             [
+               'backend=memory',
+               'bufferSize=4096',
+               'depth=1',
+               'entries=1000',
+               'fileSize=1024',
+               'files=1',
+               'iovs=1',
+               'method=fd_pwrite',
+               'mode=reset',
+               'n=1',
+               'phase=construct',
+               'preopens=1',
+               'size=1024',
+               'stats=0',
+               'syscall=clock_time_get',
+               'threads=1'
+             ],
+             { NODEJS_BENCHMARK_ZERO_ALLOWED: 1 });
@@ -0,0 +1,197 @@
+#include "node_wasi_memory.h"
+#include "gtest/gtest.h"
+
+using node::wasi::ByteSwap;
+using node::wasi::kHostIsLittleEndian;
+using node::wasi::ReadLE;
+using node::wasi::ReadSubscription;
+using node::wasi::WriteEvent;
+using node::wasi::WriteFdstat;
+using node::wasi::WriteFilestat;
+using node::wasi::WriteLE;
+
+namespace {
+
+const char kBytes[] = {
+  0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, static_cast<char>(0x88)
+};
+
+// The reference decoder used by the tests. Guest memory is little endian.
+uint64_t Decode(const char* memory, uint32_t offset, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= static_cast<uint64_t>(
+        static_cast<uint8_t>(memory[offset + i])) << (8 * i);
+  }
+  return value;
+}
+
+// Instantiating the accessors for the byte order that the host does not have
+// swaps every value. The uvwasi structs hold values in host byte order, so the
+// record helpers then store each field byte swapped. That still lets the
+// layout and padding handling of both code paths be checked on any host.
+template <typename T>
+T Expected(T value, bool swapped) {
+  return swapped ? ByteSwap(value) : value;
+}
+
+template <bool kLittleEndianHost>
+void TestScalars() {
+  const bool swapped = kLittleEndianHost != kHostIsLittleEndian;
+  uint8_t u8 = ReadLE<uint8_t, kLittleEndianHost>(kBytes, 7);
+  uint16_t u16 = ReadLE<uint16_t, kLittleEndianHost>(kBytes, 1);
+  uint32_t u32 = ReadLE<uint32_t, kLittleEndianHost>(kBytes, 3);
+  uint64_t u64 = ReadLE<uint64_t, kLittleEndianHost>(kBytes, 0);
+
+  EXPECT_EQ(u8, 0x88);
+  EXPECT_EQ(Expected(u16, swapped), 0x0302);
+  EXPECT_EQ(Expected(u32, swapped), 0x07060504u);
+  EXPECT_EQ(Expected(u64, swapped), 0x8807060504030201ull);
+
+  char memory[16] = {};
+  uint64_t value = 0x8877665544332211ull;
+  WriteLE<uint64_t, kLittleEndianHost>(memory, Expected(value, swapped), 3);
+  EXPECT_EQ(Decode(memory, 3, 8), value);
+  EXPECT_EQ(memory[2], 0);
+  EXPECT_EQ(memory[11], 0);
+
+  uint32_t value32 = 0xdeadbeef;
+  WriteLE<uint32_t, kLittleEndianHost>(memory, Expected(value32, swapped), 1);
+  EXPECT_EQ(Decode(memory, 1, 4), value32);
+}
+
+template <bool kLittleEndianHost>
+void TestFilestat() {
+  const bool swapped = kLittleEndianHost != kHostIsLittleEndian;
+  uvwasi_filestat_t stats;
+  memset(&stats, 0xaa, sizeof(stats));
+  stats.st_dev = 0x0102030405060708ull;
+  stats.st_ino = 0x1112131415161718ull;
+  stats.st_filetype = UVWASI_FILETYPE_REGULAR_FILE;
+  stats.st_nlink = 0x21222324;
+  stats.st_size = 0x3132333435363738ull;
+  stats.st_atim = 1;
+  stats.st_mtim = 2;
+  stats.st_ctim = 0xfffffffffffffffeull;
+
+  char memory[64];
+  memset(memory, 0x55, sizeof(memory));
+  WriteFilestat<kLittleEndianHost>(memory, stats, 4);
+  EXPECT_EQ(Decode(memory, 0, 4), 0x55555555u);
+  EXPECT_EQ(Decode(memory, 4, 8), Expected(stats.st_dev, swapped));
+  EXPECT_EQ(Decode(memory, 12, 8), Expected(stats.st_ino, swapped));
+  EXPECT_EQ(Decode(memory, 20, 1), stats.st_filetype);
+  EXPECT_EQ(Decode(memory, 21, 3), 0u);
+  EXPECT_EQ(Decode(memory, 24, 4), Expected(stats.st_nlink, swapped));
+  EXPECT_EQ(Decode(memory, 28, 8), Expected(stats.st_size, swapped));
+  EXPECT_EQ(Decode(memory, 36, 8), Expected(stats.st_atim, swapped));
+  EXPECT_EQ(Decode(memory, 44, 8), Expected(stats.st_mtim, swapped));
+  EXPECT_EQ(Decode(memory, 52, 8), Expected(stats.st_ctim, swapped));
+  EXPECT_EQ(Decode(memory, 60, 4), 0x55555555u);
+}
+
+template <bool kLittleEndianHost>
+void TestFdstat() {
+  const bool swapped = kLittleEndianHost != kHostIsLittleEndian;
+  uvwasi_fdstat_t stats;
+  memset(&stats, 0xaa, sizeof(stats));
+  stats.fs_filetype = UVWASI_FILETYPE_DIRECTORY;
+  stats.fs_flags = 0x0102;
+  stats.fs_rights_base = 0x0102030405060708ull;
+  stats.fs_rights_inheriting = 0x8877665544332211ull;
+
+  char memory[24];
+  memset(memory, 0x55, sizeof(memory));
+  WriteFdstat<kLittleEndianHost>(memory, stats, 0);
+  EXPECT_EQ(Decode(memory, 0, 1), stats.fs_filetype);
+  EXPECT_EQ(Decode(memory, 1, 1), 0u);
+  EXPECT_EQ(Decode(memory, 2, 2), Expected(stats.fs_flags, swapped));
+  EXPECT_EQ(Decode(memory, 4, 4), 0u);
+  EXPECT_EQ(Decode(memory, 8, 8), Expected(stats.fs_rights_base, swapped));
+  EXPECT_EQ(Decode(memory, 16, 8),
+            Expected(stats.fs_rights_inheriting, swapped));
+}
+
+template <bool kLittleEndianHost>
+void TestEvent() {
+  const bool swapped = kLittleEndianHost != kHostIsLittleEndian;
+  uvwasi_event_t event;
+  memset(&event, 0xaa, sizeof(event));
+  event.userdata = 0x0102030405060708ull;
+  event.error = UVWASI_EBADF;
+  event.type = UVWASI_EVENTTYPE_FD_READ;
+  event.u.fd_readwrite.nbytes = 1234;
+  event.u.fd_readwrite.flags = UVWASI_EVENT_FD_READWRITE_HANGUP;
+
+  char memory[32];
+  memset(memory, 0x55, sizeof(memory));
+  WriteEvent<kLittleEndianHost>(memory, event, 0);
+  EXPECT_EQ(Decode(memory, 0, 8), Expected(event.userdata, swapped));
+  EXPECT_EQ(Decode(memory, 8, 2), Expected(event.error, swapped));
+  EXPECT_EQ(Decode(memory, 10, 1), event.type);
+  EXPECT_EQ(Decode(memory, 11, 5), 0u);
+  EXPECT_EQ(Decode(memory, 16, 8),
+            Expected(event.u.fd_readwrite.nbytes, swapped));
+  EXPECT_EQ(Decode(memory, 24, 2),
+            Expected(event.u.fd_readwrite.flags, swapped));
+  EXPECT_EQ(Decode(memory, 26, 6), 0u);
+}
+
+template <bool kLittleEndianHost>
+void TestSubscription() {
+  const bool swapped = kLittleEndianHost != kHostIsLittleEndian;
+  char memory[64] = {};
+  memory[0] = 0x11;
+  memory[7] = 0x18;
+  memory[8] = UVWASI_EVENTTYPE_CLOCK;
+  memory[16] = 0x21;
+  memory[24] = UVWASI_CLOCK_MONOTONIC;
+  memory[33] = 0x10;
+  memory[40] = 0x01;
+  memory[48] = UVWASI_SUBSCRIPTION_CLOCK_ABSTIME;
+
+  uvwasi_subscription_t sub;
+  ReadSubscription<kLittleEndianHost>(memory, &sub, 0);
+  EXPECT_EQ(sub.userdata, Expected<uint64_t>(0x1800000000000011ull, swapped));
+  EXPECT_EQ(sub.type, UVWASI_EVENTTYPE_CLOCK);
+  EXPECT_EQ(sub.u.clock.identifier, Expected<uint64_t>(0x21, swapped));
+  EXPECT_EQ(sub.u.clock.clock_id,
+            Expected<uint32_t>(UVWASI_CLOCK_MONOTONIC, swapped));
+  EXPECT_EQ(sub.u.clock.timeout, Expected<uint64_t>(0x1000, swapped));
+  EXPECT_EQ(sub.u.clock.precision, Expected<uint64_t>(1, swapped));
+  EXPECT_EQ(sub.u.clock.flags,
+            Expected<uint16_t>(UVWASI_SUBSCRIPTION_CLOCK_ABSTIME, swapped));
+
+  memory[8] = UVWASI_EVENTTYPE_FD_WRITE;
+  memory[16] = 0x05;
+  memory[17] = 0x01;
+  ReadSubscription<kLittleEndianHost>(memory, &sub, 0);
+  EXPECT_EQ(sub.type, UVWASI_EVENTTYPE_FD_WRITE);
+  EXPECT_EQ(sub.u.fd_readwrite.fd, Expected<uint32_t>(0x105, swapped));
+}
+
+}  // anonymous namespace
+
+TEST(WasiMemoryTest, ByteSwap) {
+  EXPECT_EQ(ByteSwap(static_cast<uint8_t>(0x12)), 0x12);
+  EXPECT_EQ(ByteSwap(static_cast<uint16_t>(0x1234)), 0x3412);
+  EXPECT_EQ(ByteSwap(static_cast<uint32_t>(0x12345678)), 0x78563412u);
+  EXPECT_EQ(ByteSwap(static_cast<uint64_t>(0x0123456789abcdefull)),
+            0xefcdab8967452301ull);
+}
+
+TEST(WasiMemoryTest, LittleEndianHost) {
+  TestScalars<true>();
+  TestFilestat<true>();
+  TestFdstat<true>();
+  TestEvent<true>();
+  TestSubscription<true>();
+}
+
+TEST(WasiMemoryTest, BigEndianHost) {
+  TestScalars<false>();
+  TestFilestat<false>();
+  TestFdstat<false>();
+  TestEvent<false>();
+  TestSubscription<false>();
+}
@@ -0,0 +1,130 @@
+#include "uvwasi.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+
+namespace {
+
+// A system call on fd 0 that runs on its own thread.
+struct FdCall {
+  uvwasi_t* uvwasi;
+  uvwasi_errno_t err = UVWASI_ESUCCESS;
+  size_t nread = 0;
+  std::atomic<bool> done { false };
+  uv_thread_t thread;
+};
+
+void ReadFd(void* arg) {
+  FdCall* call = static_cast<FdCall*>(arg);
+  char data[8];
+  uvwasi_iovec_t iov = { data, sizeof(data) };
+  call->err = uvwasi_fd_read(call->uvwasi, 0, &iov, 1, &call->nread);
+  call->done = true;
+}
+
+void CloseFd(void* arg) {
+  FdCall* call = static_cast<FdCall*>(arg);
+  call->err = uvwasi_fd_close(call->uvwasi, 0);
+  call->done = true;
+}
+
+}  // anonymous namespace
+
+// Threads that wait for an fd that another thread blocks in fd_read() must
+// not keep the rest of the table from changing, and must see the fd closed
+// once fd_close() has detached it.
+TEST(UvwasiFdTableTest, WaitingForBlockedFdDoesNotHoldTable) {
+  char dir[] = "/tmp/uvwasi-fd-table-XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+
+  uvwasi_t uvwasi;
+  uvwasi_options_t options;
+  uvwasi_preopen_t preopen;
+  char mapped_path[] = "/sandbox";
+  char* envp[] = { nullptr };
+  memset(&options, 0, sizeof(options));
+  preopen.mapped_path = mapped_path;
+  preopen.real_path = dir;
+  options.fd_table_size = 3;
+  options.preopenc = 1;
+  options.preopens = &preopen;
+  options.envp = envp;
+  ASSERT_EQ(uvwasi_init(&uvwasi, &options), UVWASI_ESUCCESS);
+  ASSERT_EQ(uvwasi_embedder_remap_fd(&uvwasi, 0, pipe_fds[0]),
+            UVWASI_ESUCCESS);
+
+  // The first reader blocks with the entry held, and the second one waits for
+  // the entry.
+  FdCall first;
+  FdCall second;
+  first.uvwasi = second.uvwasi = &uvwasi;
+  ASSERT_EQ(uv_thread_create(&first.thread, ReadFd, &first), 0);
+  usleep(100000);
+  ASSERT_EQ(uv_thread_create(&second.thread, ReadFd, &second), 0);
+  usleep(100000);
+
+  const char name[] = "file";
+  auto open_file = [&]() {
+    uvwasi_fd_t fd = 0;
+    EXPECT_EQ(uvwasi_path_open(&uvwasi,
+                               3,
+                               0,
+                               name,
+                               strlen(name),
+                               UVWASI_O_CREAT,
+                               UVWASI_RIGHT_FD_WRITE,
+                               0,
+                               0,
+                               &fd),
+              UVWASI_ESUCCESS);
+    return fd;
+  };
+  for (int i = 0; i < 10; i++) {
+    const uvwasi_fd_t fd = open_file();
+    ASSERT_EQ(uvwasi_fd_renumber(&uvwasi, open_file(), fd), UVWASI_ESUCCESS);
+    ASSERT_EQ(uvwasi_fd_close(&uvwasi, fd), UVWASI_ESUCCESS);
+  }
+
+  // fd_close() waits for the readers, but the fd is gone right away, and its
+  // slot is the first one that path_open() hands out again.
+  FdCall closer;
+  closer.uvwasi = &uvwasi;
+  ASSERT_EQ(uv_thread_create(&closer.thread, CloseFd, &closer), 0);
+  for (;;) {
+    const uvwasi_fd_t fd = open_file();
+    ASSERT_EQ(uvwasi_fd_close(&uvwasi, fd), UVWASI_ESUCCESS);
+    if (fd == 0)
+      break;
+    usleep(1000);
+  }
+  EXPECT_FALSE(first.done);
+  EXPECT_FALSE(second.done);
+  EXPECT_FALSE(closer.done);
+
+  ASSERT_EQ(write(pipe_fds[1], "abc", 3), 3);
+  uv_thread_join(&first.thread);
+  uv_thread_join(&second.thread);
+  uv_thread_join(&closer.thread);
+  EXPECT_EQ(first.err, UVWASI_ESUCCESS);
+  EXPECT_EQ(first.nread, 3u);
+  EXPECT_EQ(second.err, UVWASI_EBADF);
+  EXPECT_EQ(closer.err, UVWASI_ESUCCESS);
+
+  uvwasi_destroy(&uvwasi);
+  close(pipe_fds[1]);
+  EXPECT_EQ(unlink((std::string(dir) + "/" + name).c_str()), 0);
+  EXPECT_EQ(rmdir(dir), 0);
+}
+
+#endif  // _WIN32
@@ -0,0 +1,6 @@
+(module
+  (type (;0;) (func))
+  (func (;0;) (type 0))
+  (memory (;0;) 1)
+  (export "memory" (memory 0))
+  (export "_start" (func 0)))
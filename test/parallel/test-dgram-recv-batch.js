@@ -0,0 +1,39 @@
+'use strict';
+
+// Sockets created with `recvBatch` receive datagrams like any other socket,
+// whether or not the platform can receive several of them at once.
+const common = require('../common');
+const assert = require('assert');
+const dgram = require('dgram');
+
+[null, 1, 'true', {}].forEach((recvBatch) => {
+  assert.throws(() => dgram.createSocket({ type: 'udp4', recvBatch }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+const kCount = 100;
+const receiver = dgram.createSocket({ type: 'udp4', recvBatch: true });
+const sender = dgram.createSocket('udp4');
+let received = 0;
+
+receiver.on('message', common.mustCall((buf, rinfo) => {
+  // Every datagram is a copy of its own, even if several were received
+  // into the same buffer.
+  assert.strictEqual(buf.toString(), `datagram ${received}`);
+  assert.strictEqual(rinfo.port, sender.address().port);
+  assert.strictEqual(rinfo.size, buf.length);
+  if (++received === kCount) {
+    receiver.close();
+    sender.close();
+  }
+}, kCount));
+
+receiver.bind(0, common.localhostIPv4, common.mustCall(() => {
+  const { port } = receiver.address();
+  sender.bind(0, common.localhostIPv4, common.mustCall(() => {
+    for (let i = 0; i < kCount; i++)
+      sender.send(`datagram ${i}`, port, common.localhostIPv4);
+  }));
+}));
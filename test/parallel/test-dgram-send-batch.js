@@ -0,0 +1,101 @@
+'use strict';
+
+const common = require('../common');
+const assert = require('assert');
+const dgram = require('dgram');
+
+const messages = [];
+const expected = [];
+for (let i = 0; i < 50; i++) {
+  const text = `message ${i}`;
+  if (i % 3 === 0) {
+    messages.push(text);
+  } else if (i % 3 === 1) {
+    messages.push(Buffer.from(text));
+  } else {
+    messages.push([Buffer.from(text.slice(0, 4)), text.slice(4)]);
+  }
+  expected.push(text);
+}
+const totalLength = expected.reduce((sum, text) => sum + text.length, 0);
+
+{
+  const socket = dgram.createSocket('udp4');
+
+  [undefined, null, 'message', Buffer.alloc(1)].forEach((messages) => {
+    assert.throws(() => socket.sendBatch(messages, 12345), {
+      code: 'ERR_INVALID_ARG_TYPE',
+      name: 'TypeError'
+    });
+  });
+
+  assert.throws(() => socket.sendBatch([], 12345), {
+    code: 'ERR_INVALID_ARG_VALUE',
+    name: 'TypeError'
+  });
+
+  [1, {}, null, [1]].forEach((message) => {
+    assert.throws(() => socket.sendBatch(['ok', message], 12345), {
+      code: 'ERR_INVALID_ARG_TYPE',
+      name: 'TypeError',
+      message: /messages\[1\]/
+    });
+  });
+
+  assert.throws(() => socket.sendBatch(['ok']), {
+    code: 'ERR_SOCKET_BAD_PORT'
+  });
+
+  socket.close();
+}
+
+// Each message is received as a datagram of its own, in order.
+{
+  const socket = dgram.createSocket('udp4');
+  const received = [];
+
+  socket.on('message', common.mustCall((buf) => {
+    received.push(buf.toString());
+    if (received.length === expected.length) {
+      assert.deepStrictEqual(received, expected);
+      socket.close();
+    }
+  }, expected.length));
+
+  socket.bind(0, common.mustCall(() => {
+    const { port } = socket.address();
+    socket.sendBatch(messages, port, common.localhostIPv4,
+                     common.mustCall((err, bytes) => {
+                       assert.ifError(err);
+                       assert.strictEqual(bytes, totalLength);
+                     }));
+  }));
+}
+
+// Connected sockets send to their remote endpoint.
+{
+  const server = dgram.createSocket('udp4');
+  const client = dgram.createSocket('udp4');
+  const received = [];
+
+  server.on('message', common.mustCall((buf) => {
+    received.push(buf.toString());
+    if (received.length === expected.length) {
+      assert.deepStrictEqual(received, expected);
+      server.close();
+      client.close();
+    }
+  }, expected.length));
+
+  server.bind(0, common.mustCall(() => {
+    client.connect(server.address().port, common.mustCall(() => {
+      assert.throws(() => client.sendBatch(messages, 12345), {
+        code: 'ERR_SOCKET_DGRAM_IS_CONNECTED'
+      });
+      client.sendBatch(messages, common.mustCall((err, bytes) => {
+        assert.ifError(err);
+        assert.strictEqual(bytes, totalLength);
+      }));
+    }));
+  }));
+}
@@ -0,0 +1,81 @@
+// Flags: --max-http-header-size=65536
+'use strict';
+
+// Headers that the parser passes as a Buffer are only turned into strings
+// when they are used, but messages look the same as if they were strings
+// from the start.
+const common = require('../common');
+const assert = require('assert');
+const http = require('http');
+const util = require('util');
+const { HTTPParser, headerOffsets } = require('_http_common');
+
+const kOnHeadersComplete = HTTPParser.kOnHeadersComplete | 0;
+const kOnMessageComplete = HTTPParser.kOnMessageComplete | 0;
+const kMaxHeaderPairs = 2000;
+
+{
+  // The shared offsets array fits as many headers as the server accepts by
+  // default, so those are not passed as strings either.
+  let request = 'GET / HTTP/1.1\r\n';
+  for (let i = 0; i < kMaxHeaderPairs; i++)
+    request += `X-${i}: ${i}\r\n`;
+  request = Buffer.from(`${request}\r\n`);
+
+  const parser = new HTTPParser();
+  parser.initialize(HTTPParser.REQUEST, {}, headerOffsets);
+  parser[kOnHeadersComplete] = common.mustCall((versionMajor, versionMinor,
+                                                headers) => {
+    assert(Buffer.isBuffer(headers));
+    assert.strictEqual(headerOffsets[0], 2 * kMaxHeaderPairs);
+    const last = 2 * kMaxHeaderPairs - 1;
+    assert.strictEqual(
+      headers.latin1Slice(headerOffsets[last + 1], headerOffsets[last + 2]),
+      `${kMaxHeaderPairs - 1}`);
+  });
+  parser[kOnMessageComplete] = common.mustCall();
+  assert.strictEqual(parser.execute(request, 0, request.length),
+                     request.length);
+  parser.close();
+}
+
+const server = http.createServer(common.mustCall((req, res) => {
+  // The headers are own properties, where the constructor puts them.
+  const keys = Object.keys(req);
+  const constructorKeys = Object.keys(new http.IncomingMessage(null));
+  for (const name of ['headers', 'rawHeaders']) {
+    assert.strictEqual(keys.indexOf(name), constructorKeys.indexOf(name));
+    assert.strictEqual(
+      typeof Object.getOwnPropertyDescriptor(req, name).get, 'function');
+  }
+
+  const copy = { ...req };
+  assert.deepStrictEqual(copy.rawHeaders.slice(-4),
+                         ['X-A', '1', 'x-a', '2']);
+  assert.strictEqual(copy.headers['x-a'], '1, 2');
+
+  // Once used, the headers are plain data properties again.
+  for (const name of ['headers', 'rawHeaders']) {
+    const descriptor = Object.getOwnPropertyDescriptor(req, name);
+    assert.strictEqual(descriptor.get, undefined);
+    assert.strictEqual(descriptor.value, copy[name]);
+    assert.strictEqual(descriptor.enumerable, true);
+    assert.strictEqual(descriptor.writable, true);
+  }
+  assert.deepStrictEqual(Object.keys(req), keys);
+  const inspected = util.inspect(req, { depth: 0 });
+  assert(inspected.includes('headers: [Object]'), inspected);
+  assert(inspected.includes('rawHeaders: [Array]'), inspected);
+
+  res.end();
+}));
+
+server.listen(0, common.mustCall(() => {
+  http.get({
+    port: server.address().port,
+    headers: [['X-A', '1'], ['x-a', '2']]
+  }, common.mustCall((res) => {
+    res.resume();
+    res.on('end', common.mustCall(() => server.close()));
+  }));
+}));
@@ -19,10 +19,12 @@
 // OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
 // USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+// Flags: --expose-internals
 'use strict';
 const { mustCall, mustNotCall } = require('../common');
 const assert = require('assert');
 
+const { internalBinding } = require('internal/test/binding');
 const { methods, HTTPParser } = require('_http_common');
 const { REQUEST, RESPONSE } = HTTPParser;
 
@@ -506,6 +508,78 @@ function expectBody(expected) {
 }
 
 
+//
+// Pipelined requests fed one byte at a time, so that every header is copied
+// from the input, including one that is longer than a slab chunk.
+//
+{
+  const longValue = 'x'.repeat(6000);
+  const request = Buffer.from(
+    'GET /first HTTP/1.1\r\n' +
+    'Host: example.com\r\n' +
+    `X-Long: ${longValue}\r\n` +
+    'content-type: text/plain\r\n' +
+    '\r\n' +
+    'GET /second HTTP/1.1\r\n' +
+    'User-Agent: test\r\n' +
+    'X-Custom: value\r\n' +
+    '\r\n'
+  );
+
+  const expected = [
+    ['/first',
+     ['Host', 'example.com', 'X-Long', longValue,
+      'content-type', 'text/plain']],
+    ['/second', ['User-Agent', 'test', 'X-Custom', 'value']]
+  ];
+
+  const parser = newParser(REQUEST);
+  parser[kOnHeadersComplete] = mustCall((versionMajor, versionMinor,
+                                         headers, method, url) => {
+    const [expectedUrl, expectedHeaders] = expected.shift();
+    assert.strictEqual(url, expectedUrl);
+    assert.deepStrictEqual(headers, expectedHeaders);
+  }, 2);
+
+  for (let i = 0; i < request.length; ++i) {
+    parser.execute(request, i, 1);
+  }
+
+  assert.strictEqual(expected.length, 0);
+}
+
+
+//
+// A long URL fed one byte at a time is moved to ever larger slab chunks, so
+// the slab stays proportional to the URL instead of to its square.
+//
+{
+  const url = `/${'a'.repeat(8000)}`;
+  const request = Buffer.from(`GET ${url} HTTP/1.1\r\n\r\n`);
+  const urlEnd = request.indexOf(' HTTP/1.1');
+
+  const parser = newParser(REQUEST);
+  parser[kOnHeadersComplete] = mustCall((versionMajor, versionMinor,
+                                         headers, method, parsedUrl) => {
+    assert.strictEqual(parsedUrl, url);
+  });
+
+  for (let i = 0; i < urlEnd; ++i) {
+    parser.execute(request, i, 1);
+  }
+
+  const { buildEmbedderGraph } = internalBinding('heap_utils');
+  const slabSizes = buildEmbedderGraph()
+    .filter((node) => node.name === 'Node / header_slab')
+    .map((node) => node.size);
+  assert(slabSizes.length > 0);
+  assert(Math.max(...slabSizes) < 64 * 1024,
+         `header slab is ${Math.max(...slabSizes)} bytes`);
+
+  parser.execute(request, urlEnd, request.length - urlEnd);
+}
+
+
 //
 // Test parser reinit sequence.
 //
@@ -562,6 +636,55 @@ function expectBody(expected) {
   parser.execute(req2, 0, req2.length);
 }
 
+//
+// Headers are passed as a Buffer and offsets if the parser is initialized
+// with a Uint32Array, even if there are many of them or they span reads.
+//
+{
+  const expected = [];
+  let request = 'POST /flat HTTP/1.1\r\nTransfer-Encoding: chunked\r\n';
+  expected.push('Transfer-Encoding', 'chunked');
+  for (let i = 0; i < 40; i++) {
+    request += `X-Filler${i}: ${'x'.repeat(i + 1)}\r\n`;
+    expected.push(`X-Filler${i}`, 'x'.repeat(i + 1));
+  }
+  request = Buffer.from(`${request}\r\n3\r\nabc\r\n0\r\nX-Trailer: t\r\n\r\n`);
+
+  const offsets = new Uint32Array(2 * 41 + 2);
+  const parser = newParser(REQUEST);
+  parser.initialize(REQUEST, {}, offsets);
+  parser[kOnHeadersComplete] = mustCall((versionMajor, versionMinor,
+                                         headers, method, url) => {
+    assert.strictEqual(url, '/flat');
+    assert(Buffer.isBuffer(headers));
+    assert.strictEqual(offsets[0], expected.length);
+    const actual = [];
+    for (let i = 0; i < offsets[0]; i++)
+      actual.push(headers.latin1Slice(offsets[i + 1], offsets[i + 2]));
+    assert.deepStrictEqual(actual, expected);
+    assert.strictEqual(parser.headers.length, 0);
+  });
+  parser[kOnBody] = expectBody('abc');
+  // Trailers are still passed as strings.
+  parser[kOnMessageComplete] = mustCall(() => {
+    assert.deepStrictEqual(parser.headers, ['X-Trailer', 't']);
+  });
+  parser.execute(request, 0, 100);
+  parser.execute(request.slice(100), 0, request.length - 100);
+}
+
+{
+  // If the offsets do not fit, the headers are passed as strings.
+  const request = Buffer.from('GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\n\r\n');
+  const parser = newParser(REQUEST);
+  parser.initialize(REQUEST, {}, new Uint32Array(5));
+  parser[kOnHeadersComplete] = mustCall((versionMajor, versionMinor,
+                                         headers) => {
+    assert.deepStrictEqual(headers, ['A', '1', 'B', '2']);
+  });
+  parser.execute(request, 0, request.length);
+}
+
 // Test parser 'this' safety
 // https://github.com/joyent/node/issues/6690
 assert.throws(function() {
@@ -0,0 +1,99 @@
+'use strict';
+const common = require('../common');
+const fixtures = require('../common/fixtures');
+
+if (!common.hasCrypto)
+  common.skip('missing crypto');
+
+// Data has to make it through unchanged with the `ktls` option, whether the
+// kernel takes over the connection or not. Only TLSv1.2 with AES-GCM can be
+// handed to the kernel, everything else stays with OpenSSL.
+
+const assert = require('assert');
+const crypto = require('crypto');
+const fs = require('fs');
+const tls = require('tls');
+
+const key = fixtures.readKey('agent1-key.pem');
+const cert = fixtures.readKey('agent1-cert.pem');
+
+for (const ktls of ['true', 1, {}]) {
+  assert.throws(() => tls.createServer({ ktls }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    message: /options\.ktls/
+  });
+  assert.throws(() => new tls.TLSSocket(null, { ktls }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    message: /options\.ktls/
+  });
+}
+
+// The kernel can only take over connections if the `tls` ULP is loaded.
+// Without it, the ciphers that kTLS supports are not tested.
+function hasTlsUlp() {
+  if (!common.isLinux)
+    return false;
+  try {
+    return fs.readFileSync('/proc/sys/net/ipv4/tcp_available_ulp', 'latin1')
+      .split(/\s+/).includes('tls');
+  } catch {
+    return false;
+  }
+}
+
+const tests = [
+  { ciphers: 'ECDHE-RSA-AES128-GCM-SHA256', maxVersion: 'TLSv1.2' },
+  { ciphers: 'ECDHE-RSA-AES256-GCM-SHA384', maxVersion: 'TLSv1.2' },
+  { ciphers: 'AES128-SHA256', maxVersion: 'TLSv1.2', unsupported: true },
+  { maxVersion: 'TLSv1.3', unsupported: true },
+].filter(({ unsupported }) => unsupported || hasTlsUlp());
+
+const data = crypto.randomBytes(1024 * 1024);
+
+function checkKTLS(socket, unsupported) {
+  const info = socket.getKTLS();
+  if (unsupported || !common.isLinux)
+    assert.deepStrictEqual(info, { tx: false, rx: false });
+  else
+    assert.deepStrictEqual(info, { tx: true, rx: true });
+}
+
+function test({ ciphers, maxVersion, unsupported }) {
+  const server = tls.createServer({
+    key,
+    cert,
+    ciphers,
+    maxVersion,
+    ktls: true
+  }, common.mustCall((socket) => {
+    checkKTLS(socket, unsupported);
+    socket.pipe(socket);
+    socket.on('close', common.mustCall(() => {
+      assert.strictEqual(socket.getKTLS(), null);
+    }));
+  }));
+
+  server.listen(0, common.mustCall(() => {
+    const client = tls.connect({
+      port: server.address().port,
+      rejectUnauthorized: false,
+      ciphers,
+      maxVersion,
+      ktls: true
+    }, common.mustCall(() => {
+      checkKTLS(client, unsupported);
+      client.end(data);
+    }));
+
+    const received = [];
+    client.on('data', (chunk) => received.push(chunk));
+    client.on('end', common.mustCall(() => {
+      assert.deepStrictEqual(Buffer.concat(received), data);
+      server.close();
+      if (tests.length > 0)
+        test(tests.shift());
+    }));
+  }));
+}
+
+test(tests.shift());
@@ -0,0 +1,69 @@
+// Flags: --experimental-wasi --experimental-wasm-bigint
+'use strict';
+
+// In async mode, the guest runs on a worker thread and start() returns a
+// promise for its exit code, so the guest can neither block nor exit the
+// main thread.
+const common = require('../common');
+
+const assert = require('assert');
+const fs = require('fs');
+const path = require('path');
+const fixtures = require('../common/fixtures');
+const tmpdir = require('../common/tmpdir');
+const { WASI } = require('wasi');
+
+function compile(name) {
+  const bytes = fs.readFileSync(path.join(__dirname, 'wasm', `${name}.wasm`));
+  return new WebAssembly.Module(bytes);
+}
+
+[null, 1, 'true', {}].forEach((async) => {
+  assert.throws(() => new WASI({ async }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+tmpdir.refresh();
+const options = {
+  async: true,
+  args: [],
+  env: process.env,
+  preopens: {
+    '/sandbox': fixtures.path('wasi'),
+    '/tmp': tmpdir.path
+  }
+};
+
+{
+  const wasi = new WASI(options);
+  assert.strictEqual(wasi.wasiImport, undefined);
+
+  const instance = new WebAssembly.Instance(compile('exitcode'), {
+    wasi_unstable: new WASI().wasiImport
+  });
+  [instance, null, {}].forEach((value) => {
+    assert.throws(() => wasi.start(value), {
+      code: 'ERR_INVALID_ARG_TYPE',
+      name: 'TypeError'
+    });
+  });
+}
+
+(async () => {
+  // proc_exit() only stops the worker thread.
+  assert.strictEqual(await new WASI(options).start(compile('exitcode')), 120);
+  assert.strictEqual(await new WASI(options).start(compile('stat')), 0);
+  assert.strictEqual(await new WASI(options).start(compile('cant_dotdot')), 0);
+
+  // Imports other than WASI cannot be provided to the worker.
+  const importsEnv = new WebAssembly.Module(new Uint8Array([
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,  // Magic and version.
+    0x01, 0x04, 0x01, 0x60, 0x00, 0x00,  // Type section: () => void.
+    0x02, 0x09, 0x01, 0x03, 0x65, 0x6e, 0x76, 0x01, 0x66, 0x00, 0x00  // env.f
+  ]));
+  await assert.rejects(new WASI(options).start(importsEnv), {
+    message: /"env"/
+  });
+})().then(common.mustCall());
@@ -0,0 +1,121 @@
+// Flags: --experimental-wasi --experimental-wasm-bigint
+'use strict';
+
+// Preopens can be served from a read-only bundle, packed in memory or mapped
+// from a file, instead of a host directory.
+require('../common');
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../common/tmpdir');
+const { WASI, createBundle } = require('wasi');
+
+const kSuccess = 0;
+const kEEXIST = 20;
+const kENOENT = 44;
+const kENOTCAPABLE = 76;
+const kPreopenFd = 3;
+const kOpenCreat = 1 << 0;
+const kOpenExcl = 1 << 2;
+const kRightsRead = 1n << 1n;
+const kRightsWrite = 1n << 6n;
+const kResultPtr = 0;
+const kIovPtr = 8;
+const kPathPtr = 16;
+const kDataPtr = 64;
+
+const tree = {
+  'hello.txt': 'hello world',
+  'lib': {
+    'data.bin': new Uint8Array([1, 2, 3])
+  }
+};
+
+[null, 1, 'tree', Buffer.alloc(1)].forEach((value) => {
+  assert.throws(() => createBundle(value), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+['', '.', '..', 'a/b', 'a\0b'].forEach((name) => {
+  assert.throws(() => createBundle({ [name]: 'x' }), {
+    code: 'ERR_INVALID_ARG_VALUE',
+    name: 'TypeError'
+  });
+});
+
+assert.throws(() => createBundle({ file: 1 }), {
+  code: 'ERR_INVALID_ARG_TYPE',
+  name: 'TypeError'
+});
+
+[null, 1, 'bundles'].forEach((bundles) => {
+  assert.throws(() => new WASI({ bundles }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+assert.throws(() => new WASI({ preopens: { '/a': Buffer.from('nope') } }), {
+  code: 'ERR_INVALID_ARG_VALUE'
+});
+
+function instantiate(wasi) {
+  const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+  const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+    wasi_unstable: wasi.wasiImport
+  });
+  wasi.start(instance);
+  return instance.exports.memory;
+}
+
+function check(wasi) {
+  const memory = instantiate(wasi);
+  const view = new DataView(memory.buffer);
+  const { fd_close, fd_read, path_filestat_get, path_open } = wasi.wasiImport;
+
+  function open(name, oflags = 0, rights = kRightsRead) {
+    const length = Buffer.from(memory.buffer).write(name, kPathPtr);
+    return path_open(kPreopenFd, 0, kPathPtr, length, oflags, rights, 0n, 0,
+                     kResultPtr);
+  }
+
+  function read(name) {
+    assert.strictEqual(open(name), kSuccess);
+    const fd = view.getUint32(kResultPtr, true);
+    view.setUint32(kIovPtr, kDataPtr, true);
+    view.setUint32(kIovPtr + 4, 32, true);
+    assert.strictEqual(fd_read(fd, kIovPtr, 1, kResultPtr), kSuccess);
+    assert.strictEqual(fd_close(fd), kSuccess);
+    return Buffer.from(memory.buffer, kDataPtr,
+                       view.getUint32(kResultPtr, true));
+  }
+
+  assert.strictEqual(read('hello.txt').toString(), 'hello world');
+  assert.deepStrictEqual([...read('lib/../lib/data.bin')], [1, 2, 3]);
+
+  const length = Buffer.from(memory.buffer).write('lib/data.bin', kPathPtr);
+  assert.strictEqual(
+    path_filestat_get(kPreopenFd, 0, kPathPtr, length, kDataPtr), kSuccess);
+  assert.strictEqual(view.getBigUint64(kDataPtr + 24, true), 3n);
+
+  assert.strictEqual(open('missing'), kENOENT);
+  assert.strictEqual(open('../hello.txt'), kENOTCAPABLE);
+  assert.strictEqual(open('hello.txt', kOpenExcl), kEEXIST);
+  assert.strictEqual(open('new.txt', kOpenCreat), kENOTCAPABLE);
+  assert.strictEqual(open('hello.txt', 0, kRightsWrite), kENOTCAPABLE);
+}
+
+check(new WASI({ preopens: { '/assets': tree } }));
+check(new WASI({ preopens: { '/assets': createBundle(tree) } }));
+
+tmpdir.refresh();
+const file = path.join(tmpdir.path, 'assets.bundle');
+fs.writeFileSync(file, createBundle(tree));
+check(new WASI({ bundles: { '/assets': file } }));
+
+assert.throws(() => {
+  new WASI({ bundles: { '/assets': path.join(tmpdir.path, 'missing') } });
+}, { code: 'ERR_INVALID_ARG_VALUE' });
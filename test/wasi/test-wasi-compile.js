@@ -0,0 +1,74 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// compile() can cache compiled modules on disk. Entries are written when the
+// process exits at the latest, and used by later processes.
+const common = require('../common');
+const assert = require('assert');
+const cp = require('child_process');
+const fixtures = require('../common/fixtures');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../common/tmpdir');
+const { compile } = require('wasi');
+
+const modulePath = fixtures.path('wasi', 'memory.wasm');
+
+if (process.argv[2] === 'child') {
+  compile(modulePath, { cache: process.argv[3] }).then(common.mustCall((m) => {
+    const instance = new WebAssembly.Instance(m);
+    assert(instance.exports.memory instanceof WebAssembly.Memory);
+  }));
+  return;
+}
+
+[null, 'cache'].forEach((options) => {
+  assert.rejects(compile(modulePath, options), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  }).then(common.mustCall());
+});
+
+assert.rejects(compile(modulePath, { cache: 1 }), {
+  code: 'ERR_INVALID_ARG_TYPE',
+  name: 'TypeError'
+}).then(common.mustCall());
+
+assert.rejects(compile(path.join(__dirname, 'missing.wasm')), {
+  code: 'ENOENT'
+}).then(common.mustCall());
+
+compile(modulePath).then(common.mustCall((module) => {
+  assert(module instanceof WebAssembly.Module);
+}));
+
+tmpdir.refresh();
+const cache = path.join(tmpdir.path, 'cache');
+
+function run() {
+  const child = cp.spawnSync(process.execPath, [
+    '--experimental-wasi',
+    '--no-warnings',
+    __filename,
+    'child',
+    cache
+  ]);
+  assert.strictEqual(child.stderr.toString(), '');
+  assert.strictEqual(child.status, 0);
+}
+
+run();
+const entries = fs.readdirSync(cache);
+assert.strictEqual(entries.length, 1);
+assert(entries[0].endsWith('.wasmcache'));
+const entry = path.join(cache, entries[0]);
+const { mtimeMs } = fs.statSync(entry);
+
+// The entry is used instead of being written again.
+run();
+assert.deepStrictEqual(fs.readdirSync(cache), entries);
+assert.strictEqual(fs.statSync(entry).mtimeMs, mtimeMs);
+
+// Entries that V8 rejects fall back to compiling the module.
+fs.writeFileSync(entry, 'garbage');
+run();
@@ -0,0 +1,39 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// The iovec count of the vectored syscalls comes from the guest. Counts that
+// put the iovec array outside of the guest memory must be rejected before the
+// bindings allocate space for the array.
+require('../common');
+
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const { WASI } = require('wasi');
+
+const kPageSize = 64 * 1024;
+const kEOVERFLOW = 61;
+
+const wasi = new WASI();
+const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+  wasi_unstable: wasi.wasiImport
+});
+wasi.start(instance);
+
+const {
+  fd_pread,
+  fd_pwrite,
+  fd_read,
+  fd_write,
+  sock_recv,
+  sock_send
+} = wasi.wasiImport;
+
+for (const len of [0xffffffff, 0x80000000, kPageSize / 8 + 1]) {
+  assert.strictEqual(fd_read(0, 0, len, 0), kEOVERFLOW);
+  assert.strictEqual(fd_write(1, 0, len, 0), kEOVERFLOW);
+  assert.strictEqual(fd_pread(0, 0, len, 0n, 0), kEOVERFLOW);
+  assert.strictEqual(fd_pwrite(1, 0, len, 0n, 0), kEOVERFLOW);
+  assert.strictEqual(sock_recv(3, 0, len, 0, 0, 4), kEOVERFLOW);
+  assert.strictEqual(sock_send(3, 0, len, 0, 0), kEOVERFLOW);
+}
@@ -0,0 +1,38 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// The bindings cache the backing store of the guest memory between calls.
+// Make sure the cache is refreshed once memory.grow() detaches the old buffer.
+require('../common');
+
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const { WASI } = require('wasi');
+
+const kPageSize = 64 * 1024;
+const kClockRealtime = 0;
+const kSuccess = 0;
+const kEOVERFLOW = 61;
+
+const wasi = new WASI();
+const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+  wasi_unstable: wasi.wasiImport
+});
+wasi.start(instance);
+
+const { memory } = instance.exports;
+const { clock_time_get } = wasi.wasiImport;
+
+assert.strictEqual(clock_time_get(kClockRealtime, 0n, 0), kSuccess);
+assert.strictEqual(clock_time_get(kClockRealtime, 0n, kPageSize), kEOVERFLOW);
+
+const oldBuffer = memory.buffer;
+memory.grow(1);
+assert.strictEqual(oldBuffer.byteLength, 0);
+
+assert.strictEqual(clock_time_get(kClockRealtime, 0n, kPageSize), kSuccess);
+const view = new DataView(memory.buffer);
+assert.notStrictEqual(view.getBigUint64(kPageSize, true), 0n);
+assert.strictEqual(clock_time_get(kClockRealtime, 0n, 2 * kPageSize),
+                   kEOVERFLOW);
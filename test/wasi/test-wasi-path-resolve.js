@@ -0,0 +1,143 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// Paths are resolved one component at a time, and directories that have
+// already been walked are cached. Make sure that symlinks are still confined
+// to the sandbox, including after a cached directory is replaced by a symlink.
+const common = require('../common');
+
+if (common.isWindows)
+  common.skip('Windows uses the lexical path resolver');
+if (!common.canCreateSymLink())
+  common.skip('insufficient privileges');
+
+const assert = require('assert');
+const fs = require('fs');
+const path = require('path');
+const fixtures = require('../common/fixtures');
+const tmpdir = require('../common/tmpdir');
+const { WASI } = require('wasi');
+
+const kPreopenFd = 3;
+const kFilestatPtr = 0;
+const kPathPtr = 64;
+const kOtherPathPtr = 1024;
+const kFdPtr = 2048;
+const kLookupSymlinkFollow = 1;
+const kRightFdRead = 1n << 1n;
+const kFilestatSetMtim = 1 << 2;
+const kFiletypeSymlink = 7;
+const kELOOP = 32;
+const kENOENT = 44;
+const kENOTCAPABLE = 76;
+
+tmpdir.refresh();
+const sandbox = path.join(tmpdir.path, 'sandbox');
+const outside = path.join(tmpdir.path, 'outside');
+fs.mkdirSync(path.join(sandbox, 'a', 'b', 'c'), { recursive: true });
+fs.mkdirSync(outside);
+fs.writeFileSync(path.join(sandbox, 'a', 'b', 'c', 'file'), 'sandbox');
+fs.writeFileSync(path.join(outside, 'file'), 'outside!');
+fs.symlinkSync(path.join('a', 'b'), path.join(sandbox, 'link'));
+fs.symlinkSync(path.join('..', 'outside'), path.join(sandbox, 'escape'));
+fs.symlinkSync(path.join('..', '..', 'outside'),
+               path.join(sandbox, 'a', 'esc'));
+const realSandbox = fs.realpathSync(sandbox);
+
+const wasi = new WASI({ preopens: { '/sandbox': sandbox } });
+const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+  wasi_unstable: wasi.wasiImport
+});
+wasi.start(instance);
+
+const { memory } = instance.exports;
+const {
+  path_filestat_get,
+  path_filestat_set_times,
+  path_open,
+  path_rename,
+  path_symlink
+} = wasi.wasiImport;
+
+function writePath(ptr, str) {
+  return Buffer.from(memory.buffer).write(str, ptr);
+}
+
+function stat(name, flags = 0) {
+  const len = writePath(kPathPtr, name);
+  const err = path_filestat_get(kPreopenFd, flags, kPathPtr, len, kFilestatPtr);
+  if (err !== 0)
+    return err;
+  return Number(new DataView(memory.buffer).getBigUint64(kFilestatPtr + 24,
+                                                         true));
+}
+
+function filetype(name) {
+  const len = writePath(kPathPtr, name);
+  const err = path_filestat_get(kPreopenFd, 0, kPathPtr, len, kFilestatPtr);
+  if (err !== 0)
+    return err;
+  return new DataView(memory.buffer).getUint8(kFilestatPtr + 16);
+}
+
+function open(name, flags = 0) {
+  const len = writePath(kPathPtr, name);
+  return path_open(kPreopenFd, flags, kPathPtr, len, 0, kRightFdRead, 0n, 0,
+                   kFdPtr);
+}
+
+function setMtime(name, seconds) {
+  const len = writePath(kPathPtr, name);
+  return path_filestat_set_times(kPreopenFd, 0, kPathPtr, len, 0n,
+                                 BigInt(seconds), kFilestatSetMtim);
+}
+
+function rename(from, to) {
+  const fromLength = writePath(kPathPtr, from);
+  const toLength = writePath(kOtherPathPtr, to);
+  return path_rename(kPreopenFd, kPathPtr, fromLength,
+                     kPreopenFd, kOtherPathPtr, toLength);
+}
+
+function symlink(target, name) {
+  const targetLength = writePath(kPathPtr, target);
+  const nameLength = writePath(kOtherPathPtr, name);
+  return path_symlink(kPathPtr, targetLength,
+                      kPreopenFd, kOtherPathPtr, nameLength);
+}
+
+// Resolve everything twice, so the second lookup goes through the cache.
+for (let i = 0; i < 2; i++) {
+  assert.strictEqual(stat('a/b/c/file'), 7);
+  assert.strictEqual(stat('./a//b/../b/c/file'), 7);
+  assert.strictEqual(stat('link/c/file'), 7);
+  assert.strictEqual(stat('a/missing/file'), kENOENT);
+  assert.strictEqual(stat('../outside/file'), kENOTCAPABLE);
+  assert.strictEqual(stat('a/../../outside/file'), kENOTCAPABLE);
+  assert.strictEqual(stat('escape/file'), kENOTCAPABLE);
+  assert.strictEqual(stat('escape', kLookupSymlinkFollow), kENOTCAPABLE);
+  assert.strictEqual(stat(`${realSandbox}/a/b/c/file`), 7);
+  assert.strictEqual(stat(`${realSandbox}2/file`), kENOTCAPABLE);
+}
+
+// Without kLookupSymlinkFollow, a symlink in the final component refers to
+// the symlink itself, and must not be followed out of the sandbox by the host.
+const outsideMtime = fs.statSync(outside).mtimeMs;
+for (const name of ['escape', 'a/esc', 'a/b/../esc']) {
+  assert.strictEqual(open(name), kELOOP);
+  assert.strictEqual(open(name, kLookupSymlinkFollow), kENOTCAPABLE);
+  assert.strictEqual(filetype(name), kFiletypeSymlink);
+  assert.strictEqual(setMtime(name, 1000), 0);
+}
+assert.strictEqual(fs.statSync(outside).mtimeMs, outsideMtime);
+assert.strictEqual(fs.lstatSync(path.join(sandbox, 'a', 'esc')).mtimeMs, 1e6);
+assert.strictEqual(open('a/b/c/file'), 0);
+
+// Renaming a cached directory away and putting a symlink that points out of
+// the sandbox in its place must not let the stale cache entry be used.
+assert.strictEqual(rename('a/b', 'a/moved'), 0);
+assert.strictEqual(stat('a/b/c/file'), kENOENT);
+assert.strictEqual(stat('a/moved/c/file'), 7);
+assert.strictEqual(symlink('../../outside', 'a/b'), 0);
+assert.strictEqual(stat('a/b/file'), kENOTCAPABLE);
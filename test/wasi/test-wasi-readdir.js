@@ -0,0 +1,77 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// fd_readdir() keeps a directory stream open between calls. Make sure that
+// listing a directory in many small chunks still returns every entry exactly
+// once, including entries that had to be truncated at the end of a chunk.
+require('../common');
+
+const assert = require('assert');
+const fs = require('fs');
+const path = require('path');
+const fixtures = require('../common/fixtures');
+const tmpdir = require('../common/tmpdir');
+const { WASI } = require('wasi');
+
+const kEntries = 1000;
+const kPreopenFd = 3;
+const kDirentSize = 24;
+const kUsedPtr = 0;
+const kBufPtr = 8;
+
+tmpdir.refresh();
+const expected = [];
+for (let i = 0; i < kEntries; i++) {
+  const name = `entry-${i}`;
+  fs.writeFileSync(path.join(tmpdir.path, name), '');
+  expected.push(name);
+}
+expected.sort();
+
+const wasi = new WASI({ preopens: { '/sandbox': tmpdir.path } });
+const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+  wasi_unstable: wasi.wasiImport
+});
+wasi.start(instance);
+
+const { memory } = instance.exports;
+const { fd_readdir } = wasi.wasiImport;
+
+function listDirectory(bufLen) {
+  const view = new DataView(memory.buffer);
+  const names = [];
+  let cookie = 0n;
+
+  for (;;) {
+    assert.strictEqual(
+      fd_readdir(kPreopenFd, kBufPtr, bufLen, cookie, kUsedPtr), 0);
+    const used = view.getUint32(kUsedPtr, true);
+    let offset = 0;
+
+    while (offset + kDirentSize <= used) {
+      const next = view.getBigUint64(kBufPtr + offset, true);
+      const nameLength = view.getUint32(kBufPtr + offset + 16, true);
+      const nameStart = kBufPtr + offset + kDirentSize;
+
+      if (offset + kDirentSize + nameLength > used)
+        break;
+
+      names.push(Buffer.from(memory.buffer, nameStart, nameLength).toString());
+      cookie = next;
+      offset += kDirentSize + nameLength;
+    }
+
+    if (used < bufLen)
+      break;
+  }
+
+  return names.sort();
+}
+
+// A buffer that holds less than two entries forces a truncated entry, and
+// with it a seek, on almost every call.
+assert.deepStrictEqual(listDirectory(50), expected);
+assert.deepStrictEqual(listDirectory(4096), expected);
+// Starting over from the first cookie rewinds the cached stream.
+assert.deepStrictEqual(listDirectory(4096), expected);
@@ -0,0 +1,80 @@
+// Flags: --experimental-wasi --experimental-wasm-bigint
+'use strict';
+
+// With returnOnExit, proc_exit() only unwinds the guest and start() returns
+// its exit code. reset() restores the fd table, so that the WASI instance can
+// start the module again.
+require('../common');
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../common/tmpdir');
+const { WASI } = require('wasi');
+
+const kSuccess = 0;
+const kEBADF = 8;
+const kPreopenFd = 3;
+const kOpenCreat = 1 << 0;
+const kRightsRead = 1n << 1n;
+const kResultPtr = 0;
+const kPathPtr = 16;
+
+tmpdir.refresh();
+
+[null, 1, 'true', {}].forEach((returnOnExit) => {
+  assert.throws(() => new WASI({ returnOnExit }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+function start(wasi, name) {
+  const bytes = name === 'memory' ?
+    fixtures.readSync(['wasi', 'memory.wasm']) :
+    fs.readFileSync(path.join(__dirname, 'wasm', `${name}.wasm`));
+  const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+    wasi_unstable: wasi.wasiImport
+  });
+  return { exitCode: wasi.start(instance), instance };
+}
+
+{
+  const wasi = new WASI({ returnOnExit: true });
+  assert.strictEqual(start(wasi, 'exitcode').exitCode, 120);
+  wasi.reset();
+  assert.strictEqual(start(wasi, 'exitcode').exitCode, 120);
+  assert.strictEqual(start(wasi, 'memory').exitCode, 0);
+}
+
+{
+  const wasi = new WASI({ preopens: { '/sandbox': tmpdir.path } });
+  const { exitCode, instance } = start(wasi, 'memory');
+  assert.strictEqual(exitCode, 0);
+
+  const {
+    fd_close, fd_fdstat_get, fd_fdstat_set_rights, fd_prestat_get, path_open
+  } = wasi.wasiImport;
+  const memory = instance.exports.memory;
+  const view = new DataView(memory.buffer);
+  const length = Buffer.from(memory.buffer).write('file', kPathPtr);
+  const open = () => path_open(kPreopenFd, 0, kPathPtr, length, kOpenCreat,
+                               kRightsRead, 0n, 0, kResultPtr);
+
+  assert.strictEqual(open(), kSuccess);
+  const fd = view.getUint32(kResultPtr, true);
+  assert.strictEqual(open(), kSuccess);
+  assert.strictEqual(view.getUint32(kResultPtr, true), fd + 1);
+
+  // The guest may also drop rights on, or close, the fds it started with.
+  assert.strictEqual(fd_fdstat_set_rights(kPreopenFd, 0n, 0n), kSuccess);
+  assert.strictEqual(fd_close(1), kSuccess);
+
+  wasi.reset();
+  assert.strictEqual(fd_fdstat_get(fd, kResultPtr), kEBADF);
+  assert.strictEqual(fd_fdstat_get(fd + 1, kResultPtr), kEBADF);
+  assert.strictEqual(fd_fdstat_get(1, kResultPtr), kSuccess);
+  assert.strictEqual(fd_prestat_get(kPreopenFd, kResultPtr), kSuccess);
+  assert.strictEqual(open(), kSuccess);
+  assert.strictEqual(view.getUint32(kResultPtr, true), fd);
+}
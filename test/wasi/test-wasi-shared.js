@@ -0,0 +1,116 @@
+// Flags: --experimental-wasi --experimental-wasm-bigint --experimental-wasm-threads
+'use strict';
+
+// WASI instances on several threads can share one fd table and a shared
+// WebAssembly.Memory, like the threads of a WebAssembly application do.
+const common = require('../common');
+const assert = require('assert');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../common/tmpdir');
+const { Worker, isMainThread, workerData } = require('worker_threads');
+const { WASI } = require('wasi');
+
+const kSuccess = 0;
+const kEBADF = 8;
+const kPreopenFd = 3;
+const kOpenCreat = 1 << 0;
+const kRightsFdRead = 1n << 1n;
+const kRightsFdWrite = 1n << 6n;
+
+function openFile(wasi, view, name, oflags, rights, base) {
+  const length = Buffer.from(view.buffer).write(name, base + 16);
+  const err = wasi.wasiImport.path_open(kPreopenFd, 0, base + 16, length,
+                                        oflags, rights, 0n, 0, base);
+  assert.strictEqual(err, kSuccess);
+  return view.getUint32(base, true);
+}
+
+if (!isMainThread) {
+  // The worker uses its own part of the shared memory.
+  const { context, memory, fd } = workerData;
+  const base = 1024;
+  const wasi = new WASI({ context });
+  assert.strictEqual(wasi.context, context);
+  wasi.setMemory(memory);
+  const view = new DataView(memory.buffer);
+  const { fd_close, fd_read, fd_write } = wasi.wasiImport;
+
+  // Read the file that the main thread opened.
+  view.setUint32(base, base + 64, true);
+  view.setUint32(base + 4, 64, true);
+  assert.strictEqual(fd_read(fd, base, 1, base + 8), kSuccess);
+  const length = view.getUint32(base + 8, true);
+  assert.strictEqual(length, 5);
+  assert.strictEqual(fd_close(fd), kSuccess);
+
+  // Write it back to a new file, which the main thread checks.
+  const output = openFile(wasi, view, 'output', kOpenCreat, kRightsFdWrite,
+                          base + 128);
+  view.setUint32(base + 4, length, true);
+  assert.strictEqual(fd_write(output, base, 1, base + 8), kSuccess);
+  assert.strictEqual(fd_close(output), kSuccess);
+  return;
+}
+
+tmpdir.refresh();
+fs.writeFileSync(path.join(tmpdir.path, 'input'), 'hello');
+
+[null, 1, 'true', {}].forEach((shared) => {
+  assert.throws(() => new WASI({ shared }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+[null, 0, -1, 1.5, '1', {}].forEach((context) => {
+  assert.throws(() => new WASI({ context }), {
+    code: /^ERR_(INVALID_ARG_TYPE|OUT_OF_RANGE)$/
+  });
+});
+
+assert.throws(() => new WASI({ shared: true, async: true }), {
+  code: 'ERR_INVALID_ARG_VALUE'
+});
+
+['args', 'env', 'preopens', 'bundles', 'sockets', 'async', 'shared']
+  .forEach((name) => {
+    assert.throws(() => new WASI({ context: 1, [name]: undefined }), {
+      code: 'ERR_INVALID_ARG_VALUE',
+      message: /is not available/
+    });
+    const value = name === 'args' || name === 'sockets' ? [] :
+      name === 'async' || name === 'shared' ? false : {};
+    assert.throws(() => new WASI({ context: 1, [name]: value }), {
+      code: 'ERR_INVALID_ARG_VALUE',
+      message: new RegExp(`cannot be used with options\\.${name}`)
+    });
+  });
+
+assert.strictEqual(new WASI().context, undefined);
+assert.strictEqual(new WASI({ async: true }).context, undefined);
+
+assert.throws(() => new WASI().setMemory({}), {
+  code: 'ERR_INVALID_ARG_TYPE',
+  name: 'TypeError'
+});
+
+const memory = new WebAssembly.Memory({ initial: 1, maximum: 1, shared: true });
+assert(memory.buffer instanceof SharedArrayBuffer);
+const wasi = new WASI({ preopens: { '/sandbox': tmpdir.path }, shared: true });
+assert.strictEqual(typeof wasi.context, 'number');
+assert.strictEqual(new WASI({ context: wasi.context }).context, wasi.context);
+wasi.setMemory(memory);
+const view = new DataView(memory.buffer);
+const fd = openFile(wasi, view, 'input', 0, kRightsFdRead, 0);
+
+const worker = new Worker(__filename, {
+  workerData: { context: wasi.context, memory, fd }
+});
+worker.on('exit', common.mustCall((code) => {
+  assert.strictEqual(code, 0);
+  // The worker closed the file in the shared fd table.
+  assert.strictEqual(wasi.wasiImport.fd_fdstat_get(fd, 0), kEBADF);
+  assert.strictEqual(
+    fs.readFileSync(path.join(tmpdir.path, 'output'), 'utf8'), 'hello');
+}));
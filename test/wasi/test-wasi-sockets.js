@@ -0,0 +1,165 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// Connected sockets passed in the sockets option can be used by the guest
+// through sock_send(), sock_recv() and sock_shutdown(). The guest owns them
+// from then on, and they are closed on the JavaScript side.
+const common = require('../common');
+
+if (common.isWindows)
+  common.skip('WASI sockets are not supported on Windows');
+
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const fs = require('fs');
+const net = require('net');
+const tmpdir = require('../common/tmpdir');
+const { WASI } = require('wasi');
+
+const kSuccess = 0;
+const kEAGAIN = 6;
+const kEBADF = 8;
+const kEINVAL = 28;
+const kShutWr = 2;
+const kIovPtr = 0;
+const kResultPtr = 16;
+const kFlagsPtr = 20;
+const kDataPtr = 64;
+
+[null, 1, 'socket', {}].forEach((sockets) => {
+  assert.throws(() => new WASI({ sockets }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+assert.throws(() => new WASI({ sockets: [{}] }), {
+  code: 'ERR_INVALID_ARG_TYPE',
+  name: 'TypeError'
+});
+
+assert.throws(() => new WASI({ sockets: [new net.Socket()] }), {
+  code: 'ERR_INVALID_ARG_VALUE',
+  message: /is not connected/
+});
+
+{
+  const socket = new net.Socket();
+  socket.destroy();
+  assert.throws(() => new WASI({ sockets: [socket] }), {
+    code: 'ERR_SOCKET_CLOSED'
+  });
+}
+
+assert.throws(() => new WASI({ sockets: [net.createServer()] }), {
+  code: 'ERR_SERVER_NOT_RUNNING'
+});
+
+tmpdir.refresh();
+const pipeServer = net.createServer(common.mustNotCall());
+pipeServer.listen(common.PIPE, common.mustCall(() => {
+  assert.throws(() => new WASI({ sockets: [pipeServer] }), {
+    code: 'ERR_INVALID_ARG_VALUE',
+    message: /is not a TCP server/
+  });
+
+  const client = net.connect(common.PIPE, common.mustCall(() => {
+    assert.throws(() => new WASI({ sockets: [client] }), {
+      code: 'ERR_INVALID_ARG_VALUE',
+      message: /is not a TCP socket/
+    });
+    client.destroy();
+    pipeServer.close();
+  }));
+}));
+
+function instantiate(wasi) {
+  const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+  const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+    wasi_unstable: wasi.wasiImport
+  });
+  wasi.start(instance);
+  return new DataView(instance.exports.memory.buffer);
+}
+
+const server = net.createServer(common.mustCall((conn) => {
+  assert.throws(() => new WASI({ sockets: [conn], async: true }), {
+    code: 'ERR_INVALID_ARG_VALUE'
+  });
+
+  const wasi = new WASI({ sockets: [conn] });
+  assert.strictEqual(conn.destroyed, true);
+  conn.on('data', common.mustNotCall());
+  const view = instantiate(wasi);
+  const { sock_recv, sock_send, sock_shutdown } = wasi.wasiImport;
+  const fd = 3;
+
+  // The host fd of the destroyed socket may be reused. The guest keeps using
+  // its own duplicate.
+  const files = [];
+  for (let i = 0; i < 4; i++)
+    files.push(fs.openSync(__filename, 'r'));
+
+  view.setUint32(kIovPtr, kDataPtr, true);
+  view.setUint32(kIovPtr + 4, 5, true);
+  Buffer.from('hello').copy(Buffer.from(view.buffer), kDataPtr);
+  assert.strictEqual(sock_send(fd, kIovPtr, 1, 0, kResultPtr), kSuccess);
+  assert.strictEqual(view.getUint32(kResultPtr, true), 5);
+
+  assert.strictEqual(sock_send(99, kIovPtr, 1, 0, kResultPtr), kEBADF);
+  assert.strictEqual(sock_shutdown(fd, 0), kEINVAL);
+
+  view.setUint32(kIovPtr + 4, 32, true);
+  function receive() {
+    const err = sock_recv(fd, kIovPtr, 1, 0, kResultPtr, kFlagsPtr);
+    if (err === kEAGAIN) {
+      setTimeout(receive, 10);
+      return;
+    }
+
+    assert.strictEqual(err, kSuccess);
+    const length = view.getUint32(kResultPtr, true);
+    const data = Buffer.from(view.buffer, kDataPtr, length).toString();
+    assert.strictEqual(data, 'world');
+    assert.strictEqual(view.getUint16(kFlagsPtr, true), 0);
+    assert.strictEqual(sock_shutdown(fd, kShutWr), kSuccess);
+    files.forEach((file) => fs.closeSync(file));
+    server.close();
+  }
+  receive();
+}));
+
+server.listen(0, common.mustCall(() => {
+  const client = net.connect(server.address().port);
+  assert.throws(() => new WASI({ sockets: [client] }), {
+    code: 'ERR_INVALID_ARG_VALUE',
+    message: /is not connected/
+  });
+  let received = '';
+  client.setEncoding('utf8');
+  client.on('data', (chunk) => {
+    received += chunk;
+    if (received === 'hello')
+      client.write('world');
+  });
+  client.on('end', common.mustCall(() => {
+    assert.strictEqual(received, 'hello');
+    client.end();
+  }));
+}));
+
+// A listening server can be passed too. It stops accepting connections on the
+// JavaScript side, although the guest cannot accept them either.
+const listener = net.createServer(common.mustNotCall());
+listener.listen(0, common.mustCall(() => {
+  const { port } = listener.address();
+  listener.on('close', common.mustCall());
+  const wasi = new WASI({ sockets: [listener] });
+  assert.strictEqual(listener.listening, false);
+
+  // The guest still owns the listening socket, so connecting succeeds.
+  const client = net.connect(port, common.mustCall(() => {
+    assert.notStrictEqual(wasi.wasiImport, undefined);
+    client.destroy();
+  }));
+}));
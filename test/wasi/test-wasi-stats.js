@@ -0,0 +1,63 @@
+// Flags: --experimental-wasi --experimental-wasm-bigint
+'use strict';
+
+// getStats() reports call counts and latency histograms per syscall when the
+// WASI instance was created with the stats option.
+require('../common');
+
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const { WASI } = require('wasi');
+
+const kClockMonotonic = 1;
+const kResultPtr = 0;
+const kCalls = 100;
+
+[null, 1, 'true', {}].forEach((stats) => {
+  assert.throws(() => new WASI({ stats }), {
+    code: 'ERR_INVALID_ARG_TYPE',
+    name: 'TypeError'
+  });
+});
+
+function run(options) {
+  const wasi = new WASI(options);
+  const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+  const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+    wasi_unstable: wasi.wasiImport
+  });
+  wasi.start(instance);
+
+  const { clock_time_get, sched_yield } = wasi.wasiImport;
+  for (let i = 0; i < kCalls; i++)
+    assert.strictEqual(clock_time_get(kClockMonotonic, 0n, kResultPtr), 0);
+  assert.strictEqual(sched_yield(), 0);
+  return wasi;
+}
+
+// The helpers are not exposed to the guest.
+assert.strictEqual(run({}).wasiImport._getStats, undefined);
+
+assert.deepStrictEqual(run({}).getStats(), {});
+assert.deepStrictEqual(run({ stats: false }).getStats(), {});
+assert.deepStrictEqual(new WASI({ async: true }).getStats(), {});
+
+const stats = run({ stats: true }).getStats();
+assert.deepStrictEqual(Object.keys(stats).sort(),
+                       ['clock_time_get', 'sched_yield']);
+assert.strictEqual(stats.clock_time_get.count, kCalls);
+assert.strictEqual(stats.sched_yield.count, 1);
+
+for (const name of Object.keys(stats)) {
+  const { min, max, mean, stddev, percentiles } = stats[name];
+  assert(min >= 0);
+  assert(min <= max);
+  assert(mean >= min && mean <= max);
+  assert(stddev >= 0);
+  assert(percentiles instanceof Map);
+  assert(percentiles.size > 0);
+  for (const [percentile, value] of percentiles) {
+    assert(percentile >= 0 && percentile <= 100);
+    assert(value >= min);
+  }
+}
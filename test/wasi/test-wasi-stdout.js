@@ -0,0 +1,156 @@
+// Flags: --experimental-wasi
+'use strict';
+
+// With stdout: 'buffered', guest writes to stdout and stderr are collected and
+// written to process.stdout and process.stderr when the buffer fills up, when
+// the guest exits and when start() returns, in the order the guest made them.
+require('../common');
+const assert = require('assert');
+const cp = require('child_process');
+const fixtures = require('../common/fixtures');
+const path = require('path');
+const { EOL } = require('os');
+const { WASI } = require('wasi');
+
+const kIovPtr = 0;
+const kResultPtr = 8;
+const kDataPtr = 64;
+
+function instantiate(wasi, name) {
+  const bytes = name === undefined ?
+    fixtures.readSync(['wasi', 'memory.wasm']) :
+    require('fs').readFileSync(path.join(__dirname, 'wasm', `${name}.wasm`));
+  return new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+    wasi_unstable: wasi.wasiImport
+  });
+}
+
+function runWrites(mode) {
+  const wasi = new WASI({ stdout: 'buffered' });
+  const instance = instantiate(wasi);
+  wasi.start(instance);
+  // Room for the large writes below.
+  instance.exports.memory.grow(17);
+  const memory = Buffer.from(instance.exports.memory.buffer);
+  const view = new DataView(instance.exports.memory.buffer);
+  const write = (fd, text) => {
+    const length = memory.write(text, kDataPtr);
+    view.setUint32(kIovPtr, kDataPtr, true);
+    view.setUint32(kIovPtr + 4, length, true);
+    assert.strictEqual(wasi.wasiImport.fd_write(fd, kIovPtr, 1, kResultPtr), 0);
+    assert.strictEqual(view.getUint32(kResultPtr, true), length);
+  };
+
+  if (mode === 'large') {
+    // Chunks stay below twice the buffer size, and large writes bypass
+    // process.stdout once the pending output has been passed on.
+    const chunks = [];
+    const streamWrite = process.stdout.write;
+    process.stdout.write = function(chunk) {
+      chunks.push(chunk.length);
+      return streamWrite.apply(this, arguments);
+    };
+    write(1, 'a');
+    write(1, 'y'.repeat(64 * 1024 - 1));
+    write(1, 'b');
+    write(1, 'x'.repeat(1024 * 1024));
+    write(1, 'c');
+    wasi.reset();
+    process.stderr.write(chunks.join());
+    return;
+  }
+
+  if (mode === 'exit') {
+    write(1, 'bye');
+    wasi.wasiImport.proc_exit(3);
+  }
+
+  write(1, 'a');
+  write(1, 'b');
+  write(2, 'c');
+  write(1, 'd');
+  // Output only reaches the streams when the guest switches between them, or
+  // when the buffer is flushed.
+  process.stdout.write('|');
+  wasi.reset();
+  write(1, 'x'.repeat(100 * 1024));
+  process.stdout.write('|');
+}
+
+function runStart(mode, name) {
+  const wasi = new WASI({
+    stdout: 'buffered',
+    preopens: { '/sandbox': fixtures.path('wasi') },
+    returnOnExit: mode === 'returnOnExit'
+  });
+  const exitCode = wasi.start(instantiate(wasi, name));
+  process.stdout.write(`[${exitCode}]`);
+}
+
+if (process.argv[2] === 'child') {
+  if (process.argv[3] === 'start' || process.argv[3] === 'returnOnExit')
+    runStart(process.argv[3], process.argv[4]);
+  else
+    runWrites(process.argv[3]);
+} else {
+  parent();
+}
+
+function parent() {
+  [1, 'line', null].forEach((stdout) => {
+    assert.throws(() => new WASI({ stdout }), {
+      code: 'ERR_INVALID_ARG_VALUE',
+      name: 'TypeError'
+    });
+  });
+
+  function run(...args) {
+    const child = cp.spawnSync(process.execPath, [
+      '--experimental-wasi',
+      '--experimental-wasm-bigint',
+      '--no-warnings',
+      __filename,
+      'child',
+      ...args
+    ]);
+    assert.strictEqual(child.signal, null);
+    return child;
+  }
+
+  {
+    const child = run('writes');
+    assert.strictEqual(child.status, 0);
+    assert.strictEqual(child.stdout.toString(),
+                       `ab|d${'x'.repeat(100 * 1024)}|`);
+    assert.strictEqual(child.stderr.toString(), 'c');
+  }
+
+  {
+    const child = run('large');
+    assert.strictEqual(child.status, 0);
+    assert.strictEqual(child.stdout.toString(),
+                       `a${'y'.repeat(64 * 1024 - 1)}b` +
+                       `${'x'.repeat(1024 * 1024)}c`);
+    assert.strictEqual(child.stderr.toString(), `${64 * 1024},1,1`);
+  }
+
+  {
+    const child = run('start', 'read_file');
+    assert.strictEqual(child.status, 0);
+    assert.strictEqual(child.stdout.toString(),
+                       `hello from input.txt${EOL}[0]`);
+  }
+
+  {
+    // proc_exit() flushes before it exits the process.
+    const child = run('exit');
+    assert.strictEqual(child.status, 3);
+    assert.strictEqual(child.stdout.toString(), 'bye');
+  }
+
+  {
+    const child = run('returnOnExit', 'exitcode');
+    assert.strictEqual(child.status, 0);
+    assert.strictEqual(child.stdout.toString(), '[120]');
+  }
+}
@@ -0,0 +1,58 @@
+'use strict';
+
+// Syscalls are emitted as spans in the node.wasi trace category.
+const common = require('../common');
+const assert = require('assert');
+const cp = require('child_process');
+const fs = require('fs');
+const path = require('path');
+const tmpdir = require('../common/tmpdir');
+
+if (process.argv[2] === 'child') {
+  const fixtures = require('../common/fixtures');
+  const { WASI } = require('wasi');
+  const wasi = new WASI();
+  const bytes = fixtures.readSync(['wasi', 'memory.wasm']);
+  const instance = new WebAssembly.Instance(new WebAssembly.Module(bytes), {
+    wasi_unstable: wasi.wasiImport
+  });
+  wasi.start(instance);
+  wasi.wasiImport.sched_yield();
+  wasi.wasiImport.args_sizes_get(0, 4);
+} else {
+  tmpdir.refresh();
+
+  const proc = cp.fork(__filename,
+                       [ 'child' ], {
+                         cwd: tmpdir.path,
+                         execArgv: [
+                           '--experimental-wasi',
+                           '--no-warnings',
+                           '--trace-event-categories',
+                           'node.wasi'
+                         ]
+                       });
+
+  proc.once('exit', common.mustCall((code) => {
+    assert.strictEqual(code, 0);
+    const file = path.join(tmpdir.path, 'node_trace.1.log');
+
+    assert(fs.existsSync(file));
+    fs.readFile(file, common.mustCall((err, data) => {
+      assert.ifError(err);
+      const traces = JSON.parse(data.toString()).traceEvents
+        .filter((trace) => trace.cat !== '__metadata');
+      const phases = traces.map((trace) => `${trace.name}:${trace.ph}`);
+      assert.deepStrictEqual(phases, [
+        'sched_yield:B',
+        'sched_yield:E',
+        'args_sizes_get:B',
+        'args_sizes_get:E'
+      ]);
+      traces.forEach((trace) => {
+        assert.strictEqual(trace.pid, proc.pid);
+        assert.strictEqual(trace.cat, 'node,node.wasi');
+      });
+    }));
+  }));
+}
@@ -36,6 +36,16 @@ if (process.argv[2] === 'wasi-child') {
   const cp = require('child_process');
   const { EOL } = require('os');
 
+  function childArgs(test) {
+    return [
+      '--experimental-wasi',
+      '--experimental-wasm-bigint',
+      __filename,
+      'wasi-child',
+      test
+    ];
+  }
+
   function runWASI(options) {
     console.log('executing', options.test);
     const opts = { env: { ...process.env, NODE_DEBUG_NATIVE: 'wasi' } };
@@ -43,13 +53,7 @@ if (process.argv[2] === 'wasi-child') {
     if (options.stdin !== undefined)
       opts.input = options.stdin;
 
-    const child = cp.spawnSync(process.execPath, [
-      '--experimental-wasi',
-      '--experimental-wasm-bigint',
-      __filename,
-      'wasi-child',
-      options.test
-    ], opts);
+    const child = cp.spawnSync(process.execPath, childArgs(options.test), opts);
     console.log(child.stderr.toString());
     assert.strictEqual(child.status, options.exitCode || 0);
     assert.strictEqual(child.signal, null);
@@ -64,7 +68,6 @@ if (process.argv[2] === 'wasi-child') {
   runWASI({ test: 'getrusage' });
   runWASI({ test: 'gettimeofday' });
   runWASI({ test: 'notdir' });
-  // runWASI({ test: 'poll' });
   runWASI({ test: 'preopen_populates' });
   runWASI({ test: 'read_file', stdout: `hello from input.txt${EOL}` });
   runWASI({
@@ -80,5 +83,19 @@ if (process.argv[2] === 'wasi-child') {
     runWASI({ test: 'stdin', stdin: 'hello world', stdout: 'hello world' });
     runWASI({ test: 'symlink_escape' });
     runWASI({ test: 'symlink_loop' });
+
+    // poll.wasm waits for stdin to time out, so the pipe is kept open, and
+    // empty, until the child exits.
+    console.log('executing poll');
+    const child = cp.spawn(process.execPath, childArgs('poll'));
+    let stdout = '';
+    child.stdout.setEncoding('utf8');
+    child.stdout.on('data', (chunk) => stdout += chunk);
+    child.stderr.pipe(process.stderr);
+    child.on('close', common.mustCall((code, signal) => {
+      assert.strictEqual(code, 0);
+      assert.strictEqual(signal, null);
+      assert.strictEqual(stdout, '');
+    }));
   }
 }